@@ -42,6 +42,15 @@ namespace dxvk {
   }
 
 
+  // NV-DXVK start: Implement memoization for some expensive CPU operations
+  uint64_t D3D9CommonBuffer::NextWriteGeneration() {
+    // Buffers may be created and locked from multiple threads
+    static std::atomic<uint64_t> s_writeGeneration = { 1 };
+    return s_writeGeneration.fetch_add(1, std::memory_order_relaxed);
+  }
+  // NV-DXVK end
+
+
   HRESULT D3D9CommonBuffer::Lock(
           UINT   OffsetToLock,
           UINT   SizeToLock,
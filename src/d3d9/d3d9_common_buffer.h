@@ -216,6 +216,21 @@ namespace dxvk {
     };
     using RemixIboMemoizer = MemoryRegionMemoizer<RemixIndexBufferMemoizationData>;
     RemixIboMemoizer remixMemoization;
+
+    /**
+     * \brief Write generation of the buffer contents
+     *
+     * Unique across all buffers and renewed whenever the buffer may have
+     * been written to, so results derived from the contents of a buffer
+     * can be keyed on it, even if the buffer is destroyed and its address
+     * reused.
+     */
+    uint64_t GetWriteGeneration() const { return m_writeGeneration; }
+
+    /**
+     * \brief Signals that the buffer contents may have changed
+     */
+    void RenewWriteGeneration() { m_writeGeneration = NextWriteGeneration(); }
     // NV-DXVK end
 
   private:
@@ -253,6 +268,12 @@ namespace dxvk {
 
     uint64_t                    m_seq = 0ull;
 
+    // NV-DXVK start: Implement memoization for some expensive CPU operations
+    uint64_t                    m_writeGeneration = NextWriteGeneration();
+
+    static uint64_t NextWriteGeneration();
+    // NV-DXVK end
+
   };
 
 }
\ No newline at end of file
@@ -8,8 +8,12 @@
 
 #include "../util/util_math.h"
 #include "../util/util_vector.h"
+// NV-DXVK start: only upload changed constants
+#include "../util/util_dirty_range.h"
+// NV-DXVK end
 
 #include <cstdint>
+#include <cstring>
 
 namespace dxvk {
 
@@ -49,6 +53,27 @@ namespace dxvk {
     Rc<DxvkBuffer>            buffer;
     DxsoShaderMetaInfo        meta  = {};
     bool                      dirty = true;
+    // NV-DXVK start: only upload changed constants
+    // Registers changed since each recycled buffer slice was last written
+    UploadDirtyTracker        floatRanges;
+    UploadDirtyTracker        intRanges;
+    // NV-DXVK end
   };
 
+  // NV-DXVK start: only upload changed constants
+  /**
+   * \brief Brings a recycled slice up to date with the shadow constants
+   *
+   * Copies the registers that changed since the slice was last written,
+   * or all \c count registers for a slice the tracker does not know.
+   */
+  template<typename T>
+  void CopyDirtyConstants(UploadDirtyTracker& ranges, const void* slice, T* dst, const T* src, uint32_t count) {
+    const UploadDirtyTracker::Range range = ranges.beginUpload(slice, count);
+
+    if (!range.empty())
+      std::memcpy(dst + range.begin, src + range.begin, range.size() * sizeof(T));
+  }
+  // NV-DXVK end
+
 }
\ No newline at end of file
@@ -79,7 +79,9 @@ namespace dxvk {
     , m_behaviorFlags  ( BehaviorFlags ) // Might want to add a mode to force SWVP?
     , m_adapter        ( pAdapter )
     , m_dxvkDevice     ( dxvkDevice )
-    , m_shaderModules  ( new D3D9ShaderModuleSet )
+// NV-DXVK start: persistent shader cache
+    , m_shaderModules  ( new D3D9ShaderModuleSet(dxvkDevice) )
+// NV-DXVK end
 // NV-DXVK start: different default values for d3d9 options
     , m_d3d9Options    ( dxvkDevice, pParent->GetInstance()->config(), WithRemixAPI )
 // NV-DXVK end
@@ -160,6 +162,11 @@ namespace dxvk {
 
 
   D3D9DeviceEx::~D3D9DeviceEx() {
+    // NV-DXVK start: background shader translation
+    // Translation workers use the device
+    m_shaderModules->StopTranslation();
+    // NV-DXVK end
+
     Flush();
     SynchronizeCsThread();
 
@@ -2947,6 +2954,9 @@ namespace dxvk {
     }
 
     dst->SetWrittenByGPU(true);
+    // NV-DXVK start: Implement memoization for some expensive CPU operations
+    dst->RenewWriteGeneration();
+    // NV-DXVK end
     TrackBufferMappingBufferSequenceNumber(dst);
 
     return D3D_OK;
@@ -3076,7 +3086,9 @@ namespace dxvk {
     DxsoModuleInfo moduleInfo;
     moduleInfo.options = m_dxsoOptions;
 
-    D3D9CommonShader module;
+    // NV-DXVK start: background shader translation
+    D3D9CommonShaderHandle module;
+    // NV-DXVK end
 
     if (FAILED(this->CreateShaderModule(&module,
       VK_SHADER_STAGE_VERTEX_BIT,
@@ -3102,6 +3114,11 @@ namespace dxvk {
     if (shader == m_state.vertexShader.ptr())
       return D3D_OK;
 
+    // NV-DXVK start: background shader translation
+    if (shader != nullptr && !m_shaderModules->WaitForModule(shader->GetModule()))
+      return D3DERR_INVALIDCALL;
+    // NV-DXVK end
+
     auto* oldShader = GetCommonShader(m_state.vertexShader);
     auto* newShader = GetCommonShader(shader);
 
@@ -3420,7 +3437,9 @@ namespace dxvk {
     DxsoModuleInfo moduleInfo;
     moduleInfo.options = m_dxsoOptions;
 
-    D3D9CommonShader module;
+    // NV-DXVK start: background shader translation
+    D3D9CommonShaderHandle module;
+    // NV-DXVK end
 
     if (FAILED(this->CreateShaderModule(&module,
       VK_SHADER_STAGE_FRAGMENT_BIT,
@@ -3446,6 +3465,11 @@ namespace dxvk {
     if (shader == m_state.pixelShader.ptr())
       return D3D_OK;
 
+    // NV-DXVK start: background shader translation
+    if (shader != nullptr && !m_shaderModules->WaitForModule(shader->GetModule()))
+      return D3DERR_INVALIDCALL;
+    // NV-DXVK end
+
     auto* oldShader = GetCommonShader(m_state.pixelShader);
     auto* newShader = GetCommonShader(shader);
 
@@ -5072,6 +5096,7 @@ namespace dxvk {
 
       // NV-DXVK start: Implement memoization for some expensive CPU operations
       pResource->remixMemoization.invalidateAll();
+      pResource->RenewWriteGeneration();
       // NV-DXVK end
     }
     else {
@@ -5107,6 +5132,7 @@ namespace dxvk {
       // NV-DXVK start: Implement memoization for some expensive CPU operations
       if (!readOnly) {
         pResource->remixMemoization.invalidate(offset, size);
+        pResource->RenewWriteGeneration();
       }
       // NV-DXVK end
     }
@@ -5180,6 +5206,12 @@ namespace dxvk {
     if (pResource->DecrementLockCount() != 0)
       return D3D_OK;
 
+    // NV-DXVK start: Implement memoization for some expensive CPU operations
+    // Draws issued while the buffer was locked may have seen partially written contents
+    if (!(pResource->GetMapFlags() & D3DLOCK_READONLY))
+      pResource->RenewWriteGeneration();
+    // NV-DXVK end
+
     if (pResource->GetMapMode() != D3D9_COMMON_BUFFER_MAP_MODE_BUFFER)
       return D3D_OK;
 
@@ -5422,17 +5454,30 @@ namespace dxvk {
     // Max copy source size is 8192 * 16 => always aligned to any plausible value
     // => we won't copy out of bounds
     if (likely(constSet.meta.maxConstIndexF != 0 || floatBuffer == nullptr)) {
-      DxvkBufferSliceHandle floatBufferSlice = CopySoftwareConstants(DxsoConstantBuffers::VSFloatConstantBuffer, floatBuffer, Src.fConsts, floatDataSize, m_dxsoOptions.vertexFloatConstantBufferAsSSBO);
+      // NV-DXVK start: only upload changed constants
+      DxvkBufferSliceHandle floatBufferSlice = CopySoftwareConstants(DxsoConstantBuffers::VSFloatConstantBuffer, floatBuffer, Src.fConsts, floatDataSize, m_dxsoOptions.vertexFloatConstantBufferAsSSBO, &constSet.floatRanges);
+      // NV-DXVK end
 
       if (constSet.meta.needsConstantCopies) {
         Vector4* data = reinterpret_cast<Vector4*>(floatBufferSlice.mapPtr);
 
         auto& shaderConsts = GetCommonShader(m_state.vertexShader)->GetConstants();
 
+        // NV-DXVK start: only upload changed constants
+        uint32_t defBegin = ~0u;
+        uint32_t defEnd = 0;
+
         for (const auto& constant : shaderConsts) {
-          if (constant.uboIdx < constSet.meta.maxConstIndexF)
+          if (constant.uboIdx < constSet.meta.maxConstIndexF) {
             data[constant.uboIdx] = *reinterpret_cast<const Vector4*>(constant.float32);
+            defBegin = std::min(defBegin, constant.uboIdx);
+            defEnd = std::max(defEnd, constant.uboIdx + 1);
+          }
         }
+
+        // The slice no longer matches the application's constants there
+        constSet.floatRanges.markDirty(defBegin, defEnd);
+        // NV-DXVK end
       }
     }
 
@@ -5440,17 +5485,25 @@ namespace dxvk {
     // Max copy source size is 2048 * 16 => always aligned to any plausible value
     // => we won't copy out of bounds
     if (likely(constSet.meta.maxConstIndexI != 0 || intBuffer == nullptr)) {
-      CopySoftwareConstants(DxsoConstantBuffers::VSIntConstantBuffer, intBuffer, Src.iConsts, intDataSize, false);
+      // NV-DXVK start: only upload changed constants
+      CopySoftwareConstants(DxsoConstantBuffers::VSIntConstantBuffer, intBuffer, Src.iConsts, intDataSize, false, &constSet.intRanges);
+      // NV-DXVK end
     }
 
     Rc<DxvkBuffer>& boolBuffer = constSet.swvpBuffers.boolBuffer;
     if (likely(constSet.meta.maxConstIndexB != 0 || boolBuffer == nullptr)) {
-      CopySoftwareConstants(DxsoConstantBuffers::VSBoolConstantBuffer, boolBuffer, Src.bConsts, boolDataSize, false);
+      // NV-DXVK start: only upload changed constants
+      // Bools are a few dwords at most, not worth tracking
+      CopySoftwareConstants(DxsoConstantBuffers::VSBoolConstantBuffer, boolBuffer, Src.bConsts, boolDataSize, false, nullptr);
+      // NV-DXVK end
     }
   }
 
 
-  inline DxvkBufferSliceHandle D3D9DeviceEx::CopySoftwareConstants(DxsoConstantBuffers cBufferTarget, Rc<DxvkBuffer>& dstBuffer, const void* src, uint32_t size, bool useSSBO) {
+  // NV-DXVK start: only upload changed constants
+  template<typename T>
+  inline DxvkBufferSliceHandle D3D9DeviceEx::CopySoftwareConstants(DxsoConstantBuffers cBufferTarget, Rc<DxvkBuffer>& dstBuffer, const T* src, uint32_t size, bool useSSBO, UploadDirtyTracker* ranges) {
+  // NV-DXVK end
     ScopedCpuProfileZone();
     uint32_t alignment = useSSBO ? m_robustSSBOAlignment : m_robustUBOAlignment;
     alignment = std::max(alignment, 64u);
@@ -5461,6 +5514,11 @@ namespace dxvk {
     if (unlikely(dstBuffer == nullptr || dstBuffer->info().size < size)) {
       dstBuffer = CreateConstantBuffer(useSSBO, size, DxsoProgramType::VertexShader, cBufferTarget);
       slice = dstBuffer->getSliceHandle();
+
+      // NV-DXVK start: only upload changed constants
+      if (ranges != nullptr)
+        ranges->invalidate();
+      // NV-DXVK end
     } else {
       slice = dstBuffer->allocSlice();
       EmitCs([
@@ -5471,7 +5529,12 @@ namespace dxvk {
       });
     }
 
-    std::memcpy(slice.mapPtr, src, size);
+    // NV-DXVK start: only upload changed constants
+    if (ranges != nullptr)
+      CopyDirtyConstants(*ranges, slice.mapPtr, reinterpret_cast<T*>(slice.mapPtr), src, size / uint32_t(sizeof(T)));
+    else
+      std::memcpy(slice.mapPtr, src, size);
+    // NV-DXVK end
     return slice;
   }
 
@@ -5529,21 +5592,34 @@ namespace dxvk {
 
     auto* dst = reinterpret_cast<HardwareLayoutType*>(slice.mapPtr);
 
+    // NV-DXVK start: only upload changed constants
+    // Slices are recycled with the constants of their last upload still in
+    // them, so only the registers changed since then need to be copied.
     if (constSet.meta.maxConstIndexI != 0)
-      std::memcpy(dst->iConsts, Src.iConsts, intDataSize);
+      CopyDirtyConstants(constSet.intRanges, slice.mapPtr, dst->iConsts, Src.iConsts, intDataSize / uint32_t(sizeof(Vector4i)));
     if (constSet.meta.maxConstIndexF != 0)
-      std::memcpy(dst->fConsts, Src.fConsts, floatDataSize);
+      CopyDirtyConstants(constSet.floatRanges, slice.mapPtr, dst->fConsts, Src.fConsts, floatDataSize / uint32_t(sizeof(Vector4)));
 
     if (constSet.meta.needsConstantCopies) {
       Vector4* data = reinterpret_cast<Vector4*>(dst->fConsts);
 
       auto& shaderConsts = GetCommonShader(Shader)->GetConstants();
 
+      uint32_t defBegin = ~0u;
+      uint32_t defEnd = 0;
+
       for (const auto& constant : shaderConsts) {
-        if (constant.uboIdx < constSet.meta.maxConstIndexF)
+        if (constant.uboIdx < constSet.meta.maxConstIndexF) {
           data[constant.uboIdx] = *reinterpret_cast<const Vector4*>(constant.float32);
+          defBegin = std::min(defBegin, constant.uboIdx);
+          defEnd = std::max(defEnd, constant.uboIdx + 1);
+        }
       }
+
+      // The slice no longer matches the application's constants there
+      constSet.floatRanges.markDirty(defBegin, defEnd);
     }
+    // NV-DXVK end
   }
 
 
@@ -6911,7 +6987,9 @@ namespace dxvk {
 
 
   HRESULT D3D9DeviceEx::CreateShaderModule(
-        D3D9CommonShader*     pShaderModule,
+// NV-DXVK start: background shader translation
+        D3D9CommonShaderHandle* pShaderModule,
+// NV-DXVK end
         VkShaderStageFlagBits ShaderStage,
   const DWORD*                pShaderBytecode,
   const DxsoModuleInfo*       pModuleInfo) {
@@ -6981,6 +7059,14 @@ namespace dxvk {
         : m_consts[ProgramType].meta.maxConstIndexI;
 
       m_consts[ProgramType].dirty |= StartRegister < maxCount;
+
+      // NV-DXVK start: only upload changed constants
+      // Tracked even if the shader doesn't read them, a later one might
+      if constexpr (ConstantType == D3D9ConstantType::Float)
+        m_consts[ProgramType].floatRanges.markDirty(StartRegister, StartRegister + Count);
+      else
+        m_consts[ProgramType].intRanges.markDirty(StartRegister, StartRegister + Count);
+      // NV-DXVK end
     } else if constexpr (ProgramType == DxsoProgramType::VertexShader) {
       if (unlikely(CanSWVP())) {
         m_consts[DxsoProgramType::VertexShader].dirty |= StartRegister < m_consts[ProgramType].meta.maxConstIndexB;
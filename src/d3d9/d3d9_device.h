@@ -830,7 +830,10 @@ namespace dxvk {
 
     inline void UploadSoftwareConstantSet(const D3D9ShaderConstantsVSSoftware& Src, const D3D9ConstantLayout& Layout);
 
-    inline DxvkBufferSliceHandle CopySoftwareConstants(DxsoConstantBuffers cBufferTarget, Rc<DxvkBuffer>& dstBuffer, const void* src, uint32_t copySize, bool useSSBO);
+    // NV-DXVK start: only upload changed constants
+    template<typename T>
+    inline DxvkBufferSliceHandle CopySoftwareConstants(DxsoConstantBuffers cBufferTarget, Rc<DxvkBuffer>& dstBuffer, const T* src, uint32_t copySize, bool useSSBO, UploadDirtyTracker* ranges);
+    // NV-DXVK end
 
     template <DxsoProgramType ShaderStage, typename HardwareLayoutType, typename SoftwareLayoutType, typename ShaderType>
     inline void UploadConstantSet(const SoftwareLayoutType& Src, const D3D9ConstantLayout& Layout, const ShaderType& Shader);
@@ -1009,7 +1012,9 @@ namespace dxvk {
     bool ShouldRecord();
 
     HRESULT               CreateShaderModule(
-            D3D9CommonShader*     pShaderModule,
+// NV-DXVK start: background shader translation
+            D3D9CommonShaderHandle* pShaderModule,
+// NV-DXVK end
             VkShaderStageFlagBits ShaderStage,
       const DWORD*                pShaderBytecode,
       const DxsoModuleInfo*       pModuleInfo);
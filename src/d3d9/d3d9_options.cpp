@@ -102,6 +102,9 @@ namespace dxvk {
     this->alphaTestWiggleRoom           = config.getOption<bool>        ("d3d9.alphaTestWiggleRoom",           false);
     this->apitraceMode                  = config.getOption<bool>        ("d3d9.apitraceMode",                  false);
     this->deviceLocalConstantBuffers    = config.getOption<bool>        ("d3d9.deviceLocalConstantBuffers",    false);
+    // NV-DXVK start: background shader translation
+    this->asyncShaderTranslation        = config.getOption<bool>        ("d3d9.asyncShaderTranslation",        false);
+    // NV-DXVK end
     this->maxEnabledLights              = config.getOption<int32_t>     ("d3d9.maxEnabledLights",              caps::MaxEnabledLights);
     // NV-DXVK start: adapter override conf
     this->adapterOverride = config.getOption<int32_t>("d3d9.adapterOverride", -1);
@@ -193,6 +193,12 @@ namespace dxvk {
     /// Use device local memory for constant buffers.
     bool deviceLocalConstantBuffers;
 
+    // NV-DXVK start: background shader translation
+    /// Translate shaders on worker threads, modules are waited for when first bound.
+    /// Off by default, since translation errors are then reported by the bind rather than the create call.
+    bool asyncShaderTranslation;
+    // NV-DXVK end
+
     // NV-DXVK start: adapter override conf
     /// Override the adapter/GPU used for D3D9 (-1 = use application defined)
     int adapterOverride;
@@ -27,7 +27,8 @@ namespace dxvk {
     : m_rtStagingData(d3d9Device->GetDXVKDevice(), (VkMemoryPropertyFlagBits) (VK_MEMORY_PROPERTY_HOST_CACHED_BIT | VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT))
     , m_parent(d3d9Device)
     , m_enableDrawCallConversion(enableDrawCallConversion)
-    , m_pGeometryWorkers(enableDrawCallConversion ? std::make_unique<GeometryProcessor>(numGeometryProcessingThreads(), "geometry-processing") : nullptr) {
+    , m_pGeometryWorkers(enableDrawCallConversion ? std::make_unique<GeometryProcessor>(numGeometryProcessingThreads(), "geometry-processing", TaskOverflowPolicy::Inline) : nullptr)
+    , m_frameOptions(RtxFrameOptions::copy()) {
 
     // Add space for 256 objects skinned with 256 bones each.
     m_stagedBones.resize(256 * 256);
@@ -102,10 +103,33 @@ namespace dxvk {
       return result;
     };
 
+    // Draws of a sub-range of previously processed indices can use a view of the processed
+    // indices, as long as the sub-range has the same min index (i.e. indices were rebased alike).
+    // The sub-range min/max only depends on the query, so it is computed once on the first
+    // containing range rather than for every container visited in the interval tree.
+    bool hasSubRangeMinMax = false;
+    uint32_t subRangeMin = 0, subRangeMax = 0;
+    auto deriveSubRange = [&indexCtx, indexCount, &hasSubRangeMinMax, &subRangeMin, &subRangeMax](const D3D9CommonBuffer::RemixIndexBufferMemoizationData& container, const size_t containerOffset,
+                                                                                                  const size_t containerSize, const size_t offset, const size_t size) {
+      std::optional<D3D9CommonBuffer::RemixIndexBufferMemoizationData> result;
+
+      if (!hasSubRangeMinMax) {
+        const T* pIndices = (const T*) ((const uint8_t*) indexCtx.indexBuffer.mapPtr + offset);
+        fast::findMinMax<T>(indexCount, pIndices, subRangeMin, subRangeMax);
+        hasSubRangeMinMax = true;
+      }
+
+      if (subRangeMin == container.min) {
+        result = D3D9CommonBuffer::RemixIndexBufferMemoizationData { container.slice.subSlice(offset - containerOffset, size), subRangeMin, subRangeMax };
+      }
+
+      return result;
+    };
+
     if (enableIndexBufferMemoization() && indexCtx.ibo != nullptr) {
       // If we have an index buffer, we can utilize memoization
       D3D9CommonBuffer::RemixIboMemoizer& memoization = indexCtx.ibo->remixMemoization;
-      const auto result = memoization.memoize(indexOffset, numIndexBytes, processing);
+      const auto result = memoization.memoize(indexOffset, numIndexBytes, processing, deriveSubRange);
       minIndex = result.min;
       maxIndex = result.max;
       return result.slice;
@@ -204,7 +228,7 @@ namespace dxvk {
     });
   }
 
-  void D3D9Rtx::processVertices(const VertexContext vertexContext[caps::MaxStreams], int vertexIndexOffset, RasterGeometry& geoData) {
+  void D3D9Rtx::processVertices(const VertexContext vertexContext[caps::MaxStreams], int vertexIndexOffset, RasterGeometry& geoData, GeometryAnalysisKey& analysisKey) {
     DxvkBufferSlice streamCopies[caps::MaxStreams] {};
 
     // Process vertex buffers from CPU
@@ -293,6 +317,22 @@ namespace dxvk {
 
         *targetBuffer = RasterBuffer(streamCopies[element.Stream], element.Offset, ctx.stride, DecodeDecltype(D3DDECLTYPE(element.Type)));
         assert(targetBuffer->offset() % 4 == 0);
+
+        // Streams read by the geometry analysis identify its results
+        if (targetBuffer == &geoData.positionBuffer || targetBuffer == &geoData.texcoordBuffer || targetBuffer == &geoData.blendIndicesBuffer) {
+          if (ctx.pVBO != nullptr) {
+            const struct {
+              uint64_t writeGeneration;
+              int32_t offset;
+              uint32_t stride;
+              uint32_t type;
+              uint32_t usage;
+            } source = { ctx.pVBO->GetWriteGeneration(), vertexOffset + element.Offset, ctx.stride, element.Type, element.Usage };
+            analysisKey.add(source);
+          } else {
+            analysisKey.valid = false;
+          }
+        }
       }
     }
   }
@@ -579,11 +619,28 @@ namespace dxvk {
     // This can be negative!!
     int vertexIndexOffset = drawContext.BaseVertexIndex;
 
+    // Identifies the data the geometry analysis will read, so the results of unchanged data can be reused
+    GeometryAnalysisKey analysisKey;
+    analysisKey.valid = enableGeometryAnalysisCache();
+
     // Process index buffer
     uint32_t minIndex = 0, maxIndex = 0;
     if (indexContext.indexType != VK_INDEX_TYPE_NONE_KHR) {
       geoData.indexCount = GetVertexCount(drawContext.PrimitiveType, drawContext.PrimitiveCount);
 
+      if (indexContext.ibo != nullptr) {
+        const struct {
+          uint64_t writeGeneration;
+          uint32_t startIndex;
+          uint32_t indexCount;
+          uint32_t indexType;
+          uint32_t padding;
+        } indices = { indexContext.ibo->GetWriteGeneration(), drawContext.StartIndex, geoData.indexCount, (uint32_t) indexContext.indexType, 0 };
+        analysisKey.add(indices);
+      } else {
+        analysisKey.valid = false;
+      }
+
       if (indexContext.indexType == VK_INDEX_TYPE_UINT16)
         geoData.indexBuffer = RasterBuffer(processIndexBuffer<uint16_t>(geoData.indexCount, drawContext.StartIndex, indexContext, minIndex, maxIndex), 0, 2, indexContext.indexType);
       else
@@ -641,12 +698,13 @@ namespace dxvk {
     const uint32_t maxOffsetedIndex = maxIndex - minIndex;
 
     // Copy all the vertices into a staging buffer.  Assign fields of the geoData structure.
-    processVertices(vertexContext, vertexIndexOffset, geoData);
-    geoData.futureGeometryHashes = computeHash(geoData, maxOffsetedIndex);
-    geoData.futureBoundingBox = computeAxisAlignedBoundingBox(geoData);
-    
-    // Process skinning data
-    m_activeDrawCallState.futureSkinningData = processSkinning(geoData);
+    processVertices(vertexContext, vertexIndexOffset, geoData, analysisKey);
+
+    // Hash the geometry, compute its bounding box and process skinning data in a single pass over the vertices
+    SkinningQuery skinning;
+    const bool isSkinned = prepareSkinning(geoData, skinning);
+    geoData.futureAnalysis = analyzeGeometry(geoData, maxOffsetedIndex, isSkinned ? &skinning : nullptr, analysisKey);
+    m_activeDrawCallState.hasPendingSkinningData = isSkinned && geoData.futureAnalysis.valid();
 
     // Hash material data
     m_activeDrawCallState.materialData.updateCachedHash();
@@ -746,13 +804,11 @@ namespace dxvk {
     }
   }
 
-  Future<SkinningData> D3D9Rtx::processSkinning(const RasterGeometry& geoData) {
+  bool D3D9Rtx::prepareSkinning(const RasterGeometry& geoData, SkinningQuery& skinningOut) {
     ScopedCpuProfileZone();
 
-    static const auto kEmptySkinningFuture = Future<SkinningData>();
-
     if (m_parent->UseProgrammableVS()) {
-      return kEmptySkinningFuture;
+      return false;
     }
 
     // Some games set vertex blend without enough data to actually do the blending, handle that logic below.
@@ -762,15 +818,15 @@ namespace dxvk {
     const bool indexedVertexBlend = hasBlendIndices && d3d9State().renderStates[D3DRS_INDEXEDVERTEXBLENDENABLE];
 
     if (d3d9State().renderStates[D3DRS_VERTEXBLEND] == D3DVBF_DISABLE) {
-      return kEmptySkinningFuture;
+      return false;
     }
 
     if (d3d9State().renderStates[D3DRS_VERTEXBLEND] != D3DVBF_0WEIGHTS) {
       if (!hasBlendWeight) {
-        return kEmptySkinningFuture;
+        return false;
       }
     } else if (!indexedVertexBlend) {
-      return kEmptySkinningFuture;
+      return false;
     }
 
     // We actually have skinning data now, process it!
@@ -783,27 +839,25 @@ namespace dxvk {
     case D3DVBF_3WEIGHTS: numBonesPerVertex = 4; break;
     }
 
-    const uint32_t vertexCount = geoData.vertexCount;
-
-    HashQuery blendIndices;
-    // Analyze the vertex data and find the min and max bone indices used in this mesh.
+    // Find the min and max bone indices used in this mesh during the geometry analysis.
     // The min index is used to detect a case when vertex blend is enabled but there is just one bone used in the mesh,
     // so we can drop the skinning pass. That is processed in RtxContext::commitGeometryToRT(...)
     if (indexedVertexBlend && geoData.blendIndicesBuffer.defined()) {
       auto& buffer = geoData.blendIndicesBuffer;
+      HashQuery& blendIndices = skinningOut.blendIndices;
 
       blendIndices.pBase = (uint8_t*) buffer.mapPtr(buffer.offsetFromSlice());
       blendIndices.elementSize = imageFormatInfo(buffer.vertexFormat())->elementSize;
       blendIndices.stride = buffer.stride();
-      blendIndices.size = blendIndices.stride * vertexCount;
+      blendIndices.size = blendIndices.stride * geoData.vertexCount;
       blendIndices.ref = buffer.buffer().ptr();
 
       // Acquire prevents the staging allocator from re-using this memory
       blendIndices.ref->acquire(DxvkAccess::Read);
-      // Make sure we hold on to this reference while the hashing is in flight
+      // Make sure we hold on to this reference while the analysis is in flight
       blendIndices.ref->incRef();
     } else {
-      blendIndices.ref = nullptr;
+      skinningOut.blendIndices.ref = nullptr;
     }
 
     // Copy bones up to the max bone we have registered so far.
@@ -818,43 +872,10 @@ namespace dxvk {
     memcpy(boneMatrices, d3d9State().transforms.data() + startBoneTransform, sizeof(Matrix4)*(maxBone + 1));
     m_stagedBonesCount += maxBone + 1;
 
-    return m_pGeometryWorkers->Schedule([boneMatrices, blendIndices, numBonesPerVertex, vertexCount]()->SkinningData {
-      ScopedCpuProfileZone();
-      uint32_t numBones = numBonesPerVertex;
-
-      int minBoneIndex = 0;
-      if (blendIndices.ref) {
-        const uint8_t* pBlendIndices = blendIndices.pBase;
-        // Find out how many bone indices are specified for each vertex.
-        // This is needed to find out the min bone index and ignore the padding zeroes.
-        int maxBoneIndex = -1;
-        if (!getMinMaxBoneIndices(pBlendIndices, blendIndices.stride, vertexCount, numBonesPerVertex, minBoneIndex, maxBoneIndex)) {
-          minBoneIndex = 0;
-          maxBoneIndex = 0;
-        }
-        numBones = maxBoneIndex + 1;
-
-        // Release this memory back to the staging allocator
-        blendIndices.ref->release(DxvkAccess::Read);
-        blendIndices.ref->decRef();
-      }
-
-      // Pass bone data to RT back-end
+    skinningOut.pBoneMatrices = boneMatrices;
+    skinningOut.numBonesPerVertex = numBonesPerVertex;
 
-      SkinningData skinningData;
-      skinningData.pBoneMatrices.reserve(numBones);
-
-      for (uint32_t n = 0; n < numBones; n++) {
-        skinningData.pBoneMatrices.push_back(boneMatrices[n]);
-      }
-
-      skinningData.minBoneIndex = minBoneIndex;
-      skinningData.numBones = numBones;
-      skinningData.numBonesPerVertex = numBonesPerVertex;
-      skinningData.computeHash(); // Computes the hash and stores it in the skinningData itself
-
-      return skinningData;
-    });
+    return true;
   }
 
   template<bool FixedFunction>
@@ -1170,6 +1191,14 @@ namespace dxvk {
     m_seenCameraPositionsPrev = std::move(m_seenCameraPositions);
 
     m_stagedBonesCount = 0;
+    m_frameOptions = RtxFrameOptions::copy();
+
+    const GeometryAnalysisCache::Stats cacheStats = m_geometryAnalysisCache.endFrame();
+    m_parent->EmitCs([cacheStats](DxvkContext* ctx) {
+      DxvkStatCounters& counters = ctx->getDevice()->statCounters();
+      counters.setCtr(DxvkStatCounter::RtxGeometryAnalysisCacheHits, cacheStats.hits);
+      counters.setCtr(DxvkStatCounter::RtxGeometryAnalysisCacheMisses, cacheStats.misses);
+    });
   }
 
   void D3D9Rtx::OnPresent(const Rc<DxvkImage>& targetImage) {
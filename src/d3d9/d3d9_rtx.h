@@ -2,6 +2,7 @@
 
 #include "d3d9_state.h"
 #include "../dxvk/dxvk_buffer.h"
+#include "../dxvk/rtx_render/rtx_frame_options.h"
 #include "../util/util_threadpool.h"
 
 #include <vector>
@@ -29,6 +30,74 @@ namespace dxvk {
   }
   using PrepareDrawFlags = uint32_t;
 
+  // Skinning state of a draw, captured on the submit thread for the geometry analysis
+  struct SkinningQuery {
+    const Matrix4* pBoneMatrices = nullptr;
+    HashQuery blendIndices = {};    // ref is nullptr if the vertices carry no bone indices
+    uint32_t numBonesPerVertex = 0;
+  };
+
+  // Results of the geometry analysis that only depend on the vertex and index data of a draw
+  struct VertexDataAnalysis {
+    GeometryHashes hashes;              // per-draw components (descriptor, layout, shader) are left empty
+    AxisAlignedBoundingBox boundingBox;
+    uint8_t minBoneIndex = 0;           // range of the bone indices used by the vertices, if skinned
+    uint8_t maxBoneIndex = 0;
+  };
+
+  // Identifies the vertex and index data a geometry analysis reads, by the buffers it is read
+  // from, their write generations and the way the draw addresses them
+  struct GeometryAnalysisKey {
+    XXH64_hash_t hash = kEmptyHash;
+    bool valid = true;                  // false if some of the data did not come from a buffer object
+
+    template<typename T>
+    void add(const T& data) {
+      static_assert(std::has_unique_object_representations_v<T>, "Padding bytes would make the key unstable.");
+      hash = XXH3_64bits_withSeed(&data, sizeof(data), hash);
+    }
+  };
+
+  /**
+   * \brief Geometry analysis results of unchanged vertex and index data
+   *
+   * Static geometry is drawn every frame from the same buffers, this lets
+   * the draws reuse hashes, bounding boxes and bone ranges computed in
+   * earlier frames instead of reading the vertices again.  Results are
+   * looked up on the submit thread and stored by the geometry workers,
+   * those not used for a while are released at the end of a frame.
+   */
+  class GeometryAnalysisCache {
+  public:
+    struct Stats {
+      uint32_t hits = 0;
+      uint32_t misses = 0;
+    };
+
+    bool lookup(const XXH64_hash_t key, VertexDataAnalysis& analysisOut);
+
+    void store(const XXH64_hash_t key, const VertexDataAnalysis& analysis);
+
+    /**
+      * \brief Releases results unused for a while, returns the stats of the frame
+      */
+    Stats endFrame();
+
+  private:
+    static constexpr uint32_t kFramesToKeep = 60;
+    static constexpr size_t kMaxEntries = 32 * 1024;
+
+    struct Entry {
+      VertexDataAnalysis analysis;
+      uint32_t frameLastUsed;
+    };
+
+    sync::Spinlock m_mutex;
+    fast_unordered_cache<Entry> m_entries;
+    uint32_t m_frame = 0;
+    Stats m_stats;
+  };
+
   //This class handles all of the RTX operations that are required from the D3D9 side.
   struct D3D9Rtx {
     friend class ImGUI; // <-- we want to modify these values directly.
@@ -40,6 +109,7 @@ namespace dxvk {
     RTX_OPTION("rtx", bool, useVertexCapture, true, "When enabled, injects code into the original vertex shader to capture final shaded vertex positions.  Is useful for games using simple vertex shaders, that still also set the fixed function transform matrices.");
     RTX_OPTION("rtx", bool, useVertexCapturedNormals, true, "When enabled, vertex normals are read from the input assembler and used in raytracing.  This doesn't always work as normals can be in any coordinate space, but can help sometimes.");
     RTX_OPTION("rtx", bool, useWorldMatricesForShaders, true, "When enabled, Remix will utilize the world matrices being passed from the game via D3D9 fixed function API, even when running with shaders.  Sometimes games pass these matrices and they are useful, however for some games they are very unreliable, and should be filtered out.  If you're seeing precision related issues with shader vertex capture, try disabling this setting.");
+    RTX_OPTION("rtx", bool, enableGeometryAnalysisCache, true, "CPU performance optimization, should generally be enabled.  Will reduce geometry processing time by reusing the hashes and bounding boxes of draw calls whose vertex and index buffers were not written to since they were last drawn, this will come at the expense of some CPU RAM.");
     RTX_OPTION("rtx", bool, enableIndexBufferMemoization, true, "CPU performance optimization, should generally be enabled.  Will reduce main thread time by caching processIndexBuffer operations and reusing when possible, this will come at the expense of some CPU RAM.");
     RTX_OPTION("rtx", uint32_t, numGeometryProcessingThreads, 2, "The desired number of CPU threads to dedicate to geometry processing  Will be limited by the number of CPU cores.  There may be some advantage to lowering this number in games which are fairly simple and use a low number of draw calls per frame.  The default was determined by looking at a game with around 2000 draw calls per frame, and with a reasonably high average triangle count per draw.");
 
@@ -173,7 +243,10 @@ namespace dxvk {
 
   private: 
     inline static const uint32_t kMaxConcurrentDraws = 6 * 1024; // some games issuing >3000 draw calls per frame...  account for some consumer thread lag with x2
-    using GeometryProcessor = WorkerThreadPool<kMaxConcurrentDraws>;
+    // Note: overflowing tasks are executed inline, so a burst of draws never loses its hashes/skinning data.
+    //       Multi-producer mode lets the consumer thread help process geometry while waiting on a result,
+    //       rather than spinning.
+    using GeometryProcessor = WorkerThreadPool<kMaxConcurrentDraws, true, true, true>;
     const std::unique_ptr<GeometryProcessor> m_pGeometryWorkers;
     AtomicQueue<DrawCallState, kMaxConcurrentDraws> m_drawCallStateQueue;
 
@@ -207,6 +280,12 @@ namespace dxvk {
 
     fast_unordered_cache<Rc<DxvkSampler>> m_samplerCache;
 
+    GeometryAnalysisCache m_geometryAnalysisCache;
+
+    // Copy of the frame options taken at the end of each frame, the published
+    // options may only be read in place on the CS thread
+    RtxFrameOptions m_frameOptions;
+
     // NOTE: to avoid calculating matrix inverse,
     //       m_seenCameraPositions doesn't contain the actual positions,
     //       but only relative values, see USE_TRUE_CAMERA_POSITION_FOR_COMPARISON
@@ -242,7 +321,7 @@ namespace dxvk {
 
     void prepareVertexCapture(const int vertexIndexOffset);
 
-    void processVertices(const VertexContext vertexContext[caps::MaxStreams], int vertexIndexOffset, RasterGeometry& geoData);
+    void processVertices(const VertexContext vertexContext[caps::MaxStreams], int vertexIndexOffset, RasterGeometry& geoData, GeometryAnalysisKey& analysisKey);
 
     bool processRenderState();
 
@@ -264,11 +343,9 @@ namespace dxvk {
 
     bool isRenderingUI();
 
-    Future<SkinningData> processSkinning(const RasterGeometry& geoData);
-
-    Future<AxisAlignedBoundingBox> computeAxisAlignedBoundingBox(const RasterGeometry& geoData);
+    bool prepareSkinning(const RasterGeometry& geoData, SkinningQuery& skinningOut);
 
-    Future<GeometryHashes> computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue);
+    Future<GeometryAnalysis> analyzeGeometry(const RasterGeometry& geoData, const uint32_t maxIndexValue, const SkinningQuery* pSkinning, GeometryAnalysisKey analysisKey);
 
     void submitActiveDrawCallState();
   };
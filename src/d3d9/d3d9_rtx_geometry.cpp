@@ -5,6 +5,7 @@
 #include "d3d9_state.h"
 #include "../dxvk/dxvk_buffer.h"
 #include "../dxvk/rtx_render/rtx_hashing.h"
+#include "../dxvk/rtx_render/rtx_frame_options.h"
 #include "../util/util_fastops.h"
 
 namespace dxvk {
@@ -41,79 +42,254 @@ namespace dxvk {
     return true;
   }
 
-  // Sorts and deduplicates a set of integers, storing the result in a vector
-  template<typename T>
-  void deduplicateSortIndices(const void* pIndexData, const size_t indexCount, const uint32_t maxIndexValue, std::vector<T>& uniqueIndicesOut) {
-    // TODO (REMIX-657): Implement optimized variant of this function
-    // We know there will be at most, this many unique indices
-    const uint32_t indexRange = maxIndexValue + 1;
-
-    // Initialize all to 0
-    uniqueIndicesOut.resize(indexRange, (T)0);
+  // Scratch memory of a geometry worker, reused across draws so that hashing does not allocate
+  struct GeometryHashingScratch {
+    // Kept zeroed between uses, see fast::deduplicateSort
+    std::vector<uint8_t> indexFlags;
+    std::vector<uint16_t> uniqueIndices16;
+    std::vector<uint32_t> uniqueIndices32;
+    std::vector<uint64_t> segmentHashes;
+
+    template<typename T>
+    std::vector<T>& getUniqueIndices() {
+      if constexpr (std::is_same<T, uint16_t>::value) {
+        return uniqueIndices16;
+      } else {
+        return uniqueIndices32;
+      }
+    }
 
-    // Use memory as a bin table for index data
-    for (uint32_t i = 0; i < indexCount; i++) {
-      const T& index = ((T*) pIndexData)[i];
-      assert(index <= maxIndexValue);
-      uniqueIndicesOut[index] = 1;
+    template<typename T>
+    std::vector<T>& getOtherUniqueIndices() {
+      if constexpr (std::is_same<T, uint16_t>::value) {
+        return uniqueIndices32;
+      } else {
+        return uniqueIndices16;
+      }
     }
+  };
 
-    // Repopulate the bins with contiguous index values
-    uint32_t uniqueIndexCount = 0;
-    for (uint32_t i = 0; i < indexRange; i++) {
-      if (uniqueIndicesOut[i])
-        uniqueIndicesOut[uniqueIndexCount++] = i;
+  static thread_local GeometryHashingScratch g_hashingScratch;
+
+  // Scratch buffers larger than this are released once a draw needs far less of them,
+  // so that a single huge draw does not pin its scratch memory on every worker forever
+  static constexpr size_t kScratchRetainBytes = 4 * 1024 * 1024;
+  static constexpr size_t kScratchShrinkFactor = 8;
+
+  // Sizes a scratch buffer for the current draw: grows as needed and shrinks it back
+  // when it is both above the retained size and far above the current need
+  template<typename T>
+  void fitScratch(std::vector<T>& scratch, const size_t size) {
+    const size_t capacityBytes = scratch.capacity() * sizeof(T);
+    if (capacityBytes > kScratchRetainBytes && scratch.capacity() > size * kScratchShrinkFactor) {
+      // Reallocating also hands back zeroed memory, as indexFlags expects
+      std::vector<T>().swap(scratch);
     }
 
-    // Remove any unused entries
-    uniqueIndicesOut.resize(uniqueIndexCount);
+    if (scratch.size() < size)
+      scratch.resize(size);
+  }
+
+  // Sorts and deduplicates a set of indices into the scratch memory of the calling thread,
+  // the result stays valid until the next call on the same thread
+  template<typename T>
+  const T* deduplicateSortIndices(const void* pIndexData, const size_t indexCount, const uint32_t maxIndexValue, uint32_t& uniqueIndexCountOut) {
+    GeometryHashingScratch& scratch = g_hashingScratch;
+
+    // New flags are zeroed on resize
+    const size_t flagsSize = fast::deduplicateSortScratchSize(maxIndexValue);
+    fitScratch(scratch.indexFlags, flagsSize);
+
+    // We know there will be at most, this many unique indices
+    const size_t maxUniqueIndexCount = std::min<size_t>(indexCount, (size_t) maxIndexValue + 1);
+    std::vector<T>& uniqueIndices = scratch.getUniqueIndices<T>();
+    fitScratch(uniqueIndices, maxUniqueIndexCount);
+    fitScratch(scratch.getOtherUniqueIndices<T>(), 0);
+
+    uniqueIndexCountOut = fast::deduplicateSort(uniqueIndices.data(), (const T*) pIndexData, (uint32_t) indexCount, maxIndexValue, scratch.indexFlags.data());
+    return uniqueIndices.data();
   }
 
+  // Inputs of the geometry analysis that are not read from vertex or index data
+  struct DrawAnalysisParams {
+    const Matrix4* pBoneMatrices;
+    uint32_t numBonesPerVertex;       // 0 if the draw is not skinned
+    bool hasBoneRange;                // bone indices were read from the vertices
+    XXH64_hash_t vertexShaderHash;
+    XXH64_hash_t geometryDescriptorHash;
+    XXH64_hash_t vertexLayoutHash;
+  };
+
+  // Everything the geometry analysis needs, captured on the submit thread
+  // Note: Workers never read RtxFrameOptions, the options they depend on are captured here.
+  struct GeometryAnalysisQuery {
+    HashRule hashRule;
+    HashQuery vertexRegions[VertexRegions::Count];
+    HashQuery blendIndices;           // ref is nullptr if no bone indices are read
+    DrawAnalysisParams draw;
+    const void* pIndexData;
+    DxvkBuffer* indexBufferRef;
+    size_t indexStride;
+    uint32_t indexCount;
+    uint32_t vertexCount;
+    uint32_t maxIndexValue;
+    uint32_t hashParallelVertexThreshold;
+    bool computeBoundingBox;
+    XXH64_hash_t cacheKey;            // kEmptyHash if the results can not be cached
+    GeometryAnalysisCache* pCache;
+  };
+
+  // Vertices analyzed per step.  A block of vertex data stays in L1 while it is bounded,
+  // scanned for bone indices and hashed, so the vertices are only read from memory once.
+  static constexpr uint32_t kAnalysisBlockSize = 256;
+
   template<typename T>
-  void hashGeometryData(const size_t indexCount, const uint32_t maxIndexValue, const void* pIndexData,
-                        DxvkBuffer* indexBufferRef, const HashQuery vertexRegions[VertexRegions::Count], GeometryHashes& hashesOut) {
+  void analyzeGeometryData(const GeometryAnalysisQuery& query, VertexDataAnalysis& analysisOut) {
     ScopedCpuProfileZone();
 
-    const HashRule& globalHashRule = RtxOptions::Get()->GeometryHashGenerationRule;
+    const HashRule globalHashRule = query.hashRule;
+    GeometryHashes& hashesOut = analysisOut.hashes;
 
-    // TODO (REMIX-658): Improve this by reducing allocation overhead of vector
-    std::vector<T> uniqueIndices(0);
+    const T* uniqueIndices = nullptr;
+    uint32_t uniqueIndexCount = 0;
     if constexpr (!std::is_same<T, NoIndices>::value) {
-      assert((indexCount > 0 && indexBufferRef));
-      deduplicateSortIndices(pIndexData, indexCount, maxIndexValue, uniqueIndices);
+      assert((query.indexCount > 0 && query.indexBufferRef));
+      uniqueIndices = deduplicateSortIndices<T>(query.pIndexData, query.indexCount, query.maxIndexValue, uniqueIndexCount);
 
       if (globalHashRule.test(HashComponents::Indices)) {
-        hashesOut[HashComponents::Indices] = hashContiguousMemory(pIndexData, indexCount * sizeof(T));
+        hashesOut[HashComponents::Indices] = hashContiguousMemory(query.pIndexData, query.indexCount * sizeof(T));
       }
 
       // TODO (REMIX-656): Remove this once we can transition content to new hash
       if (globalHashRule.test(HashComponents::LegacyIndices)) {
-        hashesOut[HashComponents::LegacyIndices] = hashIndicesLegacy<T>(pIndexData, indexCount);
+        hashesOut[HashComponents::LegacyIndices] = hashIndicesLegacy<T>(query.pIndexData, query.indexCount);
       }
 
       // Release this memory back to the staging allocator
-      indexBufferRef->release(DxvkAccess::Read);
-      indexBufferRef->decRef();
+      query.indexBufferRef->release(DxvkAccess::Read);
+      query.indexBufferRef->decRef();
     }
 
-    // Do vertex based rules
-    for (uint32_t i = 0; i < (uint32_t) HashComponents::Count; i++) {
-      const HashComponents& component = (HashComponents) i;
+    // Version 2 vertex hashes gather the vertices themselves, the original ones are chained
+    // block by block in the vertex pass below
+    const bool useVertexDataV2 = globalHashRule.test(HashComponents::VertexDataV2);
+    bool hashRegion[VertexRegions::Count] = {};
+    XXH64_hash_t regionHashes[VertexRegions::Count] = {};
+    for (const auto& [component, region] : componentToRegionMap) {
+      if (globalHashRule.test(component)) {
+        hashRegion[region] = true;
+      }
+    }
+
+    const HashQuery& positions = query.vertexRegions[VertexRegions::Position];
+    const HashQuery& blendIndices = query.blendIndices;
+    const bool findBoneRange = query.draw.hasBoneRange;
+
+    float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+    float maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+    uint8_t minBoneIndex = UINT8_MAX;
+    uint8_t maxBoneIndex = 0;
+
+    uint32_t nextUniqueIndex = 0;
+    for (uint32_t first = 0; first < query.vertexCount; first += kAnalysisBlockSize) {
+      const uint32_t count = std::min(kAnalysisBlockSize, query.vertexCount - first);
 
-      if (globalHashRule.test(component) && componentToRegionMap.count(component) > 0) {
-        const VertexRegions::Type region = componentToRegionMap.at(component);
-        hashesOut[component] = hashVertexRegionIndexed(vertexRegions[(uint32_t)region], uniqueIndices);
+      if (query.computeBoundingBox) {
+        fast::extendBoundingBox(positions.pBase + first * positions.stride, positions.stride, count, minPos, maxPos);
+      }
+
+      if (findBoneRange) {
+        fast::extendByteRange(blendIndices.pBase + first * blendIndices.stride, blendIndices.stride, count,
+                              query.draw.numBonesPerVertex, minBoneIndex, maxBoneIndex);
+      }
+
+      if (useVertexDataV2) {
+        continue;
+      }
+
+      if constexpr (!std::is_same<T, NoIndices>::value) {
+        // Unique indices are sorted, the ones referencing this block follow those of the previous blocks
+        const uint32_t firstUniqueIndex = nextUniqueIndex;
+        while (nextUniqueIndex < uniqueIndexCount && uniqueIndices[nextUniqueIndex] < first + count) {
+          ++nextUniqueIndex;
+        }
+
+        if (nextUniqueIndex == firstUniqueIndex) {
+          continue;
+        }
+
+        for (uint32_t region = 0; region < VertexRegions::Count; region++) {
+          if (hashRegion[region]) {
+            regionHashes[region] = hashVertexRegionIndexed(query.vertexRegions[region], uniqueIndices + firstUniqueIndex,
+                                                           nextUniqueIndex - firstUniqueIndex, regionHashes[region]);
+          }
+        }
+      } else {
+        for (uint32_t region = 0; region < VertexRegions::Count; region++) {
+          if (hashRegion[region]) {
+            HashQuery block = query.vertexRegions[region];
+            block.pBase += first * block.stride;
+            block.size = count * block.stride;
+            regionHashes[region] = hashVertexRegionIndexed<NoIndices>(block, nullptr, 0, regionHashes[region]);
+          }
+        }
       }
     }
 
+    for (uint32_t region = 0; region < VertexRegions::Count; region++) {
+      if (!hashRegion[region]) {
+        continue;
+      }
+
+      if (useVertexDataV2) {
+        regionHashes[region] = hashVertexRegionIndexedStreamed(query.vertexRegions[region], uniqueIndices, uniqueIndexCount,
+                                                               query.hashParallelVertexThreshold, g_hashingScratch.segmentHashes);
+      } else if (nextUniqueIndex < uniqueIndexCount) {
+        // Indices past the vertex count, chained on in the same order as a whole region hash would
+        regionHashes[region] = hashVertexRegionIndexed(query.vertexRegions[region], uniqueIndices + nextUniqueIndex,
+                                                       uniqueIndexCount - nextUniqueIndex, regionHashes[region]);
+      }
+    }
+
+    for (const auto& [component, region] : componentToRegionMap) {
+      if (globalHashRule.test(component)) {
+        hashesOut[component] = regionHashes[region];
+      }
+    }
+
+    // Tag the hashes with their version, so rules including it never match the original version
+    if (useVertexDataV2) {
+      const uint32_t version = 2;
+      hashesOut[HashComponents::VertexDataV2] = hashContiguousMemory(&version, sizeof(version));
+    }
+
     // TODO (REMIX-656): Remove this once we can transition content to new hash
     if (globalHashRule.test(HashComponents::LegacyPositions0) || globalHashRule.test(HashComponents::LegacyPositions1)) {
-      hashRegionLegacy(vertexRegions[VertexRegions::Position], hashesOut[HashComponents::LegacyPositions0], hashesOut[HashComponents::LegacyPositions1]);
+      hashRegionLegacy(positions, hashesOut[HashComponents::LegacyPositions0], hashesOut[HashComponents::LegacyPositions1]);
+    }
+
+    if (query.computeBoundingBox) {
+      analysisOut.boundingBox = AxisAlignedBoundingBox{
+        Vector3{ minPos[0], minPos[1], minPos[2] },
+        Vector3{ maxPos[0], maxPos[1], maxPos[2] }
+      };
+    }
+
+    if (findBoneRange) {
+      // Bone indices past numBonesPerVertex are padding and were not included in the range
+      if (query.vertexCount > 0) {
+        analysisOut.minBoneIndex = minBoneIndex;
+        analysisOut.maxBoneIndex = maxBoneIndex;
+      }
+
+      // Release this memory back to the staging allocator
+      blendIndices.ref->release(DxvkAccess::Read);
+      blendIndices.ref->decRef();
     }
 
     // Release this memory back to the staging allocator
     for (uint32_t i = 0; i < VertexRegions::Count; i++) {
-      const HashQuery& region = vertexRegions[i];
+      const HashQuery& region = query.vertexRegions[i];
       if (region.size == 0)
         continue;
 
@@ -124,141 +300,217 @@ namespace dxvk {
     }
   }
 
-  Future<GeometryHashes> D3D9Rtx::computeHash(const RasterGeometry& geoData, const uint32_t maxIndexValue) {
-    ScopedCpuProfileZone();
+  // Combines the results of the vertex and index data with the per-draw inputs
+  void finalizeGeometryAnalysis(const VertexDataAnalysis& data, const DrawAnalysisParams& draw, GeometryAnalysis& analysisOut) {
+    GeometryHashes& hashes = analysisOut.hashes;
+    hashes = data.hashes;
 
-    const uint32_t indexCount = geoData.indexCount;
-    const uint32_t vertexCount = geoData.vertexCount;
+    // Finalize the descriptor hash
+    hashes[HashComponents::GeometryDescriptor] = draw.geometryDescriptorHash;
+    hashes[HashComponents::VertexLayout] = draw.vertexLayoutHash;
+    hashes[HashComponents::VertexShader] = draw.vertexShaderHash;
 
-    HashQuery vertexRegions[VertexRegions::Count];
-    memset(&vertexRegions[0], 0, sizeof(vertexRegions));
+    assert(hashes[HashComponents::VertexPosition] != kEmptyHash);
 
-    if (!getVertexRegion(geoData.positionBuffer, vertexCount, vertexRegions[VertexRegions::Position]))
-      return Future<GeometryHashes>(); //invalid
+    hashes.precombine();
 
-    // Acquire prevents the staging allocator from re-using this memory
-    vertexRegions[VertexRegions::Position].ref->acquire(DxvkAccess::Read);
-    vertexRegions[VertexRegions::Position].ref->incRef();
+    analysisOut.boundingBox = data.boundingBox;
 
-    if (getVertexRegion(geoData.texcoordBuffer, vertexCount, vertexRegions[VertexRegions::Texcoord])) {
-      vertexRegions[VertexRegions::Texcoord].ref->acquire(DxvkAccess::Read);
-      vertexRegions[VertexRegions::Texcoord].ref->incRef();
+    if (draw.numBonesPerVertex > 0) {
+      uint32_t numBones = draw.numBonesPerVertex;
+      uint32_t minBone = 0;
+
+      if (draw.hasBoneRange) {
+        minBone = data.minBoneIndex;
+        numBones = data.maxBoneIndex + 1;
+      }
+
+      // Pass bone data to RT back-end
+      SkinningData& skinningData = analysisOut.skinningData;
+      skinningData.pBoneMatrices.assign(draw.pBoneMatrices, draw.pBoneMatrices + numBones);
+      skinningData.minBoneIndex = minBone;
+      skinningData.numBones = numBones;
+      skinningData.numBonesPerVertex = draw.numBonesPerVertex;
+      skinningData.computeHash(); // Computes the hash and stores it in the skinningData itself
     }
+  }
 
-    // Make sure we hold a ref to the index buffer while hashing.
-    const Rc<DxvkBuffer> indexBufferRef = geoData.indexBuffer.buffer();
-    if (indexBufferRef.ptr()) {
-      indexBufferRef->acquire(DxvkAccess::Read);
-      indexBufferRef->incRef();
+  bool GeometryAnalysisCache::lookup(const XXH64_hash_t key, VertexDataAnalysis& analysisOut) {
+    std::lock_guard<sync::Spinlock> lock(m_mutex);
+
+    auto it = m_entries.find(key);
+    if (it == m_entries.end()) {
+      ++m_stats.misses;
+      return false;
+    }
+
+    ++m_stats.hits;
+    it->second.frameLastUsed = m_frame;
+    analysisOut = it->second.analysis;
+    return true;
+  }
+
+  void GeometryAnalysisCache::store(const XXH64_hash_t key, const VertexDataAnalysis& analysis) {
+    std::lock_guard<sync::Spinlock> lock(m_mutex);
+
+    // Stop caching rather than evicting results that may still be in use, unused ones are released at the end of the frame
+    if (m_entries.size() >= kMaxEntries) {
+      return;
+    }
+
+    m_entries[key] = Entry { analysis, m_frame };
+  }
+
+  GeometryAnalysisCache::Stats GeometryAnalysisCache::endFrame() {
+    ScopedCpuProfileZone();
+    std::lock_guard<sync::Spinlock> lock(m_mutex);
+
+    for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+      if (it->second.frameLastUsed + kFramesToKeep < m_frame) {
+        it = m_entries.erase(it);
+      } else {
+        ++it;
+      }
     }
-    const void* pIndexData = geoData.indexBuffer.defined() ? geoData.indexBuffer.mapPtr(0) : nullptr;
-    const size_t indexStride = geoData.indexBuffer.stride();
-    const size_t indexDataSize = indexCount * indexStride;
+
+    ++m_frame;
+
+    const Stats stats = m_stats;
+    m_stats = Stats();
+    return stats;
+  }
+
+  Future<GeometryAnalysis> D3D9Rtx::analyzeGeometry(const RasterGeometry& geoData, const uint32_t maxIndexValue, const SkinningQuery* pSkinning, GeometryAnalysisKey analysisKey) {
+    ScopedCpuProfileZone();
+
+    GeometryAnalysisQuery query;
+    memset(&query.vertexRegions[0], 0, sizeof(query.vertexRegions));
+    query.blendIndices = pSkinning ? pSkinning->blendIndices : HashQuery {};
+
+    if (!getVertexRegion(geoData.positionBuffer, geoData.vertexCount, query.vertexRegions[VertexRegions::Position])) {
+      // Nothing will consume the bone indices
+      if (query.blendIndices.ref) {
+        query.blendIndices.ref->release(DxvkAccess::Read);
+        query.blendIndices.ref->decRef();
+      }
+      return Future<GeometryAnalysis>(); //invalid
+    }
+
+    const HashRule globalHashRule = m_frameOptions.geometryHashGenerationRule;
+    query.hashRule = globalHashRule;
+
+    query.draw.pBoneMatrices = pSkinning ? pSkinning->pBoneMatrices : nullptr;
+    query.draw.numBonesPerVertex = pSkinning ? pSkinning->numBonesPerVertex : 0;
+    query.draw.hasBoneRange = query.draw.numBonesPerVertex > 0 && query.blendIndices.ref != nullptr;
+    query.computeBoundingBox = m_frameOptions.needsMeshBoundingBox;
+    query.hashParallelVertexThreshold = m_frameOptions.geometryHashParallelVertexThreshold;
 
     // Assume the GPU changed the data via shaders, include the constant buffer data in hash
-    XXH64_hash_t vertexShaderHash = kEmptyHash;
+    query.draw.vertexShaderHash = kEmptyHash;
     if (m_parent->UseProgrammableVS() && useVertexCapture()) {
-      if (RtxOptions::Get()->GeometryHashGenerationRule.test(HashComponents::GeometryDescriptor)) {
+      if (globalHashRule.test(HashComponents::GeometryDescriptor)) {
         const D3D9ConstantSets& cb = m_parent->m_consts[DxsoProgramTypes::VertexShader];
         auto& shaderByteCode = d3d9State().vertexShader->GetCommonShader()->GetBytecode();
-        vertexShaderHash = XXH3_64bits(shaderByteCode.data(), shaderByteCode.size());
-        vertexShaderHash = XXH3_64bits_withSeed(&d3d9State().vsConsts.fConsts[0], cb.meta.maxConstIndexF * sizeof(float) * 4, vertexShaderHash);
-        vertexShaderHash = XXH3_64bits_withSeed(&d3d9State().vsConsts.iConsts[0], cb.meta.maxConstIndexI * sizeof(int) * 4, vertexShaderHash);
-        vertexShaderHash = XXH3_64bits_withSeed(&d3d9State().vsConsts.bConsts[0], cb.meta.maxConstIndexB * sizeof(uint32_t)/32, vertexShaderHash);
+        query.draw.vertexShaderHash = XXH3_64bits(shaderByteCode.data(), shaderByteCode.size());
+        query.draw.vertexShaderHash = XXH3_64bits_withSeed(&d3d9State().vsConsts.fConsts[0], cb.meta.maxConstIndexF * sizeof(float) * 4, query.draw.vertexShaderHash);
+        query.draw.vertexShaderHash = XXH3_64bits_withSeed(&d3d9State().vsConsts.iConsts[0], cb.meta.maxConstIndexI * sizeof(int) * 4, query.draw.vertexShaderHash);
+        query.draw.vertexShaderHash = XXH3_64bits_withSeed(&d3d9State().vsConsts.bConsts[0], cb.meta.maxConstIndexB * sizeof(uint32_t)/32, query.draw.vertexShaderHash);
       }
     }
 
     // Calculate this based on the RasterGeometry input data
-    XXH64_hash_t geometryDescriptorHash = kEmptyHash;
-    if (RtxOptions::Get()->GeometryHashGenerationRule.test(HashComponents::GeometryDescriptor)) {
-      geometryDescriptorHash = hashGeometryDescriptor(geoData.indexCount, 
-                                                      geoData.vertexCount, 
-                                                      geoData.indexBuffer.indexType(), 
-                                                      geoData.topology);
+    query.draw.geometryDescriptorHash = kEmptyHash;
+    if (globalHashRule.test(HashComponents::GeometryDescriptor)) {
+      query.draw.geometryDescriptorHash = hashGeometryDescriptor(geoData.indexCount, 
+                                                                 geoData.vertexCount, 
+                                                                 geoData.indexBuffer.indexType(), 
+                                                                 geoData.topology);
     }
 
     // Calculate this based on the RasterGeometry input data
-    XXH64_hash_t vertexLayoutHash = kEmptyHash;
-    if (RtxOptions::Get()->GeometryHashGenerationRule.test(HashComponents::VertexLayout)) {
-      vertexLayoutHash = hashVertexLayout(geoData);
+    query.draw.vertexLayoutHash = kEmptyHash;
+    if (globalHashRule.test(HashComponents::VertexLayout)) {
+      query.draw.vertexLayoutHash = hashVertexLayout(geoData);
     }
 
-    return m_pGeometryWorkers->Schedule([vertexRegions, indexBufferRef = indexBufferRef.ptr(),
-                                 pIndexData, indexStride, indexDataSize, indexCount,
-                                 maxIndexValue, vertexShaderHash, geometryDescriptorHash,
-                                 vertexLayoutHash]() -> GeometryHashes {
-      ScopedCpuProfileZone();
-
-      GeometryHashes hashes;
-
-      // Finalize the descriptor hash
-      hashes[HashComponents::GeometryDescriptor] = geometryDescriptorHash;
-      hashes[HashComponents::VertexLayout] = vertexLayoutHash;
-      hashes[HashComponents::VertexShader] = vertexShaderHash;
+    // Everything else the vertex data analysis depends on, besides the data itself
+    query.cacheKey = kEmptyHash;
+    if (analysisKey.valid) {
+      const struct {
+        uint32_t hashRule;
+        uint32_t vertexCount;
+        uint32_t numBonesPerVertex;
+        uint32_t hasBoneRange;
+        uint32_t computeBoundingBox;
+      } params = { globalHashRule.raw(), geoData.vertexCount, query.draw.numBonesPerVertex, query.draw.hasBoneRange, query.computeBoundingBox };
+      analysisKey.add(params);
+      query.cacheKey = analysisKey.hash;
+    }
 
-      // Index hash
-      switch (indexStride) {
-      case 2:
-        hashGeometryData<uint16_t>(indexCount, maxIndexValue, pIndexData, indexBufferRef, vertexRegions, hashes);
-        break;
-      case 4:
-        hashGeometryData<uint32_t>(indexCount, maxIndexValue, pIndexData, indexBufferRef, vertexRegions, hashes);
-        break;
-      default:
-        hashGeometryData<NoIndices>(indexCount, maxIndexValue, pIndexData, indexBufferRef, vertexRegions, hashes);
-        break;
+    VertexDataAnalysis cached;
+    if (query.cacheKey != kEmptyHash && m_geometryAnalysisCache.lookup(query.cacheKey, cached)) {
+      // The vertices are never read, release the bone indices right away
+      if (query.blendIndices.ref) {
+        query.blendIndices.ref->release(DxvkAccess::Read);
+        query.blendIndices.ref->decRef();
       }
 
-      assert(hashes[HashComponents::VertexPosition] != kEmptyHash);
+      return m_pGeometryWorkers->Schedule([cached, draw = query.draw]() -> GeometryAnalysis {
+        ScopedCpuProfileZone();
 
-      hashes.precombine();
+        GeometryAnalysis analysis;
+        finalizeGeometryAnalysis(cached, draw, analysis);
+        return analysis;
+      });
+    }
 
-      return hashes;
-    });
-  }
+    query.pCache = &m_geometryAnalysisCache;
 
-  Future<AxisAlignedBoundingBox> D3D9Rtx::computeAxisAlignedBoundingBox(const RasterGeometry& geoData) {
-    ScopedCpuProfileZone();
+    // Acquire prevents the staging allocator from re-using this memory
+    query.vertexRegions[VertexRegions::Position].ref->acquire(DxvkAccess::Read);
+    query.vertexRegions[VertexRegions::Position].ref->incRef();
 
-    if (!RtxOptions::Get()->needsMeshBoundingBox()) {
-      return Future<AxisAlignedBoundingBox>();
+    if (getVertexRegion(geoData.texcoordBuffer, geoData.vertexCount, query.vertexRegions[VertexRegions::Texcoord])) {
+      query.vertexRegions[VertexRegions::Texcoord].ref->acquire(DxvkAccess::Read);
+      query.vertexRegions[VertexRegions::Texcoord].ref->incRef();
     }
 
-    const void* pVertexData = geoData.positionBuffer.mapPtr((size_t)geoData.positionBuffer.offsetFromSlice());
-    const uint32_t vertexCount = geoData.vertexCount;
-    const size_t vertexStride = geoData.positionBuffer.stride();
-
-    if (pVertexData == nullptr) {
-      return Future<AxisAlignedBoundingBox>();
+    // Make sure we hold a ref to the index buffer while hashing.
+    query.indexBufferRef = geoData.indexBuffer.buffer().ptr();
+    if (query.indexBufferRef) {
+      query.indexBufferRef->acquire(DxvkAccess::Read);
+      query.indexBufferRef->incRef();
     }
+    query.pIndexData = geoData.indexBuffer.defined() ? geoData.indexBuffer.mapPtr(0) : nullptr;
+    query.indexStride = geoData.indexBuffer.stride();
+    query.indexCount = geoData.indexCount;
+    query.vertexCount = geoData.vertexCount;
+    query.maxIndexValue = maxIndexValue;
 
-    auto vertexBuffer = geoData.positionBuffer.buffer().ptr();
-    vertexBuffer->incRef();
-
-    return m_pGeometryWorkers->Schedule([pVertexData, vertexCount, vertexStride, vertexBuffer]()->AxisAlignedBoundingBox {
+    return m_pGeometryWorkers->Schedule([query]() -> GeometryAnalysis {
       ScopedCpuProfileZone();
 
-      __m128 minPos = _mm_set_ps1(FLT_MAX);
-      __m128 maxPos = _mm_set_ps1(-FLT_MAX);
+      VertexDataAnalysis data;
 
-      const uint8_t* pVertex = static_cast<const uint8_t*>(pVertexData);
-      for (uint32_t vertexIdx = 0; vertexIdx < vertexCount; ++vertexIdx) {
-        const Vector3* const pVertexPos = reinterpret_cast<const Vector3* const>(pVertex);
-        __m128 vertexPos = _mm_set_ps(0.0f, pVertexPos->z, pVertexPos->y, pVertexPos->x);
-        minPos = _mm_min_ps(minPos, vertexPos);
-        maxPos = _mm_max_ps(maxPos, vertexPos);
-
-        pVertex += vertexStride;
+      switch (query.indexStride) {
+      case 2:
+        analyzeGeometryData<uint16_t>(query, data);
+        break;
+      case 4:
+        analyzeGeometryData<uint32_t>(query, data);
+        break;
+      default:
+        analyzeGeometryData<NoIndices>(query, data);
+        break;
       }
 
-      AxisAlignedBoundingBox boundingBox{
-        Vector3{ minPos.m128_f32[0], minPos.m128_f32[1], minPos.m128_f32[2] },
-        Vector3{ maxPos.m128_f32[0], maxPos.m128_f32[1], maxPos.m128_f32[2] }
-      };
-
-      vertexBuffer->decRef();
+      if (query.cacheKey != kEmptyHash) {
+        query.pCache->store(query.cacheKey, data);
+      }
 
-      return boundingBox;
+      GeometryAnalysis analysis;
+      finalizeGeometryAnalysis(data, query.draw, analysis);
+      return analysis;
     });
   }
 }
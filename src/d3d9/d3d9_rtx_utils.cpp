@@ -13,25 +13,6 @@
 #include "../util/util_math.h"
 
 namespace dxvk {
-  bool getMinMaxBoneIndices(const uint8_t* pBoneIndices, uint32_t stride, uint32_t vertexCount, uint32_t numBonesPerVertex, int& minBoneIndex, int& maxBoneIndex) {
-    ScopedCpuProfileZone();
-    if (vertexCount == 0)
-      return false;
-
-    minBoneIndex = 256;
-    maxBoneIndex = -1;
-
-    for (uint32_t i = 0; i < vertexCount; ++i) {
-      for (uint32_t j = 0; j < numBonesPerVertex; ++j) {
-        minBoneIndex = std::min(minBoneIndex, (int) pBoneIndices[j]);
-        maxBoneIndex = std::max(maxBoneIndex, (int) pBoneIndices[j]);
-      }
-      pBoneIndices += stride;
-    }
-
-    return true;
-  }
-
   bool isRenderTargetPrimary(const D3DPRESENT_PARAMETERS& presenterParams, const D3D9_COMMON_TEXTURE_DESC* renderTargetDesc) {
     return presenterParams.BackBufferWidth == renderTargetDesc->Width &&
            presenterParams.BackBufferHeight == renderTargetDesc->Height;
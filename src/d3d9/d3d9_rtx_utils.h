@@ -8,20 +8,6 @@ namespace dxvk {
   struct DxvkVertexInputState;
   class DxvkBuffer;
 
-  /**
-    * \brief: Gets the min and max bone indices referenced in a vertex buffer
-    *
-    * \param [in] indexPtr: Base pointer for the bone indices vertex region
-    * \param [in] stride: Stride of the vertex buffer
-    * \param [in] vertexCount: Number of vertices
-    * \param [in] numBonesPerVertex: Number of bones per vertex
-    * \param [out] minBoneIndex: Minimum referenced bone index
-    * \param [out] maxBoneIndex: Maximum referenced bone index
-    *
-    * \returns: False if unable to determine the min/max
-    */
-  bool getMinMaxBoneIndices(const uint8_t* indexPtr, uint32_t stride, uint32_t vertexCount, uint32_t numBonesPerVertex, int& minBoneIndex, int& maxBoneIndex);
-
   /**
     * \brief: Determines of a render target can be considered primary.
     *
@@ -5,6 +5,10 @@
 #include "d3d9_util.h"
 #include "../dxvk/dxvk_scoped_annotation.h"
 
+// NV-DXVK start: persistent shader cache
+#include <version.h>
+// NV-DXVK end
+
 
 namespace dxvk {
 
@@ -15,12 +19,22 @@ namespace dxvk {
             VkShaderStageFlagBits ShaderStage,
       const DxvkShaderKey&        Key,
       const DxsoModuleInfo*       pDxsoModuleInfo,
-      const void*                 pShaderBytecode,
+// NV-DXVK start: background shader translation
+            std::vector<uint8_t>  Bytecode,
+// NV-DXVK end
       const DxsoAnalysisInfo&     AnalysisInfo,
-            DxsoModule*           pModule) {
+            DxsoModule*           pModule,
+// NV-DXVK start: persistent shader cache
+            BlobArchive*          pCache) {
+// NV-DXVK end
+    // NV-DXVK start: background shader translation
+    // Moving keeps the buffer that pModule reads from in place
     const uint32_t bytecodeLength = AnalysisInfo.bytecodeByteLength;
-    m_bytecode.resize(bytecodeLength);
-    std::memcpy(m_bytecode.data(), pShaderBytecode, bytecodeLength);
+    m_bytecode = std::move(Bytecode);
+    assert(m_bytecode.size() == bytecodeLength);
+
+    const void* pShaderBytecode = m_bytecode.data();
+    // NV-DXVK end
 
     const std::string name = Key.toString();
     Logger::debug(str::format("Compiling shader ", name));
@@ -58,25 +72,38 @@ namespace dxvk {
     const D3D9ConstantLayout& constantLayout = ShaderStage == VK_SHADER_STAGE_VERTEX_BIT
       ? pDevice->GetVertexConstantLayout()
       : pDevice->GetPixelConstantLayout();
-    m_shaders      = pModule->compile(*pDxsoModuleInfo, name, AnalysisInfo, constantLayout);
-    m_isgn         = pModule->isgn();
-    // NV-DXVK start: expose shader outputs for vertex capture
-    m_osgn = pModule->osgn();
+    // NV-DXVK start: persistent shader cache
+    const Sha1Hash cacheKey = pCache != nullptr
+      ? ComputeCacheKey(Key, *pDxsoModuleInfo, constantLayout)
+      : Sha1Hash();
+
+    if (pCache == nullptr || !LoadFromCache(*pCache, cacheKey, ShaderStage)) {
     // NV-DXVK end
-    m_usedSamplers = pModule->usedSamplers();
+      m_shaders      = pModule->compile(*pDxsoModuleInfo, name, AnalysisInfo, constantLayout);
+      m_isgn         = pModule->isgn();
+      // NV-DXVK start: expose shader outputs for vertex capture
+      m_osgn = pModule->osgn();
+      // NV-DXVK end
+      m_usedSamplers = pModule->usedSamplers();
 
-    // Shift up these sampler bits so we can just
-    // do an or per-draw in the device.
-    // We shift by 17 because 16 ps samplers + 1 dmap (tess)
-    if (ShaderStage == VK_SHADER_STAGE_VERTEX_BIT)
-      m_usedSamplers <<= caps::MaxTexturesPS + 1;
+      // Shift up these sampler bits so we can just
+      // do an or per-draw in the device.
+      // We shift by 17 because 16 ps samplers + 1 dmap (tess)
+      if (ShaderStage == VK_SHADER_STAGE_VERTEX_BIT)
+        m_usedSamplers <<= caps::MaxTexturesPS + 1;
 
-    m_usedRTs      = pModule->usedRTs();
+      m_usedRTs      = pModule->usedRTs();
 
-    m_info      = pModule->info();
-    m_meta      = pModule->meta();
-    m_constants = pModule->constants();
-    m_maxDefinedConst = pModule->maxDefinedConstant();
+      m_info      = pModule->info();
+      m_meta      = pModule->meta();
+      m_constants = pModule->constants();
+      m_maxDefinedConst = pModule->maxDefinedConstant();
+
+      // NV-DXVK start: persistent shader cache
+      if (pCache != nullptr)
+        StoreToCache(*pCache, cacheKey);
+    }
+    // NV-DXVK end
 
     m_shaders[0]->setShaderKey(Key);
 
@@ -100,9 +127,239 @@ namespace dxvk {
   }
 
 
+  // NV-DXVK start: persistent shader cache
+  // Bump when the cached shader layout changes. Cached shaders of other
+  // versions are discarded, as are those of other builds, since the
+  // compiler output may change without anyone bumping this.
+  constexpr uint32_t D3D9ShaderCacheVersion = 2;
+
+  static uint32_t GetShaderCacheContentVersion() {
+    BlobWriter version;
+    version.write(D3D9ShaderCacheVersion);
+    version.writeBytes(DXVK_VERSION, std::strlen(DXVK_VERSION));
+
+    return Sha1Hash::compute(version.data().data(), version.data().size()).dword(0);
+  }
+
+  Sha1Hash D3D9CommonShader::ComputeCacheKey(
+    const DxvkShaderKey&        Key,
+    const DxsoModuleInfo&       ModuleInfo,
+    const D3D9ConstantLayout&   Layout) {
+    // Everything the compiler output depends on besides the bytecode.
+    // Options are written one by one, the struct has padding.
+    const DxsoOptions& options = ModuleInfo.options;
+
+    BlobWriter key;
+    key.write(Key.type());
+    key.write(Key.sha1());
+    key.write(options.useDemoteToHelperInvocation);
+    key.write(options.useSubgroupOpsForEarlyDiscard);
+    key.write(options.strictConstantCopies);
+    key.write(options.d3d9FloatEmulation);
+    key.write(options.strictPow);
+    key.write(options.shaderModel);
+    key.write(options.invariantPosition);
+    key.write(options.forceSamplerTypeSpecConstants);
+    key.write(options.vertexFloatConstantBufferAsSSBO);
+    key.write(options.longMad);
+    key.write(options.alphaTestWiggleRoom);
+    key.write(options.robustness2Supported);
+    key.write(Layout.floatCount);
+    key.write(Layout.intCount);
+    key.write(Layout.boolCount);
+    key.write(Layout.bitmaskCount);
+
+    return Sha1Hash::compute(key.data().data(), key.data().size());
+  }
+
+
+  bool D3D9CommonShader::LoadFromCache(
+          BlobArchive&          Cache,
+    const Sha1Hash&             CacheKey,
+          VkShaderStageFlagBits ShaderStage) {
+    ScopedCpuProfileZone();
+    std::vector<uint8_t> data;
+
+    if (!Cache.lookup(CacheKey, data))
+      return false;
+
+    BlobReader reader(data.data(), data.size());
+    D3D9CommonShader shader;
+
+    bool valid = reader.read(shader.m_isgn)
+              && reader.read(shader.m_osgn)
+              && reader.read(shader.m_usedSamplers)
+              && reader.read(shader.m_usedRTs)
+              && reader.read(shader.m_info)
+              && reader.read(shader.m_meta)
+              && reader.readArray(shader.m_constants)
+              && reader.read(shader.m_maxDefinedConst);
+
+    for (uint32_t i = 0; valid && i < D3D9ShaderPermutations::Count; i++) {
+      bool present = false;
+      valid = reader.read(present);
+
+      if (!valid || !present)
+        continue;
+
+      DxvkInterfaceSlots iface;
+      std::vector<DxvkResourceSlot> slots;
+      SpirvCompressedBuffer code;
+
+      valid = reader.read(iface)
+           && reader.readArray(slots)
+           && code.read(reader);
+
+      if (valid) {
+        // Same as DxsoCompiler, DXSO shaders use neither options nor constant data
+        DxvkShaderOptions shaderOptions = { };
+        DxvkShaderConstData constData = { };
+
+        shader.m_shaders[i] = new DxvkShader(
+          ShaderStage, slots.size(), slots.data(), iface,
+          code.decompress(), shaderOptions, std::move(constData));
+      }
+    }
+
+    if (!valid || !reader.atEnd() || shader.m_shaders[D3D9ShaderPermutations::None] == nullptr) {
+      Logger::warn(str::format("D3D9: Ignoring malformed cached shader ", CacheKey.toString()));
+      return false;
+    }
+
+    m_isgn            = shader.m_isgn;
+    m_osgn            = shader.m_osgn;
+    m_usedSamplers    = shader.m_usedSamplers;
+    m_usedRTs         = shader.m_usedRTs;
+    m_info            = shader.m_info;
+    m_meta            = shader.m_meta;
+    m_constants       = std::move(shader.m_constants);
+    m_maxDefinedConst = shader.m_maxDefinedConst;
+    m_shaders         = std::move(shader.m_shaders);
+    return true;
+  }
+
+
+  void D3D9CommonShader::StoreToCache(
+          BlobArchive&          Cache,
+    const Sha1Hash&             CacheKey) const {
+    BlobWriter writer;
+    writer.write(m_isgn);
+    writer.write(m_osgn);
+    writer.write(m_usedSamplers);
+    writer.write(m_usedRTs);
+    writer.write(m_info);
+    writer.write(m_meta);
+    writer.writeArray(m_constants);
+    writer.write(m_maxDefinedConst);
+
+    for (const Rc<DxvkShader>& shader : m_shaders) {
+      writer.write(shader != nullptr);
+
+      if (shader != nullptr) {
+        writer.write(shader->interfaceSlots());
+        writer.writeArray(shader->resourceSlots());
+        shader->compressedCode().write(writer);
+      }
+    }
+
+    Cache.store(CacheKey, writer.release());
+  }
+
+
+  D3D9ShaderModuleSet::D3D9ShaderModuleSet(const Rc<DxvkDevice>& Device) {
+    if (env::getEnvVar("DXVK_SHADER_CACHE") == "0" || !Device->config().enableShaderCache)
+      return;
+
+    std::string path = env::getEnvVar("DXVK_SHADER_CACHE_PATH");
+
+    if (path.empty())
+      path = env::getEnvVar("DXVK_STATE_CACHE_PATH");
+
+    if (!path.empty() && *path.rbegin() != '/')
+      path += '/';
+
+    m_cache = std::make_unique<BlobArchive>(
+      path + env::getExeBaseName() + ".dxvk-shaders",
+      GetShaderCacheContentVersion());
+
+    m_cacheWriter = dxvk::thread([this] { CacheWriterFunc(); });
+  }
+
+
+  D3D9ShaderModuleSet::~D3D9ShaderModuleSet() {
+    // NV-DXVK start: background shader translation
+    StopTranslation();
+    // NV-DXVK end
+
+    if (m_cache != nullptr) {
+      { std::lock_guard<dxvk::mutex> lock(m_cacheWriterMutex);
+        m_cacheWriterStopped = true;
+        m_cacheWriterCond.notify_one();
+      }
+
+      m_cacheWriter.join();
+      m_cache->flush();
+
+      const BlobArchive::Stats stats = m_cache->getStats();
+      Logger::info(str::format("D3D9: Shader cache ", stats.hits, " hits, ", stats.misses, " misses, ", stats.corrupt, " corrupt"));
+    }
+  }
+
+
+  void D3D9ShaderModuleSet::OnPresent() {
+    if (m_cache == nullptr)
+      return;
+
+    // Write once enough shaders were translated, or once no new
+    // ones showed up for a while, rather than only at shutdown,
+    // so that a crash or a killed process loses little
+    const size_t pendingCount = m_cache->getPendingCount();
+
+    if (pendingCount != m_cachePendingCount) {
+      m_cachePendingCount = pendingCount;
+      m_cacheIdlePresents = 0;
+    } else if (pendingCount != 0) {
+      m_cacheIdlePresents += 1;
+    }
+
+    if (pendingCount >= CacheFlushRecordCount || m_cacheIdlePresents >= CacheFlushIdlePresents) {
+      std::lock_guard<dxvk::mutex> lock(m_cacheWriterMutex);
+      m_cacheWriteRequested = true;
+      m_cacheWriterCond.notify_one();
+
+      m_cachePendingCount = 0;
+      m_cacheIdlePresents = 0;
+    }
+  }
+
+
+  void D3D9ShaderModuleSet::CacheWriterFunc() {
+    env::setThreadName("dxvk-shader-cache");
+
+    while (true) {
+      { std::unique_lock<dxvk::mutex> lock(m_cacheWriterMutex);
+
+        m_cacheWriterCond.wait(lock, [this] {
+          return m_cacheWriteRequested || m_cacheWriterStopped;
+        });
+
+        if (m_cacheWriterStopped)
+          break;
+
+        m_cacheWriteRequested = false;
+      }
+
+      m_cache->flush();
+    }
+  }
+  // NV-DXVK end
+
+
   void D3D9ShaderModuleSet::GetShaderModule(
             D3D9DeviceEx*         pDevice,
-            D3D9CommonShader*     pShaderModule,
+// NV-DXVK start: background shader translation
+            D3D9CommonShaderHandle* pShaderModule,
+// NV-DXVK end
             VkShaderStageFlagBits ShaderStage,
       const DxsoModuleInfo*       pDxbcModuleInfo,
       const void*                 pShaderBytecode) {
@@ -134,15 +391,39 @@ namespace dxvk {
       }
     }
     
-    // This shader has not been compiled yet, so we have to create a
-    // new module. This takes a while, so we won't lock the structure.
-    *pShaderModule = D3D9CommonShader(
-      pDevice, ShaderStage, lookupKey,
-      pDxbcModuleInfo, pShaderBytecode,
-      info, &module);
+    // NV-DXVK start: background shader translation
+    // This shader has not been compiled yet, so we have to create a new
+    // module. The translation may run after this call has returned, so
+    // it works on copies of the bytecode and options and parses them
+    // again rather than holding on to the application's memory.
+    const uint8_t* bytecodeBegin = reinterpret_cast<const uint8_t*>(pShaderBytecode);
+    std::vector<uint8_t> bytecode(bytecodeBegin, bytecodeBegin + info.bytecodeByteLength);
+
+    // The producer runs once, so the shader takes over its copy.
+    *pShaderModule = std::make_shared<DeferredValue<D3D9CommonShader>>(
+      [pDevice, ShaderStage, lookupKey, moduleInfo = *pDxbcModuleInfo, bytecode = std::move(bytecode), pCache = m_cache.get()] () mutable {
+        DxsoReader reader(
+          reinterpret_cast<const char*>(bytecode.data()));
+
+        DxsoModule module(reader);
+        DxsoAnalysisInfo info = module.analyze();
+
+        return D3D9CommonShader(
+          pDevice, ShaderStage, lookupKey,
+          &moduleInfo, std::move(bytecode),
+          info, &module, pCache);
+      });
+
+    // Without workers, translate now so that errors are reported by
+    // the create call, and failed modules are not added to the table.
+    const bool async = pDevice->GetOptions()->asyncShaderTranslation;
+
+    if (!async) {
+      (*pShaderModule)->get();
+    }
     
     // Insert the new module into the lookup table. If another thread
-    // has compiled the same shader in the meantime, we should return
+    // has created the same shader in the meantime, we should return
     // that object instead and discard the newly created module.
     { std::unique_lock<dxvk::mutex> lock(m_mutex);
       
@@ -151,7 +432,57 @@ namespace dxvk {
         *pShaderModule = status.first->second;
         return;
       }
+
+      if (!async || m_translationStopped) {
+        return;
+      }
+
+      if (m_translationPool == nullptr) {
+        const uint32_t numThreads = std::clamp(dxvk::thread::hardware_concurrency() / 4, 1u, 4u);
+        Logger::info(str::format("D3D9: Using ", numThreads, " shader translation threads"));
+
+        m_translationPool = std::make_unique<TranslationPool>(
+          uint8_t(numThreads), "D3D9 Shader Translation", TaskOverflowPolicy::Drop);
+      }
+
+      // Dropped jobs are translated by the first bind instead
+      m_translationPool->Schedule([handle = *pShaderModule] {
+        handle->tryProduce();
+      });
+    }
+    // NV-DXVK end
+  }
+
+
+  // NV-DXVK start: background shader translation
+  void D3D9ShaderModuleSet::StopTranslation() {
+    std::unique_lock<dxvk::mutex> lock(m_mutex);
+    m_translationStopped = true;
+    m_translationPool = nullptr;
+  }
+
+
+  bool D3D9ShaderModuleSet::WaitForModule(const D3D9CommonShaderHandle& Module) {
+    try {
+      Module->get();
+      return true;
+    } catch (const DxvkError& e) {
+      std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+      // Failures are rare, so the module is looked up by value
+      auto entry = std::find_if(m_modules.begin(), m_modules.end(),
+        [&Module] (const auto& module) { return module.second == Module; });
+
+      if (entry != m_modules.end()) {
+        if (m_failedModules.insert(entry->first).second)
+          Logger::err(e.message());
+
+        m_modules.erase(entry);
+      }
+
+      return false;
     }
   }
+  // NV-DXVK end
 
 }
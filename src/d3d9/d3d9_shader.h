@@ -5,7 +5,17 @@
 #include "d3d9_shader_permutations.h"
 #include "d3d9_util.h"
 
+// NV-DXVK start: persistent shader cache
+#include "../util/util_blob_archive.h"
+// NV-DXVK end
+// NV-DXVK start: background shader translation
+#include "../util/util_deferred.h"
+#include "../util/util_threadpool.h"
+// NV-DXVK end
+
 #include <array>
+#include <memory>
+#include <unordered_set>
 
 namespace dxvk {
 
@@ -28,9 +38,14 @@ namespace dxvk {
             VkShaderStageFlagBits ShaderStage,
       const DxvkShaderKey&        Key,
       const DxsoModuleInfo*       pDxbcModuleInfo,
-      const void*                 pShaderBytecode,
+// NV-DXVK start: background shader translation
+            std::vector<uint8_t>  Bytecode,
+// NV-DXVK end
       const DxsoAnalysisInfo&     AnalysisInfo,
-            DxsoModule*           pModule);
+            DxsoModule*           pModule,
+// NV-DXVK start: persistent shader cache
+            BlobArchive*          pCache);
+// NV-DXVK end
 
 
     Rc<DxvkShader> GetShader(D3D9ShaderPermutation Permutation) const {
@@ -82,8 +97,35 @@ namespace dxvk {
 
     std::vector<uint8_t>  m_bytecode;
 
+    // NV-DXVK start: persistent shader cache
+    static Sha1Hash ComputeCacheKey(
+      const DxvkShaderKey&        Key,
+      const DxsoModuleInfo&       ModuleInfo,
+      const D3D9ConstantLayout&   Layout);
+
+    bool LoadFromCache(
+            BlobArchive&          Cache,
+      const Sha1Hash&             CacheKey,
+            VkShaderStageFlagBits ShaderStage);
+
+    void StoreToCache(
+            BlobArchive&          Cache,
+      const Sha1Hash&             CacheKey) const;
+    // NV-DXVK end
+
   };
 
+  // NV-DXVK start: background shader translation
+  /**
+   * \brief Shader module that may still be translated
+   *
+   * Shared by all shader objects created from the same
+   * bytecode. Whoever needs the module first translates it
+   * unless a translation worker has already started to.
+   */
+  using D3D9CommonShaderHandle = std::shared_ptr<DeferredValue<D3D9CommonShader>>;
+  // NV-DXVK end
+
   /**
    * \brief Common shader interface
    * 
@@ -97,10 +139,12 @@ namespace dxvk {
   public:
 
     D3D9Shader(
-            D3D9DeviceEx*      pDevice,
-      const D3D9CommonShader&  CommonShader)
+            D3D9DeviceEx*           pDevice,
+      // NV-DXVK start: background shader translation
+            D3D9CommonShaderHandle  CommonShader)
+      // NV-DXVK end
       : D3D9DeviceChild<Base>( pDevice )
-      , m_shader             ( CommonShader ) { }
+      , m_shader             ( std::move(CommonShader) ) { }
 
     HRESULT STDMETHODCALLTYPE QueryInterface(REFIID riid, void** ppvObject) {
       if (ppvObject == nullptr)
@@ -123,7 +167,18 @@ namespace dxvk {
       if (pSizeOfData == nullptr)
         return D3DERR_INVALIDCALL;
 
-      const auto& bytecode = m_shader.GetBytecode();
+      // NV-DXVK start: background shader translation
+      // Translation errors are reported when the shader is bound
+      const D3D9CommonShader* shader = nullptr;
+
+      try {
+        shader = &m_shader->get();
+      } catch (const DxvkError&) {
+        return D3DERR_INVALIDCALL;
+      }
+
+      const auto& bytecode = shader->GetBytecode();
+      // NV-DXVK end
 
       if (pOut == nullptr) {
         *pSizeOfData = bytecode.size();
@@ -136,13 +191,28 @@ namespace dxvk {
       return D3D_OK;
     }
 
+    // NV-DXVK start: background shader translation
+    /**
+     * \brief Translated shader module
+     *
+     * Must only be called after the module set's
+     * \c WaitForModule succeeded for this shader.
+     */
     const D3D9CommonShader* GetCommonShader() const {
-      return &m_shader;
+      return &m_shader->get();
+    }
+
+    /**
+     * \brief Shader module that may still be translated
+     */
+    const D3D9CommonShaderHandle& GetModule() const {
+      return m_shader;
     }
 
   private:
 
-    D3D9CommonShader m_shader;
+    D3D9CommonShaderHandle m_shader;
+    // NV-DXVK end
 
   };
 
@@ -153,9 +223,9 @@ namespace dxvk {
   public:
 
     D3D9VertexShader(
-            D3D9DeviceEx*      pDevice,
-      const D3D9CommonShader&  CommonShader)
-      : D3D9Shader<IDirect3DVertexShader9>( pDevice, CommonShader ) { }
+            D3D9DeviceEx*           pDevice,
+            D3D9CommonShaderHandle  CommonShader)
+      : D3D9Shader<IDirect3DVertexShader9>( pDevice, std::move(CommonShader) ) { }
 
   };
 
@@ -164,9 +234,9 @@ namespace dxvk {
   public:
 
     D3D9PixelShader(
-            D3D9DeviceEx*      pDevice,
-      const D3D9CommonShader&  CommonShader)
-      : D3D9Shader<IDirect3DPixelShader9>( pDevice, CommonShader ) { }
+            D3D9DeviceEx*           pDevice,
+            D3D9CommonShaderHandle  CommonShader)
+      : D3D9Shader<IDirect3DPixelShader9>( pDevice, std::move(CommonShader) ) { }
 
   };
 
@@ -177,17 +247,60 @@ namespace dxvk {
    * times, so we should cache the resulting shader modules
    * and reuse them rather than creating new ones. This
    * class is thread-safe.
+   *
+   * Modules are translated on worker threads if enabled,
+   * and are available once the first shader object that
+   * uses them is bound.
    */
   class D3D9ShaderModuleSet : public RcObject {
     
   public:
+
+    // NV-DXVK start: persistent shader cache
+    D3D9ShaderModuleSet(const Rc<DxvkDevice>& Device);
+
+    ~D3D9ShaderModuleSet();
+    // NV-DXVK end
     
     void GetShaderModule(
             D3D9DeviceEx*         pDevice,
-            D3D9CommonShader*     pShaderModule,
+// NV-DXVK start: background shader translation
+            D3D9CommonShaderHandle* pShaderModule,
+// NV-DXVK end
             VkShaderStageFlagBits ShaderStage,
       const DxsoModuleInfo*       pDxbcModuleInfo,
       const void*                 pShaderBytecode);
+
+    // NV-DXVK start: background shader translation
+    /**
+     * \brief Stops translating modules in the background
+     *
+     * Waits for running translations. Queued ones are left
+     * to whoever needs them, since workers access the device.
+     */
+    void StopTranslation();
+
+    /**
+     * \brief Waits for a shader module to be translated
+     *
+     * A module that failed to translate is removed from the set, so
+     * that shaders created from the same bytecode later on translate
+     * it again. The error is only logged once per shader.
+     * \param [in] Module The module
+     * \returns \c false if the shader could not be translated
+     */
+    bool WaitForModule(const D3D9CommonShaderHandle& Module);
+    // NV-DXVK end
+
+    // NV-DXVK start: persistent shader cache
+    /**
+     * \brief Writes out translated shaders now and then
+     *
+     * Called on present. Wakes the cache writer thread
+     * once enough new shaders are waiting to be written.
+     */
+    void OnPresent();
+    // NV-DXVK end
     
   private:
     
@@ -195,8 +308,41 @@ namespace dxvk {
     
     std::unordered_map<
       DxvkShaderKey,
-      D3D9CommonShader,
+      // NV-DXVK start: background shader translation
+      D3D9CommonShaderHandle,
+      // NV-DXVK end
       DxvkHash, DxvkEq> m_modules;
+
+    // NV-DXVK start: persistent shader cache
+    /// Translated shaders from earlier runs, or \c nullptr if disabled
+    std::unique_ptr<BlobArchive> m_cache;
+
+    static constexpr size_t   CacheFlushRecordCount  = 256;
+    static constexpr uint32_t CacheFlushIdlePresents = 300;
+
+    // Only touched by the presenting thread
+    size_t   m_cachePendingCount = 0;
+    uint32_t m_cacheIdlePresents = 0;
+
+    dxvk::mutex              m_cacheWriterMutex;
+    dxvk::condition_variable m_cacheWriterCond;
+    dxvk::thread             m_cacheWriter;
+    bool                     m_cacheWriteRequested = false;
+    bool                     m_cacheWriterStopped = false;
+
+    void CacheWriterFunc();
+    // NV-DXVK end
+
+    // NV-DXVK start: background shader translation
+    using TranslationPool = WorkerThreadPool<256, true, false, true>;
+
+    /// Created on first use, \c nullptr if translation is synchronous
+    std::unique_ptr<TranslationPool> m_translationPool;
+    bool m_translationStopped = false;
+
+    /// Shaders whose translation failed and was logged
+    std::unordered_set<DxvkShaderKey, DxvkHash, DxvkEq> m_failedModules;
+    // NV-DXVK end
     
   };
 
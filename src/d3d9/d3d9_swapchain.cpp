@@ -434,6 +434,10 @@ namespace dxvk {
     m_parent->m_rtx.EndFrame(m_backBuffers[0]->GetCommonTexture()->GetImage());
     // NV-DXVK end
 
+    // NV-DXVK start: persistent shader cache
+    m_parent->m_shaderModules->OnPresent();
+    // NV-DXVK end
+
     D3D9DeviceLock lock = m_parent->LockDevice();
 
     uint32_t presentInterval = m_presentParams.PresentationInterval;
@@ -26,6 +26,7 @@
 #include "dxvk_openxr.h"
 #include "dxvk_platform_exts.h"
 #include "rtx_render/rtx_options.h"
+#include "rtx_render/rtx_frame_options.h"
 #include "rtx_render/rtx_mod_manager.h"
 
 // NV-DXVK start: Integrate Aftermath
@@ -245,6 +246,9 @@ namespace dxvk {
 
     m_options = DxvkOptions(m_config);
     RtxOptions::Create(m_config);
+    // NV-DXVK start: Frame option snapshots must be valid before the first frame
+    RtxFrameOptions::initialize();
+    // NV-DXVK end
 
     // NV-DXVK start: Wait for debugger functionality
     if (m_config.getOption<bool>("dxvk.waitForDebuggerToAttach", false, "DXVK_WAIT_FOR_DEBUGGER_TO_ATTACH"))
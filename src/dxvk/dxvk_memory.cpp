@@ -38,6 +38,13 @@ DxvkMemoryStats& DxvkMemoryStats::operator=(const DxvkMemoryStats& other)
   rtxOpacityMicromaps = other.rtxOpacityMicromaps.load();
   rtxMaterialTextures = other.rtxMaterialTextures.load();
   rtxRenderTargets = other.rtxRenderTargets.load();
+  // NV-DXVK start: chunk fragmentation statistics
+  freeRanges = other.freeRanges.load();
+  fragmentedMemory = other.fragmentedMemory.load();
+  // NV-DXVK end
+  // NV-DXVK start: per-thread small allocation caches
+  smallSliceWasted = other.smallSliceWasted.load();
+  // NV-DXVK end
 
   return *this;
 }
@@ -151,6 +158,36 @@ VkDeviceSize DxvkMemoryStats::usedByCategory(Category category) const
   }
 }
 
+// NV-DXVK start: chunk fragmentation statistics
+void DxvkMemoryStats::trackChunkFragmentation(int64_t freeRangeDelta, int64_t fragmentedDelta)
+{
+  freeRanges += uint64_t(freeRangeDelta);
+  fragmentedMemory += VkDeviceSize(fragmentedDelta);
+}
+
+uint64_t DxvkMemoryStats::chunkFreeRanges() const
+{
+  return freeRanges;
+}
+
+VkDeviceSize DxvkMemoryStats::chunkFragmentedMemory() const
+{
+  return fragmentedMemory;
+}
+// NV-DXVK end
+
+// NV-DXVK start: per-thread small allocation caches
+void DxvkMemoryStats::trackSmallSliceWaste(int64_t delta)
+{
+  smallSliceWasted += VkDeviceSize(delta);
+}
+
+VkDeviceSize DxvkMemoryStats::smallSliceWaste() const
+{
+  return smallSliceWasted;
+}
+// NV-DXVK end
+
 static const std::map<DxvkMemoryStats::Category, const char *> categoryStringMap = {
   { DxvkMemoryStats::Category::AppBuffer, "AppBuffer" },
   { DxvkMemoryStats::Category::AppTexture, "AppTexture" },
@@ -193,7 +230,14 @@ DxvkMemory::DxvkMemory() { }
     m_offset  (std::exchange(other.m_offset, 0)),
     m_length  (std::exchange(other.m_length, 0)),
     m_mapPtr  (std::exchange(other.m_mapPtr, nullptr)),
-    m_category (std::exchange(other.m_category, DxvkMemoryStats::Category::Invalid)) { }
+    m_category (std::exchange(other.m_category, DxvkMemoryStats::Category::Invalid)),
+    // NV-DXVK start: per-thread small allocation caches
+    m_cached   (std::exchange(other.m_cached, false)),
+    m_sliceWaste (std::exchange(other.m_sliceWaste, 0u)),
+    // NV-DXVK end
+    // NV-DXVK start: TLSF chunk sub-allocation
+    m_chunkHandle (std::exchange(other.m_chunkHandle, TlsfAllocator::InvalidHandle)) { }
+    // NV-DXVK end
   
   
   DxvkMemory& DxvkMemory::operator = (DxvkMemory&& other) {
@@ -206,6 +250,13 @@ DxvkMemory::DxvkMemory() { }
     m_length  = std::exchange(other.m_length, 0);
     m_mapPtr  = std::exchange(other.m_mapPtr, nullptr);
     m_category = std::exchange(other.m_category, DxvkMemoryStats::Category::Invalid);
+    // NV-DXVK start: per-thread small allocation caches
+    m_cached   = std::exchange(other.m_cached, false);
+    m_sliceWaste = std::exchange(other.m_sliceWaste, 0u);
+    // NV-DXVK end
+    // NV-DXVK start: TLSF chunk sub-allocation
+    m_chunkHandle = std::exchange(other.m_chunkHandle, TlsfAllocator::InvalidHandle);
+    // NV-DXVK end
     return *this;
   }
   
@@ -226,13 +277,20 @@ DxvkMemory::DxvkMemory() { }
           DxvkMemoryType*       type,
           DxvkDeviceMemory      memory,
           DxvkMemoryFlags       hints)
-  : m_alloc(alloc), m_type(type), m_memory(memory), m_hints(hints) {
-    // Mark the entire chunk as free
-    m_freeList.push_back(FreeSlice { 0, memory.memSize });
+  : m_alloc(alloc), m_type(type), m_memory(memory), m_hints(hints)
+  // NV-DXVK start: TLSF chunk sub-allocation
+  , m_allocator(memory.memSize) {
+    markFragmentationChanged();
   }
+  // NV-DXVK end
   
   
   DxvkMemoryChunk::~DxvkMemoryChunk() {
+    // NV-DXVK start: chunk fragmentation statistics
+    m_type->heap->stats.trackChunkFragmentation(
+      -int64_t(m_reportedFreeRanges), -int64_t(m_reportedFragmented));
+    // NV-DXVK end
+
     // This call is technically not thread-safe, but it
     // doesn't need to be since we don't free chunks
     m_alloc->freeDeviceMemory(m_type, m_memory);
@@ -250,84 +308,80 @@ DxvkMemory::DxvkMemory() { }
     if (m_memory.memFlags != flags || !checkHints(hints))
       return DxvkMemory();
     
-    // If the chunk is full, return
-    if (m_freeList.size() == 0)
-      return DxvkMemory();
-    
-    // Select the slice to allocate from in a worst-fit
-    // manner. This may help keep fragmentation low.
-    auto bestSlice = m_freeList.begin();
-    
-    for (auto slice = m_freeList.begin(); slice != m_freeList.end(); slice++) {
-      if (slice->length == size) {
-        bestSlice = slice;
-        break;
-      } else if (slice->length > bestSlice->length) {
-        bestSlice = slice;
-      }
-    }
-    
-    // We need to align the allocation to the requested alignment
-    const VkDeviceSize sliceStart = bestSlice->offset;
-    const VkDeviceSize sliceEnd   = bestSlice->offset + bestSlice->length;
-    
-    const VkDeviceSize allocStart = dxvk::align(sliceStart,        align);
-    const VkDeviceSize allocEnd   = dxvk::align(allocStart + size, align);
-    
-    if (allocEnd > sliceEnd)
+    // NV-DXVK start: TLSF chunk sub-allocation
+    // Both the start and the length of the slice are aligned,
+    // the unused parts of the free range stay free.
+    VkDeviceSize length = 0;
+    uint32_t handle = TlsfAllocator::InvalidHandle;
+    const VkDeviceSize allocStart = m_allocator.alloc(size, align, length, handle);
+
+    if (allocStart == TlsfAllocator::InvalidOffset)
       return DxvkMemory();
-    
-    // We can use this slice, but we'll have to add
-    // the unused parts of it back to the free list.
-    m_freeList.erase(bestSlice);
-    
-    if (allocStart != sliceStart)
-      m_freeList.push_back({ sliceStart, allocStart - sliceStart });
-    
-    if (allocEnd != sliceEnd)
-      m_freeList.push_back({ allocEnd, sliceEnd - allocEnd });
 
-    // NV-DXVK start:
+    markFragmentationChanged();
+
     // Calculate the pointer to the mapped data, if any
     void* mapPtr = (m_memory.memPointer != nullptr) ? reinterpret_cast<char*>(m_memory.memPointer) + allocStart : nullptr;
 
     // Create the memory object with the aligned slice
-    return DxvkMemory(m_alloc, this, m_type,
-      m_memory.memHandle, allocStart, allocEnd - allocStart,
+    DxvkMemory memory(m_alloc, this, m_type,
+      m_memory.memHandle, allocStart, length,
       mapPtr, category);
+    memory.m_chunkHandle = handle;
+    return memory;
     // NV-DXVK end
   }
   
   
   void DxvkMemoryChunk::free(
-          VkDeviceSize  offset,
+          uint32_t      handle,
           VkDeviceSize  length) {
-    // Remove adjacent entries from the free list and then add
-    // a new slice that covers all those entries. Without doing
-    // so, the slice could not be reused for larger allocations.
-    auto curr = m_freeList.begin();
-    
-    while (curr != m_freeList.end()) {
-      if (curr->offset == offset + length) {
-        length += curr->length;
-        curr = m_freeList.erase(curr);
-      } else if (curr->offset + curr->length == offset) {
-        offset -= curr->length;
-        length += curr->length;
-        curr = m_freeList.erase(curr);
-      } else {
-        curr++;
-      }
-    }
-    
-    m_freeList.push_back({ offset, length });
+    // NV-DXVK start: TLSF chunk sub-allocation
+    // Adjacent free ranges are merged, so the slice
+    // can be reused for larger allocations.
+    const VkDeviceSize freedLength = m_allocator.free(handle);
+    assert(freedLength == length);
+
+    markFragmentationChanged();
+    // NV-DXVK end
   }
   
   
   bool DxvkMemoryChunk::isEmpty() const {
-    return m_freeList.size() == 1
-        && m_freeList[0].length == m_memory.memSize;
+    // NV-DXVK start: TLSF chunk sub-allocation
+    return m_allocator.isEmpty();
+    // NV-DXVK end
+  }
+
+
+  // NV-DXVK start: chunk fragmentation statistics
+  void DxvkMemoryChunk::markFragmentationChanged() {
+    if (!m_fragmentationChanged) {
+      m_fragmentationChanged = true;
+      m_type->heap->fragmentationChanged.store(true, std::memory_order_relaxed);
+    }
+  }
+
+
+  void DxvkMemoryChunk::updateFragmentationStats() {
+    if (!m_fragmentationChanged)
+      return;
+
+    m_fragmentationChanged = false;
+
+    const TlsfAllocator::Stats& stats = m_allocator.getStats();
+
+    const uint64_t freeRanges = stats.freeRanges;
+    const VkDeviceSize fragmented = stats.freeBytes - m_allocator.largestFreeRange();
+
+    m_type->heap->stats.trackChunkFragmentation(
+      int64_t(freeRanges) - int64_t(m_reportedFreeRanges),
+      int64_t(fragmented) - int64_t(m_reportedFragmented));
+
+    m_reportedFreeRanges = freeRanges;
+    m_reportedFragmented = fragmented;
   }
+  // NV-DXVK end
 
 
   bool DxvkMemoryChunk::isCompatible(const Rc<DxvkMemoryChunk>& other) const {
@@ -401,6 +455,15 @@ DxvkMemory::DxvkMemory() { }
         }
       }
     }
+
+    // NV-DXVK start: per-thread small allocation caches
+    const uint32_t smallSliceCacheSize = m_device->instance()->options().smallAllocationCacheSize;
+
+    if (smallSliceCacheSize != 0) {
+      m_smallSliceCaches = std::make_unique<ThreadCacheRegistry<SmallSliceCache>>(
+        [smallSliceCacheSize] { return SmallSliceCache(smallSliceCacheSize); });
+    }
+    // NV-DXVK end
   }
   
   
@@ -451,6 +514,15 @@ DxvkMemory::DxvkMemory() { }
       result = this->tryAlloc(req, nullptr, flags, hints, category);
     }
 
+    // NV-DXVK start: per-thread small allocation caches
+    // Slices held by the caches keep their chunks alive, return them and
+    // retry before falling back to slower memory types
+    if (!result && m_smallSliceCaches) {
+      this->freeUnusedChunks();
+      result = this->tryAlloc(req, nullptr, flags, hints, category);
+    }
+    // NV-DXVK end
+
     // If that still didn't work, probe slower memory types as well
     VkMemoryPropertyFlags optFlags = VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT
                                    | VK_MEMORY_PROPERTY_HOST_CACHED_BIT;
@@ -494,6 +566,10 @@ DxvkMemory::DxvkMemory() { }
   
   //// NV-DXVK start: Free unused memory
   void DxvkMemoryAllocator::freeUnusedChunks() {
+    // NV-DXVK start: per-thread small allocation caches
+    trimSmallSliceCaches();
+    // NV-DXVK end
+
     for (auto& heap : m_memHeaps) {
       freeEmptyChunks(&heap);
     }
@@ -531,6 +607,18 @@ DxvkMemory::DxvkMemory() { }
     const VkMemoryDedicatedAllocateInfo*    dedAllocInfo,
           DxvkMemoryStats::Category         category
           ) {
+    // NV-DXVK start: per-thread small allocation caches
+    if (m_smallSliceCaches && !dedAllocInfo && !hints.test(DxvkMemoryFlag::IgnoreConstraints)
+     && std::max(size, align) <= SmallSliceMaxSize) {
+      DxvkMemory memory = this->tryAllocSmallSlice(type, flags, size, align, hints, category);
+
+      if (memory) {
+        type->heap->stats.trackMemoryAssigned(category, memory.m_length);
+        return memory;
+      }
+    }
+    // NV-DXVK end
+
     // NV-DXVK start: use a per-memory-type mutex
     std::lock_guard<dxvk::mutex> lock(type->mutex);
     // NV-DXVK end
@@ -557,37 +645,192 @@ DxvkMemory::DxvkMemory() { }
       if (devMem.memHandle != VK_NULL_HANDLE)
         memory = DxvkMemory(this, nullptr, type, devMem.memHandle, 0, size, devMem.memPointer, category);
     } else {
-      for (uint32_t i = 0; i < type->chunks.size() && !memory; i++)
-        memory = type->chunks[i]->alloc(flags, size, align, hints, category);
-      
-      if (!memory) {
-        DxvkDeviceMemory devMem;
-
-        if (this->shouldFreeEmptyChunks(type->heap, chunkSize)) {
-          // NV-DXVK start: use a per-memory-type mutex
-          type->mutex.unlock();
-          this->freeEmptyChunks(type->heap);
-          type->mutex.lock();
-          // NV-DXVK end
-        }
+      // NV-DXVK start: per-thread small allocation caches
+      memory = this->allocChunkSlice(type, flags, size, align, hints, category);
+      // NV-DXVK end
+    }
 
-        for (uint32_t i = 0; i < 6 && (chunkSize >> i) >= size && !devMem.memHandle; i++)
-          devMem = tryAllocDeviceMemory(type, flags, chunkSize >> i, hints, nullptr, category);
+    if (memory)
+      type->heap->stats.trackMemoryAssigned(category, memory.m_length);
+
+    return memory;
+  }
 
-        if (devMem.memHandle) {
-          Rc<DxvkMemoryChunk> chunk = new DxvkMemoryChunk(this, type, devMem, hints);
-          memory = chunk->alloc(flags, size, align, hints, category);
 
-          type->chunks.push_back(std::move(chunk));
-        }
+  // NV-DXVK start: per-thread small allocation caches
+  DxvkMemory DxvkMemoryAllocator::allocChunkSlice(
+          DxvkMemoryType*       type,
+          VkMemoryPropertyFlags flags,
+          VkDeviceSize          size,
+          VkDeviceSize          align,
+          DxvkMemoryFlags       hints,
+          DxvkMemoryStats::Category category) {
+    VkDeviceSize chunkSize = pickChunkSize(type->memTypeId, hints);
+
+    DxvkMemory memory;
+
+    for (uint32_t i = 0; i < type->chunks.size() && !memory; i++)
+      memory = type->chunks[i]->alloc(flags, size, align, hints, category);
+    
+    if (!memory) {
+      DxvkDeviceMemory devMem;
+
+      if (this->shouldFreeEmptyChunks(type->heap, chunkSize)) {
+        type->mutex.unlock();
+        this->freeEmptyChunks(type->heap);
+        type->mutex.lock();
+      }
+
+      for (uint32_t i = 0; i < 6 && (chunkSize >> i) >= size && !devMem.memHandle; i++)
+        devMem = tryAllocDeviceMemory(type, flags, chunkSize >> i, hints, nullptr, category);
+
+      if (devMem.memHandle) {
+        Rc<DxvkMemoryChunk> chunk = new DxvkMemoryChunk(this, type, devMem, hints);
+        memory = chunk->alloc(flags, size, align, hints, category);
+
+        type->chunks.push_back(std::move(chunk));
       }
     }
 
-    if (memory)
-      type->heap->stats.trackMemoryAssigned(category, memory.m_length);
+    return memory;
+  }
+
+
+  struct DxvkMemoryAllocator::SmallSliceBackend {
+    DxvkMemoryAllocator* allocator;
+
+    uint32_t refill(const SmallSliceKey& key, SmallSlice* slices, uint32_t count) {
+      DxvkMemoryType* type = &allocator->m_memTypes[key.memTypeId];
+      const VkDeviceSize sliceSize = SmallSliceClasses::size(key.sizeClass);
+      const VkDeviceSize sliceAlign = SmallSliceClasses::align(key.sizeClass);
 
+      std::lock_guard<dxvk::mutex> lock(type->mutex);
+
+      for (uint32_t i = 0; i < count; i++) {
+        DxvkMemory memory = allocator->allocChunkSlice(type, key.flags,
+          sliceSize, sliceAlign, key.hints, DxvkMemoryStats::Category::Invalid);
+
+        if (!memory)
+          return i;
+
+        // Class sizes are multiples of their alignment, so chunks hand out exactly that much
+        assert(memory.m_length == sliceSize);
+
+        slices[i] = SmallSlice { memory.m_chunk, memory.m_memory, memory.m_offset, memory.m_mapPtr, memory.m_chunkHandle };
+
+        // The slice belongs to the cache now, don't return it to the chunk
+        memory.m_alloc = nullptr;
+      }
+
+      return count;
+    }
+
+    void flush(const SmallSliceKey& key, const SmallSlice* slices, uint32_t count) {
+      DxvkMemoryType* type = &allocator->m_memTypes[key.memTypeId];
+      const VkDeviceSize sliceSize = SmallSliceClasses::size(key.sizeClass);
+
+      std::lock_guard<dxvk::mutex> lock(type->mutex);
+
+      for (uint32_t i = 0; i < count; i++)
+        allocator->freeChunkMemory(type, slices[i].chunk, slices[i].handle, sliceSize);
+    }
+  };
+
+
+  static DxvkMemoryFlags smallSliceHints(DxvkMemoryFlags hints) {
+    // Same hints chunks are matched by, see DxvkMemoryChunk::checkHints
+    return hints & DxvkMemoryFlags(
+      DxvkMemoryFlag::Small,
+      DxvkMemoryFlag::GpuReadable,
+      DxvkMemoryFlag::GpuWritable,
+      DxvkMemoryFlag::Transient);
+  }
+
+
+  DxvkMemory DxvkMemoryAllocator::tryAllocSmallSlice(
+          DxvkMemoryType*       type,
+          VkMemoryPropertyFlags flags,
+          VkDeviceSize          size,
+          VkDeviceSize          align,
+          DxvkMemoryFlags       hints,
+          DxvkMemoryStats::Category category) {
+    const uint32_t sizeClass = SmallSliceClasses::find(size, align);
+    const VkDeviceSize sliceSize = SmallSliceClasses::size(sizeClass);
+
+    const SmallSliceKey key = { type->memTypeId, sizeClass, flags, smallSliceHints(hints) };
+    SmallSliceBackend backend = { this };
+    SmallSlice slice;
+
+    if (!m_smallSliceCaches->get()->alloc(key, backend, slice))
+      return DxvkMemory();
+
+    DxvkMemory memory(this, slice.chunk, type, slice.memory,
+      slice.offset, sliceSize, slice.mapPtr, category);
+    memory.m_chunkHandle = slice.handle;
+    memory.m_cached = true;
+    memory.m_sliceWaste = uint32_t(sliceSize - size);
+
+    type->heap->stats.trackSmallSliceWaste(int64_t(memory.m_sliceWaste));
     return memory;
   }
+
+
+  void DxvkMemoryAllocator::freeSmallSlice(
+    const DxvkMemory&           memory) {
+    // Slices are handed out at the exact size of their class
+    const uint32_t sizeClass = SmallSliceClasses::find(memory.m_length, 0);
+
+    // Chunks only hand out slices for requests with exactly matching
+    // flags and hints, so the chunk tells which cache the slice is from
+    const SmallSliceKey key = { memory.m_type->memTypeId, sizeClass,
+      memory.m_chunk->memoryFlags(), smallSliceHints(memory.m_chunk->hints()) };
+    SmallSliceBackend backend = { this };
+
+    m_smallSliceCaches->get()->free(key, backend, SmallSlice { memory.m_chunk, memory.m_memory, memory.m_offset, memory.m_mapPtr, memory.m_chunkHandle });
+  }
+
+
+  void DxvkMemoryAllocator::trimSmallSliceCaches() {
+    if (!m_smallSliceCaches)
+      return;
+
+    SmallSliceBackend backend = { this };
+
+    m_smallSliceCaches->trim([&backend] (SmallSliceCache& cache) {
+      cache.flush(backend);
+    });
+  }
+
+
+  void DxvkMemoryAllocator::trimIdleSmallSliceCaches() {
+    if (!m_smallSliceCaches)
+      return;
+
+    SmallSliceBackend backend = { this };
+
+    m_smallSliceCaches->trimIdle([&backend] (SmallSliceCache& cache) {
+      cache.flush(backend);
+    });
+  }
+  // NV-DXVK end
+
+
+  // NV-DXVK start: chunk fragmentation statistics
+  void DxvkMemoryAllocator::updateFragmentationStats(uint32_t heap) {
+    if (!m_memHeaps[heap].fragmentationChanged.exchange(false, std::memory_order_relaxed))
+      return;
+
+    for (uint32_t i = 0; i < m_memProps.memoryTypeCount; i++) {
+      if (m_memTypes[i].heapId != heap)
+        continue;
+
+      std::lock_guard<dxvk::mutex> lock(m_memTypes[i].mutex);
+
+      for (const auto& chunk : m_memTypes[i].chunks)
+        chunk->updateFragmentationStats();
+    }
+  }
+  // NV-DXVK end
   
   
   DxvkDeviceMemory DxvkMemoryAllocator::tryAllocDeviceMemory(
@@ -658,6 +901,15 @@ DxvkMemory::DxvkMemory() { }
 
   void DxvkMemoryAllocator::free(
     const DxvkMemory&           memory) {
+    // NV-DXVK start: per-thread small allocation caches
+    if (memory.m_cached) {
+      memory.m_type->heap->stats.trackMemoryReleased(memory.m_category, memory.m_length);
+      memory.m_type->heap->stats.trackSmallSliceWaste(-int64_t(memory.m_sliceWaste));
+      this->freeSmallSlice(memory);
+      return;
+    }
+    // NV-DXVK end
+
     // NV-DXVK start: use a per-memory-type mutex
     std::lock_guard<dxvk::mutex> lock(memory.m_type->mutex);
     // NV-DXVK end
@@ -667,7 +919,7 @@ DxvkMemory::DxvkMemory() { }
       this->freeChunkMemory(
         memory.m_type,
         memory.m_chunk,
-        memory.m_offset,
+        memory.m_chunkHandle,
         memory.m_length);
     } else {
       DxvkDeviceMemory devMem;
@@ -682,9 +934,9 @@ DxvkMemory::DxvkMemory() { }
   void DxvkMemoryAllocator::freeChunkMemory(
           DxvkMemoryType*       type,
           DxvkMemoryChunk*      chunk,
-          VkDeviceSize          offset,
+          uint32_t              handle,
           VkDeviceSize          length) {
-    chunk->free(offset, length);
+    chunk->free(handle, length);
 
     if (chunk->isEmpty()) {
       Rc<DxvkMemoryChunk> chunkRef = chunk;
@@ -23,6 +23,13 @@
 
 #include "dxvk_adapter.h"
 
+// NV-DXVK start: TLSF chunk sub-allocation
+#include "../util/util_tlsf.h"
+// NV-DXVK end
+// NV-DXVK start: per-thread small allocation caches
+#include "../util/util_magazine_cache.h"
+// NV-DXVK end
+
 namespace dxvk {
   
   class DxvkMemoryAllocator;
@@ -73,6 +80,23 @@ namespace dxvk {
     VkDeviceSize totalUsed() const;
     VkDeviceSize usedByCategory(Category category) const;
 
+    // NV-DXVK start: chunk fragmentation statistics
+    // tracks the free ranges within memory chunks, and how much free memory
+    // lies outside of the largest free range of each chunk
+    void trackChunkFragmentation(int64_t freeRangeDelta, int64_t fragmentedDelta);
+
+    uint64_t chunkFreeRanges() const;
+    VkDeviceSize chunkFragmentedMemory() const;
+    // NV-DXVK end
+
+    // NV-DXVK start: per-thread small allocation caches
+    // tracks how much of the cached small slices goes unused because
+    // requests are rounded up to the slice size of their size class
+    void trackSmallSliceWaste(int64_t delta);
+
+    VkDeviceSize smallSliceWaste() const;
+    // NV-DXVK end
+
     static const char* categoryToString(Category category);
     
   private:
@@ -86,6 +110,15 @@ namespace dxvk {
     std::atomic<VkDeviceSize> rtxOpacityMicromaps = 0;
     std::atomic<VkDeviceSize> rtxMaterialTextures = 0;
     std::atomic<VkDeviceSize> rtxRenderTargets = 0;
+
+    // NV-DXVK start: chunk fragmentation statistics
+    std::atomic<uint64_t> freeRanges = 0;
+    std::atomic<VkDeviceSize> fragmentedMemory = 0;
+    // NV-DXVK end
+
+    // NV-DXVK start: per-thread small allocation caches
+    std::atomic<VkDeviceSize> smallSliceWasted = 0;
+    // NV-DXVK end
   };
 
 
@@ -140,6 +173,10 @@ namespace dxvk {
     VkMemoryHeap      properties;
     DxvkMemoryStats   stats;
     VkDeviceSize      budget;
+    // NV-DXVK start: chunk fragmentation statistics
+    // Set when a chunk on the heap changed, the statistics are only updated when read
+    std::atomic<bool> fragmentationChanged = { false };
+    // NV-DXVK end
   };
 
 
@@ -173,6 +210,9 @@ namespace dxvk {
    */
   class DxvkMemory {
     friend class DxvkMemoryAllocator;
+    // NV-DXVK start: TLSF chunk sub-allocation
+    friend class DxvkMemoryChunk;
+    // NV-DXVK end
   public:
     
     DxvkMemory();
@@ -252,6 +292,14 @@ namespace dxvk {
     VkDeviceSize          m_length = 0;
     void*                 m_mapPtr = nullptr;
     DxvkMemoryStats::Category m_category = DxvkMemoryStats::Category::Invalid;
+    // NV-DXVK start: per-thread small allocation caches
+    bool                  m_cached = false;
+    uint32_t              m_sliceWaste = 0;
+    // NV-DXVK end
+    // NV-DXVK start: TLSF chunk sub-allocation
+    // Allocation handle within the chunk, so freeing needs no lookup by offset
+    uint32_t              m_chunkHandle = TlsfAllocator::InvalidHandle;
+    // NV-DXVK end
     
     void free();
     
@@ -317,11 +365,11 @@ namespace dxvk {
      * Returns a slice back to the chunk.
      * Called automatically when a memory
      * slice runs out of scope.
-     * \param [in] offset Slice offset
+     * \param [in] handle Allocation handle of the slice
      * \param [in] length Slice length
      */
     void free(
-            VkDeviceSize  offset,
+            uint32_t      handle,
             VkDeviceSize  length);
 
     /**
@@ -336,19 +384,45 @@ namespace dxvk {
      */
     bool isCompatible(const Rc<DxvkMemoryChunk>& other) const;
 
+    // NV-DXVK start: chunk fragmentation statistics
+    /**
+     * \brief Reports fragmentation changes to the heap statistics
+     *
+     * Walks the largest free size class, so this is only done when
+     * the statistics are read rather than on every allocation.
+     * Must be called with the memory type lock held.
+     */
+    void updateFragmentationStats();
+    // NV-DXVK end
+
+    // NV-DXVK start: per-thread small allocation caches
+    VkMemoryPropertyFlags memoryFlags() const {
+      return m_memory.memFlags;
+    }
+
+    DxvkMemoryFlags hints() const {
+      return m_hints;
+    }
+    // NV-DXVK end
+
   private:
     
-    struct FreeSlice {
-      VkDeviceSize offset;
-      VkDeviceSize length;
-    };
-    
     DxvkMemoryAllocator*  m_alloc;
     DxvkMemoryType*       m_type;
     DxvkDeviceMemory      m_memory;
     DxvkMemoryFlags       m_hints;
     
-    std::vector<FreeSlice> m_freeList;
+    // NV-DXVK start: TLSF chunk sub-allocation
+    // Replaces the worst-fit free list, which had to be scanned on every
+    // allocation and free and got slow with thousands of live slices.
+    TlsfAllocator         m_allocator;
+
+    uint64_t              m_reportedFreeRanges = 0;
+    VkDeviceSize          m_reportedFragmented = 0;
+    bool                  m_fragmentationChanged = false;
+
+    void markFragmentationChanged();
+    // NV-DXVK end
 
     bool checkHints(DxvkMemoryFlags hints) const;
     
@@ -409,7 +483,10 @@ namespace dxvk {
      * \param [in] heap Heap index
      * \returns Memory stats for this heap
      */
-    const DxvkMemoryStats& getMemoryStats(uint32_t heap) const {
+    const DxvkMemoryStats& getMemoryStats(uint32_t heap) {
+      // NV-DXVK start: chunk fragmentation statistics
+      updateFragmentationStats(heap);
+      // NV-DXVK end
       return m_memHeaps[heap].stats;
     }
 
@@ -441,6 +518,17 @@ namespace dxvk {
      *   be used very sparingly.
      */
     void freeUnusedChunks();
+
+    // NV-DXVK start: per-thread small allocation caches
+    /**
+     * \brief Returns slices held by idle threads
+     *
+     * Call once per frame. Threads that did not allocate
+     * or free small slices since the previous call hand
+     * the slices in their caches back to the chunks.
+     */
+    void trimIdleSmallSliceCaches();
+    // NV-DXVK end
     // NV-DXVK end
 
   private:
@@ -483,7 +571,7 @@ namespace dxvk {
     void freeChunkMemory(
             DxvkMemoryType*       type,
             DxvkMemoryChunk*      chunk,
-            VkDeviceSize          offset,
+            uint32_t              handle,
             VkDeviceSize          length);
     
     void freeDeviceMemory(
@@ -505,6 +593,71 @@ namespace dxvk {
     void freeEmptyChunks(
       const DxvkMemoryHeap*       heap);
 
+    // NV-DXVK start: per-thread small allocation caches
+    // Small slices are carved from chunks in batches and handed out from
+    // per-thread caches, so that most small allocations and frees don't
+    // take the memory type mutex. Any request up to the size and alignment
+    // of a class fits into its slices.
+    constexpr static VkDeviceSize SmallSliceMinSize = 256;
+    constexpr static VkDeviceSize SmallSliceMaxSize = 64 << 10;
+
+    using SmallSliceClasses = SliceSizeClasses<SmallSliceMinSize>;
+
+    struct SmallSliceKey {
+      uint32_t              memTypeId;
+      uint32_t              sizeClass;
+      VkMemoryPropertyFlags flags;
+      DxvkMemoryFlags       hints;
+
+      bool operator == (const SmallSliceKey& other) const {
+        return memTypeId == other.memTypeId
+            && sizeClass == other.sizeClass
+            && flags == other.flags
+            && hints == other.hints;
+      }
+    };
+
+    struct SmallSlice {
+      DxvkMemoryChunk*      chunk;
+      VkDeviceMemory        memory;
+      VkDeviceSize          offset;
+      void*                 mapPtr;
+      uint32_t              handle;
+    };
+
+    struct SmallSliceBackend;
+
+    using SmallSliceCache = MagazineCache<SmallSliceKey, SmallSlice>;
+
+    std::unique_ptr<ThreadCacheRegistry<SmallSliceCache>> m_smallSliceCaches;
+
+    DxvkMemory tryAllocSmallSlice(
+            DxvkMemoryType*       type,
+            VkMemoryPropertyFlags flags,
+            VkDeviceSize          size,
+            VkDeviceSize          align,
+            DxvkMemoryFlags       hints,
+            DxvkMemoryStats::Category category);
+
+    void freeSmallSlice(
+      const DxvkMemory&           memory);
+
+    void trimSmallSliceCaches();
+
+    // Expects the memory type mutex to be held
+    DxvkMemory allocChunkSlice(
+            DxvkMemoryType*       type,
+            VkMemoryPropertyFlags flags,
+            VkDeviceSize          size,
+            VkDeviceSize          align,
+            DxvkMemoryFlags       hints,
+            DxvkMemoryStats::Category category);
+    // NV-DXVK end
+
+    // NV-DXVK start: chunk fragmentation statistics
+    void updateFragmentationStats(uint32_t heap);
+    // NV-DXVK end
+
   };
   
 }
@@ -26,6 +26,9 @@ namespace dxvk {
 
   DxvkOptions::DxvkOptions(const Config& config) {
     enableStateCache      = config.getOption<bool>    ("dxvk.enableStateCache",       true);
+    // NV-DXVK start: persistent shader cache
+    enableShaderCache     = config.getOption<bool>    ("dxvk.enableShaderCache",      true);
+    // NV-DXVK end
     numCompilerThreads    = config.getOption<int32_t> ("dxvk.numCompilerThreads",     0);
     useRawSsbo            = config.getOption<Tristate>("dxvk.useRawSsbo",             Tristate::Auto);
     shrinkNvidiaHvvHeap   = config.getOption<Tristate>("dxvk.shrinkNvidiaHvvHeap",    Tristate::Auto);
@@ -61,6 +64,11 @@ namespace dxvk {
     deviceLocalMemoryChunkSizeMB = config.getOption<uint32_t>("dxvk.deviceLocalMemoryChunkSizeMB", 320);
     otherMemoryChunkSizeMB = config.getOption<uint32_t>("dxvk.otherMemoryChunkSizeMB", 128);
     // NV-DXVK end
+
+    // NV-DXVK start: per-thread small allocation caches
+    // Number of small slices of one size class each thread may hold on to, 0 disables the caches
+    smallAllocationCacheSize = config.getOption<uint32_t>("dxvk.smallAllocationCacheSize", 32);
+    // NV-DXVK end
   }
 
 }
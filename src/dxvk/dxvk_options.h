@@ -32,6 +32,11 @@ namespace dxvk {
     /// Enable state cache
     bool enableStateCache;
 
+    // NV-DXVK start: persistent shader cache
+    /// Enable the on-disk cache of translated shaders
+    bool enableShaderCache;
+    // NV-DXVK end
+
     /// Number of compiler threads
     /// when using the state cache
     int32_t numCompilerThreads;
@@ -66,6 +71,10 @@ namespace dxvk {
     uint32_t deviceLocalMemoryChunkSizeMB;
     uint32_t otherMemoryChunkSizeMB;
     // NV-DXVK end
+
+    // NV-DXVK start: per-thread small allocation caches
+    uint32_t smallAllocationCacheSize;
+    // NV-DXVK end
   };
 
 }
@@ -228,6 +228,24 @@ namespace dxvk {
     const DxvkShaderConstData& shaderConstants() const {
       return m_constData;
     }
+
+    // NV-DXVK start: persistent shader cache
+    /**
+     * \brief Resource slots
+     * \returns Resource slots used by the shader
+     */
+    const std::vector<DxvkResourceSlot>& resourceSlots() const {
+      return m_slots;
+    }
+
+    /**
+     * \brief Compressed SPIR-V code
+     * \returns The code as passed to the constructor
+     */
+    const SpirvCompressedBuffer& compressedCode() const {
+      return m_code;
+    }
+    // NV-DXVK end
     
     /**
      * \brief Dumps SPIR-V shader
@@ -40,6 +40,12 @@ namespace dxvk {
     RtxSamplers,                       ///< Number of samplers currently present in the scene
     RtxTexturesInFlight,               ///< Number of texture currently being loaded
     RtxLastTextureBatchDuration,       ///< Duration in ms of the last processed texture batch
+    RtxGeometryAnalysisCacheHits,      ///< Number of draws last frame reusing the geometry analysis of unchanged buffers
+    RtxGeometryAnalysisCacheMisses,    ///< Number of draws last frame analyzing their geometry, despite being cacheable
+    RtxInstancePoolCapacity,           ///< Number of instances the instance pool can hold without allocating
+    RtxInstanceAllocations,            ///< Number of instances allocated last frame
+    RtxTransientInstances,             ///< Number of per frame instance copies released in bulk last frame
+    RtxBlasPoolCapacity,               ///< Number of BLAS entries the geometry cache can hold without allocating
     // NV-DXVK end
 
     NumCounters,              ///< Number of counters available
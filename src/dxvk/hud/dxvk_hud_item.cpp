@@ -618,6 +618,32 @@ namespace dxvk::hud {
           position.y += 4.0f;
         }
 
+        // NV-DXVK start: chunk fragmentation statistics
+        if (m_heaps[i].chunkFreeRanges() != 0) {
+          std::string text = str::format(std::setfill(' '), std::setw(5), "Fragmented: ",
+            m_heaps[i].chunkFragmentedMemory() >> 20, " MB in ", m_heaps[i].chunkFreeRanges(), " free ranges");
+          position.y += 16.0f;
+          renderer.drawText(16.0f,
+                            { position.x + 16.0f, position.y },
+                            { 1.0f, 1.0f, 1.0f, 1.0f },
+                            text);
+          position.y += 4.0f;
+        }
+        // NV-DXVK end
+
+        // NV-DXVK start: per-thread small allocation caches
+        if (m_heaps[i].smallSliceWaste() != 0) {
+          std::string text = str::format(std::setfill(' '), std::setw(5), "Small slice rounding: ",
+            m_heaps[i].smallSliceWaste() >> 10, " kB");
+          position.y += 16.0f;
+          renderer.drawText(16.0f,
+                            { position.x + 16.0f, position.y },
+                            { 1.0f, 1.0f, 1.0f, 1.0f },
+                            text);
+          position.y += 4.0f;
+        }
+        // NV-DXVK end
+
         position.y += 16.0f;
       }
     }
@@ -824,7 +850,13 @@ namespace dxvk::hud {
                                    "# Lights:",
                                    "# Samplers:",
                                    "# Textures in-flight:",
-                                   "# Last tex. batch (ms):"}; 
+                                   "# Last tex. batch (ms):",
+                                   "# Geometry cache hits:",
+                                   "# Geometry cache misses:",
+                                   "# Instance pool capacity:",
+                                   "# Instance allocations:",
+                                   "# Transient instances:",
+                                   "# BLAS pool capacity:"}; 
     const uint64_t values[] = { counters.getCtr(DxvkStatCounter::QueuePresentCount),
                                 counters.getCtr(DxvkStatCounter::RtxBlasCount),
                                 counters.getCtr(DxvkStatCounter::RtxBufferCount),
@@ -836,7 +868,13 @@ namespace dxvk::hud {
                                 counters.getCtr(DxvkStatCounter::RtxLightCount),
                                 counters.getCtr(DxvkStatCounter::RtxSamplers),
                                 counters.getCtr(DxvkStatCounter::RtxTexturesInFlight),
-                                counters.getCtr(DxvkStatCounter::RtxLastTextureBatchDuration)};
+                                counters.getCtr(DxvkStatCounter::RtxLastTextureBatchDuration),
+                                counters.getCtr(DxvkStatCounter::RtxGeometryAnalysisCacheHits),
+                                counters.getCtr(DxvkStatCounter::RtxGeometryAnalysisCacheMisses),
+                                counters.getCtr(DxvkStatCounter::RtxInstancePoolCapacity),
+                                counters.getCtr(DxvkStatCounter::RtxInstanceAllocations),
+                                counters.getCtr(DxvkStatCounter::RtxTransientInstances),
+                                counters.getCtr(DxvkStatCounter::RtxBlasPoolCapacity)};
 
     const uint32_t kNumLabels = sizeof(labels) / sizeof(labels[0]);
     static_assert(kNumLabels == sizeof(values) / sizeof(values[0]));
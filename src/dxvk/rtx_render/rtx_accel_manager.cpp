@@ -22,6 +22,7 @@
 #include <mutex>
 #include <vector>
 #include <assert.h>
+#include <ppl.h>
 
 #include "rtx.h"
 #include "rtx_context.h"
@@ -45,6 +46,9 @@ namespace dxvk {
   // Make this static and not a member of AccelManager to make it safe updating the count from ~PooledBlas()
   static int g_blasCount = 0;
 
+  // Missing particle surface mappings are resolved in chunks of this size, one chunk is resolved on the calling thread
+  static constexpr uint32_t kParticleMappingChunkSize = 1024;
+
   AccelManager::AccelManager(DxvkDevice* device)
     : CommonDeviceObject(device)
     , m_scratchAlignment(device->properties().khrDeviceAccelerationStructureProperties.minAccelerationStructureScratchOffsetAlignment) {
@@ -863,47 +867,63 @@ namespace dxvk {
     }
 
     // Fix missed surface mapping by searching among objects with the same hash value, and choose the closest one.
+    // Every entry is resolved independently, so large mappings are split across threads without changing the result.
     m_lastSurfaceInfoList.resize(surfaceIndexMapping.size());
-    for (int i = 0; i < surfaceIndexMapping.size(); i++) {
-      // Skip objects have surface mapping
-      if (surfaceIndexMapping[i] != BINDING_INDEX_INVALID) {
-        continue;
-      }
-
-      // Skip objects with different materials
-      auto lastInfo = m_lastSurfaceInfoList[i];
-      auto pCandidateList = curMaterialHashToSurfaceMap.find(lastInfo.hash);
-      if (pCandidateList == curMaterialHashToSurfaceMap.end()) {
-        continue;
-      }
 
-      auto& candidateList = pCandidateList->second;
-      float minDistanceSq = FLT_MAX;
-      int bestSurfaceID = -1;
+    auto resolveMappings = [&](const uint32_t begin, const uint32_t end) {
+      for (uint32_t i = begin; i < end; i++) {
+        // Skip objects have surface mapping
+        if (surfaceIndexMapping[i] != BINDING_INDEX_INVALID) {
+          continue;
+        }
 
-      // Iterate through the candidate list and find the closest one
-      for (int ithCandidate = 0; ithCandidate < candidateList.size(); ithCandidate++) {
-        int curSurfaceID = candidateList[ithCandidate];
-        RtInstance& surface = *m_reorderedSurfaces[curSurfaceID];
-        if (surface.buildGeometries.size() == 0) {
+        // Skip objects with different materials
+        const SurfaceInfo& lastInfo = m_lastSurfaceInfoList[i];
+        auto pCandidateList = curMaterialHashToSurfaceMap.find(lastInfo.hash);
+        if (pCandidateList == curMaterialHashToSurfaceMap.end()) {
           continue;
         }
 
-        // Calculate bounding box centers' distance
-        const RasterGeometry& geometryData = surface.getBlas()->input.getGeometryData();
-        Vector3 center = geometryData.boundingBox.getTransformedCentroid(surface.getTransform());
-        float distanceSq = lengthSqr(center - lastInfo.worldPosition);
-        if (distanceSq < minDistanceSq) {
-          minDistanceSq = distanceSq;
-          bestSurfaceID = curSurfaceID;
+        const auto& candidateList = pCandidateList->second;
+        float minDistanceSq = FLT_MAX;
+        int bestSurfaceID = -1;
+
+        // Iterate through the candidate list and find the closest one
+        for (int ithCandidate = 0; ithCandidate < candidateList.size(); ithCandidate++) {
+          int curSurfaceID = candidateList[ithCandidate];
+          RtInstance& surface = *m_reorderedSurfaces[curSurfaceID];
+          if (surface.buildGeometries.size() == 0) {
+            continue;
+          }
+
+          // Calculate bounding box centers' distance
+          const RasterGeometry& geometryData = surface.getBlas()->input.getGeometryData();
+          Vector3 center = geometryData.boundingBox.getTransformedCentroid(surface.getTransform());
+          float distanceSq = lengthSqr(center - lastInfo.worldPosition);
+          if (distanceSq < minDistanceSq) {
+            minDistanceSq = distanceSq;
+            bestSurfaceID = curSurfaceID;
+          }
         }
-      }
 
-      // Use the closest surface
-      if (bestSurfaceID != -1) {
-        surfaceIndexMapping[i] = bestSurfaceID;
+        // Use the closest surface
+        if (bestSurfaceID != -1) {
+          surfaceIndexMapping[i] = bestSurfaceID;
+        }
       }
+    };
+
+    const uint32_t numMappings = surfaceIndexMapping.size();
+    const uint32_t numChunks = (numMappings + kParticleMappingChunkSize - 1) / kParticleMappingChunkSize;
+
+    if (numChunks > 1) {
+      concurrency::parallel_for<uint32_t>(0, numChunks, [&](const uint32_t chunk) {
+        resolveMappings(chunk * kParticleMappingChunkSize, std::min((chunk + 1) * kParticleMappingChunkSize, numMappings));
+      });
+    } else {
+      resolveMappings(0, numMappings);
     }
+
     m_lastSurfaceInfoList = curSurfaceInfoList;
   }
 
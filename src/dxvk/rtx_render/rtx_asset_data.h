@@ -94,12 +94,39 @@ namespace dxvk {
      * Note: for performance reasons the source media may
      * remain open after this function completes. To release
      * the source media use releaseSource() method.
+     * Implementations may return a pointer into a memory mapping
+     * of the source media instead of a cached copy. Such pointers
+     * become invalid once releaseSource() is called.
      * \param [in] layer Image layer, ignored if asset is not an image
      * \param [in] level Image level, ignored if asset is not an image
      * \returns Pointer to data
      */
     virtual const void* data(int layer, int level) = 0;
 
+    /**
+     * \brief Prefetch asset data
+     *
+     * Brings the data of a subresource into host memory, so that a
+     * subsequent data() call does not have to wait for the source
+     * media. Must not be called concurrently with other methods.
+     * \param [in] layer Image layer, ignored if asset is not an image
+     * \param [in] level Image level, ignored if asset is not an image
+     */
+    virtual void prefetch(int layer, int level) {
+      data(layer, level);
+    }
+
+    /**
+     * \brief Check if asset data is resident in host memory
+     *
+     * Resident assets are fully loaded on creation and never
+     * access the source media afterwards.
+     * \returns \c true if the asset is resident
+     */
+    virtual bool isResident() const {
+      return false;
+    }
+
     /**
      * \brief Get asset data location in the source
      *
@@ -120,7 +147,8 @@ namespace dxvk {
      * \brief Release cached resources
      *
      * Releases the internally allocated memory for a given
-     * subresource.
+     * subresource. For memory mapped sources this releases the
+     * physical pages backing the subresource data.
      * \param [in] layer Image layer, ignored if asset is not an image
      * \param [in] level Image level, ignored if asset is not an image
      */
@@ -165,6 +193,14 @@ namespace dxvk {
       return m_sourceAsset->data(layer, level + m_minLevel);
     }
 
+    void prefetch(int layer, int level) override {
+      m_sourceAsset->prefetch(layer, level + m_minLevel);
+    }
+
+    bool isResident() const override {
+      return m_sourceAsset->isResident();
+    }
+
     void releaseSource() {
       m_sourceAsset->releaseSource();
     }
@@ -204,6 +240,10 @@ namespace dxvk {
       m_minLevel = minLevel;
     }
 
+    const Rc<AssetData>& sourceAsset() const {
+      return m_sourceAsset;
+    }
+
   private:
     const Rc<AssetData> m_sourceAsset;
     int m_minLevel;
@@ -25,6 +25,7 @@
 #include "rtx_asset_package.h"
 #include "rtx_io.h"
 #include "dxvk_scoped_annotation.h"
+#include "../../util/util_mapped_file.h"
 #include <gli/gli.hpp>
 
 namespace dxvk {
@@ -87,6 +88,12 @@ namespace dxvk {
       return m_texture.data(layer, 0, level);
     }
 
+    void prefetch(int, int) override { }
+
+    bool isResident() const override {
+      return true;
+    }
+
     void evictCache(int, int) override { }
 
     void releaseSource() override { }
@@ -242,7 +249,12 @@ namespace dxvk {
   };
 
   class DdsTextureData : public DdsFileParser, public AssetData {
+    // Guards the cached data and the mapping, views are taken under it
+    // so that they cannot race with the mapping being created or released
+    dxvk::mutex m_mutex;
     std::unordered_map<int, std::vector<uint8_t>> m_data;
+    MappedFile m_mappedFile;
+    bool m_mapFailed = false;
 
     AssetType type() const {
       if (m_width > 1 && m_height == 1 && m_depth == 1) {
@@ -258,11 +270,7 @@ namespace dxvk {
       return (layer * m_faces + 0) * m_levels + level;
     }
 
-  public:
-
-    ~DdsTextureData() override { }
-
-    const void* data(int layer, int level) override {
+    const void* dataLocked(int layer, int level) {
       int key = getKey(layer, level);
       const auto& it = m_data.find(key);
       if (it != m_data.end() && !it->second.empty())
@@ -277,6 +285,18 @@ namespace dxvk {
         return nullptr;
       }
 
+      // Hand out the data straight from the mapped file when possible.
+      // Buffered reads are only used when the file could not be mapped,
+      // e.g. when running out of address space. A failed mapping is not
+      // retried until the source is released.
+      if (!m_mappedFile.isMapped() && !m_mapFailed) {
+        m_mapFailed = !m_mappedFile.map(m_filename);
+      }
+
+      if (const void* mappedData = m_mappedFile.view(dataOffset, dataSize)) {
+        return mappedData;
+      }
+
       auto file = openHandle();
       assert(file);
       
@@ -290,13 +310,50 @@ namespace dxvk {
       return rawData;
     }
 
+  public:
+
+    ~DdsTextureData() override { }
+
+    const void* data(int layer, int level) override {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      return dataLocked(layer, level);
+    }
+
+    void prefetch(int layer, int level) override {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+
+      if (dataLocked(layer, level) == nullptr || !m_mappedFile.isMapped())
+        return;
+
+      long dataOffset;
+      size_t dataSize;
+      getDataPlacement(layer, 0, level, dataOffset, dataSize);
+      m_mappedFile.prefetch(dataOffset, dataSize);
+    }
+
     void evictCache(int layer, int level) override {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+
       int key = getKey(layer, level);
-      releaseVectorMemory(m_data[key]);
+      const auto& it = m_data.find(key);
+      if (it != m_data.end()) {
+        releaseVectorMemory(it->second);
+      }
+
+      if (m_mappedFile.isMapped()) {
+        long dataOffset;
+        size_t dataSize;
+        getDataPlacement(layer, 0, level, dataOffset, dataSize);
+        m_mappedFile.discard(dataOffset, dataSize);
+      }
     }
 
     void releaseSource() override {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+
       closeHandle();
+      m_mappedFile.unmap();
+      m_mapFailed = false;
     }
 
     void placement(
@@ -396,31 +453,30 @@ namespace dxvk {
     }
 
     const void* data(int layer, int level) override {
-      uint32_t blobIdx = getBlobIndex(layer, 0, level);
-
-      const auto& it = m_data.find(blobIdx);
-      if (it != m_data.end() && !it->second.empty())
-        return it->second.data();
-
-      if (auto blobDesc = m_package->getDataBlobDesc(blobIdx)) {
-        if (blobDesc->compression != 0) {
-          throw DxvkError("Compressed data blobs are not supported for CPU readback.");
-        }
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+      return dataLocked(layer, level);
+    }
 
-        std::vector<uint8_t> data(blobDesc->size);
-        m_package->readDataBlob(blobIdx, data.data(), data.size());
+    void prefetch(int layer, int level) override {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
 
-        const void* rawData = data.data();
-        m_data[blobIdx] = std::move(data);
-        return rawData;
+      // Compressed blobs are only read through RTX IO,
+      // uncompressed mapped blobs only need their pages faulted in.
+      if (m_info.compression == AssetCompression::None && dataLocked(layer, level) != nullptr) {
+        m_package->prefetchDataBlob(getBlobIndex(layer, 0, level));
       }
-
-      return nullptr;
     }
 
     void evictCache(int layer, int level) override {
+      std::lock_guard<dxvk::mutex> lock(m_mutex);
+
       uint32_t blobIdx = getBlobIndex(layer, 0, level);
-      releaseVectorMemory(m_data[blobIdx]);
+      const auto& it = m_data.find(blobIdx);
+      if (it != m_data.end()) {
+        releaseVectorMemory(it->second);
+      }
+
+      m_package->discardDataBlob(blobIdx);
     }
 
     void releaseSource() override {
@@ -445,6 +501,33 @@ namespace dxvk {
     }
 
   private:
+    const void* dataLocked(int layer, int level) {
+      uint32_t blobIdx = getBlobIndex(layer, 0, level);
+
+      const auto& it = m_data.find(blobIdx);
+      if (it != m_data.end() && !it->second.empty())
+        return it->second.data();
+
+      if (auto blobDesc = m_package->getDataBlobDesc(blobIdx)) {
+        if (blobDesc->compression != 0) {
+          throw DxvkError("Compressed data blobs are not supported for CPU readback.");
+        }
+
+        if (const void* mappedData = m_package->mapDataBlob(blobIdx)) {
+          return mappedData;
+        }
+
+        std::vector<uint8_t> data(blobDesc->size);
+        m_package->readDataBlob(blobIdx, data.data(), data.size());
+
+        const void* rawData = data.data();
+        m_data[blobIdx] = std::move(data);
+        return rawData;
+      }
+
+      return nullptr;
+    }
+
     uint32_t getBlobIndex(int       layer,
                           int       face,
                           int       level) const {
@@ -469,6 +552,8 @@ namespace dxvk {
     const AssetPackage::AssetDesc* m_assetDesc = nullptr;
     uint32_t m_assetIdx;
 
+    // Guards the cached data, assets are read and prefetched from the I/O threads
+    dxvk::mutex m_mutex;
     std::unordered_map<uint32_t, std::vector<uint8_t>> m_data;
   };
 
@@ -0,0 +1,178 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "rtx_asset_io_scheduler.h"
+
+#include <cstring>
+
+#include "../../util/log/log.h"
+#include "../../util/util_env.h"
+#include "../../util/util_string.h"
+#include "dxvk_scoped_annotation.h"
+
+namespace dxvk {
+
+  AssetIoScheduler::AssetIoScheduler(const std::string& threadName, uint32_t numThreads)
+    : m_threadName(threadName) {
+    for (uint32_t i = 0; i < numThreads; ++i) {
+      m_threads.emplace_back([this] () { threadFunc(); });
+    }
+  }
+
+  AssetIoScheduler::~AssetIoScheduler() {
+    {
+      std::unique_lock<dxvk::mutex> lock(m_mutex);
+      m_stopped = true;
+      m_condOnAdd.notify_all();
+    }
+
+    for (auto& thread : m_threads) {
+      thread.join();
+    }
+
+    // Requests that have not been served are dropped
+    // without invoking their completion callbacks.
+    m_jobs.clear();
+  }
+
+  void AssetIoScheduler::submit(Request&& request) {
+    ScopedCpuProfileZone();
+
+    if (m_threads.empty() || request.numLevels == 0 || request.asset->isResident()) {
+      request.onComplete();
+      return;
+    }
+
+    // Offset of the first level in the source, used to order the reads
+    uint64_t offset = 0;
+    size_t size = 0;
+    request.asset->placement(0, 0, request.firstLevel, offset, size);
+
+    std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+    const uint64_t order = request.priority + (m_numSubmitted++ >> kAgingShift);
+    m_jobs.push_back({ std::move(request), offset, order });
+
+    ++m_pending;
+
+    m_condOnAdd.notify_one();
+  }
+
+  void AssetIoScheduler::sync(bool dropRequests) {
+    ScopedCpuProfileZone();
+
+    std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+    m_dropRequests = dropRequests;
+
+    m_condOnSync.wait(lock, [this] {
+      return !m_pending.load();
+    });
+
+    m_dropRequests = false;
+  }
+
+  bool AssetIoScheduler::isBefore(const Job& a, const Job& b) {
+    if (a.order != b.order) {
+      return a.order < b.order;
+    }
+
+    // Group the reads by source file and read each file front to back
+    const char* aFilename = a.request.asset->info().filename;
+    const char* bFilename = b.request.asset->info().filename;
+
+    if (aFilename != bFilename && aFilename != nullptr && bFilename != nullptr) {
+      const int cmp = std::strcmp(aFilename, bFilename);
+
+      if (cmp != 0) {
+        return cmp < 0;
+      }
+    }
+
+    return a.offset < b.offset;
+  }
+
+  void AssetIoScheduler::execute(Request& request) {
+    ScopedCpuProfileZone();
+
+    try {
+      for (uint32_t level = 0; level < request.numLevels && !m_dropRequests; ++level) {
+        for (uint32_t layer = 0; layer < request.asset->info().numLayers; ++layer) {
+          request.asset->prefetch(layer, request.firstLevel + level);
+        }
+      }
+    } catch (const DxvkError& e) {
+      // The consumer reads the data again and reports the failure
+      Logger::warn(str::format("Unable to prefetch asset ", request.asset->info().filename, ": ", e.message()));
+    }
+  }
+
+  void AssetIoScheduler::threadFunc() {
+    env::setThreadName(m_threadName);
+
+    while (true) {
+      Job job;
+
+      {
+        std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+        m_condOnAdd.wait(lock, [this] {
+          return !m_jobs.empty() || m_stopped;
+        });
+
+        if (m_stopped)
+          break;
+
+        // The queue is short-lived and small enough for a linear scan,
+        // and a scan lets the request ordering account for aging.
+        auto best = m_jobs.begin();
+
+        for (auto it = m_jobs.begin() + 1; it != m_jobs.end(); ++it) {
+          if (isBefore(*it, *best)) {
+            best = it;
+          }
+        }
+
+        job = std::move(*best);
+
+        if (best != m_jobs.end() - 1) {
+          *best = std::move(m_jobs.back());
+        }
+
+        m_jobs.pop_back();
+      }
+
+      execute(job.request);
+
+      job.request.onComplete();
+      job.request = Request();
+
+      {
+        std::unique_lock<dxvk::mutex> lock(m_mutex);
+
+        if (--m_pending == 0) {
+          m_condOnSync.notify_all();
+        }
+      }
+    }
+  }
+
+} // namespace dxvk
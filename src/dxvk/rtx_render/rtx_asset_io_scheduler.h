@@ -0,0 +1,122 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <functional>
+#include <string>
+#include <vector>
+
+#include "../../util/thread.h"
+#include "../../util/rc/util_rc_ptr.h"
+#include "rtx_asset_data.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Asynchronous asset read scheduler
+   *
+   * Reads asset subresources from the source media on a small pool of
+   * I/O threads ahead of their consumers, so that the consumer (e.g. the
+   * texture upload thread) finds the data in memory and does not block
+   * on the disk.
+   *
+   * Pending requests are served in priority order. Requests of equal
+   * priority are grouped by source file and ordered by the file offset
+   * of their data, which keeps the reads issued by the I/O threads as
+   * sequential as possible. Older requests slowly gain priority so that
+   * large requests are not starved by a steady stream of small ones.
+   */
+  class AssetIoScheduler {
+  public:
+    struct Request {
+      Rc<AssetData> asset;                              // asset to read, levels are relative to this asset
+      uint32_t firstLevel = 0;                          // first image level to read
+      uint32_t numLevels = 0;                           // number of image levels to read
+      uint32_t priority = 0;                            // lower values are served first
+      std::function<void()> onComplete;                 // invoked on an I/O thread once the data is in memory
+    };
+
+    AssetIoScheduler(const std::string& threadName, uint32_t numThreads);
+    ~AssetIoScheduler();
+
+    AssetIoScheduler(const AssetIoScheduler&) = delete;
+    AssetIoScheduler& operator=(const AssetIoScheduler&) = delete;
+
+    /**
+      * \brief Schedules an asset read
+      *
+      * Assets that are resident in host memory do not need any I/O,
+      * their completion callback is invoked on the calling thread.
+      * An asset must not be accessed by anyone else until the
+      * completion callback of its request has been invoked.
+      * \param [in] request Read request
+      */
+    void submit(Request&& request);
+
+    /**
+      * \brief Waits for all scheduled requests to complete
+      *
+      * \param [in] dropRequests Skip the reads of requests that have not
+      *   started yet. Completion callbacks are invoked regardless.
+      */
+    void sync(bool dropRequests);
+
+    /**
+      * \brief Returns the number of requests which callbacks have not been invoked yet
+      */
+    uint32_t pending() const {
+      return m_pending.load();
+    }
+
+  private:
+    struct Job {
+      Request request;
+      uint64_t offset;
+      uint64_t order;
+    };
+
+    // A request gains one priority step every 2^kAgingShift requests submitted after it
+    static constexpr uint32_t kAgingShift = 6;
+
+    std::vector<dxvk::thread> m_threads;
+    std::string m_threadName;
+
+    dxvk::mutex m_mutex;
+    dxvk::condition_variable m_condOnAdd;
+    dxvk::condition_variable m_condOnSync;
+
+    std::vector<Job> m_jobs;
+    uint64_t m_numSubmitted = 0;
+
+    std::atomic<uint32_t> m_pending = { 0u };
+    std::atomic<bool> m_dropRequests = { false };
+    bool m_stopped = false;
+
+    static bool isBefore(const Job& a, const Job& b);
+
+    void execute(Request& request);
+
+    void threadFunc();
+  };
+
+} // namespace dxvk
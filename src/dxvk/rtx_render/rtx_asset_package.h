@@ -24,12 +24,20 @@
 #include <stddef.h>
 #include <stdio.h>
 
+#include <algorithm>
+#include <cstring>
 #include <memory>
+#include <new>
 #include <string>
+#include <string_view>
+#include <vector>
 
 #include "../../util/rc/util_rc.h"
 #include "../../util/log/log.h"
 #include "../../util/util_string.h"
+#include "../../util/util_mapped_file.h"
+#include "../../util/thread.h"
+#include "../../util/xxHash/xxhash.h"
 
 #ifdef WIN32
 #define fseek64 _fseeki64
@@ -43,10 +51,16 @@
 namespace dxvk {
 
   // A trivial assets package file container
+  //
+  // Version 1 packages store 16 bit asset and blob counts and indices
+  // followed by a plain table of asset names. Version 2 packages store
+  // 32 bit counts and indices and a name index sorted by the name hash,
+  // so that the dictionary can be used straight from the mapped file.
   class AssetPackage : public RcObject {
   public:
     static constexpr uint32_t kMagic = 0xbaadd00d;
-    static constexpr uint32_t kVersion = 1;
+    static constexpr uint32_t kVersion = 2;
+    static constexpr uint32_t kMinVersion = 1;
     static constexpr uint32_t kNoAssetIdx = ~0;
 
     struct Header {
@@ -65,10 +79,11 @@ namespace dxvk {
         BUFFER,
       };
 
-      uint16_t nameIdx;
+      uint32_t nameOffset;
 
       Type type;
       uint8_t format;
+      uint16_t depth;
 
       union {
         uint32_t size;
@@ -77,17 +92,18 @@ namespace dxvk {
           uint16_t height;
         };
       };
-      uint16_t depth;
 
       uint16_t numMips;
       uint16_t numTailMips;
       uint16_t arraySize;
+      uint16_t reserved0;
 
-      uint16_t baseBlobIdx;
-      uint16_t tailBlobIdx;
+      uint32_t baseBlobIdx;
+      uint32_t tailBlobIdx;
+      uint32_t reserved1;
     };
 
-    static_assert(sizeof(AssetDesc) == 20, "Asset description structure size overrun!");
+    static_assert(sizeof(AssetDesc) == 32, "Asset description structure size overrun!");
 
     struct BlobDesc {
       uint64_t offset : 40;
@@ -100,6 +116,32 @@ namespace dxvk {
 
     static_assert(sizeof(BlobDesc) == 16, "Blob description structure size overrun!");
 
+    // Version 2 dictionary layout, starting at Header::dictOffset:
+    //   DictHeader
+    //   AssetDesc[assetCount]
+    //   BlobDesc[blobCount]
+    //   NameIndexEntry[assetCount], sorted by hash, then by asset index
+    //   Name table, nul-terminated names referenced by AssetDesc::nameOffset
+    struct DictHeader {
+      uint32_t assetCount;
+      uint32_t blobCount;
+      uint64_t nameTableSize;
+    };
+
+    static_assert(sizeof(DictHeader) == 16, "Dictionary header structure size overrun!");
+
+    struct NameIndexEntry {
+      uint64_t hash;
+      uint32_t assetIdx;
+      uint32_t reserved;
+    };
+
+    static_assert(sizeof(NameIndexEntry) == 16, "Name index entry structure size overrun!");
+
+    static uint64_t hashName(const std::string_view& name) {
+      return XXH3_64bits(name.data(), name.size());
+    }
+
     AssetPackage() = default;
     explicit AssetPackage(const std::string& filename)
       : m_filename { filename } { }
@@ -113,6 +155,8 @@ namespace dxvk {
         return false;
 
       closeFileHandle();
+      unmapFile();
+      resetDictionary();
 
       if (m_filename.empty() && nullptr != filename)
         m_filename = filename;
@@ -129,58 +173,24 @@ namespace dxvk {
           return false;
         }
 
-        if (header.version != kVersion) {
+        if (header.version < kMinVersion || header.version > kVersion) {
           Logger::err(str::format("Asset package ", m_filename, " version mismatch. "
-                                  "Got: ", header.version, ", expected: ", kVersion));
-          return false;
-        }
-
-        if (0 != fseek64(m_handle, header.dictOffset, SEEK_SET)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        if (1 != fread(&m_assetCount, 2, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        if (1 != fread(&m_blobCount, 2, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
-
-        const size_t dictSize =
-          m_assetCount * sizeof(AssetDesc) + m_blobCount * sizeof(BlobDesc);
-
-        m_metadata.reset(new uint8_t[dictSize]);
-
-        if (dictSize != fread(m_metadata.get(), 1, dictSize, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
+                                  "Got: ", header.version, ", expected: ", kMinVersion, "..", kVersion));
           return false;
         }
 
-        size_t nameTableOffset = ftell64(m_handle);
-        fseek64(m_handle, 0, SEEK_END);
-        size_t nameTableSize = ftell64(m_handle) - nameTableOffset;
-        fseek64(m_handle, nameTableOffset, SEEK_SET);
-
-        std::unique_ptr<char[]> names(new char[nameTableSize]);
-
-        if (1 != fread(names.get(), nameTableSize, 1, m_handle)) {
-          Logger::err(str::format("Malformed asset package ", m_filename));
-          return false;
-        }
+        const bool result = header.version == 1 ?
+          loadDictionaryV1(header.dictOffset) :
+          loadDictionaryV2(header.dictOffset);
 
         closeFileHandle();
 
-        auto namesPtr = names.get();
-        for (uint32_t n = 0; n < m_assetCount; n++) {
-          m_nameHash.emplace(namesPtr, n);
-          namesPtr += strlen(namesPtr) + 1;
+        if (!result) {
+          Logger::err(str::format("Malformed asset package ", m_filename));
+          resetDictionary();
         }
 
-        return true;
+        return result;
       }
 
       return false;
@@ -208,22 +218,39 @@ namespace dxvk {
     }
 
     const AssetDesc* getAssetDesc(uint32_t idx) const {
-      if (!m_metadata || idx >= m_assetCount)
+      if (idx >= m_assetCount)
         return nullptr;
 
-      const size_t offs = idx * sizeof(AssetDesc);
-
-      return reinterpret_cast<const AssetDesc*>(m_metadata.get() + offs);
+      return m_assetDescs + idx;
     }
 
     const BlobDesc* getDataBlobDesc(uint32_t idx) const {
-      if (!m_metadata || idx >= m_blobCount)
+      if (idx >= m_blobCount)
         return nullptr;
 
-      const size_t offs = m_assetCount * sizeof(AssetDesc) +
-        idx * sizeof(BlobDesc);
+      return m_blobDescs + idx;
+    }
+
+    /**
+     * \brief Get the name of an asset
+     *
+     * \param [in] idx Asset index
+     * \returns Asset name, empty if the asset does not exist.
+     *   Points into the package dictionary.
+     */
+    std::string_view getAssetName(uint32_t idx) const {
+      auto assetDesc = getAssetDesc(idx);
+
+      if (assetDesc == nullptr || assetDesc->nameOffset >= m_nameTableSize)
+        return std::string_view();
 
-      return reinterpret_cast<const BlobDesc*>(m_metadata.get() + offs);
+      const char* name = m_nameTable + assetDesc->nameOffset;
+      const void* nameEnd = memchr(name, 0, m_nameTableSize - assetDesc->nameOffset);
+
+      if (nameEnd == nullptr)
+        return std::string_view();
+
+      return std::string_view(name, static_cast<const char*>(nameEnd) - name);
     }
 
     size_t readDataBlob(uint32_t idx, void* out, size_t outSize) {
@@ -231,6 +258,9 @@ namespace dxvk {
         if (outSize < blobDesc->size)
           return 0;
 
+        // Assets of the same package may be read from several I/O threads
+        std::lock_guard<dxvk::mutex> lock(m_readMutex);
+
         if (!openFileHandle())
           return 0;
 
@@ -241,6 +271,68 @@ namespace dxvk {
       return 0;
     }
 
+    /**
+     * \brief Get a pointer to an uncompressed data blob
+     *
+     * Maps the package file on first use and returns a pointer to the
+     * blob data inside the mapping. The pointer remains valid for the
+     * lifetime of the package, so blob data can be consumed without
+     * an intermediate copy.
+     * \param [in] idx Data blob index
+     * \returns Pointer to blob data or \c nullptr if the blob is
+     *   compressed, out of the file bounds or mapping has failed.
+     */
+    const void* mapDataBlob(uint32_t idx) {
+      auto blobDesc = getDataBlobDesc(idx);
+
+      if (blobDesc == nullptr || blobDesc->compression != 0)
+        return nullptr;
+
+      {
+        std::lock_guard<dxvk::mutex> lock(m_mappingMutex);
+
+        if (!m_mappedFile.isMapped() && !m_mappingFailed) {
+          m_mappingFailed = !m_mappedFile.map(m_filename);
+
+          if (m_mappingFailed) {
+            Logger::warn(str::format("Unable to map package file ", m_filename,
+                                     ", falling back to buffered reads."));
+          }
+        }
+      }
+
+      return m_mappedFile.view(blobDesc->offset, blobDesc->size);
+    }
+
+    /**
+     * \brief Read a mapped data blob into memory
+     *
+     * Faults in the pages backing the blob, so that subsequent
+     * accesses through the pointer returned by mapDataBlob() do
+     * not wait for the disk.
+     * \param [in] idx Data blob index
+     */
+    void prefetchDataBlob(uint32_t idx) const {
+      if (auto blobDesc = getDataBlobDesc(idx)) {
+        m_mappedFile.prefetch(blobDesc->offset, blobDesc->size);
+      }
+    }
+
+    /**
+     * \brief Release the memory backing a mapped data blob
+     *
+     * Hints the OS that the blob data is not needed anymore. The pointer
+     * returned by mapDataBlob() remains valid, the data will be read from
+     * the file again when accessed.
+     * \param [in] idx Data blob index
+     */
+    void discardDataBlob(uint32_t idx) {
+      if (auto blobDesc = getDataBlobDesc(idx)) {
+        std::lock_guard<dxvk::mutex> lock(m_mappingMutex);
+        m_mappedFile.discard(blobDesc->offset, blobDesc->size);
+      }
+    }
+
     size_t getDataSize() {
       if (!openFileHandle())
         return 0;
@@ -257,10 +349,22 @@ namespace dxvk {
     }
 
     uint32_t findAsset(const std::string& filename) const {
-      auto it = m_nameHash.find(filename);
+      const uint64_t hash = hashName(filename);
+
+      const NameIndexEntry* begin = m_nameIndex;
+      const NameIndexEntry* end = m_nameIndex + m_assetCount;
+
+      auto it = std::lower_bound(begin, end, hash,
+        [](const NameIndexEntry& entry, uint64_t hash) {
+          return entry.hash < hash;
+        });
 
-      if (it != m_nameHash.end()) {
-        return it->second;
+      // Names are compared in place, hash collisions are resolved
+      // in favor of the asset with the lowest index.
+      for (; it != end && it->hash == hash; ++it) {
+        if (it->assetIdx < m_assetCount && getAssetName(it->assetIdx) == filename) {
+          return it->assetIdx;
+        }
       }
 
       return kNoAssetIdx;
@@ -271,14 +375,205 @@ namespace dxvk {
     }
 
   private:
+    // Version 1 asset description, converted to AssetDesc on load
+    struct AssetDescV1 {
+      uint16_t nameIdx;
+
+      AssetDesc::Type type;
+      uint8_t format;
+
+      union {
+        uint32_t size;
+        struct {
+          uint16_t width;
+          uint16_t height;
+        };
+      };
+      uint16_t depth;
+
+      uint16_t numMips;
+      uint16_t numTailMips;
+      uint16_t arraySize;
+
+      uint16_t baseBlobIdx;
+      uint16_t tailBlobIdx;
+    };
+
+    static_assert(sizeof(AssetDescV1) == 20, "Asset description structure size overrun!");
+
+    void unmapFile() {
+      std::lock_guard<dxvk::mutex> lock(m_mappingMutex);
+      m_mappedFile.unmap();
+      m_mappingFailed = false;
+    }
+
+    void resetDictionary() {
+      m_assetCount = 0;
+      m_blobCount = 0;
+      m_nameTableSize = 0;
+
+      m_assetDescs = nullptr;
+      m_blobDescs = nullptr;
+      m_nameIndex = nullptr;
+      m_nameTable = nullptr;
+
+      m_metadata.reset();
+    }
+
+    bool loadDictionaryV1(uint64_t dictOffset) {
+      if (0 != fseek64(m_handle, dictOffset, SEEK_SET))
+        return false;
+
+      uint16_t assetCount = 0;
+      uint16_t blobCount = 0;
+
+      if (1 != fread(&assetCount, 2, 1, m_handle) ||
+          1 != fread(&blobCount, 2, 1, m_handle))
+        return false;
+
+      std::vector<AssetDescV1> assetDescs(assetCount);
+
+      if (assetCount != fread(assetDescs.data(), sizeof(AssetDescV1), assetCount, m_handle))
+        return false;
+
+      // The name table takes the rest of the file
+      const size_t blobDescsOffset = ftell64(m_handle);
+      fseek64(m_handle, 0, SEEK_END);
+      const size_t fileSize = ftell64(m_handle);
+      fseek64(m_handle, blobDescsOffset, SEEK_SET);
+
+      const size_t blobDescsSize = blobCount * sizeof(BlobDesc);
+
+      if (fileSize < blobDescsOffset + blobDescsSize)
+        return false;
+
+      const size_t nameTableSize = fileSize - blobDescsOffset - blobDescsSize;
+
+      // Convert to the version 2 layout, the names are kept in a single block
+      m_metadata.reset(new uint8_t[assetCount * sizeof(AssetDesc) + blobDescsSize +
+                                   assetCount * sizeof(NameIndexEntry) + nameTableSize]);
+
+      auto assets = reinterpret_cast<AssetDesc*>(m_metadata.get());
+      auto blobs = reinterpret_cast<BlobDesc*>(assets + assetCount);
+      auto nameIndex = reinterpret_cast<NameIndexEntry*>(blobs + blobCount);
+      auto nameTable = reinterpret_cast<char*>(nameIndex + assetCount);
+
+      if (blobDescsSize != fread(blobs, 1, blobDescsSize, m_handle) ||
+          nameTableSize != fread(nameTable, 1, nameTableSize, m_handle))
+        return false;
+
+      // Names are stored back to back in asset order
+      size_t nameOffset = 0;
+
+      for (uint32_t n = 0; n < assetCount; n++) {
+        const AssetDescV1& src = assetDescs[n];
+        AssetDesc& dst = assets[n];
+
+        const void* nameEnd = nameOffset < nameTableSize ?
+          memchr(nameTable + nameOffset, 0, nameTableSize - nameOffset) : nullptr;
+
+        if (nameEnd == nullptr)
+          return false;
+
+        dst = AssetDesc { };
+        dst.nameOffset = static_cast<uint32_t>(nameOffset);
+        dst.type = src.type;
+        dst.format = src.format;
+        dst.depth = src.depth;
+        dst.size = src.size;
+        dst.numMips = src.numMips;
+        dst.numTailMips = src.numTailMips;
+        dst.arraySize = src.arraySize;
+        dst.baseBlobIdx = src.baseBlobIdx;
+        dst.tailBlobIdx = src.tailBlobIdx;
+
+        const size_t nameLength = static_cast<const char*>(nameEnd) - (nameTable + nameOffset);
+        nameIndex[n] = { hashName(std::string_view(nameTable + nameOffset, nameLength)), n, 0 };
+
+        nameOffset += nameLength + 1;
+      }
+
+      std::sort(nameIndex, nameIndex + assetCount,
+        [](const NameIndexEntry& a, const NameIndexEntry& b) {
+          return a.hash < b.hash || (a.hash == b.hash && a.assetIdx < b.assetIdx);
+        });
+
+      setDictionary(assetCount, blobCount, m_metadata.get(), nameTableSize);
+
+      return true;
+    }
+
+    bool loadDictionaryV2(uint64_t dictOffset) {
+      DictHeader dictHeader { 0 };
+
+      if (0 != fseek64(m_handle, dictOffset, SEEK_SET) ||
+          sizeof(dictHeader) != fread(&dictHeader, 1, sizeof(dictHeader), m_handle))
+        return false;
+
+      const uint64_t dictSize =
+        uint64_t(dictHeader.assetCount) * (sizeof(AssetDesc) + sizeof(NameIndexEntry)) +
+        uint64_t(dictHeader.blobCount) * sizeof(BlobDesc) + dictHeader.nameTableSize;
+
+      // Use the dictionary in place when the package can be mapped,
+      // nothing but the pages touched by lookups is read from disk.
+      const uint64_t dataOffset = dictOffset + sizeof(DictHeader);
+
+      if (dataOffset % alignof(BlobDesc) == 0) {
+        std::lock_guard<dxvk::mutex> lock(m_mappingMutex);
+
+        m_mappingFailed = !m_mappedFile.map(m_filename);
+
+        if (m_mappingFailed) {
+          Logger::warn(str::format("Unable to map package file ", m_filename,
+                                   ", falling back to buffered reads."));
+        }
+
+        if (const void* data = m_mappedFile.view(dataOffset, dictSize)) {
+          setDictionary(dictHeader.assetCount, dictHeader.blobCount, data, dictHeader.nameTableSize);
+          return true;
+        }
+      }
+
+      m_metadata.reset(new (std::nothrow) uint8_t[dictSize]);
+
+      if (!m_metadata || dictSize != fread(m_metadata.get(), 1, dictSize, m_handle))
+        return false;
+
+      setDictionary(dictHeader.assetCount, dictHeader.blobCount, m_metadata.get(), dictHeader.nameTableSize);
+
+      return true;
+    }
+
+    void setDictionary(uint32_t assetCount, uint32_t blobCount, const void* data, uint64_t nameTableSize) {
+      m_assetCount = assetCount;
+      m_blobCount = blobCount;
+
+      m_assetDescs = static_cast<const AssetDesc*>(data);
+      m_blobDescs = reinterpret_cast<const BlobDesc*>(m_assetDescs + assetCount);
+      m_nameIndex = reinterpret_cast<const NameIndexEntry*>(m_blobDescs + blobCount);
+      m_nameTable = reinterpret_cast<const char*>(m_nameIndex + assetCount);
+      m_nameTableSize = static_cast<size_t>(nameTableSize);
+    }
+
     std::string m_filename;
     FILE* m_handle = nullptr;
+    dxvk::mutex m_readMutex;
+
+    dxvk::mutex m_mappingMutex;
+    MappedFile m_mappedFile;
+    bool m_mappingFailed = false;
 
     uint32_t m_assetCount = 0;
     uint32_t m_blobCount = 0;
 
+    // The dictionary points either into the mapped package file or into m_metadata
+    const AssetDesc* m_assetDescs = nullptr;
+    const BlobDesc* m_blobDescs = nullptr;
+    const NameIndexEntry* m_nameIndex = nullptr;
+    const char* m_nameTable = nullptr;
+    size_t m_nameTableSize = 0;
+
     std::unique_ptr<uint8_t[]> m_metadata;
-    std::unordered_map<std::string, uint32_t> m_nameHash;
   };
 
 } // namespace dxvk
@@ -38,6 +38,7 @@ namespace dxvk {
       m_tables[Table::Textures][i].reset(new BindlessTable(this));
       m_tables[Table::Buffers][i].reset(new BindlessTable(this));
       m_tables[Table::Samplers][i].reset(new BindlessTable(this));
+      m_outdatedSamplers[i] = { 0, kMaxBindlessResources };
     }
 
     createGlobalBindlessDescPool();
@@ -55,47 +56,55 @@ namespace dxvk {
   }
 
   template<VkDescriptorType Type, typename T, typename U>
-  void BindlessResourceManager::createDescriptorSet(const Rc<DxvkContext>& ctx, const std::vector<U>& engineObjects, const T& dummyDescriptor) {
+  void BindlessResourceManager::createDescriptorSet(const Rc<DxvkContext>& ctx, const std::vector<U>& engineObjects, const T& dummyDescriptor, const SlotRange& range) {
     const size_t numDescriptors = std::max((size_t) 1, engineObjects.size()); // Must always leave 1 to have a valid binding set
     assert(numDescriptors <= kMaxBindlessResources);
 
-    std::vector<T> descriptorInfos(numDescriptors);
+    // Only the descriptors within the range are written, descriptors past the table are left as they are
+    const size_t firstDescriptor = std::min((size_t) range.begin, numDescriptors);
+    const size_t endDescriptor = std::min((size_t) range.end, numDescriptors);
+
+    if (firstDescriptor == endDescriptor) {
+      return;
+    }
+
+    std::vector<T> descriptorInfos(endDescriptor - firstDescriptor);
     descriptorInfos[0] = dummyDescriptor; // we set the first descriptor to be a dummy (size is always at least 1) and overwrite it if there are valid engine objects
 
-    uint32_t idx = 0;
-    for (auto&& engineObject : engineObjects) {
-      descriptorInfos[idx] = dummyDescriptor;
+    for (size_t idx = firstDescriptor; idx < std::min(endDescriptor, engineObjects.size()); ++idx) {
+      const U& engineObject = engineObjects[idx];
+      T& descriptorInfo = descriptorInfos[idx - firstDescriptor];
+      descriptorInfo = dummyDescriptor;
 
       if constexpr (Type == VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE) {
         DxvkImageView* imageView = engineObject.getImageView();
         if (imageView != nullptr) {
-          descriptorInfos[idx].sampler = nullptr;
-          descriptorInfos[idx].imageView = imageView->handle();
-          descriptorInfos[idx].imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+          descriptorInfo.sampler = nullptr;
+          descriptorInfo.imageView = imageView->handle();
+          descriptorInfo.imageLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
           ctx->getCommandList()->trackResource<DxvkAccess::Read>(imageView);
         }
       } else if constexpr (Type == VK_DESCRIPTOR_TYPE_STORAGE_BUFFER) {
         if (engineObject.defined()) {
-          descriptorInfos[idx] = engineObject.getDescriptor().buffer;
+          descriptorInfo = engineObject.getDescriptor().buffer;
           ctx->getCommandList()->trackResource<DxvkAccess::Read>(engineObject.buffer());
         }
       } else if constexpr (Type == VK_DESCRIPTOR_TYPE_SAMPLER) {
         if (engineObject != nullptr) {
-          descriptorInfos[idx].sampler = engineObject->handle();
-          descriptorInfos[idx].imageView = nullptr;
+          descriptorInfo.sampler = engineObject->handle();
+          descriptorInfo.imageView = nullptr;
         }
       } else {
         static_assert(Type != VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE || Type != VK_DESCRIPTOR_TYPE_STORAGE_BUFFER || Type != VK_DESCRIPTOR_TYPE_SAMPLER, "Support for this descriptor type has not been implemented yet.");
         return;
       }
-
-      ++idx;
     }
 
     VkWriteDescriptorSet descWrites;
     memset(&descWrites, 0, sizeof(descWrites));
     descWrites.sType = VK_STRUCTURE_TYPE_WRITE_DESCRIPTOR_SET;
-    descWrites.descriptorCount = numDescriptors;
+    descWrites.dstArrayElement = firstDescriptor;
+    descWrites.descriptorCount = endDescriptor - firstDescriptor;
     descWrites.descriptorType = Type;
 
     if constexpr (std::is_same_v<T, VkDescriptorImageInfo>) {
@@ -117,8 +126,14 @@ namespace dxvk {
     }
   }
 
-  void BindlessResourceManager::prepareSceneData(const Rc<DxvkContext> ctx, const std::vector<TextureRef>& rtTextures, const std::vector<RaytraceBuffer>& rtBuffers, const std::vector<Rc<DxvkSampler>>& samplers) {
+  void BindlessResourceManager::prepareSceneData(const Rc<DxvkContext> ctx, const std::vector<TextureRef>& rtTextures, const std::vector<RaytraceBuffer>& rtBuffers, const std::vector<Rc<DxvkSampler>>& samplers, const SlotRange& samplersChanged) {
     ScopedCpuProfileZone();
+    // Samplers are kept alive by the sampler cache and need no tracking, so the
+    // sampler sets only need the slots that changed since each set was written.
+    for (auto& outdatedSamplers : m_outdatedSamplers) {
+      outdatedSamplers.merge(samplersChanged);
+    }
+
     if (m_frameLastUpdated == m_device->getCurrentFrameId()) {
       Logger::debug("Updating bindless tables multiple times per frame...");
       return;
@@ -133,7 +148,8 @@ namespace dxvk {
 
     createDescriptorSet<VK_DESCRIPTOR_TYPE_SAMPLED_IMAGE>(ctx, rtTextures, dummyImage);
     createDescriptorSet<VK_DESCRIPTOR_TYPE_STORAGE_BUFFER>(ctx, rtBuffers, dummyBuffer);
-    createDescriptorSet<VK_DESCRIPTOR_TYPE_SAMPLER>(ctx, samplers, dummySampler);
+    createDescriptorSet<VK_DESCRIPTOR_TYPE_SAMPLER>(ctx, samplers, dummySampler, m_outdatedSamplers[currentIdx()]);
+    m_outdatedSamplers[currentIdx()] = {};
 
     m_frameLastUpdated = m_device->getCurrentFrameId();
   }
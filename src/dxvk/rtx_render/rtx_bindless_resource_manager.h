@@ -22,6 +22,7 @@
 #pragma once
 #include "rtx_utils.h"
 #include "rtx_common_object.h"
+#include "rtx_sparse_unique_cache.h"
 
 namespace dxvk {
   class DxvkDevice;
@@ -45,7 +46,9 @@ namespace dxvk {
 
     explicit BindlessResourceManager(DxvkDevice* device);
 
-    void prepareSceneData(const Rc<DxvkContext> ctx, const std::vector<TextureRef>& rtTextures, const std::vector<RaytraceBuffer>& rtBuffers, const std::vector<Rc<DxvkSampler>>& samplers);
+    // samplersChanged: range of sampler slots changed since the previous call, the other
+    // tables are rewritten in full every frame.
+    void prepareSceneData(const Rc<DxvkContext> ctx, const std::vector<TextureRef>& rtTextures, const std::vector<RaytraceBuffer>& rtBuffers, const std::vector<Rc<DxvkSampler>>& samplers, const SlotRange& samplersChanged);
 
     VkDescriptorSet getGlobalBindlessTableSet(Table type) const;
 
@@ -79,6 +82,9 @@ namespace dxvk {
     
     std::unique_ptr<BindlessTable> m_tables[Table::Count][kMaxFramesInFlight];
 
+    // Sampler slots each of the sampler descriptor sets is missing, every set starts out empty
+    SlotRange m_outdatedSamplers[kMaxFramesInFlight];
+
     uint32_t m_globalBindlessDescSetIdx = 0;
     uint32_t m_frameLastUpdated = UINT_MAX;
 
@@ -94,6 +100,6 @@ namespace dxvk {
     void createGlobalBindlessDescPool();
 
     template<VkDescriptorType Type, typename T, typename U>
-    void createDescriptorSet(const Rc<DxvkContext>& ctx, const std::vector<U>& engineObjects, const T& dummyDescriptor);
+    void createDescriptorSet(const Rc<DxvkContext>& ctx, const std::vector<U>& engineObjects, const T& dummyDescriptor, const SlotRange& range = { 0, kMaxBindlessResources });
   };
 } // namespace dxvk 
\ No newline at end of file
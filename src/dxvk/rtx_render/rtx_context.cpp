@@ -32,6 +32,7 @@
 #include "rtx_context.h"
 #include "rtx_asset_exporter.h"
 #include "rtx_options.h"
+#include "rtx_frame_options.h"
 #include "rtx_bindless_resource_manager.h"
 #include "rtx_opacity_micromap_manager.h"
 #include "rtx_asset_replacer.h"
@@ -405,6 +406,10 @@ namespace dxvk {
 
     m_device->setPresentThrottleDelay(RtxOptions::Get()->getPresentThrottleDelay());
 
+    // Options read by the hot paths stay fixed from here until the next frame
+    // Note: Published before any early out, so that option changes are picked up even on frames which are not raytraced.
+    RtxFrameOptions::publish();
+
     if (!m_rayTracingSupported) {
       ONCE(Logger::info(str::format("[RTX-Compatibility-Info] Raytracing doesn't appear to be supported on this HW.")));
       return;
@@ -685,6 +690,9 @@ namespace dxvk {
     }
     s_triggerScreenshot = false;
 
+    // Return the small slices cached by threads that stopped allocating, once per frame
+    m_device->getCommon()->memoryManager().trimIdleSmallSliceCaches();
+
     // Some time in the future kill process
     if (m_triggerDelayedTerminate &&
         (m_device->getCurrentFrameId() > m_terminateAppFrameNum) &&
@@ -736,7 +744,7 @@ namespace dxvk {
     RasterGeometry& geoData = drawCallState.geometryData;
     DrawCallTransforms& transformData = drawCallState.transformData;
 
-    assert(geoData.futureGeometryHashes.valid());
+    assert(geoData.futureAnalysis.valid());
     assert(geoData.positionBuffer.defined());
 
     const auto fusedMode = RtxOptions::Get()->fusedWorldViewMode();
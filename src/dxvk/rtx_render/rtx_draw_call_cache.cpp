@@ -21,6 +21,7 @@
 */
 #include "rtx_draw_call_cache.h"
 #include "../d3d9/d3d9_state.h"
+#include "../util/util_small_vector.h"
 
 namespace dxvk 
 {
@@ -41,26 +42,31 @@ namespace {
   }
 }
 
-DrawCallCache::DrawCallCache(DxvkDevice* device) : CommonDeviceObject(device) {
-  m_entries.reserve(1024);
+DrawCallCache::DrawCallCache(DxvkDevice* device)
+  : CommonDeviceObject(device)
+  , m_index(1024) {
 }
 DrawCallCache::~DrawCallCache() {}
 
 DrawCallCache::CacheState DrawCallCache::get(const DrawCallState& drawCall, BlasEntry** out) {
   // First, find the right bucket:
   const XXH64_hash_t hash = drawCall.getGeometryData().getHashForRule<rules::TopologicalHash>();
-  auto range = m_entries.equal_range(hash);
-  if (range.first == m_entries.end()) {
+
+  small_vector<BlasEntry*, 8> bucket;
+  m_index.find(hash, [&](uint32_t index) {
+    bucket.push_back(&m_entries[index]);
+    return true;
+  });
+
+  if (bucket.size() == 0) {
     // New bucket
     *out = allocateEntry(hash, drawCall);
     return CacheState::kNew;
   }
   // Handle buckets with 1 entry:
-  auto iter = range.first;
-  iter++;
-  if (iter == range.second) {
+  if (bucket.size() == 1) {
     // Only 1 element
-    BlasEntry& entry = range.first->second;
+    BlasEntry& entry = *bucket[0];
 
     const bool updatedThisFrame = entry.frameLastTouched == m_device->getCurrentFrameId();
     const bool vertexDataMatches = entry.input.getGeometryData().getHashForRule<rules::VertexDataHash>() == drawCall.getGeometryData().getHashForRule<rules::VertexDataHash>();
@@ -87,8 +93,8 @@ DrawCallCache::CacheState DrawCallCache::get(const DrawCallState& drawCall, Blas
   Matrix4 newTransform = drawCall.getTransformData().objectToWorld;
   const Vector3 newWorldPosition = drawCall.getGeometryData().boundingBox.getTransformedCentroid(newTransform);
 
-  for (auto bucketIter = range.first; bucketIter != range.second; bucketIter++) {
-    BlasEntry& blas  = bucketIter->second;
+  for (uint32_t i = 0; i < bucket.size(); i++) {
+    BlasEntry& blas = *bucket[i];
     if (exactMatch(drawCall, blas)) {
       *out = &blas;
       return CacheState::kExisted;
@@ -128,8 +134,16 @@ DrawCallCache::CacheState DrawCallCache::get(const DrawCallState& drawCall, Blas
 }
 
 BlasEntry* DrawCallCache::allocateEntry(XXH64_hash_t hash, const DrawCallState& drawCall) {
-  auto iter = m_entries.emplace(hash, drawCall);
-  BlasEntry* result = &iter->second;
+  const uint32_t index = m_entries.emplace(drawCall).index;
+
+  if (index >= m_entryHashes.size()) {
+    m_entryHashes.resize(index + 1);
+  }
+
+  m_entryHashes[index] = hash;
+  m_index.insert(hash, index);
+
+  BlasEntry* result = &m_entries[index];
   result->frameCreated = m_device->getCurrentFrameId();
   return result;
 }
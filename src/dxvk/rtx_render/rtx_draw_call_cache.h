@@ -26,6 +26,7 @@
 #include <unordered_map>
 
 #include "../util/util_vector.h"
+#include "../util/util_slot_map.h"
 #include "dxvk_scoped_annotation.h"
 
 #include "rtx_types.h"
@@ -38,10 +39,10 @@ class DxvkDevice;
 
 // A cache of the BlasEntries across frames.  This maintains stable BlasEntry pointers until that BlasEntry
 // is erased by sceneManager's garbage collection.
+// BlasEntries live in a slot map, and are found through an open addressed index keyed by the topological hash,
+// so the per draw lookups and the garbage collection walk contiguous memory.
 class DrawCallCache : public CommonDeviceObject {
 public:
-  using MultimapType = std::unordered_multimap<XXH64_hash_t, BlasEntry, XXH64_hash_passthrough>;
-
   enum class CacheState
   {
     kNew = 0,
@@ -56,20 +57,41 @@ public:
 
   CacheState get(const DrawCallState& drawCall, BlasEntry** out);
 
-  MultimapType& getEntries() {return m_entries;}
+  size_t size() const {
+    return m_entries.size();
+  }
+
+  size_t capacity() const {
+    return m_entries.capacity();
+  }
+
+  // Visits all entries, the entries for which the predicate returns true are erased
+  template<typename Pred>
+  void eraseIf(Pred&& pred) {
+    m_entries.forEach([&](uint32_t index, BlasEntry& entry) {
+      if (pred(entry)) {
+        m_index.erase(m_entryHashes[index], index);
+        m_entries.erase(index);
+      }
+    });
+  }
 
   void clear() {
     m_entries.clear();
+    m_index.clear();
   }
   
   void rebuildSpatialMaps() {
-    for (auto iter = m_entries.begin(); iter != m_entries.end(); ++iter) {
-      iter->second.rebuildSpatialMap();
-    }
+    m_entries.forEach([](uint32_t, BlasEntry& entry) {
+      entry.rebuildSpatialMap();
+    });
   }
 
 private:
-  MultimapType m_entries;
+  SlotMap<BlasEntry> m_entries;
+  SlotHashIndex m_index;
+  // Topological hash of each slot, indexed by slot
+  std::vector<XXH64_hash_t> m_entryHashes;
 
   BlasEntry* allocateEntry(XXH64_hash_t hash, const DrawCallState& drawCall);
 };
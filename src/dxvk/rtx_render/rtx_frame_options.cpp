@@ -0,0 +1,71 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstring>
+
+#include "rtx_frame_options.h"
+#include "rtx_options.h"
+#include "rtx_light_manager.h"
+
+namespace dxvk {
+  FrameSnapshot<RtxFrameOptions> RtxFrameOptions::s_snapshot;
+
+  RtxFrameOptions RtxFrameOptions::capture() {
+    const auto& options = RtxOptions::Get();
+
+    RtxFrameOptions frame;
+    // Note: Snapshots are compared bytewise, padding must not hold garbage.
+    memset(&frame, 0, sizeof(frame));
+
+    frame.uniqueObjectDistance = RtxOptions::uniqueObjectDistance();
+    frame.uniqueObjectDistanceSqr = options->getUniqueObjectDistanceSqr();
+    frame.meterToWorldUnitScale = options->getMeterToWorldUnitScale();
+    frame.numFramesToKeepInstances = options->getNumFramesToKeepInstances();
+    frame.numFramesToKeepLights = options->getNumFramesToKeepLights();
+    frame.numFramesToPutLightsToSleep = options->getNumFramesToPutLightsToSleep();
+    frame.antiCullingNumObjectsToKeep = RtxOptions::AntiCulling::Object::numObjectsToKeep();
+    frame.antiCullingNumLightsToKeep = RtxOptions::AntiCulling::Light::numLightsToKeep();
+    frame.antiCullingNumFramesToExtendLightLifetime = RtxOptions::AntiCulling::Light::numFramesToExtendLightLifetime();
+
+    frame.geometryHashGenerationRule = options->GeometryHashGenerationRule;
+    frame.geometryAssetHashRule = options->GeometryAssetHashRule;
+    frame.geometryHashParallelVertexThreshold = RtxOptions::geometryHashParallelVertexThreshold();
+
+    frame.enableInstanceDebuggingTools = RtxOptions::enableInstanceDebuggingTools();
+    frame.resolvePreCombinedMatrices = options->resolvePreCombinedMatrices();
+    frame.rayPortalVirtualInstanceMatching = options->isRayPortalVirtualInstanceMatchingEnabled();
+    frame.viewModelEnable = RtxOptions::ViewModel::enable();
+    frame.antiCullingObjectEnable = RtxOptions::AntiCulling::Object::enable();
+    frame.antiCullingLightEnable = RtxOptions::AntiCulling::Light::enable();
+    frame.needsMeshBoundingBox = options->needsMeshBoundingBox();
+    frame.suppressLightKeeping = LightManager::suppressLightKeeping();
+
+    return frame;
+  }
+
+  void RtxFrameOptions::initialize() {
+    s_snapshot.reset(capture());
+  }
+
+  bool RtxFrameOptions::publish() {
+    return s_snapshot.publish(capture());
+  }
+}
@@ -0,0 +1,112 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include "rtx_hashing.h"
+#include "../util/util_frame_snapshot.h"
+#include "../util/util_math.h"
+
+namespace dxvk {
+  /**
+   * \brief Options read per draw, instance or light, captured once per frame
+   *
+   * Hot loops read these from a single cache line instead of going through the
+   * option objects, and see the same values for the whole frame even when the
+   * options are changed from ImGui in the meantime. Options added here must be
+   * captured in capture().
+   */
+  struct alignas(CACHE_LINE_SIZE) RtxFrameOptions {
+    // Instance and light tracking
+    float uniqueObjectDistance;
+    float uniqueObjectDistanceSqr;
+    float meterToWorldUnitScale;
+    uint32_t numFramesToKeepInstances;
+    uint32_t numFramesToKeepLights;
+    uint32_t numFramesToPutLightsToSleep;
+    uint32_t antiCullingNumObjectsToKeep;
+    uint32_t antiCullingNumLightsToKeep;
+    uint32_t antiCullingNumFramesToExtendLightLifetime;
+
+    // Hashing
+    uint32_t geometryHashParallelVertexThreshold;
+    HashRule geometryHashGenerationRule;
+    HashRule geometryAssetHashRule;
+
+    bool enableInstanceDebuggingTools;
+    bool resolvePreCombinedMatrices;
+    bool rayPortalVirtualInstanceMatching;
+    bool viewModelEnable;
+    bool antiCullingObjectEnable;
+    bool antiCullingLightEnable;
+    bool needsMeshBoundingBox;
+    bool suppressLightKeeping;
+
+    /**
+     * \brief Options of the current frame, on the CS thread only
+     *
+     * The CS thread publishes the options in injectRTX, other threads use \c copy.
+     */
+    static const RtxFrameOptions& get() {
+      return s_snapshot.get();
+    }
+
+    /**
+     * \brief Copy of the options of the current frame, on any thread
+     *
+     * Threads other than the CS thread take a copy at their own frame
+     * boundary and pass the values they need on to their workers.
+     */
+    static RtxFrameOptions copy() {
+      return s_snapshot.copy();
+    }
+
+    /**
+     * \brief Captures the initial option values, before the first frame
+     */
+    static void initialize();
+
+    /**
+     * \brief Captures the current option values and publishes them, once per frame
+     *
+     * \returns \c true if any of the options changed since the last publish
+     */
+    static bool publish();
+
+    /**
+     * \brief Registers a function called on the publishing thread when options change
+     */
+    static uint32_t addListener(FrameSnapshot<RtxFrameOptions>::Listener listener) {
+      return s_snapshot.addListener(std::move(listener));
+    }
+
+    static void removeListener(uint32_t id) {
+      s_snapshot.removeListener(id);
+    }
+
+  private:
+    static RtxFrameOptions capture();
+
+    static FrameSnapshot<RtxFrameOptions> s_snapshot;
+  };
+
+  static_assert(sizeof(RtxFrameOptions) == CACHE_LINE_SIZE, "Frame options are expected to fit into a single cache line");
+}
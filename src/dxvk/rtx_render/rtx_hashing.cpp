@@ -46,6 +46,7 @@ namespace dxvk {
     "geometrydescriptor",
     "vertexlayout",
     "vertexshader",
+    "vertexdatav2",
   };
   static_assert((sizeof(HashComponentNames) / sizeof(char*)) == (size_t) HashComponents::Count);
 
@@ -103,16 +104,16 @@ namespace dxvk {
   }
 
   template<typename T>
-  XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<T>& uniqueIndices) {
+  XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const T* uniqueIndices, const size_t uniqueIndexCount, const XXH64_hash_t seed) {
     ScopedCpuProfileZone();
 
-    XXH64_hash_t result = 0;
+    XXH64_hash_t result = seed;
 
     constexpr bool hasIndices = std::is_same<T, uint16_t>::value || std::is_same<T, uint32_t>::value;
 
-    if (hasIndices && uniqueIndices.size() > 0) {
-      for (const T idx : uniqueIndices) {
-        const uint8_t* pData = (query.pBase + idx * query.stride);
+    if (hasIndices && uniqueIndexCount > 0) {
+      for (size_t i = 0; i < uniqueIndexCount; i++) {
+        const uint8_t* pData = (query.pBase + uniqueIndices[i] * query.stride);
         result = XXH3_64bits_withSeed(pData, query.elementSize, result);
       }
     } else {
@@ -126,6 +127,26 @@ namespace dxvk {
   }
 
 
+  template<typename T>
+  XXH64_hash_t hashVertexRegionIndexedStreamed(const HashQuery& query, const T* uniqueIndices, const size_t uniqueIndexCount,
+                                               const uint32_t parallelThreshold, std::vector<uint64_t>& segmentHashScratch) {
+    ScopedCpuProfileZone();
+
+    if constexpr (std::is_same<T, uint16_t>::value || std::is_same<T, uint32_t>::value) {
+      if (uniqueIndexCount > 0) {
+        const uint32_t count = (uint32_t) uniqueIndexCount;
+        segmentHashScratch.resize(std::max(segmentHashScratch.size(), fast::hashGatheredElementsScratchSize(count)));
+        return fast::hashGatheredElements<T>(query.pBase, query.stride, query.elementSize, uniqueIndices, count,
+                                             segmentHashScratch.data(), parallelThreshold);
+      }
+    }
+
+    const uint32_t vertexCount = query.stride > 0 ? (uint32_t) ((query.size + query.stride - 1) / query.stride) : 0;
+    segmentHashScratch.resize(std::max(segmentHashScratch.size(), fast::hashGatheredElementsScratchSize(vertexCount)));
+    return fast::hashGatheredElements<uint32_t>(query.pBase, query.stride, query.elementSize, nullptr, vertexCount,
+                                                segmentHashScratch.data(), parallelThreshold);
+  }
+
   // TODO (REMIX-656): Remove this once we can transition content to new hash
   constexpr static uint32_t MaxGeomHashSize = 512; // 512b - this is a performance optimization
 
@@ -217,9 +238,12 @@ namespace dxvk {
   }
 
   // Supported template params
-  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<uint16_t>& uniqueIndices);
-  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<uint32_t>& uniqueIndices);
-  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<int>& uniqueIndices);
+  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const uint16_t* uniqueIndices, const size_t uniqueIndexCount, const XXH64_hash_t seed);
+  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const uint32_t* uniqueIndices, const size_t uniqueIndexCount, const XXH64_hash_t seed);
+  template XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const int* uniqueIndices, const size_t uniqueIndexCount, const XXH64_hash_t seed);
+  template XXH64_hash_t hashVertexRegionIndexedStreamed(const HashQuery& query, const uint16_t* uniqueIndices, const size_t uniqueIndexCount, const uint32_t parallelThreshold, std::vector<uint64_t>& segmentHashScratch);
+  template XXH64_hash_t hashVertexRegionIndexedStreamed(const HashQuery& query, const uint32_t* uniqueIndices, const size_t uniqueIndexCount, const uint32_t parallelThreshold, std::vector<uint64_t>& segmentHashScratch);
+  template XXH64_hash_t hashVertexRegionIndexedStreamed(const HashQuery& query, const int* uniqueIndices, const size_t uniqueIndexCount, const uint32_t parallelThreshold, std::vector<uint64_t>& segmentHashScratch);
 
   template XXH64_hash_t hashIndicesLegacy<uint16_t>(const void* pIndexData, const size_t indexCount);
   template XXH64_hash_t hashIndicesLegacy<uint32_t>(const void* pIndexData, const size_t indexCount);
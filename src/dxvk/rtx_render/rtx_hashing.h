@@ -40,6 +40,8 @@ namespace dxvk {
     GeometryDescriptor,
     VertexLayout,
     VertexShader,
+    // Not a hash of its own, selects version 2 of the VertexPosition and VertexTexcoord hashes
+    VertexDataV2,
     Count
   };
 
@@ -208,9 +210,29 @@ namespace dxvk {
     *
     *   query [in]: structure containing information about the region
     *   uniqueIndices [in]: indices (byte offsets as multiples of query.stride) to hash
+    *   uniqueIndexCount [in]: number of indices, the whole region is hashed if zero
+    *   seed [in]: hash to chain the elements onto, hashing consecutive parts of a region
+    *              with the hash of the previous part gives the hash of the whole region
     */
   template<typename T>
-  XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const std::vector<T>& uniqueIndices);
+  XXH64_hash_t hashVertexRegionIndexed(const HashQuery& query, const T* uniqueIndices, const size_t uniqueIndexCount, const XXH64_hash_t seed = 0);
+
+  /**
+    * \brief Hashes a region of sparse memory, version 2
+    *
+    * Gathers the elements into contiguous memory and streams them through a single hash
+    * state, rather than chaining a hash per element.  Produces different hashes than
+    * hashVertexRegionIndexed.
+    *
+    *   query [in]: structure containing information about the region
+    *   uniqueIndices [in]: indices (byte offsets as multiples of query.stride) to hash
+    *   uniqueIndexCount [in]: number of indices, the whole region is hashed if zero
+    *   parallelThreshold [in]: element count from which the hashing is split across threads, 0 never splits
+    *   segmentHashScratch [in]: scratch memory of the calling thread, grown as needed
+    */
+  template<typename T>
+  XXH64_hash_t hashVertexRegionIndexedStreamed(const HashQuery& query, const T* uniqueIndices, const size_t uniqueIndexCount,
+                                               const uint32_t parallelThreshold, std::vector<uint64_t>& segmentHashScratch);
 
   template<typename T>
   [[deprecated("(REMIX-656): Remove this once we can transition content to new hash)")]]
@@ -0,0 +1,104 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <cassert>
+#include <vector>
+
+namespace dxvk {
+
+  enum GarbageCollectionFlags : uint8_t {
+    kGcMarked = 1 << 0,          // Explicitly marked for collection
+    kGcCullingExempt = 1 << 1,   // Collected once expired even with anti-culling
+  };
+
+  /**
+   * \brief Gathers the garbage collection flags of an instance
+   *
+   * \param [in] isMarkedForGC Instance was explicitly marked for collection
+   * \param [in] collectAllExpired All expired instances are collected, anti-culling or not
+   * \param [in] isCullingExempt bool(), whether anti-culling does not keep the instance
+   *   alive (inside the frustum, animated, player model or skinned). Only called when
+   *   the result matters, as it may need to access the BLAS of the instance.
+   */
+  template<typename Fn>
+  inline uint8_t getGarbageCollectionFlags(const bool isMarkedForGC, const bool collectAllExpired, Fn&& isCullingExempt) {
+    if (isMarkedForGC) {
+      return kGcMarked;
+    }
+
+    return !collectAllExpired && isCullingExempt() ? kGcCullingExempt : 0;
+  }
+
+  /**
+   * \brief Decides whether an instance is collected this frame
+   *
+   * \param [in] flags Flags from getGarbageCollectionFlags
+   * \param [in] frameLastUpdated Frame the instance was last drawn in
+   * \param [in] currentFrame Current frame
+   * \param [in] numFramesToKeepInstances Frames an instance lives on without being drawn
+   * \param [in] collectAllExpired Same as passed to getGarbageCollectionFlags
+   */
+  inline bool shouldCollectInstance(const uint8_t flags, const uint32_t frameLastUpdated, const uint32_t currentFrame,
+                                    const uint32_t numFramesToKeepInstances, const bool collectAllExpired) {
+    const bool expired = frameLastUpdated + numFramesToKeepInstances <= currentFrame;
+    return (flags & kGcMarked) || (expired && (collectAllExpired || (flags & kGcCullingExempt)));
+  }
+
+  /**
+   * \brief Removes collected items in place, keeping the order of the others
+   *
+   * \param [in,out] items Items, shrunk to the kept items
+   * \param [in] collect Nonzero for each item to remove
+   * \param [in] onKept void(T& item, uint32_t newIndex), called for each kept item
+   * \param [in] onCollected void(T& item), called for each removed item in order
+   * \returns Number of kept items
+   */
+  template<typename T, typename KeptFn, typename CollectedFn>
+  uint32_t compactCollected(std::vector<T>& items, const std::vector<uint8_t>& collect, KeptFn&& onKept, CollectedFn&& onCollected) {
+    assert(collect.size() >= items.size());
+
+    const uint32_t numItems = static_cast<uint32_t>(items.size());
+    uint32_t numKept = 0;
+
+    for (uint32_t i = 0; i < numItems; ++i) {
+      if (collect[i]) {
+        onCollected(items[i]);
+        continue;
+      }
+
+      onKept(items[i], numKept);
+
+      if (numKept != i) {
+        items[numKept] = std::move(items[i]);
+      }
+
+      ++numKept;
+    }
+
+    items.resize(numKept);
+    return numKept;
+  }
+
+}
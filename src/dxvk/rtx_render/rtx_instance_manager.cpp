@@ -19,15 +19,18 @@
 * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 * DEALINGS IN THE SOFTWARE.
 */
+#include <algorithm>
 #include <mutex>
 #include <vector>
 #include <assert.h>
+#include <ppl.h>
 
 #include "rtx_context.h"
 #include "rtx_scene_manager.h"
 #include "rtx_instance_manager.h"
 #include "rtx_camera_manager.h"
 #include "rtx_options.h"
+#include "rtx_frame_options.h"
 #include "rtx_materials.h"
 
 #include "../d3d9/d3d9_state.h"
@@ -37,9 +40,16 @@
 #include "rtx/pass/common_binding_indices.h"
 #include "rtx/concept/surface_material/surface_material_hitgroup.h"
 #include "rtx/pass/instance_definitions.h"
+#include "rtx_instance_gc.h"
 
 namespace dxvk {
-  
+
+  // Instances are marked for garbage collection in chunks of this size, one chunk is marked on the calling thread
+  static constexpr uint32_t kGarbageCollectionChunkSize = 4096;
+
+  // Billboards of an instance are created in chunks of this many quads, one chunk is created on the calling thread
+  static constexpr uint32_t kBillboardChunkSize = 512;
+
   static bool isMirrorTransform(const Matrix4& m) {
     // Note: Identify if the winding is inverted by checking if the z axis is ever flipped relative to what it's expected to be for clockwise vertices in a lefthanded space
     // (x cross y) through the series of transformations
@@ -322,70 +332,127 @@ namespace dxvk {
     }
   }
 
+  void InstanceManager::releaseInstance(RtInstance* instance) {
+    // Transient instances are released in bulk
+    if (!m_instancePool.isTransient(instance)) {
+      m_instancePool.release(instance);
+    }
+  }
+
   void InstanceManager::clear() {
     for (RtInstance* instance : m_instances) {
       removeInstance(instance);
-      delete instance;
+      releaseInstance(instance);
     }
 
+    m_instancePool.releaseTransient();
     m_instances.clear();
     m_viewModelCandidates.clear();
     m_playerModelInstances.clear();
   }  
 
   void InstanceManager::garbageCollection() {
+    const RtxFrameOptions& frameOptions = RtxFrameOptions::get();
+
     // Can be configured per game: 'rtx.numFramesToKeepInstances'
-    const uint32_t numFramesToKeepInstances = RtxOptions::Get()->getNumFramesToKeepInstances();
+    const uint32_t numFramesToKeepInstances = frameOptions.numFramesToKeepInstances;
     
     // Remove instances past their lifetime or marked for GC explicitly
     const uint32_t currentFrame = m_device->getCurrentFrameId();
 
     // Need to release all instances when ViewModel enablement changes
     // This is a big hammer but it's fine, it's a debugging feature
-    const bool isViewModelEnabled = RtxOptions::ViewModel::enable();
+    const bool isViewModelEnabled = frameOptions.viewModelEnable;
     if (isViewModelEnabled != m_previousViewModelState) {
       for (auto* instance : m_instances) {
         removeInstance(instance);
-        delete instance;
+        releaseInstance(instance);
       }
+      m_instancePool.releaseTransient();
       m_instances.clear();
       m_viewModelCandidates.clear();
       m_playerModelInstances.clear();
       m_previousViewModelState = isViewModelEnabled;
     }
 
-    const bool forceGarbageCollection = (m_instances.size() >= RtxOptions::AntiCulling::Object::numObjectsToKeep());
-    for (uint32_t i = 0; i < m_instances.size();) {
-      // Must take a ref here since we'll be swapping
-      RtInstance*& pInstance = m_instances[i];
-      assert(pInstance != nullptr);
-
-      const bool enableGarbageCollection =
-        !RtxOptions::AntiCulling::Object::enable() || // It's always True if anti-culling is disabled
-        (pInstance->m_isInsideFrustum) ||
-        (pInstance->getBlas()->input.getSkinningState().numBones > 0) ||
-        (pInstance->m_isAnimated) ||
-        (pInstance->m_isPlayerModel);
-
-      if (((forceGarbageCollection || enableGarbageCollection) &&
-           pInstance->m_frameLastUpdated + numFramesToKeepInstances <= currentFrame) ||
-          pInstance->m_isMarkedForGC) {
-        // Note: Pop and swap for performance, index not incremented to process swapped instance on next iteration
-        removeInstance(pInstance);
+    // Anti-culling keeps expired instances outside of the frustum alive, unless there are too many of them
+    const bool forceGarbageCollection = (m_instances.size() >= frameOptions.antiCullingNumObjectsToKeep);
+    const bool collectAllExpired = !frameOptions.antiCullingObjectEnable || forceGarbageCollection;
 
-        // NOTE: pInstance is now the (previously) last element
-        std::swap(pInstance, m_instances.back());
+    const uint64_t numTransientInstances = m_instancePool.getStats().transientObjects;
 
-        m_instances[i]->m_instanceVectorId = i;
+    markInstancesForGarbageCollection(currentFrame, numFramesToKeepInstances, collectAllExpired);
+    sweepInstances();
 
-        delete m_instances.back();
+    const auto& poolStats = m_instancePool.getStats();
+    m_poolStats.capacity = poolStats.capacity;
+    m_poolStats.frameAllocations = poolStats.allocations - m_lastPoolAllocations;
+    m_poolStats.frameTransientReleases = numTransientInstances;
+    m_lastPoolAllocations = poolStats.allocations;
+  }
 
-        // Remove the last element
-        m_instances.pop_back();
-        continue;
+  void InstanceManager::markInstancesForGarbageCollection(const uint32_t currentFrame, const uint32_t numFramesToKeepInstances, const bool collectAllExpired) {
+    ScopedCpuProfileZone();
+    const uint32_t numInstances = m_instances.size();
+
+    m_gcView.frameLastUpdated.resize(numInstances);
+    m_gcView.flags.resize(numInstances);
+    m_gcView.collect.resize(numInstances);
+
+    auto markChunk = [&](const uint32_t chunk) {
+      const uint32_t begin = chunk * kGarbageCollectionChunkSize;
+      const uint32_t end = std::min(begin + kGarbageCollectionChunkSize, numInstances);
+
+      // Gather the fields first, the instances themselves are scattered across the pool
+      for (uint32_t i = begin; i < end; ++i) {
+        const RtInstance& instance = *m_instances[i];
+
+        // Note: destroyed BLAS mark their instances, so the BLAS is only accessed for unmarked ones
+        m_gcView.flags[i] = getGarbageCollectionFlags(instance.m_isMarkedForGC, collectAllExpired, [&instance] {
+          return instance.m_isInsideFrustum || instance.m_isAnimated || instance.m_isPlayerModel ||
+                 instance.getBlas()->input.getSkinningState().numBones > 0;
+        });
+        m_gcView.frameLastUpdated[i] = instance.m_frameLastUpdated;
+      }
+
+      for (uint32_t i = begin; i < end; ++i) {
+        m_gcView.collect[i] = shouldCollectInstance(m_gcView.flags[i], m_gcView.frameLastUpdated[i], currentFrame, numFramesToKeepInstances, collectAllExpired);
       }
-      ++i;
+    };
+
+    const uint32_t numChunks = (numInstances + kGarbageCollectionChunkSize - 1) / kGarbageCollectionChunkSize;
+
+    if (numChunks > 1) {
+      concurrency::parallel_for<uint32_t>(0, numChunks, markChunk);
+    } else if (numChunks == 1) {
+      markChunk(0);
+    }
+  }
+
+  void InstanceManager::sweepInstances() {
+    ScopedCpuProfileZone();
+
+    // Compact in place, surviving instances keep their relative order
+    compactCollected(m_instances, m_gcView.collect,
+      [](RtInstance* pInstance, const uint32_t newIndex) {
+        assert(pInstance != nullptr);
+        pInstance->m_instanceVectorId = newIndex;
+      },
+      [this](RtInstance* pInstance) {
+        assert(pInstance != nullptr);
+        removeInstance(pInstance);
+        m_gcCollectedInstances.push_back(pInstance);
+      });
+
+    // Listeners have seen all collected instances before any of them is destroyed
+    for (RtInstance* pInstance : m_gcCollectedInstances) {
+      releaseInstance(pInstance);
     }
+
+    m_gcCollectedInstances.clear();
+
+    // Transient instances are marked for collection on creation, so all of them have been swept
+    m_instancePool.releaseTransient();
   }
 
   void InstanceManager::onFrameEnd() {
@@ -404,7 +471,7 @@ namespace dxvk {
     Matrix4 worldToProjection = drawCall.getTransformData().viewToProjection * drawCall.getTransformData().worldToView;
 
     // An attempt to resolve cases where games pre-combine view and world matrices
-    if (RtxOptions::Get()->resolvePreCombinedMatrices() &&
+    if (RtxFrameOptions::get().resolvePreCombinedMatrices &&
       isIdentityExact(drawCall.getTransformData().worldToView)) {
       const auto* referenceCamera = &cameraManager.getCamera(drawCall.cameraType);
       // Note: we may accept a data even from a prev frame, as we need any information to restore;
@@ -636,7 +703,9 @@ namespace dxvk {
 
     // Disable temporal correlation between instances so that duplicate instances are not created
     // should a developer option change instance enough for it not to match anymore
-    if (RtxOptions::enableInstanceDebuggingTools()) {
+    const RtxFrameOptions& frameOptions = RtxFrameOptions::get();
+
+    if (frameOptions.enableInstanceDebuggingTools) {
       return nullptr;
     }
 
@@ -645,47 +714,49 @@ namespace dxvk {
     const uint32_t currentFrameIdx = m_device->getCurrentFrameId();
     const Vector3 worldPosition = blas.input.getGeometryData().boundingBox.getTransformedCentroid(transform);
     
-    const float uniqueObjectDistanceSqr = RtxOptions::Get()->getUniqueObjectDistanceSqr();
+    const float uniqueObjectDistanceSqr = frameOptions.uniqueObjectDistanceSqr;
 
     RtInstance* pSimilar = nullptr;
     float nearestDistSqr = FLT_MAX;
 
     // Search the BLAS for an instance matching ours
-    {
-      const auto adjacentCells = blas.getSpatialMap().getDataNearPos(worldPosition);
-      for (const std::vector<const RtInstance*>* cellPtr : adjacentCells){
-        for (const RtInstance* instance : *cellPtr) {
-          if (instance->m_frameLastUpdated == currentFrameIdx) {
-            // If the transform is an exact match and the instance has already been touched this frame,
-            // then this is a second draw call on a single mesh.
-            const Matrix4 instanceTransform = instance->getTransform();
-            if (memcmp(&transform, &instanceTransform, sizeof(instanceTransform)) == 0) {
-              return const_cast<RtInstance*>(instance);
-            }
-          } else if (instance->m_materialHash == material.getHash()) {
-            // Instance hasn't been touched yet this frame.
+    blas.getSpatialMap().forEachInRadius(worldPosition, frameOptions.uniqueObjectDistance, [&](const RtInstance* instance) {
+      if (instance->m_frameLastUpdated == currentFrameIdx) {
+        // If the transform is an exact match and the instance has already been touched this frame,
+        // then this is a second draw call on a single mesh.
+        const Matrix4 instanceTransform = instance->getTransform();
+        if (memcmp(&transform, &instanceTransform, sizeof(instanceTransform)) == 0) {
+          pSimilar = const_cast<RtInstance*>(instance);
+          return false;
+        }
+      } else if (instance->m_materialHash == material.getHash()) {
+        // Instance hasn't been touched yet this frame.
 
-            const Vector3& prevInstanceWorldPosition = instance->getSpatialCachePosition();
+        const Vector3& prevInstanceWorldPosition = instance->getSpatialCachePosition();
 
-            const float distSqr = lengthSqr(prevInstanceWorldPosition - worldPosition);
-            if (distSqr <= uniqueObjectDistanceSqr && distSqr < nearestDistSqr) {
-              if (distSqr == 0.0f) {
-                // Not going to find anything closer.
-                return const_cast<RtInstance*>(instance);
-              }
-              nearestDistSqr = distSqr;
-              result = const_cast<RtInstance*>(instance);
-            }
+        const float distSqr = lengthSqr(prevInstanceWorldPosition - worldPosition);
+        if (distSqr <= uniqueObjectDistanceSqr && distSqr < nearestDistSqr) {
+          if (distSqr == 0.0f) {
+            // Not going to find anything closer.
+            pSimilar = const_cast<RtInstance*>(instance);
+            return false;
           }
+          nearestDistSqr = distSqr;
+          result = const_cast<RtInstance*>(instance);
         }
       }
+      return true;
+    });
+
+    if (pSimilar != nullptr) {
+      return pSimilar;
     }
 
     // For portal gun and other objects that were drawn in the ViewModel, need to check the
     // virtual version of the instance from previous frame.
     if (nearestDistSqr > 0.0f &&
         cameraType == CameraType::ViewModel && 
-        RtxOptions::Get()->isRayPortalVirtualInstanceMatchingEnabled() ) {
+        frameOptions.rayPortalVirtualInstanceMatching) {
       const Matrix4* teleportMatrix = nullptr;
       for (const RtInstance* instance : blas.getLinkedInstances()) {
         if (instance->m_frameLastUpdated != currentFrameIdx - 1 || 
@@ -741,7 +812,7 @@ namespace dxvk {
     const uint32_t currentFrameIdx = m_device->getCurrentFrameId();
 
     const uint32_t instanceIdx = m_instances.size();
-    RtInstance* newInst = new RtInstance(m_nextInstanceId++, instanceIdx);
+    RtInstance* newInst = m_instancePool.allocate(m_nextInstanceId++, instanceIdx);
     m_instances.push_back(newInst);
 
     RtInstance* currentInstance = m_instances[instanceIdx];
@@ -777,7 +848,16 @@ namespace dxvk {
     const uint32_t instanceIdx = m_instances.size();
 
     uint64_t id = generateValidID ? m_nextInstanceId++ : UINT64_MAX;
-    RtInstance* newInstance = new RtInstance(reference, id, instanceIdx);
+    RtInstance* newInstance;
+
+    if (generateValidID) {
+      newInstance = m_instancePool.allocate(reference, id, instanceIdx);
+    } else {
+      // Temporary copies are recreated every frame and released in bulk after the next garbage collection
+      newInstance = m_instancePool.allocateTransient(reference, id, instanceIdx);
+      newInstance->markForGarbageCollection();
+    }
+
     newInstance->m_isCreatedByRenderer = true;
     m_instances.push_back(newInstance);
 
@@ -907,13 +987,13 @@ namespace dxvk {
         currentInstance.surface.tFactor = drawCall.getMaterialData().tFactor;
         currentInstance.surface.alphaState = alphaState;
         currentInstance.surface.isAnimatedWater = currentInstance.testCategoryFlags(InstanceCategories::AnimatedWater);
-        currentInstance.surface.associatedGeometryHash = drawCall.getHash(RtxOptions::Get()->GeometryAssetHashRule);
+        currentInstance.surface.associatedGeometryHash = drawCall.getHash(RtxFrameOptions::get().geometryAssetHashRule);
         currentInstance.surface.isTextureFactorBlend = drawCall.getMaterialData().isTextureFactorBlend;
         currentInstance.surface.isMotionBlurMaskOut = currentInstance.testCategoryFlags(InstanceCategories::IgnoreMotionBlur);
         // Note: Skip the spritesheet adjustment logic in the surface interaction when using Ray Portal materials as this logic
         // is done later in the Surface Material Interaction (and doing it in both places will just double up the animation).
         currentInstance.surface.skipSurfaceInteractionSpritesheetAdjustment = (materialData.getType() == MaterialDataType::RayPortal);
-        currentInstance.surface.isInsideFrustum = RtxOptions::AntiCulling::Object::enable() ? currentInstance.m_isInsideFrustum : true;
+        currentInstance.surface.isInsideFrustum = RtxFrameOptions::get().antiCullingObjectEnable ? currentInstance.m_isInsideFrustum : true;
 
         currentInstance.surface.srcColorBlendFactor = drawCall.getMaterialData().srcColorBlendFactor;
         currentInstance.surface.dstColorBlendFactor = drawCall.getMaterialData().dstColorBlendFactor;
@@ -1757,141 +1837,155 @@ namespace dxvk {
     if (!bufferData.indexData || !bufferData.positionData || !bufferData.texcoordData)
       return;
 
-    const bool hasNonIdentityTextureTransform = instance.surface.textureTransform != Matrix4();
-    bool bSuccess = true;
-    bool areAllBillboardsValidIntersectionCandidates = true;
-    uint32_t billboardCount = 0;
+    const uint32_t billboardCount = geometryData.indexCount / indicesPerQuad;
     instance.m_firstBillboard = m_billboards.size();
 
-    const Matrix4 instanceTransform = instance.getTransform();
-
-    // Go over all quads in this draw call.
+    // Make sure that all quads follow a known quad pattern: A, B, C, A, C, D
+    // If one doesn't, we can't process this "quad" - so, cancel the whole instance.
     // Note: decals are often batched into a few draw calls, and we want to offset each decal separately.
-    for (int indexOffset = 0; indexOffset + indicesPerQuad <= geometryData.indexCount; indexOffset += indicesPerQuad) {
-      // Load indices for a quad
-      uint16_t indices[indicesPerQuad];
-      for (size_t idx = 0; idx < indicesPerQuad; ++idx) {
-        indices[idx] = bufferData.getIndex(idx + indexOffset);
+    for (uint32_t indexOffset = 0; indexOffset < geometryData.indexCount; indexOffset += indicesPerQuad) {
+      if (bufferData.getIndex(indexOffset + 0) != bufferData.getIndex(indexOffset + 3) ||
+          bufferData.getIndex(indexOffset + 2) != bufferData.getIndex(indexOffset + 4)) {
+        ONCE(Logger::warn("[RTX] InstanceManager: detected unsupported quad index layout for billboard creation"));
+        return;
       }
+    }
 
+    const bool hasNonIdentityTextureTransform = instance.surface.textureTransform != Matrix4();
+    const Matrix4 instanceTransform = instance.getTransform();
+    // Assume that all billboards on the player model are camera facing
+    const bool isCameraFacing = instance.m_isPlayerModel;
+    const uint32_t instanceMask = instance.getVkInstance().mask & OBJECT_MASK_UNORDERED_ALL_INTERSECTION_PRIMITIVE;
 
-      // Make sure that these indices follow a known quad pattern: A, B, C, A, C, D
-      // If they don't, we can't process this "quad" - so, cancel the whole instance.
-      if (indices[0] != indices[3] || indices[2] != indices[4]) {
-        ONCE(Logger::warn("[RTX] InstanceManager: detected unsupported quad index layout for billboard creation"));
-        // This quad is incompatible altogether. Abort processing billboards for this instance and skip billboard processing for it
-        bSuccess = false;
-        break;
-      }
-      
-      // Load data for a triangle
-      Vector3 positions[3];
-      Vector2 texcoords[4];
-      uint8_t vertexOpacities8bit[4] = {};
-      
-      for (size_t idx = 0; idx < 3; ++idx) {
-        const uint16_t currentIndex = indices[idx];
+    // Every quad owns a fixed billboard slot, so the result does not depend on how the quads are split across threads
+    const uint32_t firstBillboard = m_billboards.size();
+    m_billboards.resize(firstBillboard + billboardCount);
 
-        Vector4 objectSpacePosition = Vector4(bufferData.getPosition(currentIndex), 1.0f);
+    const uint32_t numChunks = (billboardCount + kBillboardChunkSize - 1) / kBillboardChunkSize;
+    std::vector<uint8_t> chunkCandidates(numChunks);
 
-        positions[idx] = (instanceTransform * objectSpacePosition).xyz();
+    auto createChunk = [&](const uint32_t chunk) {
+      const uint32_t quadEnd = std::min((chunk + 1) * kBillboardChunkSize, billboardCount);
+      bool areAllBillboardsValidIntersectionCandidates = true;
 
-        texcoords[idx] = bufferData.getTexCoord(currentIndex);
+      for (uint32_t quad = chunk * kBillboardChunkSize; quad < quadEnd; ++quad) {
+        const uint32_t indexOffset = quad * indicesPerQuad;
 
-        if (hasNonIdentityTextureTransform)
-          texcoords[idx] = (instance.surface.textureTransform * Vector4(texcoords[idx].x, texcoords[idx].y, 0.f, 1.f)).xy();
+        // Load indices for a quad
+        uint16_t indices[indicesPerQuad];
+        for (size_t idx = 0; idx < indicesPerQuad; ++idx) {
+          indices[idx] = bufferData.getIndex(idx + indexOffset);
+        }
 
+        // Load data for a triangle
+        Vector3 positions[3];
+        Vector2 texcoords[4];
+        uint8_t vertexOpacities8bit[4] = {};
+        
+        for (size_t idx = 0; idx < 3; ++idx) {
+          const uint16_t currentIndex = indices[idx];
+
+          Vector4 objectSpacePosition = Vector4(bufferData.getPosition(currentIndex), 1.0f);
+
+          positions[idx] = (instanceTransform * objectSpacePosition).xyz();
+
+          texcoords[idx] = bufferData.getTexCoord(currentIndex);
+
+          if (hasNonIdentityTextureTransform)
+            texcoords[idx] = (instance.surface.textureTransform * Vector4(texcoords[idx].x, texcoords[idx].y, 0.f, 1.f)).xy();
+
+          if (bufferData.vertexColorData)
+            vertexOpacities8bit[idx] = bufferData.getVertexColor(indices[idx]) >> 24;
+        }
+
+        // Load one vertex color - assuming that the entire billboard uses the same color
+        uint32_t vertexColor = ~0u;
         if (bufferData.vertexColorData)
-          vertexOpacities8bit[idx] = bufferData.getVertexColor(indices[idx]) >> 24;
-      }
+          vertexColor = bufferData.getVertexColor(indices[0]);
 
-      // Load one vertex color - assuming that the entire billboard uses the same color
-      uint32_t vertexColor = ~0u;
-      if (bufferData.vertexColorData)
-        vertexColor = bufferData.getVertexColor(indices[0]);
+        // Compute the normal
+        const Vector3 xVector { positions[2] - positions[1] };
+        const Vector3 yVector { positions[1] - positions[0] };
+        const Vector3 center { (positions[2] + positions[0]) * 0.5f };
 
-      // Compute the normal
-      const Vector3 xVector { positions[2] - positions[1] };
-      const Vector3 yVector { positions[1] - positions[0] };
-      const Vector3 center { (positions[2] + positions[0]) * 0.5f };
+        const bool centerIsSpecial = isFpSpecial(center.x) || isFpSpecial(center.y) || isFpSpecial(center.z);
+        if (centerIsSpecial) {
+          areAllBillboardsValidIntersectionCandidates = false;
+        }
 
-      IntersectionBillboard billboard;
+        const float xLength = length(xVector);
+        const float yLength = length(yVector);
+        const float dotAxes = dot(xVector, yVector) / (xLength * yLength);
+        // Note: This could probably be handled in a better way (like skipping this quad) rather than just assigning
+        // a fallback normal, but this is simple enough.
+        const Vector3 normal = safeNormalize(cross(xVector, yVector), Vector3(0.0f, 0.0f, 1.0f));
+        const float normalDotCamera = dot(normal, cameraViewDirection);
+
+
+        // Limit the set of particles that are turned into intersection primitives:
+        // - Must be roughly square
+        const bool isSquare = xLength <= yLength * 1.5f && yLength <= xLength * 1.5f;
+        // - The original quad must have perpendicular sides
+        const bool hasPerpendicularSides = std::abs(dotAxes) < 0.01f;
+        // - Must be in the camera view plane, i.e. only auto-oriented particles, not world-space ones
+        //   (except player model particles, which are oriented towards the camera and not in the view plane)
+        const bool isInViewPlane = std::abs(normalDotCamera) > 0.99f;
+        if (!isSquare || !hasPerpendicularSides || !isInViewPlane && !isCameraFacing) {
+          areAllBillboardsValidIntersectionCandidates = false;
+        }
 
-      const bool centerIsSpecial = isFpSpecial(center.x) || isFpSpecial(center.y) || isFpSpecial(center.z);
-      if (centerIsSpecial) {
-        areAllBillboardsValidIntersectionCandidates = false;
-      }
+        const Vector2 xVectorUV { texcoords[2] - texcoords[1] };
+        const Vector2 yVectorUV { texcoords[1] - texcoords[0] };
+        const Vector2 centerUV { (texcoords[2] + texcoords[0]) * 0.5f };
 
-      const float xLength = length(xVector);
-      const float yLength = length(yVector);
-      const float dotAxes = dot(xVector, yVector) / (xLength * yLength);
-      // Note: This could probably be handled in a better way (like skipping this quad) rather than just assigning
-      // a fallback normal, but this is simple enough.
-      const Vector3 normal = safeNormalize(cross(xVector, yVector), Vector3(0.0f, 0.0f, 1.0f));
-      const float normalDotCamera = dot(normal, cameraViewDirection);
-
-
-      // Limit the set of particles that are turned into intersection primitives:
-      // - Must be roughly square
-      const bool isSquare = xLength <= yLength * 1.5f && yLength <= xLength * 1.5f;
-      // - The original quad must have perpendicular sides
-      const bool hasPerpendicularSides = std::abs(dotAxes) < 0.01f;
-      // - Must be in the camera view plane, i.e. only auto-oriented particles, not world-space ones
-      //   (except player model particles, which are oriented towards the camera and not in the view plane)
-      const bool isInViewPlane = std::abs(normalDotCamera) > 0.99f;
-      // Assume that all billboards on the player model are camera facing
-      const bool isCameraFacing = instance.m_isPlayerModel;
-      if (!isSquare || !hasPerpendicularSides || !isInViewPlane && !isCameraFacing) {
-        areAllBillboardsValidIntersectionCandidates = false;
+        // Fill in data for the quad's last/4th vertex
+        texcoords[3] = bufferData.getTexCoord(indices[5]);
+        if (bufferData.vertexColorData)
+          vertexOpacities8bit[3] = bufferData.getVertexColor(indices[5]) >> 24;
+
+        IntersectionBillboard& billboard = m_billboards[firstBillboard + quad];
+        billboard.center = center;
+        billboard.xAxis = xVector / xLength;
+        billboard.width = xLength;
+        billboard.yAxis = yVector / yLength;
+        billboard.height = yLength;
+        billboard.xAxisUV = xVectorUV * 0.5f;
+        billboard.yAxisUV = yVectorUV * 0.5f;
+        billboard.centerUV = centerUV;
+        billboard.instance = &instance;
+        billboard.vertexColor = vertexColor;
+        billboard.instanceMask = instanceMask;
+        billboard.texCoordHash = XXH64(texcoords, sizeof(texcoords), kEmptyHash);
+        billboard.vertexOpacityHash = XXH64(vertexOpacities8bit, sizeof(vertexOpacities8bit), kEmptyHash);
+        billboard.allowAsIntersectionPrimitive = true;
+        billboard.isBeam = false;
+        billboard.isCameraFacing = isCameraFacing;
       }
 
-      const Vector2 xVectorUV { texcoords[2] - texcoords[1] };
-      const Vector2 yVectorUV { texcoords[1] - texcoords[0] };
-      const Vector2 centerUV { (texcoords[2] + texcoords[0]) * 0.5f };
+      chunkCandidates[chunk] = areAllBillboardsValidIntersectionCandidates;
+    };
 
-      // Fill in data for the quad's last/4th vertex
-      texcoords[3] = bufferData.getTexCoord(indices[5]);
-      if (bufferData.vertexColorData)
-        vertexOpacities8bit[3] = bufferData.getVertexColor(indices[5]) >> 24;
-
-      billboard.center = center;
-      billboard.xAxis = xVector / xLength;
-      billboard.width = xLength;
-      billboard.yAxis = yVector / yLength;
-      billboard.height = yLength;
-      billboard.xAxisUV = xVectorUV * 0.5f;
-      billboard.yAxisUV = yVectorUV * 0.5f;
-      billboard.centerUV = centerUV;
-      billboard.instance = &instance;
-      billboard.vertexColor = vertexColor;
-      billboard.instanceMask = instance.getVkInstance().mask & OBJECT_MASK_UNORDERED_ALL_INTERSECTION_PRIMITIVE;
-      billboard.texCoordHash = XXH64(texcoords, sizeof(texcoords), kEmptyHash);
-      billboard.vertexOpacityHash = XXH64(vertexOpacities8bit, sizeof(vertexOpacities8bit), kEmptyHash);
-      billboard.allowAsIntersectionPrimitive = true;
-      billboard.isBeam = false;
-      billboard.isCameraFacing = isCameraFacing;
-      m_billboards.push_back(billboard);
-      ++billboardCount;
+    if (numChunks > 1) {
+      concurrency::parallel_for<uint32_t>(0, numChunks, createChunk);
+    } else {
+      createChunk(0);
     }
 
-    if (bSuccess) {
-      instance.m_billboardCount = billboardCount;
+    instance.m_billboardCount = billboardCount;
 
-      if (areAllBillboardsValidIntersectionCandidates) {
-        // Update the instance mask to hide it from rays that look only for intersection billboards.
-        instance.getVkInstance().mask &= OBJECT_MASK_UNORDERED_ALL_GEOMETRY;
-      } else {
-        // Disable the rest of the billboards as intersection primitives since only a single mask can be used
-        // per instance
-        for (uint32_t i = m_billboards.size() - instance.m_billboardCount; i < m_billboards.size(); i++) {
-          IntersectionBillboard& billboard = m_billboards[i];
-          billboard.allowAsIntersectionPrimitive = false;
-        }
-      }
+    const bool areAllBillboardsValidIntersectionCandidates =
+      std::all_of(chunkCandidates.begin(), chunkCandidates.end(), [](uint8_t candidate) { return candidate != 0; });
+
+    if (areAllBillboardsValidIntersectionCandidates) {
+      // Update the instance mask to hide it from rays that look only for intersection billboards.
+      instance.getVkInstance().mask &= OBJECT_MASK_UNORDERED_ALL_GEOMETRY;
     } else {
-      // Revert the billboards that were created successfully before the first failure,
-      // because one of the failed to be created
-      m_billboards.erase(m_billboards.end() - billboardCount, m_billboards.end());
+      // Disable the rest of the billboards as intersection primitives since only a single mask can be used
+      // per instance
+      for (uint32_t i = firstBillboard; i < m_billboards.size(); i++) {
+        IntersectionBillboard& billboard = m_billboards[i];
+        billboard.allowAsIntersectionPrimitive = false;
+      }
     }
   }
 
@@ -1995,13 +2089,15 @@ namespace dxvk {
   }
 
   const XXH64_hash_t RtInstance::calculateAntiCullingHash() const {
-    if (RtxOptions::AntiCulling::Object::enable()) {
+    const RtxFrameOptions& frameOptions = RtxFrameOptions::get();
+
+    if (frameOptions.antiCullingObjectEnable) {
       const Vector3 pos = getWorldPosition();
       const XXH64_hash_t posHash = XXH3_64bits(&pos, sizeof(pos));
       XXH64_hash_t antiCullingHash = XXH3_64bits_withSeed(&m_materialDataHash, sizeof(XXH64_hash_t), posHash);
 
       if (RtxOptions::AntiCulling::Object::hashInstanceWithBoundingBoxHash() &&
-          RtxOptions::Get()->needsMeshBoundingBox()) {
+          frameOptions.needsMeshBoundingBox) {
         const AxisAlignedBoundingBox& boundingBox = getBlas()->input.getGeometryData().boundingBox;
         const XXH64_hash_t bboxHash = boundingBox.calculateHash();
         antiCullingHash = XXH3_64bits_withSeed(&bboxHash, sizeof(antiCullingHash), antiCullingHash);
@@ -29,6 +29,7 @@
 #include "rtx_types.h"
 #include "../util/util_vector.h"
 #include "../util/util_matrix.h"
+#include "../util/util_object_pool.h"
 #include "rtx_camera_manager.h"
 #include "dxvk_cmdlist.h"
 #include "rtx_opacity_micromap_manager.h"
@@ -265,6 +266,14 @@ public:
 
   // Returns the active number of instances in scene
   const uint32_t getActiveCount() const { return m_instances.size(); }
+
+  // Allocation statistics of the instance storage, the per frame values are taken at each garbage collection
+  struct PoolStats {
+    size_t capacity = 0;
+    uint64_t frameAllocations = 0;
+    uint64_t frameTransientReleases = 0;
+  };
+  const PoolStats& getPoolStats() const { return m_poolStats; }
   
   void onFrameEnd();
 
@@ -314,6 +323,11 @@ private:
 
   uint64_t m_nextInstanceId = 0;
 
+  // Storage of all instances. Copies which only live for a frame are transient and released together after each sweep
+  ObjectPool<RtInstance, 1024> m_instancePool;
+  uint64_t m_lastPoolAllocations = 0;
+  PoolStats m_poolStats;
+
   std::vector<RtInstance*> m_instances; 
   std::vector<RtInstance*> m_viewModelCandidates;
   std::vector<RtInstance*> m_playerModelInstances;
@@ -330,6 +344,21 @@ private:
 
   std::vector<InstanceEventHandler> m_eventHandlers;
 
+  // Liveness fields of all instances, gathered for the garbage collection mark pass
+  struct GarbageCollectionView {
+    std::vector<uint32_t> frameLastUpdated;
+    std::vector<uint8_t> flags;
+    std::vector<uint8_t> collect;
+  } m_gcView;
+  std::vector<RtInstance*> m_gcCollectedInstances;
+
+  void releaseInstance(RtInstance* instance);
+
+  // Decides which instances to collect, in parallel for large instance counts
+  void markInstancesForGarbageCollection(const uint32_t currentFrame, const uint32_t numFramesToKeepInstances, const bool collectAllExpired);
+  // Notifies listeners of the collected instances, compacts the instance table and releases the instances in one batch
+  void sweepInstances();
+
   // Handles the case of when two (or more) identical geometries+textures draw calls have been submitted in a single frame (typically used for two-pass rendering in FF)
   void mergeInstanceHeuristics(RtInstance& instanceToModify, const DrawCallState& drawCall, const RtSurfaceMaterial& material, const RtSurface::AlphaState& alphaState) const;
 
@@ -19,6 +19,7 @@
 * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 * DEALINGS IN THE SOFTWARE.
 */
+#include <algorithm>
 #include <vector>
 #include <cmath>
 #include <cassert>
@@ -26,6 +27,7 @@
 #include "rtx_light_manager.h"
 #include "rtx_context.h"
 #include "rtx_options.h"
+#include "rtx_frame_options.h"
 #include "rtx_utils.h"
 
 #include "../d3d9/d3d9_state.h"
@@ -34,6 +36,7 @@
 #include "math.h"
 #include "rtx_lights.h"
 #include "rtx_intersection_test.h"
+#include "../util/util_slot_assignment.h"
 
 /*  Light Manager (blurb)
 * 
@@ -75,8 +78,38 @@ namespace dxvk {
   // to represent something such as a new light index.
   static_assert(LIGHT_INDEX_INVALID == kNewLightIdx, "New light index must match invalid light sentinel value");
 
+  static const float kNotSimilar = -1.f;
+  static const float kCosAngleSimilarityThreshold = cos(5.f * kPi / 180.f);
+
+  // Distant lights are placed at their direction, so a similar direction is a point within the chord of the angle threshold
+  static const float kDistantLightCellSize = 0.1f;
+  static const float kDistantLightSimilarityRadius = std::sqrt(2.f - 2.f * kCosAngleSimilarityThreshold);
+
+  // Note: Widens the spatial queries slightly, so that rounding never drops a light isSimilar would accept.
+  static const float kSimilarityRadiusScale = 1.01f;
+
+  static Vector3 getSimilarityPosition(const RtLight& light) {
+    return light.getType() == RtLightType::Distant ? light.getDirection() : light.getPosition();
+  }
+
+  static SpatialMap<XXH64_hash_t> createLightSpatialMap(const RtLightType type) {
+    // Queries span up to uniqueObjectDistance, the cell size does not affect which lights are found
+    return SpatialMap<XXH64_hash_t>(type == RtLightType::Distant ? kDistantLightCellSize : RtxOptions::uniqueObjectDistance());
+  }
+
+  // Note: The light index is 16 bit on the GPU, with the highest index reserved for the invalid index sentinel.
+  // TODO: Lift this limit with a 32-bit light mapping mode. Slot assignment is already 32-bit, the remaining work is
+  // m_lightMappingData and the lightMapping buffer (common_bindings.slangh), LIGHT_INDEX_INVALID and the 16-bit light
+  // indices stored by RTXDI and the NEE cache, selected at runtime only when the active light count needs it.
+  static const uint32_t kMaxActiveLights = LIGHT_INDEX_INVALID;
+  // Note: Dirty elements at most this far apart are uploaded together, as every upload records a command and a barrier.
+  static const uint32_t kDirtyRangeMergeDistance = 8;
+  // Note: Beyond this many separate uploads a single upload spanning all of them is issued instead.
+  static const size_t kMaxDirtyRangeUploads = 64;
+
   LightManager::LightManager(DxvkDevice* device)
-    : CommonDeviceObject(device) {
+    : CommonDeviceObject(device)
+    , m_dirtyRanges(kDirtyRangeMergeDistance, kMaxDirtyRangeUploads) {
     // Legacy light translation Options
     fallbackLightRadianceRef().x = std::max(fallbackLightRadiance().x, 0.0f);
     fallbackLightRadianceRef().y = std::max(fallbackLightRadiance().y, 0.0f);
@@ -89,6 +122,10 @@ namespace dxvk {
     RTX_OPTION_CLAMP_MIN(lightConversionSphereLightFixedRadius, 0.0f);
     RTX_OPTION_CLAMP_MIN(lightConversionDistantLightFixedIntensity, 0.0f);
     RTX_OPTION_CLAMP(lightConversionDistantLightFixedAngle, 0.0f, kPi);
+
+    for (uint32_t type = 0; type < lightTypeCount; ++type) {
+      m_lightsByType.emplace_back(createLightSpatialMap(static_cast<RtLightType>(type)));
+    }
   }
 
   LightManager::~LightManager() {
@@ -96,27 +133,132 @@ namespace dxvk {
 
   void LightManager::clear() {
     m_lights.clear();
+
+    for (uint32_t type = 0; type < lightTypeCount; ++type) {
+      m_lightsByType[type] = createLightSpatialMap(static_cast<RtLightType>(type));
+    }
+  }
+
+  RtLight& LightManager::emplaceLight(const RtLight& light) {
+    const auto& [lightIterator, addedSuccessfully] = m_lights.try_emplace(light.getInstanceHash(), light);
+
+    // Note: Ensure that the new light was added successfully (meaning that no existing light existed in the light map at the
+    // given Light instance hash). Callers only emplace lights they did not find in the light map.
+    // If this fact ever changes, use insert_or_assign instead of emplace to insert or overwrite the light in the map if that is
+    // the desired behavior.
+    assert(addedSuccessfully);
+
+    m_lightsByType[static_cast<uint32_t>(light.getType())].insert(getSimilarityPosition(light), lightIterator->first);
+    return lightIterator->second;
+  }
+
+  LightManager::LightMap::iterator LightManager::eraseLight(LightMap::const_iterator it) {
+    const RtLight& light = it->second;
+    m_lightsByType[static_cast<uint32_t>(light.getType())].erase(getSimilarityPosition(light), it->first);
+    return m_lights.erase(it);
+  }
+
+  void LightManager::assignLight(LightMap::iterator it, const RtLight& light) {
+    RtLight& storedLight = it->second;
+    SpatialMap<XXH64_hash_t>& oldMap = m_lightsByType[static_cast<uint32_t>(storedLight.getType())];
+    SpatialMap<XXH64_hash_t>& newMap = m_lightsByType[static_cast<uint32_t>(light.getType())];
+
+    if (&oldMap == &newMap) {
+      oldMap.move(getSimilarityPosition(storedLight), getSimilarityPosition(light), it->first);
+    } else {
+      oldMap.erase(getSimilarityPosition(storedLight), it->first);
+      newMap.insert(getSimilarityPosition(light), it->first);
+    }
+
+    storedLight = light;
+  }
+
+  template<typename Fn>
+  void LightManager::forEachSimilarCandidate(const RtLight& light, float distanceThreshold, Fn&& fn) {
+    // Lights are only ever similar to lights of the same type
+    const SpatialMap<XXH64_hash_t>& lights = m_lightsByType[static_cast<uint32_t>(light.getType())];
+    const float radius = light.getType() == RtLightType::Distant ? kDistantLightSimilarityRadius : distanceThreshold;
+
+    lights.forEachInRadius(getSimilarityPosition(light), radius * kSimilarityRadiusScale, [&](const XXH64_hash_t& lightHash) {
+      auto it = m_lights.find(lightHash);
+      assert(it != m_lights.end());
+      fn(it->second);
+      return true;
+    });
+  }
+
+  void LightManager::assignLightSlots(const uint32_t previousLightActiveCount) {
+    // Collect the active lights
+
+    m_activeLights.clear();
+
+    for (auto&& linearizedLight : m_linearizedLights) {
+      RtLight& light = *linearizedLight;
+
+      // Note: Lights absent from last frame's list may still hold an index past its end.
+      if (light.getBufferIdx() >= previousLightActiveCount) {
+        light.setBufferIdx(kNewLightIdx);
+      }
+
+      if (light.getColorAndIntensity().w > 0) {
+        m_activeLights.emplace_back(&light);
+      } else {
+        // This light is disabled, so set its buffer index to invalid.
+        light.setBufferIdx(kNewLightIdx);
+      }
+    }
+
+    if (m_activeLights.size() > kMaxActiveLights) {
+      // Note: The light index and mappings are 16 bit on the GPU, so the lights over the limit are clamped away rather than indexed.
+      ONCE(Logger::warn(str::format("[RTX-Compatibility-Info] Raytracing supports at most ", kMaxActiveLights, " active lights, skipping ",
+                                    m_activeLights.size() - kMaxActiveLights, " of ", m_activeLights.size(), " lights.")));
+
+      // Lights which were in the buffer last frame keep their place, so that the skipped lights do not change from frame to frame
+      std::stable_partition(m_activeLights.begin(), m_activeLights.end(), [](const RtLight* light) {
+        return light->getBufferIdx() != kNewLightIdx;
+      });
+
+      for (size_t i = kMaxActiveLights; i < m_activeLights.size(); ++i) {
+        m_activeLights[i]->setBufferIdx(kNewLightIdx);
+      }
+
+      m_activeLights.resize(kMaxActiveLights);
+    }
+
+    m_currentActiveLightCount = static_cast<uint32_t>(m_activeLights.size());
+
+    assignStableSlots(m_currentActiveLightCount,
+      [this](uint32_t light) { return static_cast<uint32_t>(m_activeLights[light]->getType()); },
+      [this](uint32_t light) { return m_activeLights[light]->getBufferIdx(); },
+      m_lightTypeRanges, m_lightSlots, m_unplacedLights);
+  }
+
+  void LightManager::uploadDirtyRanges(Rc<DxvkContext>& ctx, const Rc<DxvkBuffer>& buffer, const void* data, size_t elementSize) {
+    for (const DirtyRangeList::Range& range : m_dirtyRanges.ranges()) {
+      ctx->writeToBuffer(buffer, range.begin * elementSize, range.size() * elementSize, static_cast<const unsigned char*>(data) + range.begin * elementSize);
+    }
   }
 
   void LightManager::garbageCollectionInternal() {
+    const RtxFrameOptions& frameOptions = RtxFrameOptions::get();
     const uint32_t currentFrame = m_device->getCurrentFrameId();
-    const uint32_t framesToKeep = RtxOptions::Get()->getNumFramesToKeepLights();
-    const uint32_t framesToSleep = RtxOptions::Get()->getNumFramesToPutLightsToSleep();
+    const uint32_t framesToKeep = frameOptions.numFramesToKeepLights;
+    const uint32_t framesToSleep = frameOptions.numFramesToPutLightsToSleep;
 
-    const bool forceGarbageCollection = (m_lights.size() >= RtxOptions::AntiCulling::Light::numLightsToKeep());
+    const bool forceGarbageCollection = (m_lights.size() >= frameOptions.antiCullingNumLightsToKeep);
     for (auto it = m_lights.begin(); it != m_lights.end();) {
       const RtLight& light = it->second;
       const uint32_t frameLastTouched = light.getFrameLastTouched();
-      if (!RtxOptions::AntiCulling::Light::enable() || // It's always True if anti-culling is disabled
+      if (!frameOptions.antiCullingLightEnable || // It's always True if anti-culling is disabled
           (light.getIsInsideFrustum() ||
-           frameLastTouched + RtxOptions::AntiCulling::Light::numFramesToExtendLightLifetime() <= currentFrame)) {
-        if (light.isChildOfMesh() || light.isDynamic || suppressLightKeeping()) {
+           frameLastTouched + frameOptions.antiCullingNumFramesToExtendLightLifetime <= currentFrame)) {
+        if (light.isChildOfMesh() || light.isDynamic || frameOptions.suppressLightKeeping) {
           if (light.getFrameLastTouched() < currentFrame) {
-            it = m_lights.erase(it);
+            it = eraseLight(it);
             continue;
           }
         } else if ((light.isStaticCount < framesToSleep) && (frameLastTouched + framesToKeep) <= currentFrame) {
-          it = m_lights.erase(it);
+          it = eraseLight(it);
           continue;
         }
       }
@@ -163,6 +305,8 @@ namespace dxvk {
 
   void LightManager::dynamicLightMatching() {
     ScopedCpuProfileZone();
+    const float uniqueObjectDistance = RtxFrameOptions::get().uniqueObjectDistance;
+
     // Try match up any stragglers now we have the full light list this frame.
     for (auto it = m_lights.cbegin(); it != m_lights.cend(); ) {
       const RtLight& light = it->second;
@@ -182,34 +326,33 @@ namespace dxvk {
         continue;
       }
 
-      float currentSimilarity = -1.f;
-      // Note: Using an iterator for the found similar light is safe here because the m_lights map will not change between where
+      float currentSimilarity = kNotSimilar;
+      // Note: Using a pointer to the found similar light is safe here because the m_lights map will not change between where
       // it is found and where it is accessed.
-      std::optional<decltype(m_lights)::iterator> similarLight;
-      for (auto similarLightIterator = m_lights.begin(); similarLightIterator != m_lights.end(); ++similarLightIterator) {
-        const RtLight& newLight = similarLightIterator->second;
+      RtLight* similarLight = nullptr;
+      forEachSimilarCandidate(light, uniqueObjectDistance, [&](RtLight& newLight) {
         // Skip comparing to old lights, this check implicitly avoids comparing the exact same light.
         if (newLight.getBufferIdx() != kNewLightIdx || newLight.isChildOfMesh())
-          continue;
+          return;
 
-        const float similarity = isSimilar(light, newLight, RtxOptions::uniqueObjectDistance());
+        const float similarity = isSimilar(light, newLight, uniqueObjectDistance);
         // Update the cached light if it's similar.
         if (similarity > currentSimilarity) {
-          similarLight = similarLightIterator;
+          similarLight = &newLight;
           currentSimilarity = similarity;
         }
-      }
+      });
 
-      if (currentSimilarity >= 0 && similarLight.has_value()) {
+      if (currentSimilarity >= 0 && similarLight != nullptr) {
         // This is a dynamic light!
-        RtLight& dynamicLight = (*similarLight)->second;
+        RtLight& dynamicLight = *similarLight;
         dynamicLight.isDynamic = true;
 
         // This is the same light, so update our new light
         updateLight(light, dynamicLight);
 
         // Remove the previous frames version
-        it = m_lights.erase(it);
+        it = eraseLight(it);
       } else {
         ++it;
       }
@@ -304,9 +447,9 @@ namespace dxvk {
 
     // Light buffer
     const uint32_t previousLightActiveCount = m_currentActiveLightCount;
-    m_currentActiveLightCount = 0;
 
     std::swap(m_lightBuffer, m_previousLightBuffer);
+    std::swap(m_lightsGPUData, m_previousLightsGPUData);
 
     // Linearize the light list
     // Note: This is done rather than just iterating over the light list twice mostly so that the fallback light
@@ -333,115 +476,94 @@ namespace dxvk {
       }
     }
 
-    // Count the active light of each type
+    // Place the active lights into the light buffer, mostly into the slots they occupied last frame
 
-    m_lightTypeRanges.fill(LightRange {});
-    for (auto&& linearizedLight : m_linearizedLights) {
-      const RtLight& light = *linearizedLight;
+    assignLightSlots(previousLightActiveCount);
 
-      if (light.getColorAndIntensity().w <= 0) {
-        continue;
-      }
+    const size_t lightsGPUSize = m_currentActiveLightCount * kLightGPUSize;
+    const uint32_t lightMappingBufferEntries = m_currentActiveLightCount + previousLightActiveCount;
 
-      ++m_lightTypeRanges[static_cast<uint32_t>(light.getType())].count;
-      ++m_currentActiveLightCount;
+    // Allocate the light buffers
+    // Note: A newly allocated buffer holds none of the uploaded light data, so its copy is dropped to upload every slot.
+    DxvkBufferCreateInfo info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
+    info.usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+    info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
+    info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
+    info.size = align(lightsGPUSize, kBufferAlignment);
 
-      // Note: Highest light index reserved for the invalid index sentinel.
-      if (m_currentActiveLightCount == LIGHT_INDEX_INVALID) {
-        ONCE(Logger::info(str::format("[RTX-Compatibility-Info] Raytracing support more than 65535 lights currently, skipping some lights for now.")));
-        break;
-      }
+    // Note: Only allocating the light buffer here, not the previous light buffer as on the first frame it is fine for it to be null as
+    // no previous frame light indices can possibly exist (and thus nothing in the shader should be trying to access it). On the next frame
+    // after the light buffer and previous light buffer are swapped, this code will allocate another buffer and the process will continue
+    // fine swapping back and forth from that point onwards.
+    if (info.size > 0 && (m_lightBuffer == nullptr || info.size > m_lightBuffer->info().size)) {
+      m_lightBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DxvkMemoryStats::Category::RTXBuffer);
+      m_lightsGPUData.clear();
     }
 
-    // Arrange the ligth ranges of each types sequentially in the buffer, reset the counts
+    // Note: Mapping entries are uploaded in pairs to keep the updates 4 byte aligned, so the data is padded to an even count.
+    const uint32_t lightMappingDataEntries = align(lightMappingBufferEntries, 2);
 
-    uint offset = 0;
-    for (uint lightType = 0; lightType < lightTypeCount; ++lightType) {
-      LightRange& range = m_lightTypeRanges[lightType];
-      range.offset = offset;
-      offset += range.count;
-      range.count = 0;
+    info.size = align(lightMappingDataEntries * sizeof(uint16_t), kBufferAlignment);
+    if (info.size > 0 && (m_lightMappingBuffer == nullptr || info.size > m_lightMappingBuffer->info().size)) {
+      m_lightMappingBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DxvkMemoryStats::Category::RTXBuffer);
+      m_lightMappingData.clear();
     }
 
-    assert(offset == m_currentActiveLightCount);
-    uint32_t lightsWritten = 0;
-
-    const size_t lightsGPUSize = m_currentActiveLightCount * kLightGPUSize;
-    const uint32_t lightMappingBufferEntries = m_currentActiveLightCount + previousLightActiveCount;
-
-    // Resize persistent data buffers
-    // Note: std::vector::shrink_to_fit may potentially be useful to call on these buffers in the future if the new desired size is much smaller
-    // than the reserved capacity if support for many more lights than 2^16 is desired to allow reclaiming of some memory. For now though this
-    // is not an issue and the buffers are allowed to keep whatever capacity they have allocated between calls for the sake of performance.
+    // Write the light data and mappings of each slot, only keeping track of the slots whose data changed since this
+    // buffer was last written to (two frames ago, as the current and previous light buffers alternate)
 
+    const uint32_t validLightSlots = static_cast<uint32_t>(std::min(m_lightsGPUData.size(), lightsGPUSize) / kLightGPUSize);
     m_lightsGPUData.resize(lightsGPUSize);
-    memset(m_lightsGPUData.data(), 0xff, sizeof(char)* m_lightsGPUData.size());
-    m_lightMappingData.resize(lightMappingBufferEntries);
 
     // Clear all slots to new light
-    memset(m_lightMappingData.data(), kNewLightIdx, sizeof(uint16_t) * m_lightMappingData.size());
+    m_newLightMappingData.assign(lightMappingDataEntries, kNewLightIdx);
 
-    // Write the light data into the previously allocated ranges
-    for (auto&& linearizedLight : m_linearizedLights) {
-      RtLight& light = *linearizedLight;
+    m_dirtyRanges.clear();
 
-      if (light.getColorAndIntensity().w > 0 && lightsWritten < m_currentActiveLightCount) {
-        // Find the buffer location for this light
-        LightRange& range = m_lightTypeRanges[static_cast<uint32_t>(light.getType())];
-        uint32_t newBufferIdx = range.offset + range.count;
-        ++range.count;
+    for (uint32_t slot = 0; slot < m_currentActiveLightCount; ++slot) {
+      RtLight& light = *m_activeLights[m_lightSlots[slot]];
 
-        // RTXDI needs a mapping from previous light idx to current (to deal with light list reordering)
-        if (light.getBufferIdx() != kNewLightIdx)
-          m_lightMappingData[m_currentActiveLightCount + light.getBufferIdx()] = (uint16_t)newBufferIdx;
+      // RTXDI needs a mapping from previous light idx to current (to deal with light list reordering)
+      if (light.getBufferIdx() != kNewLightIdx)
+        m_newLightMappingData[m_currentActiveLightCount + light.getBufferIdx()] = static_cast<uint16_t>(slot);
 
-        // Also a mapping from current light idx to previous (for unbiased resampling)
-        m_lightMappingData[newBufferIdx] = light.getBufferIdx();
+      // Also a mapping from current light idx to previous (for unbiased resampling)
+      m_newLightMappingData[slot] = static_cast<uint16_t>(light.getBufferIdx());
 
-        // Prepare data for GPU
-        size_t dataOffset = newBufferIdx * kLightGPUSize;
-        assert(dataOffset < lightsGPUSize);
-        light.writeGPUData(m_lightsGPUData.data(), dataOffset);
+      // Prepare data for GPU
+      unsigned char lightData[kLightGPUSize];
+      size_t dataOffset = 0;
+      light.writeGPUData(lightData, dataOffset);
+      assert(dataOffset == kLightGPUSize);
 
-        // Update the position in buffer for next frame
-        light.setBufferIdx(newBufferIdx);
+      unsigned char* slotData = m_lightsGPUData.data() + slot * kLightGPUSize;
 
-        // Guard against overflowing the light buffer, in case the light counting loop above terminated early
-        ++lightsWritten;
-      } else {
-        // This light is either disabled or didn't fit into the buffer, so set its buffer index to invalid.
-        light.setBufferIdx(kNewLightIdx);
+      if (slot >= validLightSlots || memcmp(slotData, lightData, kLightGPUSize) != 0) {
+        memcpy(slotData, lightData, kLightGPUSize);
+        m_dirtyRanges.markDirty(slot);
       }
+
+      // Update the position in buffer for next frame
+      light.setBufferIdx(slot);
     }
 
-    // Allocate the light buffer and copy its contents from host to device memory
-    DxvkBufferCreateInfo info = { VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO };
-    info.usage = VK_BUFFER_USAGE_SHADER_DEVICE_ADDRESS_BIT | VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
-    info.stages = VK_PIPELINE_STAGE_TRANSFER_BIT;
-    info.access = VK_ACCESS_TRANSFER_WRITE_BIT;
-    info.size = align(lightsGPUSize, kBufferAlignment);
+    uploadDirtyRanges(ctx, m_lightBuffer, m_lightsGPUData.data(), kLightGPUSize);
 
-    // Note: Only allocating the light buffer here, not the previous light buffer as on the first frame it is fine for it to be null as
-    // no previous frame light indices can possibly exist (and thus nothing in the shader should be trying to access it). On the next frame
-    // after the light buffer and previous light buffer are swapped, this code will allocate another buffer and the process will continue
-    // fine swapping back and forth from that point onwards.
-    if (info.size > 0 && (m_lightBuffer == nullptr || info.size > m_lightBuffer->info().size)) {
-      m_lightBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DxvkMemoryStats::Category::RTXBuffer);
-    }
+    // Compare the mappings in pairs of entries, matching the 4 byte granularity of the uploads
 
-    info.size = align(lightMappingBufferEntries * sizeof(uint16_t), kBufferAlignment);
-    if (info.size > 0 && (m_lightMappingBuffer == nullptr || info.size > m_lightMappingBuffer->info().size)) {
-      m_lightMappingBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DxvkMemoryStats::Category::RTXBuffer);
-    }
-    
-    if (!m_lightsGPUData.empty()) {
-      ctx->writeToBuffer(m_lightBuffer, 0, m_lightsGPUData.size(), m_lightsGPUData.data());
-    }
+    const uint32_t validMappingPairs = static_cast<uint32_t>(std::min<size_t>(m_lightMappingData.size(), lightMappingDataEntries) / 2);
+    m_dirtyRanges.clear();
 
-    if (!m_lightMappingData.empty()) {
-      ctx->writeToBuffer(m_lightMappingBuffer, 0, m_lightMappingData.size() * sizeof(uint16_t), m_lightMappingData.data());
+    for (uint32_t pair = 0; pair < lightMappingDataEntries / 2; ++pair) {
+      if (pair >= validMappingPairs || memcmp(&m_lightMappingData[pair * 2], &m_newLightMappingData[pair * 2], 2 * sizeof(uint16_t)) != 0) {
+        m_dirtyRanges.markDirty(pair);
+      }
     }
 
+    std::swap(m_lightMappingData, m_newLightMappingData);
+
+    uploadDirtyRanges(ctx, m_lightMappingBuffer, m_lightMappingData.data(), 2 * sizeof(uint16_t));
+
     // If there are no lights with >0 intensity, then clear the list...
     if (m_currentActiveLightCount == 0)
       clear();
@@ -467,10 +589,7 @@ namespace dxvk {
     m_externalActiveLightList.clear();
   }
 
-  static const float kNotSimilar = -1.f;
   float LightManager::isSimilar(const RtLight& a, const RtLight& b, float distanceThreshold) {
-    static const float kCosAngleSimilarityThreshold = cos(5.f * kPi / 180.f);
-
     // Basic similarity check.
     const bool sameType = a.getType() == b.getType();
 
@@ -576,7 +695,7 @@ namespace dxvk {
     if (lightToReplace != kEmptyHash && lightToReplace != rtLight.getInstanceHash()) {
       const auto& lightToReplaceIt = m_lights.find(lightToReplace);
       if (lightToReplaceIt != m_lights.end()) {
-        m_lights.erase(lightToReplaceIt);
+        eraseLight(lightToReplaceIt);
       }
     }
 
@@ -588,17 +707,17 @@ namespace dxvk {
           // If light transform changed, update it.
           if (foundLightIt->second.getTransformedHash() != rtLight.getTransformedHash()) {
             uint16_t bufferIdx = foundLightIt->second.getBufferIdx();
-            foundLightIt->second = rtLight;
+            assignLight(foundLightIt, rtLight);
             foundLightIt->second.setBufferIdx(bufferIdx);
           }
-        } else if (!rtLight.isDynamic && !suppressLightKeeping()) {
+        } else if (!rtLight.isDynamic && !RtxFrameOptions::get().suppressLightKeeping) {
           // Update the light - its an exact hash match (meaning it's static)
           const uint32_t isStaticCount = foundLightIt->second.isStaticCount;
 
           // If this light hasnt moved for N frames, put it to sleep.  This is a defeat device to stop games aggressively ramping up/down intensity as lights 
-          if (isStaticCount < RtxOptions::Get()->getNumFramesToPutLightsToSleep()) {
+          if (isStaticCount < RtxFrameOptions::get().numFramesToPutLightsToSleep) {
             uint16_t bufferIdx = foundLightIt->second.getBufferIdx();
-            foundLightIt->second = rtLight;
+            assignLight(foundLightIt, rtLight);
             foundLightIt->second.setBufferIdx(bufferIdx);
           }
 
@@ -606,7 +725,7 @@ namespace dxvk {
           foundLightIt->second.isStaticCount = isStaticCount + 1;
         } else {
           uint16_t bufferIdx = foundLightIt->second.getBufferIdx();
-          foundLightIt->second = rtLight;
+          assignLight(foundLightIt, rtLight);
           foundLightIt->second.setBufferIdx(bufferIdx);
         }
 
@@ -616,38 +735,30 @@ namespace dxvk {
 
     } else {
       //  Try find a similar light
-      std::optional<RtLight> similarLight;
-      float bestSimilarity = kNotSimilar;
-      for (auto&& pair : m_lights) {
-        const RtLight& light = pair.second;
+      // Update the cached light if it's similar.  This should catch minor perturbations in static lights (e.g. due to precision loss)
+      const float kDistanceThresholdMeters = 0.02f;
+      const float kDistanceThresholdWorldUnits = kDistanceThresholdMeters * RtxFrameOptions::get().meterToWorldUnitScale;
 
-        // Update the cached light if it's similar.  This should catch minor perturbations in static lights (e.g. due to precision loss)
-        const float kDistanceThresholdMeters = 0.02f;
-        const float kDistanceThresholdWorldUnits = kDistanceThresholdMeters * RtxOptions::Get()->getMeterToWorldUnitScale();
+      const RtLight* bestLight = nullptr;
+      float bestSimilarity = kNotSimilar;
+      forEachSimilarCandidate(rtLight, kDistanceThresholdWorldUnits, [&](const RtLight& light) {
         const float thisLightsSimilarity = isSimilar(light, rtLight, kDistanceThresholdWorldUnits);
 
         if (thisLightsSimilarity >= 0.f && thisLightsSimilarity > bestSimilarity) {
-          // Copy off light state.
-          similarLight = light;
+          bestLight = &light;
           bestSimilarity = thisLightsSimilarity;
-        } 
-      }
+        }
+      });
 
-      if (similarLight.has_value()) {
-        // Remove it, since we want to re-add it with a (potentially) new hash
-        m_lights.erase(similarLight->getInstanceHash());
+      std::optional<RtLight> similarLight;
+      if (bestLight != nullptr) {
+        // Copy off light state, then remove it, since we want to re-add it with a (potentially) new hash
+        similarLight = *bestLight;
+        eraseLight(m_lights.find(similarLight->getInstanceHash()));
       }
 
       // Add as a new light (with/out updated data depending on if a similar light was found)
-      const auto& [localLightIterator, addedSuccessfully] = m_lights.try_emplace(rtLight.getInstanceHash(), rtLight);
-      RtLight& localLight = localLightIterator->second;
-
-      // Note: Ensure that the new light was added successfully (meaning that no existing light existed in the light map at the
-      // given Light instance hash). This should always be the case as this code is in the "else" branch of a check to see if the
-      // light exists in the map already, meaning a light with this hash should not be present in this case.
-      // If this fact ever changes, use insert_or_assign instead of emplace to insert or overwrite the light in the map if that is
-      // the desired behavior.
-      assert(addedSuccessfully);
+      RtLight& localLight = emplaceLight(rtLight);
 
       // Copy/interpolate any state we like from the similar light.
       if (similarLight.has_value())
@@ -25,6 +25,8 @@
 #include <vector>
 #include <unordered_map>
 #include "../util/rc/util_rc_ptr.h"
+#include "../util/util_dirty_range.h"
+#include "../util/util_spatial_map.h"
 #include "rtx_types.h"
 #include "rtx/utility/shader_types.h"
 #include "rtx/concept/light/light_types.h"
@@ -100,7 +102,12 @@ public:
 
 
 private:
-  std::unordered_map<XXH64_hash_t, RtLight> m_lights;
+  using LightMap = std::unordered_map<XXH64_hash_t, RtLight>;
+
+  LightMap m_lights;
+  // Note: The lights of m_lights by type, positional lights placed at their position and distant lights at their
+  // direction, so that similar lights are only searched for among nearby lights. Kept in sync with m_lights.
+  std::vector<SpatialMap<XXH64_hash_t>> m_lightsByType;
   // Note: A fallback light tracked seperately and handled specially to not be mixed up with
   // lights provided from the application.
   std::optional<RtLight> m_fallbackLight{};
@@ -121,13 +128,34 @@ private:
   // of the memory behind these buffers between each call (at the cost of slightly more persistent
   // memory usage, but these buffers are fairly small at only 4 MiB or so max with 2^16 lights present).
   std::vector<RtLight*> m_linearizedLights{};
+  std::vector<RtLight*> m_activeLights{};
+  std::vector<uint32_t> m_unplacedLights{};
+  // Note: The index into m_activeLights of the light occupying each slot of the light buffer this frame.
+  std::vector<uint32_t> m_lightSlots{};
+  // Note: Copies of what was last uploaded to m_lightBuffer and m_previousLightBuffer (swapped along with them) and
+  // to m_lightMappingBuffer, lights keep their slot between frames so that only the slots whose data changed are uploaded.
   std::vector<unsigned char> m_lightsGPUData{};
+  std::vector<unsigned char> m_previousLightsGPUData{};
   std::vector<uint16_t> m_lightMappingData{};
+  std::vector<uint16_t> m_newLightMappingData{};
+  // Note: Element ranges to upload this frame.
+  DirtyRangeList m_dirtyRanges;
 
   bool getActiveDomeLight(DomeLight& lightOut);
 
   void garbageCollectionInternal();
 
+  void assignLightSlots(const uint32_t previousLightActiveCount);
+  void uploadDirtyRanges(Rc<DxvkContext>& ctx, const Rc<DxvkBuffer>& buffer, const void* data, size_t elementSize);
+
+  RtLight& emplaceLight(const RtLight& light);
+  LightMap::iterator eraseLight(LightMap::const_iterator it);
+  void assignLight(LightMap::iterator it, const RtLight& light);
+
+  // Visits the lights which may be similar to a light, fn(RtLight&)
+  template<typename Fn>
+  void forEachSimilarCandidate(const RtLight& light, float distanceThreshold, Fn&& fn);
+
   // Similarity check.
   //  Returns -1 if not similar
   //  Returns 0~1 if similar, higher is more similar
@@ -253,10 +253,14 @@ namespace dxvk {
     RW_RTX_OPTION("rtx.postfx", fast_unordered_set, motionBlurMaskOutTextures, {}, "Disable motion blur for meshes with specific texture.");
 
     RW_RTX_OPTION("rtx", std::string, geometryGenerationHashRuleString, "positions,indices,texcoords,geometrydescriptor,vertexlayout,vertexshader",
-                  "Defines which asset hashes we need to generate via the geometry processing engine.");
+                  "Defines which asset hashes we need to generate via the geometry processing engine.\n"
+                  "Adding vertexdatav2 generates the positions and texcoords hashes with the streamed version 2 vertex hash, which is faster but does not match content hashed with the original version.");
     RW_RTX_OPTION("rtx", std::string, geometryAssetHashRuleString, "positions,indices,geometrydescriptor",
                   "Defines which hashes we need to include when sampling from replacements and doing USD capture.");
     RW_RTX_OPTION("rtx", fast_unordered_set, raytracedRenderTargetTextures, {}, "DescriptorHashes for Render Targets. (Screens that should display the output of another camera).");
+    RTX_OPTION("rtx", uint32_t, geometryHashParallelVertexThreshold, 256 * 1024,
+               "The number of vertices from which the version 2 vertex hashes (see vertexdatav2 in \"rtx.geometryGenerationHashRuleString\") of a mesh are computed on multiple threads, 0 disables it.\n"
+               "The resulting hashes are the same either way.");
     
   public:
     RTX_OPTION("rtx", bool, showRaytracingOption, true, "Enables or disables the option to toggle ray tracing in the UI. When set to false the ray tracing checkbox will not appear in the Remix UI.");
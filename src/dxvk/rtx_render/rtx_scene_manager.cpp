@@ -24,6 +24,7 @@
 
 #include "rtx_asset_replacer.h"
 #include "rtx_scene_manager.h"
+#include "rtx_frame_options.h"
 #include "rtx_opacity_micromap_manager.h"
 #include "dxvk_device.h"
 #include "dxvk_context.h"
@@ -59,13 +60,19 @@ namespace dxvk {
     , m_pReplacer(new AssetReplacer())
     , m_terrainBaker(new TerrainBaker())
     , m_cameraManager(device)
-    , m_startTime(std::chrono::steady_clock::now())
-    , m_uniqueObjectSearchDistance(RtxOptions::uniqueObjectDistance()) {
+    , m_startTime(std::chrono::steady_clock::now()) {
     InstanceEventHandler instanceEvents(this);
     instanceEvents.onInstanceAddedCallback = [this](const RtInstance& instance) { onInstanceAdded(instance); };
     instanceEvents.onInstanceUpdatedCallback = [this](RtInstance& instance, const RtSurfaceMaterial& material, bool hasTransformChanged, bool hasVerticesChanged) { onInstanceUpdated(instance, material, hasTransformChanged, hasVerticesChanged); };
     instanceEvents.onInstanceDestroyedCallback = [this](const RtInstance& instance) { onInstanceDestroyed(instance); };
     m_instanceManager.addEventHandler(instanceEvents);
+
+    // The BLAS spatial maps are bucketed by the unique object distance
+    m_frameOptionsListener = RtxFrameOptions::addListener([this](const RtxFrameOptions& previous, const RtxFrameOptions& current) {
+      if (previous.uniqueObjectDistance != current.uniqueObjectDistance) {
+        m_drawCallCache.rebuildSpatialMaps();
+      }
+    });
     
     if (env::getEnvVar("DXVK_RTX_CAPTURE_ENABLE_ON_FRAME") != "") {
       m_beginUsdExportFrameNum = stoul(env::getEnvVar("DXVK_RTX_CAPTURE_ENABLE_ON_FRAME"));
@@ -76,6 +83,7 @@ namespace dxvk {
   }
 
   SceneManager::~SceneManager() {
+    RtxFrameOptions::removeListener(m_frameOptionsListener);
   }
 
   bool SceneManager::areReplacementsLoaded() const {
@@ -190,13 +198,12 @@ namespace dxvk {
     ScopedCpuProfileZone();
 
     const size_t oldestFrame = m_device->getCurrentFrameId() - RtxOptions::Get()->numFramesToKeepGeometryData();
-    auto blasEntryGarbageCollection = [&](auto& iter, auto& entries) -> void {
-      if (iter->second.frameLastTouched < oldestFrame) {
-        onSceneObjectDestroyed(iter->second);
-        iter = entries.erase(iter);
-      } else {
-        ++iter;
+    auto blasEntryGarbageCollection = [&](BlasEntry& blas) -> bool {
+      if (blas.frameLastTouched < oldestFrame) {
+        onSceneObjectDestroyed(blas);
+        return true;
       }
+      return false;
     };
 
     // Garbage collection for BLAS/Scene objects
@@ -204,20 +211,16 @@ namespace dxvk {
     // When anti-culling is enabled, we need to check if any instances are outside frustum. Because in such
     // case the life of the instances will be extended and we need to keep the BLAS as well.
     if (!RtxOptions::AntiCulling::Object::enable()) {
-      auto& entries = m_drawCallCache.getEntries();
       if (m_device->getCurrentFrameId() > RtxOptions::Get()->numFramesToKeepGeometryData()) {
-        for (auto iter = entries.begin(); iter != entries.end(); ) {
-          blasEntryGarbageCollection(iter, entries);
-        }
+        m_drawCallCache.eraseIf(blasEntryGarbageCollection);
       }
     }
     else { // Implement anti-culling BLAS/Scene object GC
       fast_unordered_cache<const RtInstance*> outsideFrustumInstancesCache;
 
-      auto& entries = m_drawCallCache.getEntries();
-      for (auto iter = entries.begin(); iter != entries.end();) {
+      m_drawCallCache.eraseIf([&](BlasEntry& blas) -> bool {
         bool isAllInstancesInCurrentBlasInsideFrustum = true;
-        for (const RtInstance* instance : iter->second.getLinkedInstances()) {
+        for (const RtInstance* instance : blas.getLinkedInstances()) {
           const Matrix4 objectToView = getCamera().getWorldToView(false) * instance->getTransform();
 
           bool isInsideFrustum = true;
@@ -277,11 +280,11 @@ namespace dxvk {
         // If all instances in current BLAS are inside the frustum, then use original GC logic to recycle BLAS Objects
         if (isAllInstancesInCurrentBlasInsideFrustum &&
             m_device->getCurrentFrameId() > RtxOptions::Get()->numFramesToKeepGeometryData()) {
-          blasEntryGarbageCollection(iter, entries);
-        } else { // If any instances are outside of the frustum in current BLAS, we need to keep the entity
-          ++iter;
+          return blasEntryGarbageCollection(blas);
         }
-      }
+        // If any instances are outside of the frustum in current BLAS, we need to keep the entity
+        return false;
+      });
     }
 
     // Perform GC on the other managers
@@ -482,11 +485,6 @@ namespace dxvk {
     }
     
     m_activePOMCount = 0;
-
-    if (m_uniqueObjectSearchDistance != RtxOptions::uniqueObjectDistance()) {
-      m_uniqueObjectSearchDistance = RtxOptions::uniqueObjectDistance();
-      m_drawCallCache.rebuildSpatialMaps();
-    }
   }
 
   void SceneManager::onFrameEndNoRTX() {
@@ -1302,7 +1300,8 @@ namespace dxvk {
 
     
     auto& textureManager = m_device->getCommon()->getTextureManager();
-    m_bindlessResourceManager.prepareSceneData(ctx, textureManager.getTextureTable(), getBufferTable(), getSamplerTable());
+    m_bindlessResourceManager.prepareSceneData(ctx, textureManager.getTextureTable(), getBufferTable(), getSamplerTable(), m_samplerCache.getDirtyRange());
+    m_samplerCache.clearDirtyRange();
 
     // If there are no instances, we should do nothing!
     if (m_instanceManager.getActiveCount() == 0) {
@@ -1407,23 +1406,29 @@ namespace dxvk {
 
         info.size = align(surfaceMaterialExtensionsGPUSize, kBufferAlignment);
         info.usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+        // Only the slots changed since the last upload need to be written, unless the buffer is new
+        SlotRange dirtyRange = m_surfaceMaterialExtensionCache.getDirtyRange();
         if (m_surfaceMaterialExtensionBuffer == nullptr || info.size > m_surfaceMaterialExtensionBuffer->info().size) {
           m_surfaceMaterialExtensionBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DxvkMemoryStats::Category::RTXBuffer);
+          dirtyRange = { 0, m_surfaceMaterialExtensionCache.getTotalCount() };
         }
+        dirtyRange.end = std::min(dirtyRange.end, m_surfaceMaterialExtensionCache.getTotalCount());
 
-        std::size_t dataOffset = 0;
-        std::vector<unsigned char> surfaceMaterialExtensionsGPUData(surfaceMaterialExtensionsGPUSize);
+        if (!dirtyRange.empty()) {
+          std::size_t dataOffset = 0;
+          std::vector<unsigned char> surfaceMaterialExtensionsGPUData((dirtyRange.end - dirtyRange.begin) * kSurfaceMaterialGPUSize);
 
-        uint16_t surfaceIndex = 0;
-        for (auto&& surfaceMaterialExtension : m_surfaceMaterialExtensionCache.getObjectTable()) {
-          surfaceMaterialExtension.writeGPUData(surfaceMaterialExtensionsGPUData.data(), dataOffset, surfaceIndex);
-          surfaceIndex++;
-        }
+          const auto& surfaceMaterialExtensions = m_surfaceMaterialExtensionCache.getObjectTable();
+          for (uint32_t surfaceIndex = dirtyRange.begin; surfaceIndex < dirtyRange.end; surfaceIndex++) {
+            surfaceMaterialExtensions[surfaceIndex].writeGPUData(surfaceMaterialExtensionsGPUData.data(), dataOffset, static_cast<uint16_t>(surfaceIndex));
+          }
+
+          assert(dataOffset == surfaceMaterialExtensionsGPUData.size());
 
-        assert(dataOffset == surfaceMaterialExtensionsGPUSize);
-        assert(surfaceMaterialExtensionsGPUData.size() == surfaceMaterialExtensionsGPUSize);
+          ctx->writeToBuffer(m_surfaceMaterialExtensionBuffer, dirtyRange.begin * kSurfaceMaterialGPUSize, surfaceMaterialExtensionsGPUData.size(), surfaceMaterialExtensionsGPUData.data());
+        }
 
-        ctx->writeToBuffer(m_surfaceMaterialExtensionBuffer, 0, surfaceMaterialExtensionsGPUData.size(), surfaceMaterialExtensionsGPUData.data());
+        m_surfaceMaterialExtensionCache.clearDirtyRange();
       }
 
       // Volume Material buffer
@@ -1433,21 +1438,29 @@ namespace dxvk {
 
         info.size = align(volumeMaterialsGPUSize, kBufferAlignment);
         info.usage |= VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT;
+
+        SlotRange dirtyRange = m_volumeMaterialCache.getDirtyRange();
         if (m_volumeMaterialBuffer == nullptr || info.size > m_volumeMaterialBuffer->info().size) {
           m_volumeMaterialBuffer = m_device->createBuffer(info, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, DxvkMemoryStats::Category::RTXBuffer);
+          dirtyRange = { 0, m_volumeMaterialCache.getTotalCount() };
         }
+        dirtyRange.end = std::min(dirtyRange.end, m_volumeMaterialCache.getTotalCount());
 
-        std::size_t dataOffset = 0;
-        std::vector<unsigned char> volumeMaterialsGPUData(volumeMaterialsGPUSize);
+        if (!dirtyRange.empty()) {
+          std::size_t dataOffset = 0;
+          std::vector<unsigned char> volumeMaterialsGPUData((dirtyRange.end - dirtyRange.begin) * kVolumeMaterialGPUSize);
 
-        for (auto&& volumeMaterial : m_volumeMaterialCache.getObjectTable()) {
-          volumeMaterial.writeGPUData(volumeMaterialsGPUData.data(), dataOffset);
-        }
+          const auto& volumeMaterials = m_volumeMaterialCache.getObjectTable();
+          for (uint32_t i = dirtyRange.begin; i < dirtyRange.end; i++) {
+            volumeMaterials[i].writeGPUData(volumeMaterialsGPUData.data(), dataOffset);
+          }
 
-        assert(dataOffset == volumeMaterialsGPUSize);
-        assert(volumeMaterialsGPUData.size() == volumeMaterialsGPUSize);
+          assert(dataOffset == volumeMaterialsGPUData.size());
 
-        ctx->writeToBuffer(m_volumeMaterialBuffer, 0, volumeMaterialsGPUData.size(), volumeMaterialsGPUData.data());
+          ctx->writeToBuffer(m_volumeMaterialBuffer, dirtyRange.begin * kVolumeMaterialGPUSize, volumeMaterialsGPUData.size(), volumeMaterialsGPUData.data());
+        }
+
+        m_volumeMaterialCache.clearDirtyRange();
       }
     }
 
@@ -1468,6 +1481,12 @@ namespace dxvk {
     m_device->statCounters().setCtr(DxvkStatCounter::RtxLightCount, m_lightManager.getActiveCount());
     m_device->statCounters().setCtr(DxvkStatCounter::RtxSamplers, m_samplerCache.getActiveCount());
 
+    const InstanceManager::PoolStats& instancePoolStats = m_instanceManager.getPoolStats();
+    m_device->statCounters().setCtr(DxvkStatCounter::RtxInstancePoolCapacity, instancePoolStats.capacity);
+    m_device->statCounters().setCtr(DxvkStatCounter::RtxInstanceAllocations, instancePoolStats.frameAllocations);
+    m_device->statCounters().setCtr(DxvkStatCounter::RtxTransientInstances, instancePoolStats.frameTransientReleases);
+    m_device->statCounters().setCtr(DxvkStatCounter::RtxBlasPoolCapacity, m_drawCallCache.capacity());
+
     auto capturer = m_device->getCommon()->capturer();
     if (m_device->getCurrentFrameId() == m_beginUsdExportFrameNum) {
       capturer->triggerNewCapture();
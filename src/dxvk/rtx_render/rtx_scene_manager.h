@@ -281,7 +281,7 @@ private:
   std::chrono::time_point<std::chrono::steady_clock> m_startTime;
   uint32_t m_activePOMCount = 0;
   
-  float m_uniqueObjectSearchDistance = 1.f;
+  uint32_t m_frameOptionsListener = 0;
 
   struct DrawCallMetaInfo {
     XXH64_hash_t legacyTextureHash { kEmptyHash };
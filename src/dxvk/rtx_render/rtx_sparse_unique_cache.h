@@ -21,12 +21,43 @@
 */
 #pragma once
 
-#include <vector>
+#include <stdint.h>
+#include <algorithm>
+#include <functional>
 #include <queue>
-#include <unordered_map>
+#include <vector>
+
+#include "../../util/util_slot_map.h"
 
 namespace dxvk 
 {
+/*
+*  Half-open range of cache slots [begin, end).
+*/
+struct SlotRange {
+  uint32_t begin = 0;
+  uint32_t end = 0;
+
+  bool empty() const { return begin >= end; }
+
+  void merge(uint32_t slot) {
+    merge(SlotRange { slot, slot + 1 });
+  }
+
+  void merge(const SlotRange& other) {
+    if (other.empty()) {
+      return;
+    }
+
+    if (empty()) {
+      *this = other;
+    } else {
+      begin = std::min(begin, other.begin);
+      end = std::max(end, other.end);
+    }
+  }
+};
+
 /*
 *  Sparse Unique (Object) Cache
 * 
@@ -50,6 +81,14 @@ namespace dxvk
 *  This structure is particularly useful for tracking GPU objects, where persistent
 *  indices for large, dynamic arrays are required.  e.g. bindless resources.
 * 
+*  Objects are looked up through an open addressed index of their hashes, the
+*  hash of each live object is computed once and kept alongside its slot, so
+*  neither lookups nor removals copy or rehash the objects themselves. Every
+*  slot carries a generation which is bumped when its object is freed.
+* 
+*  The range of slots modified since the last clearDirtyRange() call is tracked
+*  so that GPU copies of the object table only need to update the changed slots.
+* 
 *  NOTE: This object does no ref counting - its expected that the user supply T 
    as a ref-counted object if that behavior is desired.
 */
@@ -57,6 +96,10 @@ template<typename T, class HashFn, class KeyEqual = std::equal_to<T>>
 struct SparseUniqueCache
 {
 public:
+  struct Identity {
+    const T& operator()(const T& in) const { return in; }
+  };
+
   SparseUniqueCache(SparseUniqueCache const&) = delete;
   SparseUniqueCache& operator=(SparseUniqueCache const&) = delete;
 
@@ -64,59 +107,114 @@ public:
   ~SparseUniqueCache() {}
 
   void clear() {
-    m_freeBuffers = {};
+    m_freeSlots = {};
     m_objects.clear();
-    m_bufferMap.clear();
+    m_slots.clear();
+    m_index.clear();
+    m_dirtyRange = {};
   }
 
-  uint32_t track(const T& obj, std::function<T(const T&)> onFirstCache = [](const T& in) { return in; }) {
+  // onFirstCache is invoked with the object when it is not in the cache yet and
+  // returns the object to store, it must be equal to the object passed in.
+  template<typename OnFirstCache = Identity>
+  uint32_t track(const T& obj, OnFirstCache&& onFirstCache = Identity()) {
+    const uint64_t hash = hashObject(obj);
+
     uint32_t idx;
-    if (!find(obj, idx)) {
+    if (!find(obj, hash, idx)) {
       const T& objectToCache = onFirstCache(obj);
-      if (!m_freeBuffers.empty()) {
-        idx = m_freeBuffers.front();
-        m_freeBuffers.pop();
-        m_objects.at(idx) = objectToCache;
+      if (!m_freeSlots.empty()) {
+        idx = m_freeSlots.front();
+        m_freeSlots.pop();
+        m_objects[idx] = objectToCache;
       } else {
         idx = m_objects.size();
         m_objects.push_back(objectToCache);
+        m_slots.push_back({ 0, 0 });
       }
-      m_bufferMap.insert({ objectToCache, idx });
+      m_slots[idx].hash = hash;
+      m_index.insert(hash, idx);
+      m_dirtyRange.merge(idx);
     }
     return idx;
   }
 
   bool find(const T& buf, uint32_t& outIdx) const {
-    const auto& vtxBuffer = m_bufferMap.find(buf);
-    if (vtxBuffer != m_bufferMap.end()) {
-      outIdx = vtxBuffer->second;
-      return true;
-    }
-    return false;
+    return find(buf, hashObject(buf), outIdx);
   }
 
   void free(const T& buf) {
-    auto iter = m_bufferMap.find(buf);
-    if (iter != m_bufferMap.end()) {
-      m_objects.at(iter->second) = T();
-      m_freeBuffers.push(iter->second);
-      m_bufferMap.erase(iter);
+    const uint64_t hash = hashObject(buf);
+
+    uint32_t idx;
+    if (find(buf, hash, idx)) {
+      m_index.erase(hash, idx);
+      m_objects[idx] = T();
+      m_slots[idx].generation++;
+      m_freeSlots.push(idx);
+      m_dirtyRange.merge(idx);
     }
   }
 
-  uint32_t getActiveCount() const { return m_objects.size() - m_freeBuffers.size(); }
+  uint32_t getActiveCount() const { return m_objects.size() - m_freeSlots.size(); }
   uint32_t getTotalCount() const { return m_objects.size(); }
 
-  T& at(const uint32_t i) { return m_objects[i]; }
-  
+  // Number of times the object in the slot has been freed, allows users
+  // holding on to an index to detect that the slot has been reused.
+  uint32_t getGeneration(const uint32_t i) const { return m_slots[i].generation; }
+
+  // Note: the object returned must stay equal to the one tracked, changes
+  // to it are assumed to require an update of its GPU copy.
+  T& at(const uint32_t i) {
+    m_dirtyRange.merge(i);
+    return m_objects[i];
+  }
+
+  const T& at(const uint32_t i) const { return m_objects[i]; }
+
   const std::vector<T>& getObjectTable() const { return m_objects; }
-  std::vector<T>& getObjectTable() { return m_objects; }
+
+  // Range of slots changed since the dirty range was last cleared, may
+  // extend past the table when objects were freed.
+  const SlotRange& getDirtyRange() const { return m_dirtyRange; }
+  void clearDirtyRange() { m_dirtyRange = {}; }
 
 private:
-  std::queue<uint32_t> m_freeBuffers;
+  struct Slot {
+    uint64_t hash;
+    uint32_t generation;
+  };
+
+  std::queue<uint32_t> m_freeSlots;
   std::vector<T> m_objects;
-  std::unordered_map<T, uint32_t, HashFn, KeyEqual> m_bufferMap;
+  std::vector<Slot> m_slots;
+  SlotHashIndex m_index;
+  SlotRange m_dirtyRange;
+
+  static uint64_t hashObject(const T& obj) {
+    // Some hash functions return plain keys (e.g. texture ids), scramble them
+    // so that consecutive keys do not form long probe runs in the index.
+    uint64_t h = static_cast<uint64_t>(HashFn()(obj));
+    h ^= h >> 33;
+    h *= 0xff51afd7ed558ccdull;
+    h ^= h >> 33;
+    h *= 0xc4ceb9fe1a85ec53ull;
+    h ^= h >> 33;
+    return h;
+  }
+
+  bool find(const T& buf, const uint64_t hash, uint32_t& outIdx) const {
+    bool found = false;
+    m_index.find(hash, [&](uint32_t idx) {
+      if (!KeyEqual()(m_objects[idx], buf)) {
+        return true;
+      }
+      outIdx = idx;
+      found = true;
+      return false;
+    });
+    return found;
+  }
 };
 
 }  // namespace dxvk
-
@@ -287,9 +287,7 @@ namespace dxvk {
     return texture;
   }
 
-  void TextureUtils::loadTexture(Rc<ManagedTexture> texture, const Rc<DxvkContext>& ctx, const bool isPreloading, int minimumMipLevel) {
-    ScopedCpuProfileZone();
-
+  int TextureUtils::calcBaseLevel(const Rc<ManagedTexture>& texture, const bool isPreloading, int minimumMipLevel) {
     if (!isPreloading) {
       // Apply config overrides if we're not preloading
       if (RtxOptions::Get()->forceHighResolutionReplacementTextures()) {
@@ -301,8 +299,14 @@ namespace dxvk {
       }
     }
 
+    return std::min(minimumMipLevel, texture->mipCount - 1);
+  }
+
+  void TextureUtils::loadTexture(Rc<ManagedTexture> texture, const Rc<DxvkContext>& ctx, const bool isPreloading, int minimumMipLevel) {
+    ScopedCpuProfileZone();
+
     // Adjust the asset data view if necessary
-    const int baseLevel = std::min(minimumMipLevel, texture->mipCount - 1);
+    const int baseLevel = calcBaseLevel(texture, isPreloading, minimumMipLevel);
     texture->assetData->setMinLevel(baseLevel);
 
     if (isPreloading) {
@@ -262,6 +262,15 @@ namespace dxvk {
     static Rc<ManagedTexture> createTexture(const Rc<AssetData>& assetData, ColorSpace colorSpace);
 
     static void loadTexture(Rc<ManagedTexture> texture, const Rc<DxvkContext>& ctx, const bool isPreloading, int minimumMipLevel);
+
+    /**
+      * \brief Calculates the base level of the asset data loaded by loadTexture().
+      * \param [in] texture The texture to be loaded.
+      * \param [in] isPreloading Whether the texture is being preloaded, preloads ignore the resolution overrides.
+      * \param [in] minimumMipLevel The requested base level.
+      * \return The base level in the source asset.
+      */
+    static int calcBaseLevel(const Rc<ManagedTexture>& texture, const bool isPreloading, int minimumMipLevel);
   };
 
 } // namespace dxvk
@@ -23,6 +23,7 @@
 #include "rtx_texture_manager.h"
 #include "../../util/thread.h"
 #include "../../util/rc/util_rc_ptr.h"
+#include "../../util/util_bit.h"
 #include "dxvk_context.h"
 #include "dxvk_scoped_annotation.h"
 #include <chrono>
@@ -73,6 +74,11 @@ namespace dxvk {
   void RtxTextureManager::initialize(const Rc<DxvkContext>& ctx) {
     // Kick off upload thread
     RenderProcessor::start();
+
+    // Kick off read threads, RTX IO does its own reads
+    if (!RtxIo::enabled() && numIoThreads() > 0) {
+      m_ioScheduler = std::make_unique<AssetIoScheduler>("rtx-texture-io", numIoThreads());
+    }
   }
 
   static ManagedTexture::State processManagedTextureState(const TextureRef& texture) {
@@ -120,7 +126,7 @@ namespace dxvk {
     if (managedTexture == nullptr)
       return;
 
-    if (m_itemsPending == 0) {
+    if (numTexturesInFlight() == 0) {
       // We're about to start a batch
       m_batchStartTime = dxvk::high_resolution_clock::now();
     }
@@ -148,16 +154,48 @@ namespace dxvk {
 
     if (!allowAsync) {
       loadTexture(managedTexture, immediateContext);
+    } else if (m_ioScheduler) {
+      scheduleTextureRead(managedTexture);
     } else {
       RenderProcessor::add(std::move(managedTexture));
     }
   }
 
+  void RtxTextureManager::scheduleTextureRead(const Rc<ManagedTexture>& texture) {
+    // Read the levels loadTexture() is going to upload. The estimate may be off if the budget changes
+    // in the meantime, the upload thread then reads the missing levels on its own.
+    const int baseLevel = TextureUtils::calcBaseLevel(texture, false, calcLargestMipToLoad());
+    const bool isPreloaded = texture->minPreloadedMip >= 0 && texture->minPreloadedMip <= baseLevel;
+
+    AssetIoScheduler::Request request;
+    request.asset = texture->assetData->sourceAsset();
+    request.firstLevel = baseLevel;
+    request.numLevels = isPreloaded ? 0 : texture->mipCount - baseLevel;
+
+    // Smaller reads go first so that more textures reach their final resolution sooner,
+    // the scheduler ages the requests so the larger reads are not postponed indefinitely.
+    const VkExtent3D& extent = texture->assetData->sourceAsset()->info().extent;
+    const uint32_t numTexels = std::max(1u, (extent.width >> baseLevel) * (extent.height >> baseLevel));
+    request.priority = 32 - bit::lzcnt(numTexels);
+
+    // Hand the texture over to the upload thread once its data is in memory
+    request.onComplete = [this, texture] {
+      RenderProcessor::add(Rc<ManagedTexture>(texture));
+    };
+
+    m_ioScheduler->submit(std::move(request));
+  }
+
   void RtxTextureManager::synchronize(bool dropRequests) {
     ScopedCpuProfileZone();
     
     m_dropRequests = dropRequests;
 
+    // Wait for the reads first, completed reads are queued for upload
+    if (m_ioScheduler) {
+      m_ioScheduler->sync(dropRequests);
+    }
+
     RenderProcessor::sync();
 
     m_dropRequests = false;
@@ -166,7 +204,7 @@ namespace dxvk {
   }
 
   void RtxTextureManager::kickoff() {
-    if (m_itemsPending == 0) {
+    if (numTexturesInFlight() == 0) {
       m_kickoff = true;
       m_condOnAdd.notify_one();
     } else if (m_preloadInflight) {
@@ -176,7 +214,7 @@ namespace dxvk {
       m_preloadInflight = false;
     }
 
-    m_pDevice->statCounters().setCtr(DxvkStatCounter::RtxTexturesInFlight, m_itemsPending.load());
+    m_pDevice->statCounters().setCtr(DxvkStatCounter::RtxTexturesInFlight, numTexturesInFlight());
   }
 
   void RtxTextureManager::finalizeAllPendingTexturePromotions() {
@@ -294,16 +332,7 @@ namespace dxvk {
     }
 
     try {
-      uint32_t largestMipToLoad = 0;
-
-      const uint32_t kPercentageOfBudgetConsideredSpilling = 75;
-      const VkDeviceSize spillMib = overBudgetMib(kPercentageOfBudgetConsideredSpilling);
-
-      // If we're over budget, aggressively limit the texture resolution for new textures, every 512Mib we go over budget
-      if (spillMib) {
-        const uint32_t kReduceMipsEveryMib = 512;
-        largestMipToLoad += spillMib / kReduceMipsEveryMib;
-      }
+      const uint32_t largestMipToLoad = calcLargestMipToLoad();
 
       TextureUtils::loadTexture(texture, ctx, false, largestMipToLoad);
 
@@ -322,6 +351,31 @@ namespace dxvk {
     }
   }
 
+  uint32_t RtxTextureManager::calcLargestMipToLoad() const {
+    // The budget is not known until the first texture load
+    if (m_textureBudgetMib == 0) {
+      return 0;
+    }
+
+    uint32_t largestMipToLoad = 0;
+
+    const uint32_t kPercentageOfBudgetConsideredSpilling = 75;
+    const VkDeviceSize spillMib = overBudgetMib(kPercentageOfBudgetConsideredSpilling);
+
+    // If we're over budget, aggressively limit the texture resolution for new textures, every 512Mib we go over budget
+    if (spillMib) {
+      const uint32_t kReduceMipsEveryMib = 512;
+      largestMipToLoad += spillMib / kReduceMipsEveryMib;
+    }
+
+    return largestMipToLoad;
+  }
+
+  uint32_t RtxTextureManager::numTexturesInFlight() const {
+    // Textures are either waiting for their data to be read or for the upload
+    return m_itemsPending + (m_ioScheduler ? m_ioScheduler->pending() : 0);
+  }
+
   VkDeviceSize RtxTextureManager::overBudgetMib(VkDeviceSize percentageOfBudget) const {
     // Get the current memory usage for material textures
     VkDeviceSize currentUsageMib = 0;
@@ -475,7 +529,7 @@ namespace dxvk {
 
       constexpr auto zeroTimePoint = dxvk::high_resolution_clock::time_point(dxvk::high_resolution_clock::duration(0));
 
-      if (m_itemsPending == 0 && m_batchStartTime != zeroTimePoint) {
+      if (numTexturesInFlight() == 0 && m_batchStartTime != zeroTimePoint) {
         m_lastBatchDuration = dxvk::high_resolution_clock::now() - m_batchStartTime;
         m_batchStartTime = zeroTimePoint;
 
@@ -29,6 +29,7 @@
 #include "../../util/sync/sync_signal.h"
 #include "rtx_texture.h"
 #include "rtx_sparse_unique_cache.h"
+#include "rtx_asset_io_scheduler.h"
 
 namespace dxvk {
   class DxvkContext;
@@ -158,18 +159,25 @@ namespace dxvk {
     dxvk::high_resolution_clock::time_point m_batchStartTime { dxvk::high_resolution_clock::duration(0) };
     dxvk::high_resolution_clock::duration m_lastBatchDuration { dxvk::high_resolution_clock::duration(0) };
 
-    VkDeviceSize m_textureBudgetMib = 0;
+    // Note: the budget is read when scheduling texture reads on the calling thread
+    std::atomic<VkDeviceSize> m_textureBudgetMib = 0;
     uint32_t m_promotionStartFrame = 0;
     bool m_preloadInflight = false;
 
     fast_unordered_cache<Rc<ManagedTexture>> m_assetHashToTextures;
 
+    std::unique_ptr<AssetIoScheduler> m_ioScheduler;
+
     RTX_OPTION("rtx.texturemanager", uint32_t, budgetPercentageOfAvailableVram, 50, "The percentage of available VRAM we should use for material textures.  If material textures are required beyond this budget, then those textures will be loaded at lower quality.  Important note, it's impossible to perfectly match the budget while maintaining reasonable quality levels, so use this as more of a guideline.  If the replacements assets are simply too large for the target GPUs available vid mem, we may end up going overbudget regularly.  Defaults to 50% of the available VRAM.");
     RTX_OPTION("rtx.texturemanager", bool, showProgress, false, "Show texture loading progress in the HUD.");
+    RTX_OPTION("rtx.texturemanager", uint32_t, numIoThreads, 2, "The number of threads reading replacement texture data from disk ahead of the texture upload. Reads are prioritized by size, and ordered by file and offset within the same priority. 0 reads the texture data on the texture upload thread. Not used with RTX IO.");
 
     bool isTextureSuboptimal(const Rc<ManagedTexture>& texture) const;
     void scheduleTextureLoad(TextureRef& texture, Rc<DxvkContext>& immediateContext, bool allowAsync);
+    void scheduleTextureRead(const Rc<ManagedTexture>& texture);
     void loadTexture(const Rc<ManagedTexture>& texture, Rc<DxvkContext>& ctx);
+    uint32_t calcLargestMipToLoad() const;
+    uint32_t numTexturesInFlight() const;
 
     VkDeviceSize overBudgetMib(VkDeviceSize percentageOfBudget = 100) const;
   };
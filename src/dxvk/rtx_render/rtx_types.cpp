@@ -49,45 +49,43 @@ namespace dxvk {
   bool DrawCallState::finalizePendingFutures(const RtCamera* pLastCamera) {
     ScopedCpuProfileZone();
     // Geometry hashes are vital, and cannot be disabled, so its important we get valid data (hence the return type)
-    const bool valid = finalizeGeometryHashes();
-    if (valid) {
-      // Bounding boxes (if enabled) will be finalized here, default is FLT_MAX bounds
-      finalizeGeometryBoundingBox();
+    if (!geometryData.futureAnalysis.valid()) {
+      return false;
+    }
 
-      // Skinning processing will be finalized here, if object requires skinning
-      finalizeSkinningData(pLastCamera);
+    // Hashes, bounding box and skinning data all come from a single analysis of the geometry
+    GeometryAnalysis analysis = geometryData.futureAnalysis.get();
 
-      // Update any categories that require geometry hash
-      setupCategoriesForGeometry();
+    finalizeGeometryHashes(analysis);
 
-      return true;
-    }
+    // Bounding boxes (if enabled) will be finalized here, default is FLT_MAX bounds
+    finalizeGeometryBoundingBox(analysis);
 
-    return false;
-  }
+    // Skinning processing will be finalized here, if object requires skinning
+    finalizeSkinningData(analysis, pLastCamera);
 
-  bool DrawCallState::finalizeGeometryHashes() {
-    if (!geometryData.futureGeometryHashes.valid()) {
-      return false;
-    }
+    // Update any categories that require geometry hash
+    setupCategoriesForGeometry();
 
-    geometryData.hashes = geometryData.futureGeometryHashes.get();
+    return true;
+  }
+
+  void DrawCallState::finalizeGeometryHashes(const GeometryAnalysis& analysis) {
+    geometryData.hashes = analysis.hashes;
 
     if (geometryData.hashes[HashComponents::VertexPosition] == kEmptyHash) {
       throw DxvkError("Position hash should never be empty");
     }
-
-    return true;
   }
 
-  void DrawCallState::finalizeGeometryBoundingBox() {
-    if (geometryData.futureBoundingBox.valid())
-      geometryData.boundingBox = geometryData.futureBoundingBox.get();
+  void DrawCallState::finalizeGeometryBoundingBox(const GeometryAnalysis& analysis) {
+    geometryData.boundingBox = analysis.boundingBox;
   }
 
-  void DrawCallState::finalizeSkinningData(const RtCamera* pLastCamera) {
-    if (futureSkinningData.valid()) {
-      skinningData = futureSkinningData.get();
+  void DrawCallState::finalizeSkinningData(GeometryAnalysis& analysis, const RtCamera* pLastCamera) {
+    if (hasPendingSkinningData) {
+      skinningData = std::move(analysis.skinningData);
+      hasPendingSkinningData = false;
 
       assert(geometryData.blendWeightBuffer.defined());
       assert(skinningData.numBonesPerVertex <= 4);
@@ -334,7 +332,7 @@ namespace dxvk {
   void DrawCallState::setupCategoriesForHeuristics(uint32_t prevFrameSeenCamerasCount,
                                                    std::vector<Vector3>& seenCameraPositions) {
     setCategory(InstanceCategories::Sky, shouldBakeSky(*this,
-                                                       futureSkinningData.valid(),
+                                                       hasPendingSkinningData,
                                                        prevFrameSeenCamerasCount,
                                                        seenCameraPositions));
     setCategory(InstanceCategories::Terrain, shouldBakeTerrain(*this));
@@ -362,11 +360,9 @@ namespace dxvk {
   void BlasEntry::rebuildSpatialMap() {
     InstanceMap newMap(RtxOptions::uniqueObjectDistance() * 2.f);
     
-    for (const auto& iter : m_spatialMap.getAll()){
-      for (const RtInstance* instance : iter.second) {
-        newMap.insert(instance->getSpatialCachePosition(), instance);
-      }
-    }
+    m_spatialMap.forEach([&newMap](const RtInstance* instance, const Vector3& position) {
+      newMap.insert(position, instance);
+    });
     m_spatialMap = std::move(newMap);
   }
 
@@ -151,12 +151,39 @@ struct AxisAlignedBoundingBox {
   }
 };
 
+// Everything derived from the vertex data of a draw call, produced by a single pass over the data.
+// Note: Returned through a Future, so it must stay within kResultStorageCapacity.
+struct GeometryAnalysis {
+  GeometryHashes hashes;
+  AxisAlignedBoundingBox boundingBox;
+  SkinningData skinningData;
+};
+
+// Pending analysis of a draw call's geometry.  Futures are move-only, but geometry is copied freely
+// (e.g. into replacements), so a copy never takes the pending analysis along.  Only the draw call
+// the analysis was scheduled for consumes it, moving through the draw call queue on the way.
+struct PendingGeometryAnalysis : Future<GeometryAnalysis> {
+  PendingGeometryAnalysis() = default;
+  PendingGeometryAnalysis(Future<GeometryAnalysis>&& future)
+  : Future<GeometryAnalysis>(std::move(future)) { }
+
+  PendingGeometryAnalysis(const PendingGeometryAnalysis&)
+  : Future<GeometryAnalysis>() { }
+  PendingGeometryAnalysis(PendingGeometryAnalysis&&) = default;
+
+  PendingGeometryAnalysis& operator=(const PendingGeometryAnalysis&) {
+    Future<GeometryAnalysis>::operator=(Future<GeometryAnalysis>());
+    return *this;
+  }
+  PendingGeometryAnalysis& operator=(PendingGeometryAnalysis&&) = default;
+};
+
 // Stores a snapshot of the geometry state for a draw call.
 // WARNING: Usage is undefined after the drawcall this was 
 //          generated from has finished executing on the GPU
 struct RasterGeometry {
   GeometryHashes hashes;
-  Future<GeometryHashes> futureGeometryHashes;
+  PendingGeometryAnalysis futureAnalysis;
 
   // Actual vertex/index count (when applicable) as calculated by geo-engine
   uint32_t vertexCount = 0;
@@ -183,7 +210,6 @@ struct RasterGeometry {
   RasterBuffer blendIndicesBuffer;
 
   AxisAlignedBoundingBox boundingBox;
-  Future<AxisAlignedBoundingBox> futureBoundingBox;
 
   remixapi_MaterialHandle externalMaterial = nullptr;
 
@@ -438,7 +464,9 @@ using CategoryFlags = Flags<InstanceCategories>;
 struct DrawCallState {
   DrawCallState() = default;
   DrawCallState(const DrawCallState& _input) = default;
+  DrawCallState(DrawCallState&& _input) = default;
   DrawCallState& operator=(const DrawCallState& drawCallState) = default;
+  DrawCallState& operator=(DrawCallState&& drawCallState) = default;
 
   // Note: This uses the original material for the hash, not the replaced material
   const XXH64_hash_t getHash(const HashRule& rule) const {
@@ -519,9 +547,9 @@ private:
   friend class TerrainBaker;
   friend struct RemixAPIPrivateAccessor;
 
-  bool finalizeGeometryHashes();
-  void finalizeGeometryBoundingBox();
-  void finalizeSkinningData(const RtCamera* pLastCamera);
+  void finalizeGeometryHashes(const GeometryAnalysis& analysis);
+  void finalizeGeometryBoundingBox(const GeometryAnalysis& analysis);
+  void finalizeSkinningData(GeometryAnalysis& analysis, const RtCamera* pLastCamera);
 
   void setCategory(InstanceCategories category, bool set);
 
@@ -535,7 +563,8 @@ private:
 
   // Note: Set these pointers to nullptr when not used
   SkinningData skinningData;
-  Future<SkinningData> futureSkinningData;
+  // Set when skinningData is pending on the geometry analysis
+  bool hasPendingSkinningData = false;
 
   FogState fogState;
 
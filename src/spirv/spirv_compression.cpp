@@ -107,4 +107,46 @@ namespace dxvk {
     return code;
   }
 
-}
\ No newline at end of file
+  // NV-DXVK start: persistent shader cache
+  void SpirvCompressedBuffer::write(BlobWriter& writer) const {
+    writer.write(m_size);
+    writer.writeArray(m_mask);
+    writer.writeArray(m_code);
+  }
+
+
+  bool SpirvCompressedBuffer::read(BlobReader& reader) {
+    uint32_t size = 0;
+    std::vector<uint64_t> mask;
+    std::vector<uint64_t> code;
+
+    if (!reader.read(size) || !reader.readArray(mask) || !reader.readArray(code))
+      return false;
+
+    // decompress trusts the masks to match the packed words, so make sure
+    // they do before the buffer can be decompressed
+    if (mask.size() != (size + NumMaskWords - 1) / NumMaskWords)
+      return false;
+
+    uint64_t bits = 0;
+
+    for (uint32_t i = 0; i < size; i += NumMaskWords) {
+      uint64_t srcMask = mask[i / NumMaskWords];
+
+      for (uint32_t w = 0; w < NumMaskWords && i + w < size; w++) {
+        bits += 8 * ((srcMask & 3) + 1);
+        srcMask >>= 2;
+      }
+    }
+
+    if (code.size() != (bits + 63) / 64)
+      return false;
+
+    m_size = size;
+    m_mask = std::move(mask);
+    m_code = std::move(code);
+    return true;
+  }
+  // NV-DXVK end
+
+}
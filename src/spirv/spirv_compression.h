@@ -25,6 +25,10 @@
 
 #include "spirv_code_buffer.h"
 
+// NV-DXVK start: persistent shader cache
+#include "../util/util_blob_archive.h"
+// NV-DXVK end
+
 namespace dxvk {
 
   /**
@@ -50,6 +54,23 @@ namespace dxvk {
       return m_code;
     }
 
+    // NV-DXVK start: persistent shader cache
+    /**
+     * \brief Writes the compressed code to a blob
+     * \param [in] writer Blob writer
+     */
+    void write(BlobWriter& writer) const;
+
+    /**
+     * \brief Reads compressed code written by \c write
+     *
+     * \param [in] reader Blob reader
+     * \returns \c false if the data is malformed, in
+     *   which case the buffer is left unchanged
+     */
+    bool read(BlobReader& reader);
+    // NV-DXVK end
+
   private:
 
     uint32_t              m_size;
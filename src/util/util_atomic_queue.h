@@ -21,8 +21,11 @@
 */
 #pragma once
 
+#include <array>
 #include <atomic>
+#include <cstdint>
 #include <cstring>
+#include <type_traits>
 #include <utility>
 
 namespace dxvk {
@@ -75,4 +78,167 @@ namespace dxvk {
     std::atomic<uint32_t> m_head;
     std::atomic<uint32_t> m_tail;
   };
+
+  // Rounds a queue capacity up to the closest power-of-two, so ring indices can use a mask as modulo
+  constexpr uint32_t atomicQueueCapacity(uint32_t capacity) {
+    uint32_t pow2 = 1;
+    while (pow2 < capacity) {
+      pow2 <<= 1;
+    }
+    return pow2;
+  }
+
+  /**
+    * \brief Implements a bounded (MPMC) queue as a ring buffer of
+    *        sequenced cells.  Any number of threads may "push" and
+    *        "pop" simultaneously, no locks are taken.
+    *  T: Type of the object
+    *  Capacity: Minimum number of elements in the ring buffer,
+    *            rounded up to a power-of-two.
+    */
+  template <typename T, uint32_t Capacity>
+  class AtomicMpmcQueue {
+    static constexpr uint32_t kCapacity = atomicQueueCapacity(Capacity);
+    static constexpr uint32_t kMask = kCapacity - 1;
+
+  public:
+    AtomicMpmcQueue() {
+      for (uint32_t i = 0; i < kCapacity; i++) {
+        m_cells[i].sequence.store(i, std::memory_order_relaxed);
+      }
+      m_head = m_tail = 0;
+    }
+
+    bool push(T&& item) {
+      Cell* cell;
+      uint32_t tail = m_tail.load(std::memory_order_relaxed);
+      while (true) {
+        cell = &m_cells[tail & kMask];
+        const uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const int32_t diff = (int32_t) (sequence - tail);
+        if (diff == 0) {
+          if (m_tail.compare_exchange_weak(tail, tail + 1, std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          return false;  // queue is full
+        } else {
+          tail = m_tail.load(std::memory_order_relaxed);
+        }
+      }
+      cell->data = std::move(item);
+      cell->sequence.store(tail + 1, std::memory_order_release);
+      return true;
+    }
+
+    bool pop(T& item) {
+      Cell* cell;
+      uint32_t head = m_head.load(std::memory_order_relaxed);
+      while (true) {
+        cell = &m_cells[head & kMask];
+        const uint32_t sequence = cell->sequence.load(std::memory_order_acquire);
+        const int32_t diff = (int32_t) (sequence - (head + 1));
+        if (diff == 0) {
+          if (m_head.compare_exchange_weak(head, head + 1, std::memory_order_relaxed)) {
+            break;
+          }
+        } else if (diff < 0) {
+          return false;  // queue is empty
+        } else {
+          head = m_head.load(std::memory_order_relaxed);
+        }
+      }
+      item = std::move(cell->data);
+      cell->sequence.store(head + kCapacity, std::memory_order_release);
+      return true;
+    }
+
+  private:
+    struct Cell {
+      std::atomic<uint32_t> sequence;
+      T data;
+    };
+
+    std::array<Cell, kCapacity> m_cells;
+    alignas(64) std::atomic<uint32_t> m_head;
+    alignas(64) std::atomic<uint32_t> m_tail;
+  };
+
+  /**
+    * \brief Implements a bounded Chase-Lev work stealing deque.
+    *        Only the owning thread may "push" and "pop" (LIFO end),
+    *        while any other thread may "steal" (FIFO end).
+    *  T: Type of the object, must be trivially copyable
+    *  Capacity: Minimum number of elements in the ring buffer,
+    *            rounded up to a power-of-two.
+    */
+  template <typename T, uint32_t Capacity>
+  class AtomicWorkStealingDeque {
+    static_assert(std::is_trivially_copyable_v<T>, "Work stealing deque elements are read speculatively, and must be trivially copyable!");
+    static constexpr uint32_t kCapacity = atomicQueueCapacity(Capacity);
+    static constexpr uint32_t kMask = kCapacity - 1;
+
+  public:
+    AtomicWorkStealingDeque() {
+      m_top = m_bottom = 0;
+    }
+
+    // Owner only
+    bool push(const T& item) {
+      const int64_t bottom = m_bottom.load(std::memory_order_relaxed);
+      const int64_t top = m_top.load(std::memory_order_acquire);
+      if (bottom - top >= (int64_t) kCapacity) {
+        return false;  // deque is full
+      }
+      m_data[bottom & kMask].store(item, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_release);
+      m_bottom.store(bottom + 1, std::memory_order_relaxed);
+      return true;
+    }
+
+    // Owner only
+    bool pop(T& item) {
+      const int64_t bottom = m_bottom.load(std::memory_order_relaxed) - 1;
+      m_bottom.store(bottom, std::memory_order_relaxed);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      int64_t top = m_top.load(std::memory_order_relaxed);
+
+      if (top > bottom) {
+        // deque is empty
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return false;
+      }
+
+      item = m_data[bottom & kMask].load(std::memory_order_relaxed);
+      if (top == bottom) {
+        // Last element, race against the thieves for it
+        const bool won = m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+        m_bottom.store(bottom + 1, std::memory_order_relaxed);
+        return won;
+      }
+      return true;
+    }
+
+    // Any thread
+    bool steal(T& item) {
+      int64_t top = m_top.load(std::memory_order_acquire);
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      const int64_t bottom = m_bottom.load(std::memory_order_acquire);
+      if (top >= bottom) {
+        return false;  // deque is empty
+      }
+
+      item = m_data[top & kMask].load(std::memory_order_relaxed);
+      return m_top.compare_exchange_strong(top, top + 1, std::memory_order_seq_cst, std::memory_order_relaxed);
+    }
+
+    bool empty() const {
+      return m_top.load(std::memory_order_relaxed) >= m_bottom.load(std::memory_order_relaxed);
+    }
+
+  private:
+    std::array<std::atomic<T>, kCapacity> m_data;
+    alignas(64) std::atomic<int64_t> m_top;
+    alignas(64) std::atomic<int64_t> m_bottom;
+  };
 } //dxvk
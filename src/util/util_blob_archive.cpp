@@ -0,0 +1,318 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "util_blob_archive.h"
+
+#include <algorithm>
+#include <cstdio>
+#include <fstream>
+
+#include "log/log.h"
+#include "util_string.h"
+#include "xxHash/xxhash.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#endif
+
+namespace dxvk {
+
+  namespace {
+    constexpr char ArchiveMagic[8] = { 'D', 'X', 'V', 'K', 'B', 'L', 'O', 'B' };
+
+    Sha1Digest toDigest(const Sha1Hash& hash) {
+      Sha1Digest digest;
+
+      for (uint32_t i = 0; i < 5; i++) {
+        const uint32_t dword = hash.dword(i);
+        std::memcpy(&digest[4 * i], &dword, sizeof(dword));
+      }
+
+      return digest;
+    }
+  }
+
+  BlobArchive::BlobArchive(std::string filename, uint32_t contentVersion)
+  : m_filename(std::move(filename)), m_contentVersion(contentVersion) { }
+
+
+  BlobArchive::~BlobArchive() { }
+
+
+  bool BlobArchive::lookup(const Sha1Hash& key, std::vector<uint8_t>& data) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_opened) {
+      open();
+    }
+
+    auto pending = m_pending.find(key);
+
+    if (pending != m_pending.end()) {
+      data = pending->second;
+      m_stats.hits += 1;
+      return true;
+    }
+
+    auto record = m_records.find(key);
+
+    if (record == m_records.end()) {
+      m_stats.misses += 1;
+      return false;
+    }
+
+    // Headers were bounds checked when the file was opened
+    RecordHeader header;
+    std::memcpy(&header, m_file.view(record->second, sizeof(header)), sizeof(header));
+
+    const void* payload = m_file.view(record->second + sizeof(header), header.size);
+
+    if (computeChecksum(key, payload, header.size) != header.checksum) {
+      Logger::warn(str::format("BlobArchive: Dropping corrupt record ", key.toString(), " in ", m_filename));
+      m_records.erase(record);
+      m_dirty = true;
+      m_stats.corrupt += 1;
+      m_stats.misses += 1;
+      return false;
+    }
+
+    const uint8_t* bytes = reinterpret_cast<const uint8_t*>(payload);
+    data.assign(bytes, bytes + header.size);
+    m_stats.hits += 1;
+    return true;
+  }
+
+
+  void BlobArchive::store(const Sha1Hash& key, std::vector<uint8_t> data) {
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    if (!m_opened) {
+      open();
+    }
+
+    if (m_records.find(key) != m_records.end()) {
+      return;
+    }
+
+    if (m_pending.emplace(key, std::move(data)).second) {
+      m_stats.stored += 1;
+    }
+  }
+
+
+  bool BlobArchive::flush() {
+    std::lock_guard<std::mutex> flushLock(m_flushMutex);
+
+    // Writing the file only reads the mapping and blobs that are not
+    // modified until the file is replaced, so the lock is only held to
+    // take stock and to swap files. Lookups and stores go on meanwhile.
+    std::vector<uint64_t> offsets;
+    std::vector<PendingBlob> pending;
+
+    { std::lock_guard<std::mutex> lock(m_mutex);
+
+      if (!m_opened) {
+        open();
+      }
+
+      if (m_pending.empty() && !m_dirty) {
+        return true;
+      }
+
+      offsets.reserve(m_records.size());
+
+      for (const auto& record : m_records) {
+        offsets.push_back(record.second);
+      }
+
+      // Nodes of unordered maps stay put when other entries are added
+      pending.reserve(m_pending.size());
+
+      for (const auto& blob : m_pending) {
+        pending.push_back({ &blob.first, &blob.second });
+      }
+
+      m_dirty = false;
+    }
+
+    const std::string tmpFilename = m_filename + ".tmp";
+
+    if (!writeFile(tmpFilename, offsets, pending)) {
+      Logger::warn(str::format("BlobArchive: Failed to write ", tmpFilename));
+      std::remove(tmpFilename.c_str());
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_dirty = true;
+      return false;
+    }
+
+    std::lock_guard<std::mutex> lock(m_mutex);
+
+    // Records are copied out of the mapping, so it can only be
+    // unmapped now that the new file is complete.
+    m_file.unmap();
+    m_records.clear();
+
+    if (!replaceFile(tmpFilename, m_filename)) {
+      Logger::warn(str::format("BlobArchive: Failed to replace ", m_filename));
+      std::remove(tmpFilename.c_str());
+
+      // The old file is still intact, the blobs stay pending
+      m_dirty = true;
+      open();
+      return false;
+    }
+
+    // Blobs stored while writing stay pending for the next flush
+    for (const PendingBlob& blob : pending) {
+      m_pending.erase(*blob.key);
+    }
+
+    open();
+    return true;
+  }
+
+
+  size_t BlobArchive::getPendingCount() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_pending.size();
+  }
+
+
+  BlobArchive::Stats BlobArchive::getStats() {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    return m_stats;
+  }
+
+
+  void BlobArchive::open() {
+    m_opened = true;
+
+    // A missing file is an empty archive
+    if (!m_file.map(m_filename)) {
+      return;
+    }
+
+    FileHeader fileHeader;
+    const void* fileHeaderData = m_file.view(0, sizeof(fileHeader));
+
+    if (fileHeaderData != nullptr) {
+      std::memcpy(&fileHeader, fileHeaderData, sizeof(fileHeader));
+    }
+
+    if (fileHeaderData == nullptr
+     || std::memcmp(fileHeader.magic, ArchiveMagic, sizeof(ArchiveMagic)) != 0
+     || fileHeader.formatVersion != FormatVersion
+     || fileHeader.contentVersion != m_contentVersion) {
+      Logger::info(str::format("BlobArchive: Discarding outdated ", m_filename));
+      m_file.unmap();
+      m_dirty = true;
+      return;
+    }
+
+    uint64_t offset = sizeof(fileHeader);
+
+    while (offset < m_file.size()) {
+      const void* headerData = m_file.view(offset, sizeof(RecordHeader));
+      RecordHeader header;
+
+      if (headerData != nullptr) {
+        std::memcpy(&header, headerData, sizeof(header));
+      }
+
+      // Anything past a truncated record, e.g. from a crash during a
+      // write, is lost. Records before it are still good.
+      if (headerData == nullptr || m_file.view(offset + sizeof(header), alignRecord(header.size)) == nullptr) {
+        Logger::warn(str::format("BlobArchive: Truncated record at ", offset, " in ", m_filename));
+        m_stats.corrupt += 1;
+        m_dirty = true;
+        break;
+      }
+
+      m_records.emplace(Sha1Hash(header.key), offset);
+      offset += sizeof(header) + alignRecord(header.size);
+    }
+  }
+
+
+  bool BlobArchive::writeFile(
+    const std::string&              filename,
+          std::vector<uint64_t>&    offsets,
+    const std::vector<PendingBlob>& pending) const {
+    std::ofstream file(filename, std::ios_base::binary | std::ios_base::trunc);
+
+    if (!file) {
+      return false;
+    }
+
+    FileHeader fileHeader;
+    std::memcpy(fileHeader.magic, ArchiveMagic, sizeof(ArchiveMagic));
+    fileHeader.formatVersion = FormatVersion;
+    fileHeader.contentVersion = m_contentVersion;
+    file.write(reinterpret_cast<const char*>(&fileHeader), sizeof(fileHeader));
+
+    // Copy existing records verbatim, in file order. Unless they were looked
+    // up, their checksums have not been verified, which the next session does.
+    std::sort(offsets.begin(), offsets.end());
+
+    for (const uint64_t offset : offsets) {
+      RecordHeader header;
+      std::memcpy(&header, m_file.view(offset, sizeof(header)), sizeof(header));
+
+      const size_t recordSize = sizeof(header) + alignRecord(header.size);
+      file.write(reinterpret_cast<const char*>(m_file.view(offset, recordSize)), recordSize);
+    }
+
+    static const uint8_t padding[8] = { };
+
+    for (const PendingBlob& blob : pending) {
+      RecordHeader header;
+      header.key = toDigest(*blob.key);
+      header.size = uint32_t(blob.data->size());
+      header.checksum = computeChecksum(*blob.key, blob.data->data(), blob.data->size());
+
+      file.write(reinterpret_cast<const char*>(&header), sizeof(header));
+      file.write(reinterpret_cast<const char*>(blob.data->data()), blob.data->size());
+      file.write(reinterpret_cast<const char*>(padding), alignRecord(header.size) - header.size);
+    }
+
+    file.flush();
+    return bool(file);
+  }
+
+
+  bool BlobArchive::replaceFile(const std::string& src, const std::string& dst) {
+#ifdef _WIN32
+    // Unlike rename on Windows, this replaces the file in one step, so
+    // a crash can not leave the archive missing
+    return ::MoveFileExA(src.c_str(), dst.c_str(), MOVEFILE_REPLACE_EXISTING) != 0;
+#else
+    return std::rename(src.c_str(), dst.c_str()) == 0;
+#endif
+  }
+
+
+  uint64_t BlobArchive::computeChecksum(const Sha1Hash& key, const void* data, size_t size) {
+    // Seeded with the key, so that a record can't pass for another one
+    return XXH3_64bits_withSeed(data, size, KeyHash()(key));
+  }
+
+}
@@ -0,0 +1,261 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <cstring>
+#include <mutex>
+#include <string>
+#include <type_traits>
+#include <unordered_map>
+#include <vector>
+
+#include "util_mapped_file.h"
+#include "sha1/sha1_util.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Serializes plain data into a byte buffer
+   */
+  class BlobWriter {
+  public:
+    template<typename T>
+    void write(const T& value) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      writeBytes(&value, sizeof(T));
+    }
+
+    template<typename T>
+    void writeArray(const std::vector<T>& values) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      write(uint32_t(values.size()));
+      writeBytes(values.data(), values.size() * sizeof(T));
+    }
+
+    void writeBytes(const void* data, size_t size) {
+      const uint8_t* bytes = reinterpret_cast<const uint8_t*>(data);
+      m_data.insert(m_data.end(), bytes, bytes + size);
+    }
+
+    const std::vector<uint8_t>& data() const {
+      return m_data;
+    }
+
+    std::vector<uint8_t> release() {
+      return std::move(m_data);
+    }
+
+  private:
+    std::vector<uint8_t> m_data;
+  };
+
+
+  /**
+   * \brief Reads back data written by a \c BlobWriter
+   *
+   * All reads are bounds checked, a failed read leaves
+   * the reader at the end so that later reads fail too.
+   */
+  class BlobReader {
+  public:
+    BlobReader(const void* data, size_t size)
+    : m_data(reinterpret_cast<const uint8_t*>(data)), m_size(size) { }
+
+    template<typename T>
+    bool read(T& value) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      return readBytes(&value, sizeof(T));
+    }
+
+    template<typename T>
+    bool readArray(std::vector<T>& values) {
+      static_assert(std::is_trivially_copyable_v<T>);
+      uint32_t count = 0;
+
+      if (!read(count) || count > (m_size - m_offset) / sizeof(T)) {
+        m_offset = m_size;
+        return false;
+      }
+
+      values.resize(count);
+      return readBytes(values.data(), count * sizeof(T));
+    }
+
+    bool readBytes(void* data, size_t size) {
+      if (size > m_size - m_offset) {
+        m_offset = m_size;
+        return false;
+      }
+
+      if (size != 0) {
+        std::memcpy(data, m_data + m_offset, size);
+      }
+
+      m_offset += size;
+      return true;
+    }
+
+    bool atEnd() const {
+      return m_offset == m_size;
+    }
+
+  private:
+    const uint8_t* m_data;
+    size_t m_size;
+    size_t m_offset = 0;
+  };
+
+
+  /**
+   * \brief Persistent content addressed blob archive
+   *
+   * Stores blobs under a hash of whatever produced them in a single file
+   * that is memory mapped on first use. Only the record headers are read
+   * then, blob contents are paged in and checked against their checksum
+   * when they are looked up. Blobs stored during the session are kept in
+   * memory and written out by \c flush, which rewrites the file and then
+   * replaces the old one in one step.
+   *
+   * Files written by another format or content version, and records that
+   * fail their checksum, are ignored and dropped on the next flush. This
+   * class is thread-safe.
+   */
+  class BlobArchive {
+  public:
+    /// Bump when the layout of the file changes
+    static constexpr uint32_t FormatVersion = 1;
+
+    struct Stats {
+      uint64_t hits = 0;
+      uint64_t misses = 0;
+      uint64_t corrupt = 0;   // records that failed their checks
+      uint64_t stored = 0;
+    };
+
+    /**
+     * \brief Creates an archive
+     *
+     * Does not touch the file until the archive is used.
+     * \param [in] filename Path to the archive file
+     * \param [in] contentVersion Version of the blob contents,
+     *   files with a different version are discarded
+     */
+    BlobArchive(std::string filename, uint32_t contentVersion);
+
+    ~BlobArchive();
+
+    BlobArchive(const BlobArchive&) = delete;
+    BlobArchive& operator=(const BlobArchive&) = delete;
+
+    /**
+     * \brief Looks up a blob
+     *
+     * \param [in] key Key the blob was stored with
+     * \param [out] data Contents of the blob
+     * \returns \c true if the blob was found and is intact
+     */
+    bool lookup(const Sha1Hash& key, std::vector<uint8_t>& data);
+
+    /**
+     * \brief Adds a blob
+     *
+     * Keeps the existing blob if the key is already in use.
+     * \param [in] key Key to store the blob with
+     * \param [in] data Contents of the blob
+     */
+    void store(const Sha1Hash& key, std::vector<uint8_t> data);
+
+    /**
+     * \brief Writes blobs stored since the last flush to the file
+     *
+     * \returns \c false if the file could not be written, the
+     *   blobs are kept in memory in that case.
+     */
+    bool flush();
+
+    /**
+     * \brief Number of blobs not yet written to the file
+     */
+    size_t getPendingCount();
+
+    Stats getStats();
+
+  private:
+    struct FileHeader {
+      char     magic[8];
+      uint32_t formatVersion;
+      uint32_t contentVersion;
+    };
+
+    struct RecordHeader {
+      Sha1Digest key;
+      uint32_t   size;
+      uint64_t   checksum;
+    };
+
+    static_assert(sizeof(RecordHeader) == 32);
+
+    struct PendingBlob {
+      const Sha1Hash*             key;
+      const std::vector<uint8_t>* data;
+    };
+
+    struct KeyHash {
+      size_t operator () (const Sha1Hash& key) const {
+        return size_t(key.dword(0)) | (size_t(key.dword(1)) << 32);
+      }
+    };
+
+    std::string m_filename;
+    uint32_t m_contentVersion;
+
+    std::mutex m_flushMutex;
+    std::mutex m_mutex;
+    bool m_opened = false;
+    bool m_dirty = false;
+    Stats m_stats;
+
+    MappedFile m_file;
+
+    // Record offsets in the mapped file and blobs not yet written to it
+    std::unordered_map<Sha1Hash, uint64_t, KeyHash> m_records;
+    std::unordered_map<Sha1Hash, std::vector<uint8_t>, KeyHash> m_pending;
+
+    void open();
+
+    bool writeFile(
+      const std::string&              filename,
+            std::vector<uint64_t>&    offsets,
+      const std::vector<PendingBlob>& pending) const;
+
+    static bool replaceFile(const std::string& src, const std::string& dst);
+
+    static uint64_t computeChecksum(const Sha1Hash& key, const void* data, size_t size);
+
+    static uint64_t alignRecord(uint64_t size) {
+      return (size + 7) & ~uint64_t(7);
+    }
+  };
+
+}
@@ -0,0 +1,127 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <exception>
+#include <functional>
+#include <optional>
+
+#include "thread.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Value that is produced once, by whoever needs it first
+   *
+   * Holds a producer until the value is needed. A worker thread can
+   * produce it ahead of time with \c tryProduce, and \c get produces
+   * it on the calling thread if no worker has picked it up yet, or
+   * waits for the worker that did. Either way the producer runs
+   * exactly once, so a job that was dropped or never scheduled is
+   * not lost. Exceptions thrown by the producer are rethrown by
+   * every call to \c get. This class is thread-safe.
+   */
+  template<typename T>
+  class DeferredValue {
+  public:
+    using Producer = std::function<T()>;
+
+    explicit DeferredValue(Producer producer)
+    : m_producer(std::move(producer)) { }
+
+    DeferredValue(const DeferredValue&) = delete;
+    DeferredValue& operator=(const DeferredValue&) = delete;
+
+    /**
+     * \brief Produces the value unless another thread has started to
+     *
+     * \returns \c true if the value was produced by this call
+     */
+    bool tryProduce() {
+      uint32_t expected = Pending;
+
+      if (!m_state.compare_exchange_strong(expected, Producing, std::memory_order_acquire)) {
+        return false;
+      }
+
+      produce();
+      return true;
+    }
+
+    /**
+     * \brief Checks whether the value can be retrieved without waiting
+     */
+    bool ready() const {
+      return m_state.load(std::memory_order_acquire) == Ready;
+    }
+
+    /**
+     * \brief Retrieves the value
+     *
+     * Produces the value or waits for it as needed.
+     * \returns The value, throws what the producer threw
+     */
+    const T& get() {
+      if (!ready() && !tryProduce()) {
+        std::unique_lock<dxvk::mutex> lock(m_mutex);
+        m_cond.wait(lock, [this] { return ready(); });
+      }
+
+      if (m_error) {
+        std::rethrow_exception(m_error);
+      }
+
+      return *m_value;
+    }
+
+  private:
+    enum : uint32_t { Pending, Producing, Ready };
+
+    std::atomic<uint32_t> m_state = { Pending };
+
+    Producer m_producer;
+    std::optional<T> m_value;
+    std::exception_ptr m_error;
+
+    dxvk::mutex m_mutex;
+    dxvk::condition_variable m_cond;
+
+    void produce() {
+      try {
+        m_value.emplace(m_producer());
+      } catch (...) {
+        m_error = std::current_exception();
+      }
+
+      // Drop whatever the producer captured
+      m_producer = nullptr;
+
+      { std::lock_guard<dxvk::mutex> lock(m_mutex);
+        m_state.store(Ready, std::memory_order_release);
+      }
+
+      m_cond.notify_all();
+    }
+  };
+
+}
@@ -0,0 +1,231 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <cassert>
+#include <unordered_map>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Tracks which elements of a shadow array each upload slice misses
+   *
+   * Uploads copy a CPU side array into one of a set of recycled slices, e.g.
+   * the slices of a DxvkBuffer, which still hold what was copied into them
+   * the last time they were used. Elements changed between two uploads are
+   * recorded as one range, and only the union of the ranges recorded since a
+   * slice was last written has to be copied to bring it up to date.
+   *
+   * The union is looked up through two monotonic stacks of the range bounds,
+   * so the cost does not grow with the number of uploads in between. Slices
+   * the tracker has not seen, and slices written with fewer elements, get a
+   * full copy. Not thread safe.
+   */
+  class UploadDirtyTracker {
+  public:
+    struct Range {
+      uint32_t begin;
+      uint32_t end;
+
+      bool empty() const {
+        return begin >= end;
+      }
+
+      uint32_t size() const {
+        return empty() ? 0 : end - begin;
+      }
+    };
+
+    /**
+     * \brief Marks elements of the shadow array as changed
+     *
+     * \param [in] begin First changed element
+     * \param [in] end One past the last changed element
+     */
+    void markDirty(uint32_t begin, uint32_t end) {
+      m_pendingBegin = std::min(m_pendingBegin, begin);
+      m_pendingEnd = std::max(m_pendingEnd, end);
+    }
+
+    /**
+     * \brief Forgets all slices
+     *
+     * Must be called when slices may have been written
+     * behind the tracker's back, e.g. for a new buffer.
+     */
+    void invalidate() {
+      m_slices.clear();
+      m_begins.clear();
+      m_ends.clear();
+      m_pendingBegin = ~0u;
+      m_pendingEnd = 0;
+    }
+
+    /**
+     * \brief Range to copy into a slice before using it
+     *
+     * Records that the slice holds the first \c count elements of
+     * the current shadow array once the returned range is copied.
+     * \param [in] slice Slice, identified by its address
+     * \param [in] count Number of elements the slice needs
+     * \returns Elements to copy from the shadow array
+     */
+    Range beginUpload(const void* slice, uint32_t count) {
+      commitPending();
+
+      auto entry = m_slices.emplace(slice, SliceState { m_version, count });
+      SliceState& state = entry.first->second;
+
+      Range range = { 0, count };
+
+      if (!entry.second && state.count >= count) {
+        range.begin = std::min(suffixBound(m_begins, state.version, ~0u), count);
+        range.end = std::min(suffixBound(m_ends, state.version, 0u), count);
+      }
+
+      state.version = m_version;
+      state.count = count;
+      return range;
+    }
+
+    size_t trackedSlices() const {
+      return m_slices.size();
+    }
+
+  private:
+    struct SliceState {
+      uint64_t version;
+      uint32_t count;
+    };
+
+    struct Bound {
+      uint64_t version;
+      uint32_t value;
+    };
+
+    uint64_t m_version = 0;
+    uint32_t m_pendingBegin = ~0u;
+    uint32_t m_pendingEnd = 0;
+
+    // Range bounds by version, begins strictly increasing and ends strictly
+    // decreasing from the bottom. A bound dominated by a later one can never
+    // be the minimum or maximum of a suffix of versions, so it is dropped.
+    std::vector<Bound> m_begins;
+    std::vector<Bound> m_ends;
+
+    std::unordered_map<const void*, SliceState> m_slices;
+
+    void commitPending() {
+      if (m_pendingBegin >= m_pendingEnd) {
+        return;
+      }
+
+      m_version += 1;
+
+      while (!m_begins.empty() && m_begins.back().value >= m_pendingBegin) {
+        m_begins.pop_back();
+      }
+
+      while (!m_ends.empty() && m_ends.back().value <= m_pendingEnd) {
+        m_ends.pop_back();
+      }
+
+      m_begins.push_back({ m_version, m_pendingBegin });
+      m_ends.push_back({ m_version, m_pendingEnd });
+
+      m_pendingBegin = ~0u;
+      m_pendingEnd = 0;
+    }
+
+    // Bound of all ranges recorded after the given version
+    static uint32_t suffixBound(const std::vector<Bound>& bounds, uint64_t version, uint32_t none) {
+      auto first = std::upper_bound(bounds.begin(), bounds.end(), version,
+        [] (uint64_t v, const Bound& bound) { return v < bound.version; });
+
+      return first != bounds.end() ? first->value : none;
+    }
+  };
+
+
+  /**
+   * \brief Collects changed elements into ranges to upload
+   *
+   * Elements are marked in increasing order. An element close to the last
+   * range extends it, as every separate upload records a command and a
+   * barrier, and once more than the maximum number of ranges would be needed
+   * all of them are collapsed into one range spanning them. Not thread safe.
+   */
+  class DirtyRangeList {
+  public:
+    using Range = UploadDirtyTracker::Range;
+
+    /**
+     * \param [in] mergeDistance Elements at most this far past the last range extend it
+     * \param [in] maxRanges Maximum number of separate ranges
+     */
+    DirtyRangeList(uint32_t mergeDistance, size_t maxRanges)
+    : m_mergeDistance(mergeDistance), m_maxRanges(std::max<size_t>(maxRanges, 1)) { }
+
+    void clear() {
+      m_ranges.clear();
+      m_collapsed = false;
+    }
+
+    /**
+     * \brief Marks an element as changed
+     *
+     * \param [in] element Changed element, past all previously marked ones
+     */
+    void markDirty(uint32_t element) {
+      assert(m_ranges.empty() || element >= m_ranges.back().end);
+
+      if (!m_ranges.empty() && (m_collapsed || element <= m_ranges.back().end + m_mergeDistance)) {
+        m_ranges.back().end = element + 1;
+      } else if (m_ranges.size() < m_maxRanges) {
+        m_ranges.push_back({ element, element + 1 });
+      } else {
+        m_ranges.front().end = element + 1;
+        m_ranges.resize(1);
+        m_collapsed = true;
+      }
+    }
+
+    /**
+     * \brief Ranges [begin, end) of changed elements, in increasing order
+     */
+    const std::vector<Range>& ranges() const {
+      return m_ranges;
+    }
+
+  private:
+    uint32_t m_mergeDistance;
+    size_t m_maxRanges;
+    bool m_collapsed = false;
+
+    std::vector<Range> m_ranges;
+  };
+
+}
@@ -19,15 +19,20 @@
 * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 * DEALINGS IN THE SOFTWARE.
 */
+#include <assert.h>
 #include <smmintrin.h>
 #include <math.h>
 #include <intrin.h>
 #include "util_math.h"
 #include "util_fastops.h"
 #include <algorithm>
+#include <vector>
 #include <ppl.h>
 #include "util_fastops.h"
 
+#define XXH_STATIC_LINKING_ONLY
+#include "xxHash/xxhash.h"
+
 #define SSE_ENABLE ((fast::g_simdSupportLevel != fast::SIMD::None) && 1)
 
 namespace fast {
@@ -931,6 +936,420 @@ namespace fast {
   template void copySubtract<uint16_t>(uint16_t* dstData, const uint16_t* srcData, const uint32_t count, const uint16_t value, const bool ignoreSentinel, const uint16_t sentinelValue);
   template void copySubtract<uint32_t>(uint32_t* dstData, const uint32_t* srcData, const uint32_t count, const uint32_t value, const bool ignoreSentinel, const uint32_t sentinelValue);
 
+  // Deduplication scatters the values into a table of byte flags, then scans the flags in
+  // order to gather the sorted unique values.  Setting a flag is a plain store, unlike
+  // setting a bit it does not depend on earlier writes to the same word, which matters as
+  // neighbouring indices tend to be close.  The scan skips empty blocks with a single vector
+  // test, writes fully used blocks as a run and clears the flags it visited.
+  template<typename T>
+  __forceinline void deduplicateSortScatter(const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* flags) {
+    const uint32_t alignedCount = dxvk::alignDown(count, 4u);
+
+    for (uint32_t i = 0; i < alignedCount; i += 4) {
+      assert(srcData[i + 0] <= maxValue && srcData[i + 1] <= maxValue && srcData[i + 2] <= maxValue && srcData[i + 3] <= maxValue);
+      flags[srcData[i + 0]] = 1;
+      flags[srcData[i + 1]] = 1;
+      flags[srcData[i + 2]] = 1;
+      flags[srcData[i + 3]] = 1;
+    }
+
+    for (uint32_t i = alignedCount; i < count; ++i) {
+      assert(srcData[i] <= maxValue);
+      flags[srcData[i]] = 1;
+    }
+  }
+
+  template<typename T>
+  __forceinline uint32_t deduplicateSortGatherMask(T* dstData, uint32_t mask, const uint32_t base) {
+    uint32_t n = 0;
+
+    // Note: TZCNT executes as BSF on CPUs without BMI1, which yields the same result for non-zero input
+    while (mask != 0) {
+      dstData[n++] = static_cast<T>(base + _tzcnt_u32(mask));
+      mask &= mask - 1;
+    }
+
+    return n;
+  }
+
+  template<typename T>
+  uint32_t deduplicateSort_slow(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags) {
+    deduplicateSortScatter(srcData, count, maxValue, scratchFlags);
+
+    uint32_t uniqueCount = 0;
+    for (uint64_t value = 0; value <= maxValue; value++) {
+      if (scratchFlags[value]) {
+        scratchFlags[value] = 0;
+        dstData[uniqueCount++] = static_cast<T>(value);
+      }
+    }
+
+    return uniqueCount;
+  }
+
+  template<typename T>
+  uint32_t deduplicateSort_SSE(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags) {
+    deduplicateSortScatter(srcData, count, maxValue, scratchFlags);
+
+    const size_t scratchSize = deduplicateSortScratchSize(maxValue);
+    const uint32_t numLanes = 16 / sizeof(T);
+    const __m128i zero = _mm_setzero_si128();
+    const __m128i step = sizeof(T) == 2 ? _mm_set1_epi16(numLanes) : _mm_set1_epi32(numLanes);
+    const __m128i iota = sizeof(T) == 2 ? _mm_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7) : _mm_setr_epi32(0, 1, 2, 3);
+
+    uint32_t uniqueCount = 0;
+    for (size_t i = 0; i < scratchSize; i += 16) {
+      const __m128i block = _mm_loadu_si128((const __m128i*) &scratchFlags[i]);
+      const uint32_t mask = ~_mm_movemask_epi8(_mm_cmpeq_epi8(block, zero)) & 0xFFFF;
+      if (mask == 0)
+        continue;
+
+      const uint32_t base = static_cast<uint32_t>(i);
+
+      if (mask == 0xFFFF) {
+        // Fully used blocks are common with dense index buffers, write the whole run
+        __m128i values = sizeof(T) == 2 ? _mm_add_epi16(_mm_set1_epi16(static_cast<uint16_t>(base)), iota) : _mm_add_epi32(_mm_set1_epi32(base), iota);
+        for (uint32_t n = 0; n < 16; n += numLanes) {
+          _mm_storeu_si128((__m128i*) &dstData[uniqueCount + n], values);
+          values = sizeof(T) == 2 ? _mm_add_epi16(values, step) : _mm_add_epi32(values, step);
+        }
+        uniqueCount += 16;
+      } else {
+        uniqueCount += deduplicateSortGatherMask(&dstData[uniqueCount], mask, base);
+      }
+
+      _mm_storeu_si128((__m128i*) &scratchFlags[i], zero);
+    }
+
+    return uniqueCount;
+  }
+
+  template<typename T>
+  uint32_t deduplicateSort_AVX2(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags) {
+    deduplicateSortScatter(srcData, count, maxValue, scratchFlags);
+
+    const size_t scratchSize = deduplicateSortScratchSize(maxValue);
+    const uint32_t numLanes = 32 / sizeof(T);
+    const __m256i zero = _mm256_setzero_si256();
+    const __m256i step = sizeof(T) == 2 ? _mm256_set1_epi16(numLanes) : _mm256_set1_epi32(numLanes);
+    const __m256i iota = sizeof(T) == 2 ? _mm256_setr_epi16(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15) : _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    uint32_t uniqueCount = 0;
+    for (size_t i = 0; i < scratchSize; i += 32) {
+      const __m256i block = _mm256_loadu_si256((const __m256i*) &scratchFlags[i]);
+      if (_mm256_testz_si256(block, block))
+        continue;
+
+      const uint32_t mask = ~static_cast<uint32_t>(_mm256_movemask_epi8(_mm256_cmpeq_epi8(block, zero)));
+      const uint32_t base = static_cast<uint32_t>(i);
+
+      if (mask == ~0u) {
+        // Fully used blocks are common with dense index buffers, write the whole run
+        __m256i values = sizeof(T) == 2 ? _mm256_add_epi16(_mm256_set1_epi16(static_cast<uint16_t>(base)), iota) : _mm256_add_epi32(_mm256_set1_epi32(base), iota);
+        for (uint32_t n = 0; n < 32; n += numLanes) {
+          _mm256_storeu_si256((__m256i*) &dstData[uniqueCount + n], values);
+          values = sizeof(T) == 2 ? _mm256_add_epi16(values, step) : _mm256_add_epi32(values, step);
+        }
+        uniqueCount += 32;
+      } else {
+        uniqueCount += deduplicateSortGatherMask(&dstData[uniqueCount], mask, base);
+      }
+
+      _mm256_storeu_si256((__m256i*) &scratchFlags[i], zero);
+    }
+
+    return uniqueCount;
+  }
+
+  template<typename T>
+  uint32_t deduplicateSort_AVX512(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags) {
+    deduplicateSortScatter(srcData, count, maxValue, scratchFlags);
+
+    const size_t scratchSize = deduplicateSortScratchSize(maxValue);
+    const __m512i zero = _mm512_setzero_si512();
+    const __m512i iota = _mm512_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7, 8, 9, 10, 11, 12, 13, 14, 15);
+
+    uint32_t uniqueCount = 0;
+    for (size_t i = 0; i < scratchSize; i += 64) {
+      const __m512i block = _mm512_loadu_si512((const __m512i*) &scratchFlags[i]);
+      if (_mm512_test_epi64_mask(block, block) == 0)
+        continue;
+
+      // Widen 16 flags at a time and compress the set positions into contiguous lanes,
+      // only the written lanes are stored so the output needs no padding
+      for (size_t n = i; n < i + 64; n += 16) {
+        const __m512i flags = _mm512_cvtepu8_epi32(_mm_loadu_si128((const __m128i*) &scratchFlags[n]));
+        const __mmask16 mask = _mm512_test_epi32_mask(flags, flags);
+        if (mask == 0)
+          continue;
+
+        const __m512i values = _mm512_maskz_compress_epi32(mask, _mm512_add_epi32(_mm512_set1_epi32(static_cast<uint32_t>(n)), iota));
+        const uint32_t numValues = _mm_popcnt_u32(mask);
+        const __mmask16 storeMask = static_cast<__mmask16>((1u << numValues) - 1);
+
+        if (sizeof(T) == 2) {
+          _mm512_mask_cvtepi32_storeu_epi16(&dstData[uniqueCount], storeMask, values);
+        } else {
+          _mm512_mask_storeu_epi32(&dstData[uniqueCount], storeMask, values);
+        }
+
+        uniqueCount += numValues;
+      }
+
+      _mm512_storeu_si512((__m512i*) &scratchFlags[i], zero);
+    }
+
+    return uniqueCount;
+  }
+
+  template<typename T>
+  uint32_t deduplicateSort(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags) {
+    static_assert(std::is_same<T, uint16_t>::value || std::is_same<T, uint32_t>::value, "Not a supported type");
+
+    if (count == 0)
+      return 0;
+
+    switch (g_simdSupportLevel) {
+    case SIMD::AVX512:
+      return deduplicateSort_AVX512(dstData, srcData, count, maxValue, scratchFlags);
+    case SIMD::AVX2:
+      return deduplicateSort_AVX2(dstData, srcData, count, maxValue, scratchFlags);
+    case SIMD::SSE4_1:
+    case SIMD::SSE3:
+    case SIMD::SSE2:
+      return deduplicateSort_SSE(dstData, srcData, count, maxValue, scratchFlags);
+    default:
+      return deduplicateSort_slow(dstData, srcData, count, maxValue, scratchFlags);
+    }
+  }
+
+  template uint32_t deduplicateSort<uint16_t>(uint16_t* dstData, const uint16_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template uint32_t deduplicateSort<uint32_t>(uint32_t* dstData, const uint32_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+
+  // Exposed for the unit tests
+  template uint32_t deduplicateSort_slow<uint16_t>(uint16_t* dstData, const uint16_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template uint32_t deduplicateSort_slow<uint32_t>(uint32_t* dstData, const uint32_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template uint32_t deduplicateSort_SSE<uint16_t>(uint16_t* dstData, const uint16_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template uint32_t deduplicateSort_SSE<uint32_t>(uint32_t* dstData, const uint32_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template uint32_t deduplicateSort_AVX2<uint16_t>(uint16_t* dstData, const uint16_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template uint32_t deduplicateSort_AVX2<uint32_t>(uint32_t* dstData, const uint32_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template uint32_t deduplicateSort_AVX512<uint16_t>(uint16_t* dstData, const uint16_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template uint32_t deduplicateSort_AVX512<uint32_t>(uint32_t* dstData, const uint32_t* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+
+  // Gather hashing works on fixed size segments, so that splitting the work across
+  // threads cannot change the result.  Each segment is gathered through a block small
+  // enough to stay in L1, which is handed to XXH3 in one piece.
+  static constexpr uint32_t kHashSegmentElements = 64 * 1024;
+  static constexpr size_t kHashGatherBlockSize = 8 * 1024;
+  static_assert(kHashSegmentElements == 1 << 16, "hashGatheredElementsScratchSize assumes 64k element segments");
+
+  template<size_t ElementSize, typename T>
+  uint64_t hashGatheredSegment(const uint8_t* pBase, const size_t stride, const size_t elementSize, const T* indices, const uint32_t begin, const uint32_t end) {
+    // Known element sizes turn the copies below into plain moves
+    const size_t size = ElementSize != 0 ? ElementSize : elementSize;
+
+    XXH3_state_t state;
+    XXH3_64bits_reset(&state);
+
+    if (size > kHashGatherBlockSize) {
+      for (uint32_t i = begin; i < end; i++) {
+        const size_t index = indices ? indices[i] : i;
+        XXH3_64bits_update(&state, pBase + index * stride, size);
+      }
+      return XXH3_64bits_digest(&state);
+    }
+
+    alignas(64) uint8_t block[kHashGatherBlockSize];
+    const uint32_t elementsPerBlock = static_cast<uint32_t>(kHashGatherBlockSize / size);
+
+    for (uint32_t first = begin; first < end; first += elementsPerBlock) {
+      const uint32_t last = std::min(first + elementsPerBlock, end);
+
+      uint8_t* dst = block;
+      if (indices) {
+        for (uint32_t i = first; i < last; i++, dst += size) {
+          memcpy(dst, pBase + indices[i] * stride, size);
+        }
+      } else {
+        for (uint32_t i = first; i < last; i++, dst += size) {
+          memcpy(dst, pBase + i * stride, size);
+        }
+      }
+
+      XXH3_64bits_update(&state, block, dst - block);
+    }
+
+    return XXH3_64bits_digest(&state);
+  }
+
+  template<typename T>
+  uint64_t hashGatheredSegment(const uint8_t* pBase, const size_t stride, const size_t elementSize, const T* indices, const uint32_t begin, const uint32_t end) {
+    switch (elementSize) {
+    case 8:
+      return hashGatheredSegment<8>(pBase, stride, elementSize, indices, begin, end);
+    case 12:
+      return hashGatheredSegment<12>(pBase, stride, elementSize, indices, begin, end);
+    case 16:
+      return hashGatheredSegment<16>(pBase, stride, elementSize, indices, begin, end);
+    default:
+      return hashGatheredSegment<0>(pBase, stride, elementSize, indices, begin, end);
+    }
+  }
+
+  template<typename T>
+  uint64_t hashGatheredElements(const uint8_t* pBase, const size_t stride, const size_t elementSize, const T* indices, const uint32_t count, uint64_t* scratchSegmentHashes, const uint32_t parallelThreshold/* = 0*/) {
+    static_assert(std::is_same<T, uint16_t>::value || std::is_same<T, uint32_t>::value, "Not a supported type");
+
+    if (count <= kHashSegmentElements) {
+      return hashGatheredSegment(pBase, stride, elementSize, indices, 0, count);
+    }
+
+    const uint32_t numSegments = (count - 1) / kHashSegmentElements + 1;
+    assert(numSegments <= hashGatheredElementsScratchSize(count));
+
+    uint64_t* segmentHashes = scratchSegmentHashes;
+
+    auto hashSegment = [&](uint32_t segment) {
+      const uint32_t begin = segment * kHashSegmentElements;
+      const uint32_t end = std::min(begin + kHashSegmentElements, count);
+      segmentHashes[segment] = hashGatheredSegment(pBase, stride, elementSize, indices, begin, end);
+    };
+
+    if (parallelThreshold != 0 && count >= parallelThreshold) {
+      concurrency::parallel_for<uint32_t>(0, numSegments, hashSegment);
+    } else {
+      for (uint32_t segment = 0; segment < numSegments; segment++) {
+        hashSegment(segment);
+      }
+    }
+
+    return XXH3_64bits(segmentHashes, numSegments * sizeof(uint64_t));
+  }
+
+  template uint64_t hashGatheredElements<uint16_t>(const uint8_t* pBase, const size_t stride, const size_t elementSize, const uint16_t* indices, const uint32_t count, uint64_t* scratchSegmentHashes, const uint32_t parallelThreshold);
+  template uint64_t hashGatheredElements<uint32_t>(const uint8_t* pBase, const size_t stride, const size_t elementSize, const uint32_t* indices, const uint32_t count, uint64_t* scratchSegmentHashes, const uint32_t parallelThreshold);
+
+  void extendBoundingBox_slow(const uint8_t* pPositions, const size_t stride, const uint32_t count, float minPos[3], float maxPos[3]) {
+    for (uint32_t i = 0; i < count; i++, pPositions += stride) {
+      const float* pPosition = reinterpret_cast<const float*>(pPositions);
+      for (uint32_t c = 0; c < 3; c++) {
+        minPos[c] = std::min(minPos[c], pPosition[c]);
+        maxPos[c] = std::max(maxPos[c], pPosition[c]);
+      }
+    }
+  }
+
+  void extendBoundingBox_SSE(const uint8_t* pPositions, const size_t stride, const uint32_t count, float minPos[3], float maxPos[3]) {
+    if (count == 0)
+      return;
+
+    // A full width load of a position also reads the first 4 bytes of the next one, the last
+    // position is loaded on its own.  The 4th lane is never written back.
+    const uint32_t numFullLoads = count - 1;
+
+    __m128 min0 = _mm_setr_ps(minPos[0], minPos[1], minPos[2], 0.f);
+    __m128 max0 = _mm_setr_ps(maxPos[0], maxPos[1], maxPos[2], 0.f);
+    __m128 min1 = min0;
+    __m128 max1 = max0;
+
+    const uint8_t* pPosition = pPositions;
+    uint32_t i = 0;
+    for (; i + 2 <= numFullLoads; i += 2, pPosition += 2 * stride) {
+      const __m128 pos0 = _mm_loadu_ps(reinterpret_cast<const float*>(pPosition));
+      const __m128 pos1 = _mm_loadu_ps(reinterpret_cast<const float*>(pPosition + stride));
+      min0 = _mm_min_ps(min0, pos0);
+      max0 = _mm_max_ps(max0, pos0);
+      min1 = _mm_min_ps(min1, pos1);
+      max1 = _mm_max_ps(max1, pos1);
+    }
+
+    for (; i < numFullLoads; i++, pPosition += stride) {
+      const __m128 pos = _mm_loadu_ps(reinterpret_cast<const float*>(pPosition));
+      min0 = _mm_min_ps(min0, pos);
+      max0 = _mm_max_ps(max0, pos);
+    }
+
+    const float* pLast = reinterpret_cast<const float*>(pPosition);
+    const __m128 last = _mm_setr_ps(pLast[0], pLast[1], pLast[2], 0.f);
+    min0 = _mm_min_ps(_mm_min_ps(min0, min1), last);
+    max0 = _mm_max_ps(_mm_max_ps(max0, max1), last);
+
+    alignas(16) float minOut[4];
+    alignas(16) float maxOut[4];
+    _mm_store_ps(minOut, min0);
+    _mm_store_ps(maxOut, max0);
+
+    for (uint32_t c = 0; c < 3; c++) {
+      minPos[c] = minOut[c];
+      maxPos[c] = maxOut[c];
+    }
+  }
+
+  void extendBoundingBox(const uint8_t* pPositions, const size_t stride, const uint32_t count, float minPos[3], float maxPos[3]) {
+    if (SSE_ENABLE) {
+      extendBoundingBox_SSE(pPositions, stride, count, minPos, maxPos);
+    } else {
+      extendBoundingBox_slow(pPositions, stride, count, minPos, maxPos);
+    }
+  }
+
+  void extendByteRange_slow(const uint8_t* pData, const size_t stride, const uint32_t count, const uint32_t bytesPerElement, uint8_t& minValue, uint8_t& maxValue) {
+    for (uint32_t i = 0; i < count; i++, pData += stride) {
+      for (uint32_t j = 0; j < bytesPerElement; j++) {
+        minValue = std::min(minValue, pData[j]);
+        maxValue = std::max(maxValue, pData[j]);
+      }
+    }
+  }
+
+  void extendByteRange_SSE(const uint8_t* pData, const size_t stride, const uint32_t count, const uint32_t bytesPerElement, uint8_t& minValue, uint8_t& maxValue) {
+    assert(bytesPerElement >= 1 && bytesPerElement <= 4);
+
+    // Each lane holds the 4 leading bytes of an element, the bytes past bytesPerElement are
+    // masked to values that cannot affect the range.  Like above, the last element is never
+    // loaded at full width.
+    const uint32_t keepBits = bytesPerElement >= 4 ? ~0u : (1u << (bytesPerElement * 8)) - 1;
+    const __m128i keep = _mm_set1_epi32(static_cast<int>(keepBits));
+    const __m128i ignore = _mm_set1_epi32(static_cast<int>(~keepBits));
+
+    __m128i min = _mm_set1_epi8(static_cast<char>(minValue));
+    __m128i max = _mm_set1_epi8(static_cast<char>(maxValue));
+
+    const uint32_t numFullLoads = count > 0 ? count - 1 : 0;
+
+    uint32_t i = 0;
+    for (; i + 4 <= numFullLoads; i += 4, pData += 4 * stride) {
+      uint32_t element[4];
+      for (uint32_t n = 0; n < 4; n++) {
+        memcpy(&element[n], pData + n * stride, sizeof(uint32_t));
+      }
+
+      const __m128i values = _mm_setr_epi32(element[0], element[1], element[2], element[3]);
+      min = _mm_min_epu8(min, _mm_or_si128(values, ignore));
+      max = _mm_max_epu8(max, _mm_and_si128(values, keep));
+    }
+
+    alignas(16) uint8_t minOut[16];
+    alignas(16) uint8_t maxOut[16];
+    _mm_store_si128(reinterpret_cast<__m128i*>(minOut), min);
+    _mm_store_si128(reinterpret_cast<__m128i*>(maxOut), max);
+
+    for (uint32_t n = 0; n < 16; n++) {
+      minValue = std::min(minValue, minOut[n]);
+      maxValue = std::max(maxValue, maxOut[n]);
+    }
+
+    extendByteRange_slow(pData, stride, count - i, bytesPerElement, minValue, maxValue);
+  }
+
+  void extendByteRange(const uint8_t* pData, const size_t stride, const uint32_t count, const uint32_t bytesPerElement, uint8_t& minValue, uint8_t& maxValue) {
+    if (SSE_ENABLE && stride >= sizeof(uint32_t)) {
+      extendByteRange_SSE(pData, stride, count, bytesPerElement, minValue, maxValue);
+    } else {
+      extendByteRange_slow(pData, stride, count, bytesPerElement, minValue, maxValue);
+    }
+  }
+
   void parallel_memcpy(void* dst, const void* src, const size_t count, const size_t chunkSize) {
     const uint8_t* srcBytes = static_cast<const uint8_t*>(src);
     uint8_t* dstBytes = static_cast<uint8_t*>(dst);
@@ -21,6 +21,7 @@
 */
 #pragma once
 
+#include <stddef.h>
 #include <stdint.h>
 
 namespace fast {
@@ -70,6 +71,87 @@ namespace fast {
   template<typename T>
   void copySubtract(T* dstData, const T* srcData, const uint32_t count, const T value, const bool ignoreSentinel = false, const T sentinelValue = 0);
 
+  /**
+    * \brief Sorts an array of unsigned integers and removes duplicates, (D = sorted unique values of S)
+    *
+    * dstData: array of unsigned integers to write data, must hold min(count, maxValue + 1) integers
+    * srcData: array of unsigned integers to read data
+    * count: number of integers
+    * maxValue: largest value in srcData
+    * scratchFlags: zeroed scratch memory of deduplicateSortScratchSize(maxValue) bytes,
+    *   left zeroed on return so it can be reused by the next call without clearing
+    *
+    * Returns the number of integers written to dstData.
+    * Supports unsigned 32-bit and 16-bit integers.  All other uses undefined.
+    */
+  template<typename T>
+  uint32_t deduplicateSort(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+
+  /**
+    * \brief Number of bytes of scratch memory deduplicateSort needs for a value range
+    *
+    * maxValue: largest value that will be deduplicated
+    */
+  inline size_t deduplicateSortScratchSize(const uint32_t maxValue) {
+    // Whole 64 byte blocks, so the flags can be scanned with full width vector loads
+    return (static_cast<size_t>(maxValue) / 64 + 1) * 64;
+  }
+
+  /**
+    * \brief Hashes elements gathered from a strided array, (H = XXH3(S[I[0]], S[I[1]], ...))
+    *
+    * pBase: base pointer of the array
+    * stride: byte stride of the elements within the array
+    * elementSize: number of bytes to hash of each element
+    * indices: indices of the elements to hash, or nullptr to hash the first count elements
+    * count: number of elements to hash
+    * scratchSegmentHashes: at least hashGatheredElementsScratchSize(count) entries, contents are overwritten
+    * parallelThreshold: element count from which the work is split across threads, 0 never splits
+    *
+    * Elements are copied into a small contiguous block which is streamed into a single XXH3
+    * state.  Element counts larger than a segment (64k elements) hash each segment independently
+    * and combine the segment hashes, so the result never depends on the number of threads used.
+    *
+    * Supports unsigned 32-bit and 16-bit indices.  All other uses undefined.
+    */
+  template<typename T>
+  uint64_t hashGatheredElements(const uint8_t* pBase, const size_t stride, const size_t elementSize, const T* indices, const uint32_t count, uint64_t* scratchSegmentHashes, const uint32_t parallelThreshold = 0);
+
+  /**
+    * \brief Number of scratch entries hashGatheredElements needs for a given element count
+    */
+  inline size_t hashGatheredElementsScratchSize(const uint32_t count) {
+    // One hash per 64k element segment
+    return (static_cast<size_t>(count) + 0xffff) >> 16;
+  }
+
+  /**
+    * \brief Extends a bounding box by an array of strided positions, (min = min(min, P[i].xyz), max = max(max, P[i].xyz))
+    *
+    * pPositions: pointer to the first position, three floats
+    * stride: byte stride of the positions within the array, at least 12 bytes
+    * count: number of positions
+    * minPos: minimum of the bounding box, extended in place
+    * maxPos: maximum of the bounding box, extended in place
+    *
+    * Only the 12 bytes of the last position are read, so the array may end right after it.
+    */
+  void extendBoundingBox(const uint8_t* pPositions, const size_t stride, const uint32_t count, float minPos[3], float maxPos[3]);
+
+  /**
+    * \brief Extends a value range by the leading bytes of strided elements, e.g. the bone indices of vertices
+    *
+    * pData: pointer to the first element
+    * stride: byte stride of the elements within the array, at least 4 bytes
+    * count: number of elements
+    * bytesPerElement: number of leading bytes to include of each element, 1 to 4
+    * minValue: minimum of the range, extended in place
+    * maxValue: maximum of the range, extended in place
+    *
+    * Only bytesPerElement bytes of the last element are read, so the array may end right after them.
+    */
+  void extendByteRange(const uint8_t* pData, const size_t stride, const uint32_t count, const uint32_t bytesPerElement, uint8_t& minValue, uint8_t& maxValue);
+
   /**
     * \brief Memory copy function that uses threads internally, can be useful for very large memcpy's
     *
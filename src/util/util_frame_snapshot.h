@@ -0,0 +1,177 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <atomic>
+#include <cassert>
+#include <cstring>
+#include <functional>
+#include <mutex>
+#include <thread>
+#include <type_traits>
+#include <vector>
+
+namespace dxvk {
+  /**
+   * \brief Double buffered value published once per frame
+   *
+   * The producer publishes a new value into the inactive buffer and swaps
+   * buffers with a single atomic store. Values are compared bytewise, so T
+   * should be value-initialized before its members are set to keep padding
+   * zeroed.
+   *
+   * Only the publishing thread reads the value in place through \c get,
+   * where it can not race a publish. Readers on other threads take a
+   * \c copy at their own frame boundary and keep using that copy, as a
+   * reference could be overwritten by any later publish. Listeners are
+   * notified on the publishing thread when the value changed.
+   */
+  template<typename T>
+  class FrameSnapshot {
+    static_assert(std::is_trivially_copyable_v<T>, "Frame snapshots are copied and compared bytewise");
+  public:
+    using Listener = std::function<void(const T& previous, const T& current)>;
+
+    explicit FrameSnapshot(const T& initial = T()) {
+      std::memcpy(&m_values[0], &initial, sizeof(T));
+      std::memcpy(&m_values[1], &initial, sizeof(T));
+    }
+
+    FrameSnapshot(const FrameSnapshot&) = delete;
+    FrameSnapshot& operator=(const FrameSnapshot&) = delete;
+
+    /**
+     * \brief Last published value, on the publishing thread only
+     *
+     * The reference stays valid until the publish after the next changing one.
+     */
+    const T& get() const {
+      assert(isPublishingThread());
+      return m_values[m_current.load(std::memory_order_acquire)];
+    }
+
+    /**
+     * \brief Copy of the last published value, on any thread
+     */
+    T copy() const {
+      std::lock_guard<std::mutex> lock(m_valueMutex);
+      return m_values[m_current.load(std::memory_order_relaxed)];
+    }
+
+    /**
+     * \brief Sets the value without notifying listeners
+     *
+     * Meant for the initial value before any reader exists, the calling
+     * thread does not become the publishing thread.
+     * \param [in] value The new value
+     */
+    void reset(const T& value) {
+      std::lock_guard<std::mutex> lock(m_valueMutex);
+      std::memcpy(&m_values[0], &value, sizeof(T));
+      std::memcpy(&m_values[1], &value, sizeof(T));
+    }
+
+    /**
+     * \brief Number of publishes which changed the value
+     */
+    uint64_t getVersion() const {
+      return m_version.load(std::memory_order_acquire);
+    }
+
+    /**
+     * \brief Publishes a value, must only be called from one thread at a time
+     *
+     * \param [in] value The new value
+     * \returns \c true if the value differs from the last published one
+     */
+    bool publish(const T& value) {
+      m_publishingThread.store(std::this_thread::get_id(), std::memory_order_relaxed);
+
+      const uint32_t current = m_current.load(std::memory_order_relaxed);
+
+      if (std::memcmp(&m_values[current], &value, sizeof(T)) == 0) {
+        return false;
+      }
+
+      const uint32_t next = current ^ 1;
+
+      { std::lock_guard<std::mutex> lock(m_valueMutex);
+        std::memcpy(&m_values[next], &value, sizeof(T));
+        m_current.store(next, std::memory_order_release);
+      }
+
+      m_version.fetch_add(1, std::memory_order_release);
+
+      std::lock_guard<std::mutex> lock(m_listenerMutex);
+
+      for (const auto& [id, listener] : m_listeners) {
+        listener(m_values[current], m_values[next]);
+      }
+
+      return true;
+    }
+
+    /**
+     * \brief Registers a function called whenever a changed value is published
+     *
+     * Listeners must not add or remove listeners themselves.
+     * \param [in] listener Called with the previous and the new value
+     * \returns Id to remove the listener with
+     */
+    uint32_t addListener(Listener listener) {
+      std::lock_guard<std::mutex> lock(m_listenerMutex);
+      const uint32_t id = m_nextListenerId++;
+      m_listeners.emplace_back(id, std::move(listener));
+      return id;
+    }
+
+    void removeListener(uint32_t id) {
+      std::lock_guard<std::mutex> lock(m_listenerMutex);
+
+      for (auto it = m_listeners.begin(); it != m_listeners.end(); ++it) {
+        if (it->first == id) {
+          m_listeners.erase(it);
+          return;
+        }
+      }
+    }
+
+  private:
+    T m_values[2];
+    std::atomic<uint32_t> m_current = { 0 };
+    std::atomic<uint64_t> m_version = { 0 };
+
+    // Note: Only guards against copies on other threads, the publishing thread reads without it.
+    mutable std::mutex m_valueMutex;
+    std::atomic<std::thread::id> m_publishingThread = { std::thread::id() };
+
+    bool isPublishingThread() const {
+      // Note: Before the first publish no other thread writes, so any thread may read.
+      const std::thread::id publisher = m_publishingThread.load(std::memory_order_relaxed);
+      return publisher == std::thread::id() || publisher == std::this_thread::get_id();
+    }
+
+    std::mutex m_listenerMutex;
+    std::vector<std::pair<uint32_t, Listener>> m_listeners;
+    uint32_t m_nextListenerId = 0;
+  };
+}
@@ -0,0 +1,395 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+#include <algorithm>
+#include <atomic>
+#include <functional>
+#include <memory>
+#include <mutex>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Cache of pre-allocated items for a single thread
+   *
+   * Keeps one magazine of up to \c capacity items per key. Allocations pop
+   * from the magazine and frees push to it, an empty magazine is refilled
+   * with half its capacity from the backend and a full one flushes half of
+   * its items back, so the backend, and whatever lock it takes, is only hit
+   * once per batch. The backend provides:
+   *
+   *   uint32_t refill(const Key& key, Item* items, uint32_t count);
+   *   void flush(const Key& key, const Item* items, uint32_t count);
+   *
+   * where \c refill returns the number of items it could provide. Meant to
+   * be owned by one thread, see \c ThreadCacheRegistry. Not thread safe.
+   */
+  template<typename Key, typename Item>
+  class MagazineCache {
+  public:
+    struct Stats {
+      uint64_t hits = 0;      // allocations served from a magazine
+      uint64_t refills = 0;   // batches taken from the backend
+      uint64_t flushes = 0;   // batches returned to the backend
+    };
+
+    explicit MagazineCache(uint32_t capacity)
+    : m_capacity(std::max(capacity, 2u)) { }
+
+    /**
+     * \brief Takes an item from the magazine of a key
+     *
+     * \param [in] key Key of the item
+     * \param [in] backend Refills the magazine if it is empty
+     * \param [out] item The item
+     * \returns \c false if the backend ran out of items
+     */
+    template<typename Backend>
+    bool alloc(const Key& key, Backend& backend, Item& item) {
+      Magazine& magazine = getMagazine(key);
+
+      if (magazine.count == 0) {
+        magazine.count = backend.refill(key, magazine.items.data(), m_capacity / 2);
+        m_stats.refills += 1;
+
+        if (magazine.count == 0) {
+          return false;
+        }
+      } else {
+        m_stats.hits += 1;
+      }
+
+      item = magazine.items[--magazine.count];
+      return true;
+    }
+
+    /**
+     * \brief Returns an item to the magazine of a key
+     *
+     * \param [in] key Key of the item
+     * \param [in] backend Takes half the items if the magazine is full
+     * \param [in] item The item
+     */
+    template<typename Backend>
+    void free(const Key& key, Backend& backend, const Item& item) {
+      Magazine& magazine = getMagazine(key);
+
+      if (magazine.count == m_capacity) {
+        // Return the oldest half, recently freed items are more likely to be hot
+        const uint32_t count = m_capacity / 2;
+        backend.flush(key, magazine.items.data(), count);
+        std::move(magazine.items.begin() + count, magazine.items.end(), magazine.items.begin());
+        magazine.count -= count;
+        m_stats.flushes += 1;
+      }
+
+      magazine.items[magazine.count++] = item;
+    }
+
+    /**
+     * \brief Returns all items to the backend
+     */
+    template<typename Backend>
+    void flush(Backend& backend) {
+      for (Magazine& magazine : m_magazines) {
+        if (magazine.count != 0) {
+          backend.flush(magazine.key, magazine.items.data(), magazine.count);
+          magazine.count = 0;
+          m_stats.flushes += 1;
+        }
+      }
+    }
+
+    /**
+     * \brief Number of items held across all magazines
+     */
+    size_t size() const {
+      size_t count = 0;
+
+      for (const Magazine& magazine : m_magazines) {
+        count += magazine.count;
+      }
+
+      return count;
+    }
+
+    const Stats& getStats() const {
+      return m_stats;
+    }
+
+  private:
+    struct Magazine {
+      Key key;
+      uint32_t count;
+      std::vector<Item> items;
+    };
+
+    uint32_t m_capacity;
+    Stats m_stats;
+
+    // Only a handful of keys are in use, so these are searched linearly
+    std::vector<Magazine> m_magazines;
+    size_t m_lastMagazine = 0;
+
+    Magazine& getMagazine(const Key& key) {
+      if (m_lastMagazine < m_magazines.size() && m_magazines[m_lastMagazine].key == key) {
+        return m_magazines[m_lastMagazine];
+      }
+
+      for (size_t i = 0; i < m_magazines.size(); ++i) {
+        if (m_magazines[i].key == key) {
+          m_lastMagazine = i;
+          return m_magazines[i];
+        }
+      }
+
+      m_lastMagazine = m_magazines.size();
+      return m_magazines.emplace_back(Magazine { key, 0, std::vector<Item>(m_capacity) });
+    }
+  };
+
+
+  /**
+   * \brief Size classes of cached slices
+   *
+   * Classes go up in half powers of two from \c MinSize. Even classes
+   * are a power of two and aligned to their size. Odd classes are 1.5
+   * times the class below and aligned to half of that, the largest
+   * power of two their size is a multiple of, so that carving a slice
+   * at its class size and alignment needs no padding. A request that
+   * is aligned to at most half its size thus wastes less than a third.
+   */
+  template<uint64_t MinSize>
+  struct SliceSizeClasses {
+    static_assert((MinSize & (MinSize - 1)) == 0 && MinSize >= 2);
+
+    static uint64_t align(uint32_t sizeClass) {
+      const uint64_t base = MinSize << (sizeClass / 2);
+      return (sizeClass & 1) ? base / 2 : base;
+    }
+
+    static uint64_t size(uint32_t sizeClass) {
+      const uint64_t base = MinSize << (sizeClass / 2);
+      return (sizeClass & 1) ? base + base / 2 : base;
+    }
+
+    /**
+     * \brief Smallest class that fits a request
+     *
+     * \param [in] size Size of the request
+     * \param [in] align Alignment of the request
+     */
+    static uint32_t find(uint64_t size, uint64_t align) {
+      uint32_t sizeClass = 0;
+
+      while (SliceSizeClasses::size(sizeClass) < size || SliceSizeClasses::align(sizeClass) < align)
+        sizeClass++;
+
+      return sizeClass;
+    }
+  };
+
+
+  /**
+   * \brief Hands every thread its own cache object
+   *
+   * Each cache has its own lock, which only its thread takes unless the
+   * caches are trimmed, so it is uncontended in the common case. Caches
+   * live as long as the registry, caches of threads that exited are handed
+   * back through \c trim and \c trimIdle so that whatever they hold can
+   * be returned.
+   */
+  template<typename Cache>
+  class ThreadCacheRegistry {
+    struct Entry {
+      explicit Entry(Cache&& c) : cache(std::move(c)) { }
+
+      std::mutex mutex;
+      Cache cache;
+      std::atomic<uint32_t> lastUsedTick = { 0 };
+      std::atomic<bool> threadExited = { false };
+      std::atomic<bool> registryDestroyed = { false };
+    };
+
+    struct ThreadEntries {
+      std::vector<std::pair<uint64_t, std::shared_ptr<Entry>>> entries;
+
+      ~ThreadEntries() {
+        for (auto& entry : entries) {
+          entry.second->threadExited.store(true, std::memory_order_release);
+        }
+      }
+    };
+
+  public:
+    /**
+     * \brief Locked cache of one thread
+     */
+    class Access {
+    public:
+      explicit Access(Entry& entry)
+      : m_lock(entry.mutex), m_cache(&entry.cache) { }
+
+      Cache& operator * () const { return *m_cache; }
+      Cache* operator -> () const { return m_cache; }
+
+    private:
+      std::unique_lock<std::mutex> m_lock;
+      Cache* m_cache;
+    };
+
+    explicit ThreadCacheRegistry(std::function<Cache()> createCache)
+    : m_createCache(std::move(createCache)) { }
+
+    ~ThreadCacheRegistry() {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (auto& entry : m_entries) {
+        entry->registryDestroyed.store(true, std::memory_order_release);
+      }
+    }
+
+    ThreadCacheRegistry(const ThreadCacheRegistry&) = delete;
+    ThreadCacheRegistry& operator=(const ThreadCacheRegistry&) = delete;
+
+    /**
+     * \brief Cache of the calling thread
+     *
+     * The cache stays locked until the returned object is
+     * destroyed, so it must not be held across frames.
+     * \returns The locked cache
+     */
+    Access get() {
+      Entry* entry = nullptr;
+
+      for (auto& threadEntry : s_threadEntries.entries) {
+        if (threadEntry.first == m_id) {
+          entry = threadEntry.second.get();
+          break;
+        }
+      }
+
+      if (entry == nullptr) {
+        entry = registerThread();
+      }
+
+      entry->lastUsedTick.store(m_tick.load(std::memory_order_relaxed), std::memory_order_relaxed);
+      return Access(*entry);
+    }
+
+    /**
+     * \brief Trims the caches of all threads
+     *
+     * Waits for threads that are using their cache. Caches of threads
+     * that exited are removed from the registry afterwards.
+     * \param [in] fn Called for each cache
+     */
+    template<typename Fn>
+    void trim(const Fn& fn) {
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        {
+          std::lock_guard<std::mutex> entryLock((*it)->mutex);
+          fn((*it)->cache);
+        }
+
+        if ((*it)->threadExited.load(std::memory_order_acquire)) {
+          it = m_entries.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+    /**
+     * \brief Trims the caches of idle threads
+     *
+     * Meant to be called once per frame. Trims the caches that were not
+     * used since the previous call, skipping any that are in use right now,
+     * and removes the caches of threads that exited.
+     * \param [in] fn Called for each idle cache
+     */
+    template<typename Fn>
+    void trimIdle(const Fn& fn) {
+      const uint32_t tick = m_tick.fetch_add(1, std::memory_order_relaxed);
+
+      std::lock_guard<std::mutex> lock(m_mutex);
+
+      for (auto it = m_entries.begin(); it != m_entries.end(); ) {
+        const bool exited = (*it)->threadExited.load(std::memory_order_acquire);
+
+        if (exited || (*it)->lastUsedTick.load(std::memory_order_relaxed) != tick) {
+          std::unique_lock<std::mutex> entryLock((*it)->mutex, std::try_to_lock);
+
+          if (entryLock.owns_lock()) {
+            fn((*it)->cache);
+          }
+        }
+
+        if (exited) {
+          it = m_entries.erase(it);
+        } else {
+          ++it;
+        }
+      }
+    }
+
+  private:
+    // Ids are never reused, so threads can not mistake a new registry for a destroyed one
+    static inline std::atomic<uint64_t> s_nextId = { 1 };
+    static inline thread_local ThreadEntries s_threadEntries;
+
+    const uint64_t m_id = s_nextId.fetch_add(1);
+    std::function<Cache()> m_createCache;
+    std::atomic<uint32_t> m_tick = { 0 };
+
+    std::mutex m_mutex;
+    std::vector<std::shared_ptr<Entry>> m_entries;
+
+    Entry* registerThread() {
+      auto& entries = s_threadEntries.entries;
+
+      // Drop the caches of destroyed registries while we're here
+      entries.erase(std::remove_if(entries.begin(), entries.end(),
+        [] (const auto& threadEntry) { return threadEntry.second->registryDestroyed.load(std::memory_order_acquire); }),
+        entries.end());
+
+      auto entry = std::make_shared<Entry>(m_createCache());
+
+      {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_entries.push_back(entry);
+      }
+
+      entries.emplace_back(m_id, entry);
+      return entry.get();
+    }
+  };
+
+}
@@ -0,0 +1,188 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include "util_mapped_file.h"
+
+#include <algorithm>
+#include <utility>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+namespace dxvk {
+
+  namespace {
+    uint64_t getPageSize() {
+#ifdef _WIN32
+      SYSTEM_INFO info = { };
+      ::GetSystemInfo(&info);
+      return info.dwPageSize;
+#else
+      return static_cast<uint64_t>(::sysconf(_SC_PAGESIZE));
+#endif
+    }
+  }
+
+  MappedFile::MappedFile(MappedFile&& other) noexcept {
+    *this = std::move(other);
+  }
+
+  MappedFile& MappedFile::operator=(MappedFile&& other) noexcept {
+    if (this != &other) {
+      unmap();
+
+      m_data = std::exchange(other.m_data, nullptr);
+      m_size = std::exchange(other.m_size, 0);
+#ifdef _WIN32
+      m_mapping = std::exchange(other.m_mapping, nullptr);
+#endif
+    }
+
+    return *this;
+  }
+
+  bool MappedFile::map(const std::string& filename) {
+    unmap();
+
+#ifdef _WIN32
+    HANDLE file = ::CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ,
+      nullptr, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, nullptr);
+
+    if (file == INVALID_HANDLE_VALUE)
+      return false;
+
+    LARGE_INTEGER fileSize;
+    if (!::GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0) {
+      ::CloseHandle(file);
+      return false;
+    }
+
+    // The mapping object keeps a reference to the file, the file handle
+    // itself is not needed past this point.
+    HANDLE mapping = ::CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+    ::CloseHandle(file);
+
+    if (mapping == nullptr)
+      return false;
+
+    void* data = ::MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (data == nullptr) {
+      ::CloseHandle(mapping);
+      return false;
+    }
+
+    m_mapping = mapping;
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = static_cast<uint64_t>(fileSize.QuadPart);
+#else
+    int fd = ::open(filename.c_str(), O_RDONLY);
+
+    if (fd < 0)
+      return false;
+
+    struct stat st;
+    if (::fstat(fd, &st) != 0 || st.st_size == 0) {
+      ::close(fd);
+      return false;
+    }
+
+    void* data = ::mmap(nullptr, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+
+    if (data == MAP_FAILED)
+      return false;
+
+    m_data = static_cast<const uint8_t*>(data);
+    m_size = static_cast<uint64_t>(st.st_size);
+#endif
+
+    return true;
+  }
+
+  void MappedFile::unmap() {
+    if (m_data == nullptr)
+      return;
+
+#ifdef _WIN32
+    ::UnmapViewOfFile(m_data);
+    ::CloseHandle(m_mapping);
+    m_mapping = nullptr;
+#else
+    ::munmap(const_cast<uint8_t*>(m_data), m_size);
+#endif
+
+    m_data = nullptr;
+    m_size = 0;
+  }
+
+  void MappedFile::discard(uint64_t offset, size_t size) const {
+    if (view(offset, size) == nullptr || size == 0)
+      return;
+
+    // Only the pages fully covered by the range can be released,
+    // the pages at the edges may be shared with neighbouring data.
+    static const uint64_t pageSize = getPageSize();
+    const uint64_t begin = (offset + pageSize - 1) & ~(pageSize - 1);
+    const uint64_t end = (offset + size) & ~(pageSize - 1);
+
+    if (begin >= end)
+      return;
+
+    void* ptr = const_cast<uint8_t*>(m_data + begin);
+
+#ifdef _WIN32
+    // Unlocking pages that are not locked removes them from the working set.
+    // The pages are clean, so the OS may reclaim them without writing back.
+    ::VirtualUnlock(ptr, end - begin);
+#else
+    ::madvise(ptr, end - begin, MADV_DONTNEED);
+#endif
+  }
+
+  void MappedFile::prefetch(uint64_t offset, size_t size) const {
+    if (view(offset, size) == nullptr || size == 0)
+      return;
+
+    static const uint64_t pageSize = getPageSize();
+    const uint64_t begin = offset & ~(pageSize - 1);
+    const uint64_t end = offset + size;
+
+#ifndef _WIN32
+    // Let the kernel issue the whole range as a single read-ahead
+    ::madvise(const_cast<uint8_t*>(m_data + begin), end - begin, MADV_WILLNEED);
+#endif
+
+    // Touch every page so that the reads complete on this thread
+    const volatile uint8_t* data = m_data;
+
+    for (uint64_t page = std::max(begin, offset); page < end; page = (page & ~(pageSize - 1)) + pageSize) {
+      (void) data[page];
+    }
+  }
+
+} // namespace dxvk
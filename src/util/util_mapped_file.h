@@ -0,0 +1,126 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include <string>
+
+namespace dxvk {
+
+  /**
+   * \brief Read-only memory mapped file
+   *
+   * Maps a whole file into the address space of the process so that
+   * the file contents can be accessed in place, without intermediate
+   * copies. Pages are faulted in from the OS file cache on first access
+   * and may be dropped from the working set at any time using discard().
+   * Pointers returned by view() are valid until the file is unmapped.
+   */
+  class MappedFile {
+  public:
+    MappedFile() = default;
+    ~MappedFile() {
+      unmap();
+    }
+
+    MappedFile(const MappedFile&) = delete;
+    MappedFile& operator=(const MappedFile&) = delete;
+
+    MappedFile(MappedFile&& other) noexcept;
+    MappedFile& operator=(MappedFile&& other) noexcept;
+
+    /**
+     * \brief Maps a file
+     *
+     * Unmaps the previously mapped file, if any.
+     * \param [in] filename Path to the file
+     * \returns \c true on success. Empty files cannot be mapped.
+     */
+    bool map(const std::string& filename);
+
+    /**
+     * \brief Unmaps the file
+     *
+     * Invalidates all pointers returned by view().
+     */
+    void unmap();
+
+    /**
+     * \brief Releases the physical pages backing a range
+     *
+     * Hints the OS that the pages fully covered by the range are not
+     * needed anymore. The mapping stays valid and the pages will be
+     * read from the file again if accessed later.
+     * \param [in] offset Offset of the range in the file
+     * \param [in] size Size of the range
+     */
+    void discard(uint64_t offset, size_t size) const;
+
+    /**
+     * \brief Reads a range into physical memory
+     *
+     * Faults in the pages covering the range on the calling thread,
+     * so that later accesses to the range do not wait for the disk.
+     * \param [in] offset Offset of the range in the file
+     * \param [in] size Size of the range
+     */
+    void prefetch(uint64_t offset, size_t size) const;
+
+    /**
+     * \brief Gets a pointer into the mapped file
+     *
+     * \param [in] offset Offset of the range in the file
+     * \param [in] size Size of the range
+     * \returns Pointer to the data or \c nullptr if the range
+     *   does not fit into the file or the file is not mapped.
+     */
+    const void* view(uint64_t offset, size_t size) const {
+      if (m_data == nullptr || offset > m_size || size > m_size - offset)
+        return nullptr;
+
+      return m_data + offset;
+    }
+
+    bool isMapped() const {
+      return m_data != nullptr;
+    }
+
+    const uint8_t* data() const {
+      return m_data;
+    }
+
+    uint64_t size() const {
+      return m_size;
+    }
+
+  private:
+    const uint8_t* m_data = nullptr;
+    uint64_t m_size = 0;
+
+#ifdef _WIN32
+    void* m_mapping = nullptr;
+#endif
+  };
+
+} // namespace dxvk
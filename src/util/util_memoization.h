@@ -1,75 +1,402 @@
-#include <map>
+#pragma once
+
+#include <stdint.h>
+
+#include <algorithm>
+#include <functional>
+#include <optional>
+#include <type_traits>
+#include <vector>
 
 namespace dxvk {
+  /**
+   * \brief Memoizes results of computations over memory ranges
+   *
+   * Results are kept in an interval tree keyed on their byte range, so that
+   * a query can be answered from an exact match or, if the caller knows how
+   * to derive it, from any cached range containing the queried one. Writes
+   * to the memory invalidate all overlapping results.
+   *
+   * Discarding the whole memory only bumps the write generation, results of
+   * older generations are never returned and are released in bulk on the next
+   * query, so repeated discards between queries are cheap. The number of
+   * results is bounded, the least recently used ones are evicted first.
+   */
   template<typename T>
   class MemoryRegionMemoizer {
+  public:
+    static constexpr size_t kDefaultCapacity = 256;
+
+    struct Stats {
+      uint64_t hits = 0;            // exact range matches
+      uint64_t containedHits = 0;   // results derived from a containing range
+      uint64_t misses = 0;          // results computed
+      uint64_t evictions = 0;       // results dropped to stay within capacity
+      uint64_t invalidations = 0;   // results dropped due to writes
+    };
+
+    explicit MemoryRegionMemoizer(size_t capacity = kDefaultCapacity)
+      : m_capacity(std::max<size_t>(capacity, 1)) { }
+
+    /**
+     * \brief Returns the cached result of the exact range or computes it
+     *
+     * \param [in] start Range start
+     * \param [in] size Range size
+     * \param [in] func Computes the result, T(size_t start, size_t size)
+     */
+    template<typename Func>
+    T memoize(size_t start, size_t size, Func&& func) {
+      return memoize(start, size, std::forward<Func>(func), nullptr);
+    }
+
+    /**
+     * \brief Returns a cached result of the range or computes it
+     *
+     * Without an exact match, results of ranges containing the queried range
+     * are passed to \c derive, which may return the result for the sub-range.
+     * \param [in] start Range start
+     * \param [in] size Range size
+     * \param [in] func Computes the result, T(size_t start, size_t size)
+     * \param [in] derive Derives the result from a containing range,
+     *   std::optional<T>(const T& result, size_t resultStart, size_t resultSize, size_t start, size_t size)
+     */
+    template<typename Func, typename Derive>
+    T memoize(size_t start, size_t size, Func&& func, Derive&& derive) {
+      if (m_sweptGeneration != m_generation) {
+        clear();
+        m_sweptGeneration = m_generation;
+      }
+
+      const size_t end = start + size;
+
+      uint32_t node = findExact(m_root, start, end);
+      if (node != kNil) {
+        ++m_stats.hits;
+        touch(node);
+        return m_nodes[node].result;
+      }
+
+      if constexpr (!std::is_same_v<std::decay_t<Derive>, std::nullptr_t>) {
+        std::optional<T> derived;
+        visitContaining(m_root, start, end, [&](uint32_t container) {
+          const Node& c = m_nodes[container];
+          derived = derive(c.result, c.start, c.end - c.start, start, size);
+          if (derived.has_value()) {
+            touch(container);
+            return false;
+          }
+          return true;
+        });
+
+        if (derived.has_value()) {
+          ++m_stats.containedHits;
+          insert(start, end, *derived);
+          return std::move(*derived);
+        }
+      }
+
+      ++m_stats.misses;
+      T result = std::invoke(func, start, size);
+      insert(start, end, result);
+      return result;
+    }
+
+    /**
+     * \brief Drops all results overlapping a written range
+     */
+    void invalidate(size_t start, size_t size) {
+      const size_t end = start + size;
+
+      m_scratch.clear();
+      visitOverlapping(m_root, start, end, [this](uint32_t node) {
+        m_scratch.push_back(node);
+      });
+
+      for (uint32_t node : m_scratch) {
+        remove(node);
+        ++m_stats.invalidations;
+      }
+    }
+
+    /**
+     * \brief Drops all results, e.g. when the memory is discarded
+     *
+     * Only bumps the write generation, the results are released on the next query.
+     */
+    void invalidateAll() {
+      ++m_generation;
+    }
+
+    uint64_t getGeneration() const {
+      return m_generation;
+    }
+
+    size_t size() const {
+      return m_sweptGeneration == m_generation ? m_size : 0;
+    }
+
+    const Stats& getStats() const {
+      return m_stats;
+    }
+
   private:
-    struct Range {
+    static constexpr uint32_t kNil = ~0u;
+
+    // Treap node, ordered by (start, end) and augmented with the largest end in its subtree
+    struct Node {
       size_t start = 0;
       size_t end = 0;
-      Range() = default;
-      Range(size_t s, size_t e) : start(s), end(e) { }
+      size_t maxEnd = 0;
+      uint32_t priority = 0;
+      uint32_t left = kNil;
+      uint32_t right = kNil;
+      uint32_t lruPrev = kNil;
+      uint32_t lruNext = kNil;
+      T result = T();
+    };
+
+    std::vector<Node> m_nodes;
+    std::vector<uint32_t> m_freeNodes;
+    std::vector<uint32_t> m_scratch;
+    uint32_t m_root = kNil;
+    uint32_t m_lruHead = kNil;     // most recently used
+    uint32_t m_lruTail = kNil;     // least recently used
+    size_t m_size = 0;
+    size_t m_capacity;
+
+    uint64_t m_generation = 0;
+    uint64_t m_sweptGeneration = 0;
+    uint32_t m_seed = 0x9E3779B9u;
 
-      bool contains(size_t point) const {
-        return start <= point && point < end;
+    Stats m_stats;
+
+    uint32_t nextPriority() {
+      // xorshift32
+      m_seed ^= m_seed << 13;
+      m_seed ^= m_seed >> 17;
+      m_seed ^= m_seed << 5;
+      return m_seed;
+    }
+
+    static bool isBefore(size_t startA, size_t endA, size_t startB, size_t endB) {
+      return startA < startB || (startA == startB && endA < endB);
+    }
+
+    size_t maxEnd(uint32_t node) const {
+      return node == kNil ? 0 : m_nodes[node].maxEnd;
+    }
+
+    void update(uint32_t node) {
+      Node& n = m_nodes[node];
+      n.maxEnd = std::max(n.end, std::max(maxEnd(n.left), maxEnd(n.right)));
+    }
+
+    uint32_t rotateRight(uint32_t node) {
+      const uint32_t left = m_nodes[node].left;
+      m_nodes[node].left = m_nodes[left].right;
+      m_nodes[left].right = node;
+      update(node);
+      update(left);
+      return left;
+    }
+
+    uint32_t rotateLeft(uint32_t node) {
+      const uint32_t right = m_nodes[node].right;
+      m_nodes[node].right = m_nodes[right].left;
+      m_nodes[right].left = node;
+      update(node);
+      update(right);
+      return right;
+    }
+
+    uint32_t insertNode(uint32_t root, uint32_t node) {
+      if (root == kNil) {
+        return node;
       }
 
-      bool overlaps(const Range& other) const {
-        return (start <= other.start && other.start < end) ||
-          (start < other.end&& other.end <= end) ||
-          (other.start <= start && end <= other.end);
+      const Node& n = m_nodes[node];
+      if (isBefore(n.start, n.end, m_nodes[root].start, m_nodes[root].end)) {
+        m_nodes[root].left = insertNode(m_nodes[root].left, node);
+        if (m_nodes[m_nodes[root].left].priority > m_nodes[root].priority) {
+          return rotateRight(root);
+        }
+      } else {
+        m_nodes[root].right = insertNode(m_nodes[root].right, node);
+        if (m_nodes[m_nodes[root].right].priority > m_nodes[root].priority) {
+          return rotateLeft(root);
+        }
       }
-    };
 
-    template<typename U>
-    struct CacheEntry {
-      Range range = {};
-      U result;
-      CacheEntry() = default;
-      CacheEntry(Range r, U res) : range(r), result(std::move(res)) { }
-    };
+      update(root);
+      return root;
+    }
 
-    std::map<size_t, CacheEntry<T>> cache;
+    uint32_t merge(uint32_t left, uint32_t right) {
+      if (left == kNil) {
+        return right;
+      }
+      if (right == kNil) {
+        return left;
+      }
 
-  public:
-    template<typename Func>
-    T memoize(size_t start, size_t size, Func&& func) {
-      const Range currentRange(start, start + size);
+      if (m_nodes[left].priority > m_nodes[right].priority) {
+        m_nodes[left].right = merge(m_nodes[left].right, right);
+        update(left);
+        return left;
+      }
 
-      auto it = cache.find(start);
-      if (it != cache.end() && it->second.range.start == currentRange.start && it->second.range.end == currentRange.end) {
-        // Exact match found, return cached result
-        return it->second.result;
+      m_nodes[right].left = merge(left, m_nodes[right].left);
+      update(right);
+      return right;
+    }
+
+    uint32_t eraseNode(uint32_t root, uint32_t node) {
+      if (root == node) {
+        return merge(m_nodes[root].left, m_nodes[root].right);
       }
 
-      // No exact match, invalidate all overlapping ranges
-      invalidate(currentRange.start, currentRange.end);
+      const Node& n = m_nodes[node];
+      if (isBefore(n.start, n.end, m_nodes[root].start, m_nodes[root].end)) {
+        m_nodes[root].left = eraseNode(m_nodes[root].left, node);
+      } else {
+        m_nodes[root].right = eraseNode(m_nodes[root].right, node);
+      }
 
-      // If we didn't find a usable cached result, compute and store the result
-      T result = std::invoke(func, start, size);
-      cache[start] = CacheEntry<T>(currentRange, result);
-      return result;
+      update(root);
+      return root;
     }
 
-    void invalidate(size_t start, size_t size) {
-      Range invalidRange(start, start + size);
-
-      // Find the first range overlapping range in cache
-      auto it = cache.lower_bound(start);
-      if (it != cache.begin()) --it;
-
-      // Erase overlapping ranges
-      while (it != cache.end() && it->second.range.start < invalidRange.end) {
-        if (it->second.range.overlaps(invalidRange)) {
-          it = cache.erase(it);
-        } else {
-          ++it;
+    uint32_t findExact(uint32_t node, size_t start, size_t end) const {
+      while (node != kNil) {
+        const Node& n = m_nodes[node];
+        if (n.start == start && n.end == end) {
+          return node;
         }
+        node = isBefore(start, end, n.start, n.end) ? n.left : n.right;
       }
+      return kNil;
     }
 
-    void invalidateAll() {
-      cache.clear();
+    // Visits nodes with start <= queryStart and end >= queryEnd, fn returns false to stop
+    template<typename Fn>
+    bool visitContaining(uint32_t node, size_t start, size_t end, Fn&& fn) {
+      if (node == kNil || m_nodes[node].maxEnd < end) {
+        return true;
+      }
+
+      if (!visitContaining(m_nodes[node].left, start, end, fn)) {
+        return false;
+      }
+
+      const Node& n = m_nodes[node];
+      if (n.start > start) {
+        return true;
+      }
+
+      if (n.end >= end && !fn(node)) {
+        return false;
+      }
+
+      return visitContaining(n.right, start, end, fn);
+    }
+
+    template<typename Fn>
+    void visitOverlapping(uint32_t node, size_t start, size_t end, Fn&& fn) const {
+      if (node == kNil || m_nodes[node].maxEnd <= start) {
+        return;
+      }
+
+      visitOverlapping(m_nodes[node].left, start, end, fn);
+
+      const Node& n = m_nodes[node];
+      if (n.start >= end) {
+        return;
+      }
+
+      if (n.end > start) {
+        fn(node);
+      }
+
+      visitOverlapping(n.right, start, end, fn);
+    }
+
+    void lruUnlink(uint32_t node) {
+      Node& n = m_nodes[node];
+      if (n.lruPrev != kNil) {
+        m_nodes[n.lruPrev].lruNext = n.lruNext;
+      } else {
+        m_lruHead = n.lruNext;
+      }
+      if (n.lruNext != kNil) {
+        m_nodes[n.lruNext].lruPrev = n.lruPrev;
+      } else {
+        m_lruTail = n.lruPrev;
+      }
+      n.lruPrev = n.lruNext = kNil;
+    }
+
+    void lruPushFront(uint32_t node) {
+      Node& n = m_nodes[node];
+      n.lruPrev = kNil;
+      n.lruNext = m_lruHead;
+      if (m_lruHead != kNil) {
+        m_nodes[m_lruHead].lruPrev = node;
+      }
+      m_lruHead = node;
+      if (m_lruTail == kNil) {
+        m_lruTail = node;
+      }
+    }
+
+    void touch(uint32_t node) {
+      if (m_lruHead != node) {
+        lruUnlink(node);
+        lruPushFront(node);
+      }
+    }
+
+    void insert(size_t start, size_t end, const T& result) {
+      while (m_size >= m_capacity) {
+        remove(m_lruTail);
+        ++m_stats.evictions;
+      }
+
+      uint32_t node;
+      if (!m_freeNodes.empty()) {
+        node = m_freeNodes.back();
+        m_freeNodes.pop_back();
+      } else {
+        node = static_cast<uint32_t>(m_nodes.size());
+        m_nodes.emplace_back();
+      }
+
+      Node& n = m_nodes[node];
+      n.start = start;
+      n.end = end;
+      n.maxEnd = end;
+      n.priority = nextPriority();
+      n.left = n.right = kNil;
+      n.result = result;
+
+      m_root = insertNode(m_root, node);
+      lruPushFront(node);
+      ++m_size;
+    }
+
+    void remove(uint32_t node) {
+      m_root = eraseNode(m_root, node);
+      lruUnlink(node);
+      m_nodes[node].result = T();
+      m_freeNodes.push_back(node);
+      --m_size;
+    }
+
+    void clear() {
+      m_nodes.clear();
+      m_freeNodes.clear();
+      m_root = m_lruHead = m_lruTail = kNil;
+      m_size = 0;
     }
   };
-}
\ No newline at end of file
+}
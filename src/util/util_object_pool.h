@@ -0,0 +1,219 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Typed slab allocator with persistent and transient objects
+   *
+   * Objects are constructed in place in fixed size slabs which are
+   * never freed while the pool lives, so object addresses are stable.
+   *
+   * Persistent objects are released individually, their cells go to a
+   * free list and are reused by the next allocations. Transient objects
+   * are bump allocated from separate slabs and all of them are destroyed
+   * at once by \c releaseTransient, e.g. once per frame.
+   *
+   * Not thread safe.
+   */
+  template<typename T, uint32_t SlabSize = 256>
+  class ObjectPool {
+    static_assert(SlabSize > 0, "Slabs must hold at least one object!");
+
+  public:
+    struct Stats {
+      size_t liveObjects = 0;       // persistent and transient objects alive
+      size_t transientObjects = 0;  // transient objects alive
+      size_t capacity = 0;          // objects all slabs can hold
+      uint64_t allocations = 0;     // objects constructed since creation
+      uint64_t releases = 0;        // objects destroyed since creation
+    };
+
+    ObjectPool() = default;
+
+    ~ObjectPool() {
+      releaseTransient();
+
+      for (auto& slab : m_slabs) {
+        for (uint32_t i = 0; i < SlabSize; ++i) {
+          if (slab[i].alive) {
+            slab[i].object()->~T();
+          }
+        }
+      }
+    }
+
+    ObjectPool(const ObjectPool&) = delete;
+    ObjectPool& operator=(const ObjectPool&) = delete;
+
+    /**
+     * \brief Constructs a persistent object
+     *
+     * \param [in] args Constructor arguments
+     * \returns The object, valid until it is released
+     */
+    template<typename... Args>
+    T* allocate(Args&&... args) {
+      if (m_freeList == nullptr) {
+        addSlab();
+      }
+
+      Cell* cell = m_freeList;
+      T* object = new (cell->storage) T(std::forward<Args>(args)...);
+
+      m_freeList = cell->nextFree;
+      cell->nextFree = nullptr;
+      cell->alive = true;
+
+      ++m_stats.liveObjects;
+      ++m_stats.allocations;
+      return object;
+    }
+
+    /**
+     * \brief Constructs a transient object
+     *
+     * \param [in] args Constructor arguments
+     * \returns The object, valid until the next \c releaseTransient
+     */
+    template<typename... Args>
+    T* allocateTransient(Args&&... args) {
+      const size_t slab = m_transientCount / SlabSize;
+
+      if (slab == m_transientSlabs.size()) {
+        m_transientSlabs.emplace_back(new Cell[SlabSize]);
+        m_stats.capacity += SlabSize;
+      }
+
+      Cell* cell = &m_transientSlabs[slab][m_transientCount % SlabSize];
+      T* object = new (cell->storage) T(std::forward<Args>(args)...);
+
+      cell->alive = true;
+      cell->transient = true;
+      ++m_transientCount;
+
+      ++m_stats.liveObjects;
+      ++m_stats.transientObjects;
+      ++m_stats.allocations;
+      return object;
+    }
+
+    /**
+     * \brief Destroys a persistent object
+     *
+     * \param [in] object Object returned by \c allocate
+     */
+    void release(T* object) {
+      Cell* cell = Cell::fromObject(object);
+      assert(cell->alive && !cell->transient);
+
+      object->~T();
+
+      cell->alive = false;
+      cell->nextFree = m_freeList;
+      m_freeList = cell;
+
+      --m_stats.liveObjects;
+      ++m_stats.releases;
+    }
+
+    /**
+     * \brief Destroys all transient objects
+     *
+     * Objects are destroyed in allocation order, their memory is
+     * kept for the transient objects allocated afterwards.
+     */
+    void releaseTransient() {
+      for (size_t i = 0; i < m_transientCount; ++i) {
+        Cell& cell = m_transientSlabs[i / SlabSize][i % SlabSize];
+        cell.object()->~T();
+        cell.alive = false;
+      }
+
+      m_stats.liveObjects -= m_transientCount;
+      m_stats.transientObjects = 0;
+      m_stats.releases += m_transientCount;
+      m_transientCount = 0;
+    }
+
+    /**
+     * \brief Checks whether an object was allocated as transient
+     */
+    static bool isTransient(const T* object) {
+      return Cell::fromObject(const_cast<T*>(object))->transient;
+    }
+
+    size_t size() const {
+      return m_stats.liveObjects;
+    }
+
+    const Stats& getStats() const {
+      return m_stats;
+    }
+
+  private:
+    // Object storage first, so that object and cell addresses are the same
+    struct Cell {
+      alignas(T) uint8_t storage[sizeof(T)];
+      Cell* nextFree = nullptr;
+      bool alive = false;
+      bool transient = false;
+
+      T* object() {
+        return std::launder(reinterpret_cast<T*>(storage));
+      }
+
+      static Cell* fromObject(T* object) {
+        return reinterpret_cast<Cell*>(object);
+      }
+    };
+
+    std::vector<std::unique_ptr<Cell[]>> m_slabs;
+    std::vector<std::unique_ptr<Cell[]>> m_transientSlabs;
+    Cell* m_freeList = nullptr;
+    size_t m_transientCount = 0;
+
+    Stats m_stats;
+
+    void addSlab() {
+      Cell* slab = m_slabs.emplace_back(new Cell[SlabSize]).get();
+
+      // Link in reverse, so that cells of a new slab are handed out in address order
+      for (uint32_t i = SlabSize; i > 0; --i) {
+        slab[i - 1].nextFree = m_freeList;
+        m_freeList = &slab[i - 1];
+      }
+
+      m_stats.capacity += SlabSize;
+    }
+  };
+
+} // namespace dxvk
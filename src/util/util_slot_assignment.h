@@ -0,0 +1,109 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+
+#include <array>
+#include <cassert>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Assigns items to slots, keeping the slots they had before
+   *
+   * Slots are grouped into one range per item type, with the ranges laid
+   * out back to back in type order. An item keeps its previous slot when
+   * that slot lies within the range of its type this time, e.g. so that the
+   * data uploaded for it stays valid. All other items fill the free slots of
+   * their range in item order. Not thread safe.
+   *
+   * \param [in] itemCount Number of items
+   * \param [in] getType Type of an item, uint32_t(uint32_t item), below NumTypes
+   * \param [in] getPreviousSlot Previous slot of an item, uint32_t(uint32_t item),
+   *   any slot outside the range of the item's type counts as no slot
+   * \param [out] ranges Offset and item count of the slots of each type
+   * \param [out] slots Item occupying each slot, itemCount slots in total
+   * \param [out] unplacedItems Scratch memory, holds the items that moved
+   */
+  template<typename Range, size_t NumTypes, typename TypeFn, typename SlotFn>
+  void assignStableSlots(
+          uint32_t                      itemCount,
+          TypeFn&&                      getType,
+          SlotFn&&                      getPreviousSlot,
+          std::array<Range, NumTypes>&  ranges,
+          std::vector<uint32_t>&        slots,
+          std::vector<uint32_t>&        unplacedItems) {
+    static constexpr uint32_t kFreeSlot = ~0u;
+
+    // Count the items of each type and arrange the ranges of each type sequentially
+
+    ranges.fill(Range {});
+    for (uint32_t item = 0; item < itemCount; ++item) {
+      ++ranges[getType(item)].count;
+    }
+
+    uint32_t offset = 0;
+    for (Range& range : ranges) {
+      range.offset = offset;
+      offset += range.count;
+    }
+
+    assert(offset == itemCount);
+
+    // Keep each item in its previous slot if that slot is still within the range of its type
+
+    slots.assign(itemCount, kFreeSlot);
+    unplacedItems.clear();
+
+    for (uint32_t item = 0; item < itemCount; ++item) {
+      const Range& range = ranges[getType(item)];
+      const uint32_t previousSlot = getPreviousSlot(item);
+
+      if (previousSlot >= range.offset && previousSlot - range.offset < range.count &&
+          slots[previousSlot] == kFreeSlot) {
+        slots[previousSlot] = item;
+      } else {
+        unplacedItems.push_back(item);
+      }
+    }
+
+    // Fill the remaining slots with new items and items whose slot was taken by another type
+
+    std::array<uint32_t, NumTypes> nextFreeSlot;
+    for (size_t type = 0; type < NumTypes; ++type) {
+      nextFreeSlot[type] = ranges[type].offset;
+    }
+
+    for (uint32_t item : unplacedItems) {
+      uint32_t& slot = nextFreeSlot[getType(item)];
+
+      while (slots[slot] != kFreeSlot) {
+        ++slot;
+      }
+
+      slots[slot] = item;
+    }
+  }
+
+}
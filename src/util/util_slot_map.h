@@ -0,0 +1,378 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+#include <memory>
+#include <new>
+#include <utility>
+#include <vector>
+
+namespace dxvk {
+
+  /**
+   * \brief Slot map with stable object addresses
+   *
+   * Objects are constructed in place in fixed size chunks and never
+   * move, so pointers to live objects stay valid until the object is
+   * erased. Freed slots are reused. Each slot carries a generation
+   * counter that is bumped on erase, handles to erased objects are
+   * detected and resolve to \c nullptr.
+   *
+   * Slot state is kept in a contiguous array, so visiting all live
+   * objects is a linear scan.
+   */
+  template<typename T, uint32_t ChunkSize = 256>
+  class SlotMap {
+    static_assert((ChunkSize & (ChunkSize - 1)) == 0, "Chunk size must be a power of two!");
+
+  public:
+    static constexpr uint32_t kInvalidIndex = ~0u;
+
+    struct Handle {
+      uint32_t index = kInvalidIndex;
+      uint32_t generation = 0;
+
+      bool operator==(const Handle& other) const {
+        return index == other.index && generation == other.generation;
+      }
+
+      bool operator!=(const Handle& other) const {
+        return !(*this == other);
+      }
+    };
+
+    SlotMap() = default;
+
+    ~SlotMap() {
+      clear();
+    }
+
+    SlotMap(const SlotMap&) = delete;
+    SlotMap& operator=(const SlotMap&) = delete;
+
+    /**
+     * \brief Constructs an object in a free slot
+     *
+     * \param [in] args Constructor arguments
+     * \returns Handle of the new object
+     */
+    template<typename... Args>
+    Handle emplace(Args&&... args) {
+      uint32_t index;
+
+      if (!m_freeSlots.empty()) {
+        index = m_freeSlots.back();
+        m_freeSlots.pop_back();
+      } else {
+        index = static_cast<uint32_t>(m_slots.size());
+
+        if (index % ChunkSize == 0) {
+          m_chunks.emplace_back(new Chunk);
+        }
+
+        m_slots.push_back({ 0, false });
+      }
+
+      new (ptr(index)) T(std::forward<Args>(args)...);
+
+      m_slots[index].alive = true;
+      ++m_size;
+
+      return { index, m_slots[index].generation };
+    }
+
+    /**
+     * \brief Destroys an object
+     *
+     * Invalidates all handles and pointers to the object.
+     * \param [in] index Slot index of a live object
+     */
+    void erase(uint32_t index) {
+      assert(isAlive(index));
+
+      ptr(index)->~T();
+
+      m_slots[index].alive = false;
+      m_slots[index].generation++;
+      m_freeSlots.push_back(index);
+      --m_size;
+    }
+
+    void erase(const Handle& handle) {
+      if (get(handle) != nullptr) {
+        erase(handle.index);
+      }
+    }
+
+    /**
+     * \brief Destroys all objects
+     *
+     * Memory is kept around for reuse.
+     */
+    void clear() {
+      for (uint32_t index = 0; index < m_slots.size(); ++index) {
+        if (m_slots[index].alive) {
+          erase(index);
+        }
+      }
+    }
+
+    /**
+     * \brief Resolves a handle
+     *
+     * \param [in] handle Object handle
+     * \returns Pointer to the object or \c nullptr
+     *   if the object has been erased.
+     */
+    T* get(const Handle& handle) const {
+      if (handle.index >= m_slots.size() ||
+          !m_slots[handle.index].alive ||
+          m_slots[handle.index].generation != handle.generation) {
+        return nullptr;
+      }
+
+      return ptr(handle.index);
+    }
+
+    Handle getHandle(uint32_t index) const {
+      assert(isAlive(index));
+      return { index, m_slots[index].generation };
+    }
+
+    bool isAlive(uint32_t index) const {
+      return index < m_slots.size() && m_slots[index].alive;
+    }
+
+    T& operator[](uint32_t index) const {
+      assert(isAlive(index));
+      return *ptr(index);
+    }
+
+    /**
+     * \brief Visits all live objects
+     *
+     * Objects may be erased from within the callback.
+     * \param [in] fn Callback taking the slot index and the object
+     */
+    template<typename Fn>
+    void forEach(Fn&& fn) {
+      for (uint32_t index = 0; index < m_slots.size(); ++index) {
+        if (m_slots[index].alive) {
+          fn(index, *ptr(index));
+        }
+      }
+    }
+
+    size_t size() const {
+      return m_size;
+    }
+
+    bool empty() const {
+      return m_size == 0;
+    }
+
+    size_t capacity() const {
+      return m_chunks.size() * ChunkSize;
+    }
+
+  private:
+    struct Slot {
+      uint32_t generation;
+      bool alive;
+    };
+
+    struct Chunk {
+      alignas(T) uint8_t storage[ChunkSize][sizeof(T)];
+    };
+
+    std::vector<std::unique_ptr<Chunk>> m_chunks;
+    std::vector<Slot> m_slots;
+    std::vector<uint32_t> m_freeSlots;
+    size_t m_size = 0;
+
+    T* ptr(uint32_t index) const {
+      return reinterpret_cast<T*>(m_chunks[index / ChunkSize]->storage[index % ChunkSize]);
+    }
+  };
+
+
+  /**
+   * \brief Open addressed hash multimap of slot indices
+   *
+   * Maps 64-bit hashes to 32-bit values, typically SlotMap indices.
+   * Multiple values may share a hash. Entries live in a single array
+   * and collisions are resolved with linear probing, so all values of
+   * a hash are found by scanning a short contiguous run of entries.
+   * Erased entries are removed by shifting the following entries back,
+   * the table never accumulates tombstones.
+   *
+   * Keys are expected to be well distributed hashes (e.g. XXH64).
+   */
+  class SlotHashIndex {
+  public:
+    static constexpr uint32_t kEmpty = ~0u;
+
+    explicit SlotHashIndex(size_t capacity = 64) {
+      rehash(capacity);
+    }
+
+    /**
+     * \brief Adds a value
+     *
+     * \param [in] key Hash
+     * \param [in] value Value, must not be \c kEmpty
+     */
+    void insert(uint64_t key, uint32_t value) {
+      assert(value != kEmpty);
+
+      // Keep the load factor under 3/4 to keep the probe sequences short
+      if ((m_size + 1) * 4 > m_entries.size() * 3) {
+        rehash(m_entries.size() * 2);
+      }
+
+      insertEntry({ key, value });
+      ++m_size;
+    }
+
+    /**
+     * \brief Removes a value
+     *
+     * \param [in] key Hash
+     * \param [in] value Value
+     * \returns \c true if the value was found
+     */
+    bool erase(uint64_t key, uint32_t value) {
+      for (size_t i = home(key); m_entries[i].value != kEmpty; i = next(i)) {
+        if (m_entries[i].key == key && m_entries[i].value == value) {
+          removeEntry(i);
+          --m_size;
+          return true;
+        }
+      }
+
+      return false;
+    }
+
+    /**
+     * \brief Visits all values of a hash
+     *
+     * The index must not be modified from within the callback.
+     * \param [in] key Hash
+     * \param [in] fn Callback taking a value, returns \c false to stop
+     */
+    template<typename Fn>
+    void find(uint64_t key, Fn&& fn) const {
+      for (size_t i = home(key); m_entries[i].value != kEmpty; i = next(i)) {
+        if (m_entries[i].key == key && !fn(m_entries[i].value)) {
+          return;
+        }
+      }
+    }
+
+    size_t count(uint64_t key) const {
+      size_t result = 0;
+      find(key, [&result] (uint32_t) { ++result; return true; });
+      return result;
+    }
+
+    void clear() {
+      for (auto& entry : m_entries) {
+        entry = Entry();
+      }
+
+      m_size = 0;
+    }
+
+    size_t size() const {
+      return m_size;
+    }
+
+  private:
+    struct Entry {
+      uint64_t key = 0;
+      uint32_t value = kEmpty;
+    };
+
+    std::vector<Entry> m_entries;
+    size_t m_mask = 0;
+    size_t m_size = 0;
+
+    size_t home(uint64_t key) const {
+      // Fold the upper bits in, tables are smaller than 2^32 entries
+      return static_cast<size_t>(key ^ (key >> 32)) & m_mask;
+    }
+
+    size_t next(size_t i) const {
+      return (i + 1) & m_mask;
+    }
+
+    void insertEntry(const Entry& entry) {
+      size_t i = home(entry.key);
+
+      while (m_entries[i].value != kEmpty) {
+        i = next(i);
+      }
+
+      m_entries[i] = entry;
+    }
+
+    void removeEntry(size_t hole) {
+      // Move entries of the probe run into the hole whenever the hole lies
+      // between their home slot and their current slot, so that every entry
+      // stays reachable from its home slot without tombstones.
+      for (size_t i = next(hole); m_entries[i].value != kEmpty; i = next(i)) {
+        const size_t h = home(m_entries[i].key);
+        const size_t distEntry = (i - h) & m_mask;
+        const size_t distHole = (hole - h) & m_mask;
+
+        if (distHole < distEntry) {
+          m_entries[hole] = m_entries[i];
+          hole = i;
+        }
+      }
+
+      m_entries[hole] = Entry();
+    }
+
+    void rehash(size_t capacity) {
+      size_t size = 16;
+
+      while (size < capacity) {
+        size *= 2;
+      }
+
+      std::vector<Entry> entries(size);
+      std::swap(entries, m_entries);
+      m_mask = size - 1;
+
+      for (const auto& entry : entries) {
+        if (entry.value != kEmpty) {
+          insertEntry(entry);
+        }
+      }
+    }
+  };
+
+} // namespace dxvk
@@ -21,15 +21,28 @@
 */
 
 #pragma once
-#include <unordered_map>
+#include <algorithm>
+#include <cmath>
+#include <functional>
+#include <vector>
 
 #include "util_vector.h"
 #include "util_fast_cache.h"
+#include "util_slot_map.h"
 #include "./log/log.h"
 
 namespace dxvk {
   // A structure to allow for quickly returning data close to a specific position.
-  template<class T>
+  //
+  // Cells and entries live in flat arrays: occupied cells are found through an open
+  // addressed index of their coordinates, and the entries of a cell are linked into a
+  // list within the entry array. Entries are found by their data for removal, so
+  // erase() and move() do not scan the cell. Emptied cells and entries are recycled.
+  //
+  // Queries visit the data with a callback and never allocate. Queries do not modify
+  // the map, so any number of threads may query it concurrently as long as no thread
+  // modifies it at the same time.
+  template<class T, class Hash = std::hash<T>>
   class SpatialMap {
   public:
     SpatialMap(float cellSize) : m_cellSize(cellSize) {
@@ -39,96 +52,295 @@ namespace dxvk {
       }
     }
 
-    SpatialMap& operator=(SpatialMap&& other) {
-      m_cellSize = other.m_cellSize;
-      m_cache = std::move(other.m_cache);
-      return *this;
-    }
-
-    // returns the 8 cells closest to `position`
-    const std::vector<const std::vector<T>*> getDataNearPos(const Vector3& position) const {
-      static const std::array kOffsets{
-        Vector3i{0, 0, 0},
-        Vector3i{0, 0, 1},
-        Vector3i{0, 1, 0},
-        Vector3i{0, 1, 1},
-        Vector3i{1, 0, 0},
-        Vector3i{1, 0, 1},
-        Vector3i{1, 1, 0},
-        Vector3i{1, 1, 1}
-      };
-      std::vector<const std::vector<T>*> result;
-      result.reserve(8);
+    SpatialMap(SpatialMap&& other) = default;
+    SpatialMap& operator=(SpatialMap&& other) = default;
 
+    // Visits the data in the 8 cells closest to `position`.
+    // fn(const T&) returns false to stop the query.
+    template<typename Fn>
+    void forEachNearPos(const Vector3& position, Fn&& fn) const {
       const Vector3 cellPosition = position / m_cellSize - Vector3(0.5f, 0.5f, 0.5f);
       const Vector3i floorPos(int(std::floor(cellPosition.x)), int(std::floor(cellPosition.y)), int(std::floor(cellPosition.z)));
 
-      for (const Vector3i& offset : kOffsets) {
-        auto iter = m_cache.find(floorPos + offset);
-        if (iter != m_cache.end()) {
-          const std::vector<T>* value = &iter->second;
-          result.push_back(value);
+      visitCells(floorPos, floorPos + Vector3i(1, 1, 1), [&fn](const Entry& entry) {
+        return fn(entry.data);
+      });
+    }
+
+    // Visits the data inserted within `radius` of `center`.
+    // fn(const T&) returns false to stop the query.
+    template<typename Fn>
+    void forEachInRadius(const Vector3& center, float radius, Fn&& fn) const {
+      const float radiusSqr = radius * radius;
+
+      visitCells(getCellPos(center - Vector3(radius)), getCellPos(center + Vector3(radius)), [&](const Entry& entry) {
+        return lengthSqr(entry.position - center) > radiusSqr || fn(entry.data);
+      });
+    }
+
+    // Visits the data inserted within the [minPos, maxPos] box.
+    // fn(const T&) returns false to stop the query.
+    template<typename Fn>
+    void forEachInAABB(const Vector3& minPos, const Vector3& maxPos, Fn&& fn) const {
+      visitCells(getCellPos(minPos), getCellPos(maxPos), [&](const Entry& entry) {
+        const Vector3& p = entry.position;
+        const bool inside =
+          p.x >= minPos.x && p.y >= minPos.y && p.z >= minPos.z &&
+          p.x <= maxPos.x && p.y <= maxPos.y && p.z <= maxPos.z;
+        return !inside || fn(entry.data);
+      });
+    }
+
+    // Visits all the data, fn(const T&, const Vector3& position).
+    template<typename Fn>
+    void forEach(Fn&& fn) const {
+      for (const Entry& entry : m_entries) {
+        if (entry.cell != kInvalid) {
+          fn(entry.data, entry.position);
         }
       }
-      
-      return result;
-    };
-    
+    }
+
     void insert(const Vector3& position, T data) {
-      insert(getCellPos(position), data);
+      const uint32_t entryIdx = allocateEntry();
+      Entry& entry = m_entries[entryIdx];
+      entry.data = std::move(data);
+      entry.position = position;
+
+      link(entryIdx, findOrCreateCell(getCellPos(position)));
+      m_dataIndex.insert(hashData(entry.data), entryIdx);
     }
 
     void erase(const Vector3& position, T data) {
-      erase(getCellPos(position), data);
+      const uint32_t entryIdx = findEntry(getCellPos(position), data);
+      if (entryIdx == kInvalid) {
+        return;
+      }
+
+      unlink(entryIdx);
+      m_dataIndex.erase(hashData(data), entryIdx);
+
+      m_entries[entryIdx].data = T();
+      m_freeEntries.push_back(entryIdx);
     }
 
     void move(const Vector3& oldPosition, const Vector3& newPosition, T data) {
-      Vector3i oldPos = getCellPos(oldPosition);
-      Vector3i newPos = getCellPos(newPosition);
-      if (oldPos != newPos) {
-        erase(oldPosition, data);
-        insert(newPos, data);
+      const uint32_t entryIdx = findEntry(getCellPos(oldPosition), data);
+      if (entryIdx == kInvalid) {
+        insert(newPosition, std::move(data));
+        return;
       }
+
+      const Vector3i newPos = getCellPos(newPosition);
+      m_entries[entryIdx].position = newPosition;
+
+      if (m_cells[m_entries[entryIdx].cell].pos != newPos) {
+        unlink(entryIdx);
+        link(entryIdx, findOrCreateCell(newPos));
+      }
+    }
+
+    size_t size() const {
+      return m_entries.size() - m_freeEntries.size();
     }
 
-    const fast_spatial_cache<std::vector<T>>& getAll() {
-      return m_cache;
+    size_t getCellCount() const {
+      return m_cellIndex.size();
     }
 
   private:
+    static constexpr uint32_t kInvalid = ~0u;
+    static constexpr float kMaxCellCoord = float(1 << 30);
+
+    struct Entry {
+      T data = T();
+      Vector3 position;
+      uint32_t cell = kInvalid;   // kInvalid for free entries
+      uint32_t prev = kInvalid;
+      uint32_t next = kInvalid;
+    };
+
+    struct Cell {
+      Vector3i pos;
+      uint32_t head = kInvalid;   // kInvalid for free cells
+    };
+
+    float m_cellSize;
+
+    std::vector<Entry> m_entries;
+    std::vector<uint32_t> m_freeEntries;
+    std::vector<Cell> m_cells;
+    std::vector<uint32_t> m_freeCells;
+
+    SlotHashIndex m_cellIndex;    // cell coordinates -> m_cells
+    SlotHashIndex m_dataIndex;    // data -> m_entries
+
+    static uint64_t hashCell(const Vector3i& pos) {
+      return Vector3i_hash_passthrough()(pos);
+    }
+
+    static uint64_t hashData(const T& data) {
+      // std::hash of pointers and integers is the identity, scramble it for the index
+      uint64_t h = static_cast<uint64_t>(Hash()(data));
+      h ^= h >> 33;
+      h *= 0xff51afd7ed558ccdull;
+      h ^= h >> 33;
+      return h;
+    }
 
     Vector3i getCellPos(const Vector3& position) const {
-      const Vector3 scaledPos = position / m_cellSize;
-      return Vector3i(int(std::floor(scaledPos.x)), int(std::floor(scaledPos.y)), int(std::floor(scaledPos.z))); 
+      // Clamp so that unbounded query ranges do not overflow the cell coordinates
+      auto toCell = [this](float x) {
+        return int(std::clamp(std::floor(x / m_cellSize), -kMaxCellCoord, kMaxCellCoord));
+      };
+      return Vector3i(toCell(position.x), toCell(position.y), toCell(position.z));
+    }
+
+    uint32_t findCell(const Vector3i& pos) const {
+      uint32_t result = kInvalid;
+      m_cellIndex.find(hashCell(pos), [&](uint32_t cellIdx) {
+        if (m_cells[cellIdx].pos != pos) {
+          return true;
+        }
+        result = cellIdx;
+        return false;
+      });
+      return result;
     }
 
-    void insert(const Vector3i& pos, T data) {
-      m_cache[pos].push_back(data);
+    uint32_t findOrCreateCell(const Vector3i& pos) {
+      uint32_t cellIdx = findCell(pos);
+      if (cellIdx != kInvalid) {
+        return cellIdx;
+      }
+
+      if (!m_freeCells.empty()) {
+        cellIdx = m_freeCells.back();
+        m_freeCells.pop_back();
+      } else {
+        cellIdx = static_cast<uint32_t>(m_cells.size());
+        m_cells.emplace_back();
+      }
+
+      m_cells[cellIdx].pos = pos;
+      m_cells[cellIdx].head = kInvalid;
+      m_cellIndex.insert(hashCell(pos), cellIdx);
+      return cellIdx;
     }
 
-    void erase(const Vector3i& pos, T data) {
-      auto cellIter = m_cache.find(pos);
-      if (cellIter == m_cache.end()) {
-        Logger::err("Specified cell was already empty in SpatialMap::erase().");
-        return;
+    uint32_t allocateEntry() {
+      if (!m_freeEntries.empty()) {
+        const uint32_t entryIdx = m_freeEntries.back();
+        m_freeEntries.pop_back();
+        return entryIdx;
+      }
+
+      m_entries.emplace_back();
+      return static_cast<uint32_t>(m_entries.size() - 1);
+    }
+
+    uint32_t findEntry(const Vector3i& pos, const T& data) const {
+      const uint32_t cellIdx = findCell(pos);
+      if (cellIdx == kInvalid) {
+        Logger::err("Specified cell was already empty in SpatialMap.");
+        return kInvalid;
       }
 
-      std::vector<T>& cell = cellIter->second;
-      auto iter = std::find(cell.begin(), cell.end(), data);
-      if (iter != cell.end()) {
-        if (cell.size() > 1) {
-          // Swap & pop - faster than "erase", but doesn't preserve order, which is fine here.
-          std::swap(*iter, cell.back());
-          cell.pop_back();
-        } else {
-          m_cache.erase(cellIter);
+      uint32_t result = kInvalid;
+      m_dataIndex.find(hashData(data), [&](uint32_t entryIdx) {
+        if (m_entries[entryIdx].cell != cellIdx || !(m_entries[entryIdx].data == data)) {
+          return true;
         }
+        result = entryIdx;
+        return false;
+      });
+
+      if (result == kInvalid) {
+        Logger::err("Couldn't find matching data in SpatialMap.");
+      }
+      return result;
+    }
+
+    void link(uint32_t entryIdx, uint32_t cellIdx) {
+      Entry& entry = m_entries[entryIdx];
+      Cell& cell = m_cells[cellIdx];
+
+      entry.cell = cellIdx;
+      entry.prev = kInvalid;
+      entry.next = cell.head;
+
+      if (cell.head != kInvalid) {
+        m_entries[cell.head].prev = entryIdx;
+      }
+      cell.head = entryIdx;
+    }
+
+    void unlink(uint32_t entryIdx) {
+      Entry& entry = m_entries[entryIdx];
+      Cell& cell = m_cells[entry.cell];
+
+      if (entry.prev != kInvalid) {
+        m_entries[entry.prev].next = entry.next;
       } else {
-        Logger::err("Couldn't find matching data in SpatialMap::erase().");
+        cell.head = entry.next;
+      }
+
+      if (entry.next != kInvalid) {
+        m_entries[entry.next].prev = entry.prev;
       }
+
+      // Release the cell once its last entry is gone
+      if (cell.head == kInvalid) {
+        m_cellIndex.erase(hashCell(cell.pos), entry.cell);
+        m_freeCells.push_back(entry.cell);
+      }
+
+      entry.cell = kInvalid;
+      entry.prev = kInvalid;
+      entry.next = kInvalid;
     }
 
-    float m_cellSize;
-    fast_spatial_cache<std::vector<T>> m_cache;
+    template<typename Fn>
+    void visitCells(const Vector3i& minCell, const Vector3i& maxCell, Fn&& fn) const {
+      auto visitCell = [&](uint32_t cellIdx) {
+        for (uint32_t entryIdx = m_cells[cellIdx].head; entryIdx != kInvalid; entryIdx = m_entries[entryIdx].next) {
+          if (!fn(m_entries[entryIdx])) {
+            return false;
+          }
+        }
+        return true;
+      };
+
+      const uint64_t numCells =
+        uint64_t(int64_t(maxCell.x) - minCell.x + 1) *
+        uint64_t(int64_t(maxCell.y) - minCell.y + 1) *
+        uint64_t(int64_t(maxCell.z) - minCell.z + 1);
+
+      // Large ranges are cheaper to serve by walking the occupied cells
+      if (numCells > m_cellIndex.size()) {
+        for (uint32_t cellIdx = 0; cellIdx < m_cells.size(); ++cellIdx) {
+          const Vector3i& pos = m_cells[cellIdx].pos;
+          if (m_cells[cellIdx].head != kInvalid &&
+              pos.x >= minCell.x && pos.y >= minCell.y && pos.z >= minCell.z &&
+              pos.x <= maxCell.x && pos.y <= maxCell.y && pos.z <= maxCell.z) {
+            if (!visitCell(cellIdx)) {
+              return;
+            }
+          }
+        }
+        return;
+      }
+
+      for (int x = minCell.x; x <= maxCell.x; ++x) {
+        for (int y = minCell.y; y <= maxCell.y; ++y) {
+          for (int z = minCell.z; z <= maxCell.z; ++z) {
+            const uint32_t cellIdx = findCell(Vector3i(x, y, z));
+            if (cellIdx != kInvalid && !visitCell(cellIdx)) {
+              return;
+            }
+          }
+        }
+      }
+    }
   };
 }
@@ -30,6 +30,8 @@
 #include <vector>
 #include <type_traits>
 #include <future>
+#include <tuple>
+#include <utility>
 #include <assert.h>
 #include "util_atomic_queue.h"
 #include "util_env.h"
@@ -40,8 +42,9 @@
 
 namespace dxvk {
   const size_t kLambdaStorageCapacity = 256;
-  // Note: use up to 64 bytes for state
-  const size_t kResultStorageCapacity = 256 - 64;
+  // Note: use up to 32 bytes for state, results of the geometry analysis (hashes,
+  //       bounding box and skinning data) need more than 192 bytes in debug builds
+  const size_t kResultStorageCapacity = 256 - 32;
 
   template<size_t Capacity = kResultStorageCapacity, bool UseWait = false>
   struct Result {
@@ -80,13 +83,12 @@ namespace dxvk {
         if (!hasResult) {
           std::unique_lock<dxvk::mutex> lock(mtx);
           cond.wait(lock, [this] {
-            return hasResult;
+            return hasResult.load();
           });
         }
       } else {
-        while (!hasResult) {
-          std::this_thread::yield();
-        }
+        // Note: the owning task waits for the result before retrieving it
+        assert(hasResult && "Result retrieved before it was set!");
       }
 
       hasResult = false;
@@ -113,10 +115,14 @@ namespace dxvk {
       return isDisposed;
     }
 
+    bool ready() const {
+      return hasResult;
+    }
+
   private:
     std::array<uint8_t, Capacity> storage;
-    bool hasResult = false;
-    bool isDisposed = false;
+    std::atomic<bool> hasResult = false;
+    std::atomic<bool> isDisposed = false;
 
     OnSetCondition cond;
     mutable ResultMutex mtx;
@@ -124,11 +130,16 @@ namespace dxvk {
 
   using TaskId = uint32_t;
   template<typename ResultType> struct Future;
+  template<size_t NumTasksPerThread, bool WorkStealing, bool LowLatency, bool MultiProducer> class WorkerThreadPool;
 
   struct Task {
     using LambdaStorage = std::array<uint8_t, kLambdaStorageCapacity>;
     using ThunkType = void(void*);
     using ThunkStorage = std::array<uint8_t, sizeof(uintptr_t)>;
+    using WaiterType = void(void*, const Task&);
+
+    static constexpr TaskId kNoContinuation = UINT32_MAX;
+    static constexpr TaskId kFinished = UINT32_MAX - 1;
 
     template<typename LambdaType, typename ResultType>
     Future<ResultType> capture(LambdaType&& lambda) {
@@ -157,6 +168,11 @@ namespace dxvk {
       });
 
       result.reset();
+      continuation.store(kNoContinuation, std::memory_order_relaxed);
+
+      // The Future holds its own reference, so the slot (and its result) can't be
+      // captured again until the Future is consumed, cancelled or destroyed
+      refCount.fetch_add(1, std::memory_order_relaxed);
 
       return Future<ResultType>(*this);
     }
@@ -167,10 +183,12 @@ namespace dxvk {
 
     template<typename ResultType>
     ResultType getResult() {
+      waitForResult();
       return result.get<ResultType>();
     }
 
     void getResult() {
+      waitForResult();
       result.get();
     }
 
@@ -182,6 +200,55 @@ namespace dxvk {
       return !result.disposed();
     }
 
+    bool ready() const {
+      return result.ready();
+    }
+
+    // Claims the task slot for a new capture.  The claim is the reference the pool drops once
+    // the task has executed, capture adds a second one for the Future.  Fails while the previous
+    // task is still queued or executing, or while its Future is still held.
+    bool tryAcquire() {
+      uint32_t expected = 0;
+      return refCount.compare_exchange_strong(expected, 1, std::memory_order_acquire);
+    }
+
+    // Releases a reference to the task slot, once all are gone it may be captured again
+    void release() {
+      refCount.fetch_sub(1, std::memory_order_release);
+    }
+
+    // Set by the owning thread pool, which decides how to wait on this task's result
+    void setWaiter(WaiterType* pWaiter, void* pWaiterContext) {
+      waiter = pWaiter;
+      waiterContext = pWaiterContext;
+    }
+
+    // Registers the one continuation waiting on this task, only one Future exists to be consumed by it.
+    // Returns false if this task had already finished.
+    bool addContinuation(const TaskId continuationId) {
+      TaskId expected = kNoContinuation;
+      if (continuation.compare_exchange_strong(expected, continuationId, std::memory_order_acq_rel)) {
+        return true;
+      }
+      assert(expected == kFinished && "Task already has a continuation!");
+      return false;
+    }
+
+    // Marks the task as finished, and returns the continuation waiting on it (or kNoContinuation)
+    TaskId finish() {
+      return continuation.exchange(kFinished, std::memory_order_acq_rel);
+    }
+
+    // Continuations are held back until all the tasks they depend on have finished
+    void setNumDependencies(const uint32_t numDependencies) {
+      pendingDependencies.store(numDependencies, std::memory_order_relaxed);
+    }
+
+    // Returns true when the last dependency was resolved
+    bool resolveDependency() {
+      return pendingDependencies.fetch_sub(1, std::memory_order_acq_rel) == 1;
+    }
+
   private:
     template<typename InvocableType>
     static inline void Thunk(void* thunkLambda) {
@@ -204,10 +271,23 @@ namespace dxvk {
       thunk = nullptr;
     }
 
+    void waitForResult() {
+      if (!result.ready()) {
+        waiter(waiterContext, *this);
+      }
+    }
+
     alignas(64) LambdaStorage lambdaStorage;
     alignas(64) Result<kResultStorageCapacity> result;
     alignas(64) ThunkStorage thunkStorage;
     ThunkType* thunk = nullptr;
+    std::atomic<uint32_t> refCount = 0;
+
+    WaiterType* waiter = nullptr;
+    void* waiterContext = nullptr;
+
+    std::atomic<TaskId> continuation = kNoContinuation;
+    std::atomic<uint32_t> pendingDependencies = 0;
   };
 
   template<typename ResultType>
@@ -217,9 +297,29 @@ namespace dxvk {
     : task { &task }
     { }
 
-    ResultType get() const {
+    Future(Future&& other) noexcept
+    : task { std::exchange(other.task, nullptr) }
+    { }
+
+    Future& operator=(Future&& other) noexcept {
+      if (this != &other) {
+        drop();
+        task = std::exchange(other.task, nullptr);
+      }
+      return *this;
+    }
+
+    // Note: only one Future may ever retrieve a result, so they can be moved but not copied
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    ~Future() {
+      drop();
+    }
+
+    ResultType get() {
       ResultType r = task->getResult<ResultType>();
-      task = nullptr;
+      drop();
       return r;
     }
 
@@ -227,13 +327,23 @@ namespace dxvk {
       return task != nullptr && task->valid();
     }
 
-    void cancel() const {
+    void cancel() {
       task->cancel();
-      task = nullptr;
+      drop();
     }
 
   private:
-    mutable Task* task = nullptr;
+    template<size_t, bool, bool, bool> friend class WorkerThreadPool;
+
+    // Releases this Future's reference to the task slot
+    void drop() {
+      if (task != nullptr) {
+        task->release();
+        task = nullptr;
+      }
+    }
+
+    Task* task = nullptr;
   };
 
   template<>
@@ -242,22 +352,59 @@ namespace dxvk {
     explicit Future(Task& task)
     : task { &task } { }
 
-    void get() const {
+    Future(Future&& other) noexcept
+    : task { std::exchange(other.task, nullptr) } { }
+
+    Future& operator=(Future&& other) noexcept {
+      if (this != &other) {
+        drop();
+        task = std::exchange(other.task, nullptr);
+      }
+      return *this;
+    }
+
+    Future(const Future&) = delete;
+    Future& operator=(const Future&) = delete;
+
+    ~Future() {
+      drop();
+    }
+
+    void get() {
       task->getResult();
-      task = nullptr;
+      drop();
     }
 
     bool valid() const {
       return task != nullptr && task->valid();
     }
 
-    void cancel() const {
+    void cancel() {
       task->cancel();
-      task = nullptr;
+      drop();
     }
 
   private:
-    mutable Task* task = nullptr;
+    template<size_t, bool, bool, bool> friend class WorkerThreadPool;
+
+    void drop() {
+      if (task != nullptr) {
+        task->release();
+        task = nullptr;
+      }
+    }
+
+    Task* task = nullptr;
+  };
+
+  /**
+    * \brief Determines what WorkerThreadPool::Schedule does when
+    *        the task queues are full.
+    */
+  enum class TaskOverflowPolicy : uint32_t {
+    Drop,   // Return an invalid Future, the caller is responsible for the fallback
+    Block,  // Help execute queued tasks on the calling thread until there is space
+    Inline, // Execute the task immediately on the calling thread
   };
 
   /**
@@ -265,12 +412,21 @@ namespace dxvk {
     *        for tasks of varying execution time using a
     *        work stealing algorithm.
     *
-    *  NumThreads: How many threads to spawn (up to 255)
     *  NumTasksPerThread: Size of the task queue ring buffer
     *  WorkStealing: Enables the work stealing features of the scheduler
     *  LowLatency: Enables the low-latency mode where workers will spin instead of
     *              waiting for tasks on a conditional variable
+    *  MultiProducer: Enables scheduling from any thread.  Tasks are injected via
+    *                 a shared MPMC queue, and tasks scheduled from within a worker
+    *                 go to that worker's Chase-Lev deque where others can steal
+    *                 them.  The Affinity mask of Schedule is ignored in this mode.
+    *                 Tasks can be chained with ScheduleAfter and WhenAll.
+    *  (ctor)numThreads: How many threads to spawn (up to 255)
     *  (ctor)workerName: Name given to threads with the pattern: workerName(N)
+    *  (ctor)overflowPolicy: What to do with a task when the queues are full
+    *
+    *  Every Future keeps its task slot alive until it is consumed, cancelled or destroyed,
+    *  so scheduling waits for a free slot while too many Futures are held at once.
     * 
     *  Example usage:
     *   // Creates 1 thread, and uses it to return PI via a future
@@ -278,34 +434,64 @@ namespace dxvk {
     *   Future<float> result = threadPool.Schedule([]{ return 3.14159265359f; });
     *   float pi = result.get();
     */
-  template<size_t NumTasksPerThread, bool WorkStealing = true, bool LowLatency = true>
+  template<size_t NumTasksPerThread, bool WorkStealing = true, bool LowLatency = true, bool MultiProducer = false>
   class WorkerThreadPool {
     using Queue = AtomicQueue<TaskId, NumTasksPerThread>;
     using QueuePtr = std::unique_ptr<Queue>;
+    using InjectionQueue = AtomicMpmcQueue<TaskId, NumTasksPerThread>;
+    using Deque = AtomicWorkStealingDeque<TaskId, NumTasksPerThread>;
+    using DequePtr = std::unique_ptr<Deque>;
 
     struct Nop { };
     using OnAddCondition = std::conditional_t<LowLatency, Nop, dxvk::condition_variable>;
     using TaskMutex = std::conditional_t<LowLatency, Nop, dxvk::mutex>;
 
+    static constexpr uint32_t kInvalidWorker = UINT32_MAX;
+
+    // Multi-producer mode: most tasks that may be queued at once, across the
+    // injection queue and all worker deques.  Each of them can hold this many.
+    static constexpr uint32_t kQueueBudget = atomicQueueCapacity(NumTasksPerThread);
+
   public:
-    WorkerThreadPool(uint8_t numThreads, const char* workerName = "Nameless Worker Thread") 
-    : m_numThread(std::clamp(numThreads, (uint8_t)1u, (uint8_t)dxvk::thread::hardware_concurrency())) {
+    WorkerThreadPool(uint8_t numThreads, const char* workerName = "Nameless Worker Thread", TaskOverflowPolicy overflowPolicy = TaskOverflowPolicy::Drop)
+    : m_numThread(std::clamp(numThreads, (uint8_t)1u, (uint8_t)dxvk::thread::hardware_concurrency()))
+    , m_overflowPolicy(overflowPolicy) {
+      // Note: task slots must cover every queued task, plus one executing per worker, plus one being captured
+      //       on overflow.  SPSC queues hold one less than their size, which leaves room for the executing tasks.
+      //       In multi-producer mode all queues share a single budget of queued tasks, see reserveQueuedTask.
+      const uint32_t numOverflowTasks = overflowPolicy != TaskOverflowPolicy::Drop ? 1 : 0;
+      const uint32_t numInFlightTasks = MultiProducer
+        ? kQueueBudget + m_numThread + numOverflowTasks
+        : NumTasksPerThread * m_numThread + numOverflowTasks;
       // Note: round up to a closest power-of-two so we can use mask as modulo
-      m_taskCount = 1 << (32 - bit::lzcnt(static_cast<uint32_t>(NumTasksPerThread * m_numThread) - 1));
-      m_tasks.resize(m_taskCount);
-      m_workerTasks.resize(m_numThread);
+      m_taskCount = 1 << (32 - bit::lzcnt(numInFlightTasks - 1));
+      m_tasks = std::make_unique<Task[]>(m_taskCount);
+      for (uint32_t i = 0; i < m_taskCount; i++) {
+        m_tasks[i].setWaiter(&waitForTask, this);
+      }
       m_workerThreads.resize(m_numThread);
       // Create the work queues first!  We need to create
       // then all since work stealing may access the other
       // queues.
-      for (int i = 0; i < m_numThread; i++) {
-        m_workerTasks[i] = std::make_unique<Queue>();
+      if constexpr (MultiProducer) {
+        m_injectionQueue = std::make_unique<InjectionQueue>();
+        m_workerDeques.resize(m_numThread);
+        for (int i = 0; i < m_numThread; i++) {
+          m_workerDeques[i] = std::make_unique<Deque>();
+        }
+      } else {
+        m_workerTasks.resize(m_numThread);
+        for (int i = 0; i < m_numThread; i++) {
+          m_workerTasks[i] = std::make_unique<Queue>();
+        }
       }
 
       // Start the worker threads
       for (int i = 0; i < m_numThread; i++) {
         m_workerThreads[i] = std::thread([this, i, workerName] {
           env::setThreadName(str::format(workerName, "(", i, ")"));
+          s_pCurrentPool = this;
+          s_currentWorkerId = i;
           processWork(i);
         });
       }
@@ -325,14 +511,32 @@ namespace dxvk {
       }
 
       if (m_numTasks > 0) {
-        for (auto& workerTasks : m_workerTasks) {
-          TaskId taskId;
-          while (workerTasks->pop(taskId)) {
-            // Cancel the actual task job
-            m_tasks[taskId].cancel();
-            // Execute the task to dispatch the destructor
-            m_tasks[taskId]();
-            --m_numTasks;
+        auto cancelTask = [this](TaskId taskId) {
+          // Cancel the actual task job
+          m_tasks[taskId].cancel();
+          // Execute the task to dispatch the destructor
+          runTask(taskId);
+          --m_numTasks;
+        };
+
+        TaskId taskId;
+        if constexpr (MultiProducer) {
+          // Note: cancelled tasks still release their continuations into the injection queue
+          while (m_numTasks > 0) {
+            while (m_injectionQueue->pop(taskId)) {
+              cancelTask(taskId);
+            }
+            for (auto& workerDeque : m_workerDeques) {
+              while (workerDeque->steal(taskId)) {
+                cancelTask(taskId);
+              }
+            }
+          }
+        } else {
+          for (auto& workerTasks : m_workerTasks) {
+            while (workerTasks->pop(taskId)) {
+              cancelTask(taskId);
+            }
           }
         }
       }
@@ -343,45 +547,288 @@ namespace dxvk {
     // Schedule a task to be executed by the thread pool
     template <uint8_t Affinity = 0xFF, typename F, typename R = std::invoke_result_t<std::decay_t<F>>>
     Future<R> Schedule(F&& f) {
-      // Is the affinity mask valid?
-      const uint8_t affinityMask = std::min(popcnt_uint8(Affinity), m_numThread);
-
-      // Schedule work on the appropriate thread
-      const uint32_t thread = fast::findNthBit(Affinity, (uint8_t) (m_schedulerIndex++ % affinityMask));
-      assert(thread < m_numThread);
-
-      // Atomic queue is SPSC, so we don't need to take a lock here
-      // since we know this will always be called from a single thread.
+      if constexpr (MultiProducer) {
+        return scheduleMultiProducer<F, R>(std::forward<F>(f));
+      } else {
+        // Is the affinity mask valid?
+        const uint8_t affinityMask = std::min(popcnt_uint8(Affinity), m_numThread);
+
+        // Schedule work on the appropriate thread
+        const uint32_t thread = fast::findNthBit(Affinity, (uint8_t) (m_schedulerIndex++ % affinityMask));
+        assert(thread < m_numThread);
+
+        // Atomic queue is SPSC, so we don't need to take a lock here
+        // since we know this will always be called from a single thread.
+
+        while (m_workerTasks[thread]->isFull()) {
+          switch (m_overflowPolicy) {
+          case TaskOverflowPolicy::Drop:
+            return Future<R>();
+          case TaskOverflowPolicy::Inline:
+            return executeInline<F, R>(std::forward<F>(f));
+          case TaskOverflowPolicy::Block:
+            // Help drain the queue we're waiting on
+            if (!executeTask(thread)) {
+              std::this_thread::yield();
+            }
+            break;
+          }
+        }
 
-      Future<R> future;
-      if (!m_workerTasks[thread]->isFull()) {
-        // Get next task id
-        TaskId taskId = m_taskId++ & (m_taskCount - 1);
+        // Get next free task id
+        TaskId taskId = allocateTask();
 
         // Capture task lambda
-        future = m_tasks[taskId].capture<F, R>(std::forward<F>(f));
+        Future<R> future = m_tasks[taskId].capture<F, R>(std::forward<F>(f));
 
         // Place task into queue
         m_workerTasks[thread]->push(std::move(taskId));
 
-        if constexpr (!LowLatency) {
-          std::unique_lock<TaskMutex> lock(m_taskMutex);
-          if constexpr (WorkStealing) {
-            // Notify only one worker when workers can steal from the others
-            m_condOnAdd.notify_one();
-          } else {
-            // Notify all workers when they cannot steal
-            m_condOnAdd.notify_all();
-          }
-        }
+        notifyWorkers();
 
         ++m_numTasks;
+
+        return future;
+      }
+    }
+
+    // Schedule a continuation to be executed by the thread pool once all of the dependencies
+    // have finished.  The continuation is invoked with the dependency futures, which are ready
+    // at that point (or invalid, if they were never scheduled).  The futures passed in are
+    // consumed, and must come from this pool.  A pending continuation holds on to a task slot.
+    //
+    //  Example usage:
+    //   Future<uint32_t> a = threadPool.Schedule([] { return 1u; });
+    //   Future<uint32_t> b = threadPool.Schedule([] { return 2u; });
+    //   Future<uint32_t> sum = threadPool.ScheduleAfter([](Future<uint32_t> a, Future<uint32_t> b) {
+    //     return a.get() + b.get();
+    //   }, std::move(a), std::move(b));
+    template<typename F, typename... Ts, typename R = std::invoke_result_t<std::decay_t<F>, Future<Ts>...>>
+    Future<R> ScheduleAfter(F&& f, Future<Ts>&&... dependencies) {
+      static_assert(MultiProducer, "Continuations are scheduled from the worker threads, and so require a multi-producer thread pool!");
+
+      const TaskId taskId = allocateTask();
+      Task& task = m_tasks[taskId];
+
+      const std::array<Task*, sizeof...(Ts)> dependencyTasks { dependencies.task... };
+
+      // The continuation owns the dependency futures, so their task slots (and results) can't
+      // be captured again before it has run.  A finished dependency then stays finished.
+      auto continuation = [f = std::forward<F>(f), dependencies = std::make_tuple(std::move(dependencies)...)]() mutable -> R {
+        return std::apply([&f](Future<Ts>&... futures) -> R {
+          return f(std::move(futures)...);
+        }, dependencies);
+      };
+      Future<R> future = task.capture<decltype(continuation), R>(std::move(continuation));
+
+      // Note: hold the continuation back until all the dependencies are registered
+      task.setNumDependencies(sizeof...(Ts) + 1);
+
+      for (Task* pDependency : dependencyTasks) {
+        assert((pDependency == nullptr || (pDependency >= &m_tasks[0] && pDependency < &m_tasks[m_taskCount])) &&
+               "Continuation dependencies must be scheduled on the same thread pool!");
+        if (pDependency == nullptr || !pDependency->addContinuation(taskId)) {
+          task.resolveDependency();
+        }
+      }
+
+      if (task.resolveDependency()) {
+        submitContinuation(taskId);
       }
 
       return future;
     }
 
+    // Returns a future which is ready once all of the dependencies have finished
+    template<typename... Ts>
+    Future<void> WhenAll(Future<Ts>&&... dependencies) {
+      return ScheduleAfter([](Future<Ts>...) { }, std::move(dependencies)...);
+    }
+
   private:
+    uint32_t currentWorkerId() const {
+      return s_pCurrentPool == this ? s_currentWorkerId : kInvalidWorker;
+    }
+
+    // Claims room for one more queued task, and counts it before it becomes visible
+    // so workers never observe an underflow.  Fails once the budget is used up.
+    bool reserveQueuedTask() {
+      if (m_numTasks.fetch_add(1, std::memory_order_acq_rel) >= kQueueBudget) {
+        --m_numTasks;
+        return false;
+      }
+      return true;
+    }
+
+    // Prefer the local deque when called from a worker, so the task stays cache-hot
+    // but can still be stolen.  Everyone else goes through the injection queue.
+    // Note: a reserved task always fits, since any single queue can hold the whole budget.  The
+    //       injection queue may still look full for a moment, consumers pop out of order and the
+    //       task count drops as soon as any of them is done, while an earlier cell is still being
+    //       read by another consumer.  That consumer has already claimed it, so just retry.
+    void pushTask(const TaskId taskId) {
+      const uint32_t workerId = currentWorkerId();
+      if (workerId != kInvalidWorker && m_workerDeques[workerId]->push(taskId)) {
+        return;
+      }
+
+      while (!m_injectionQueue->push(TaskId(taskId))) {
+        std::this_thread::yield();
+      }
+    }
+
+    // Executes a task, releases the continuation waiting on it, then drops the pool's reference to its slot
+    void runTask(const TaskId taskId) {
+      Task& task = m_tasks[taskId];
+      task();
+
+      if constexpr (MultiProducer) {
+        const TaskId continuation = task.finish();
+        if (continuation != Task::kNoContinuation && m_tasks[continuation].resolveDependency()) {
+          submitContinuation(continuation);
+        }
+      }
+
+      task.release();
+
+      // Wake anyone waiting on the result
+      notifyWaiters();
+    }
+
+    void submitContinuation(const TaskId taskId) {
+      // Note: continuations are never dropped, their dependencies have already been consumed
+      if (!reserveQueuedTask()) {
+        runTask(taskId);
+        return;
+      }
+
+      pushTask(taskId);
+      notifyWorkers();
+    }
+
+    static void waitForTask(void* pContext, const Task& task) {
+      static_cast<WorkerThreadPool*>(pContext)->waitFor(task);
+    }
+
+    // Multi-producer pools execute other queued tasks while waiting, which also keeps workers that
+    // wait on tasks they scheduled themselves from stalling the pool.  Once there's nothing left to
+    // help with, sleep until a task finishes or more work is queued, rather than spinning.
+    void waitFor(const Task& task) {
+      while (!task.ready()) {
+        // Note: announce the waiter before looking for work, so a task queued (or a result set) after
+        //       the search has failed always wakes it
+        const uint64_t epoch = m_waitEpoch.load();
+        ++m_numWaiters;
+        std::atomic_thread_fence(std::memory_order_seq_cst);
+
+        if constexpr (MultiProducer) {
+          if (executeNextTask(currentWorkerId())) {
+            --m_numWaiters;
+            continue;
+          }
+        }
+
+        {
+          std::unique_lock<dxvk::mutex> lock(m_waitMutex);
+          m_condOnProgress.wait(lock, [this, &task, epoch] {
+            return task.ready() || m_waitEpoch.load() != epoch;
+          });
+        }
+
+        --m_numWaiters;
+      }
+    }
+
+    void notifyWaiters() {
+      std::atomic_thread_fence(std::memory_order_seq_cst);
+      if (m_numWaiters.load() > 0) {
+        std::unique_lock<dxvk::mutex> lock(m_waitMutex);
+        ++m_waitEpoch;
+        m_condOnProgress.notify_all();
+      }
+    }
+
+    template<typename F, typename R>
+    Future<R> scheduleMultiProducer(F&& f) {
+      // Claim room in the queues first, a task slot is only needed once the task fits
+      while (!reserveQueuedTask()) {
+        switch (m_overflowPolicy) {
+        case TaskOverflowPolicy::Drop:
+          return Future<R>();
+        case TaskOverflowPolicy::Inline:
+          return executeInline<F, R>(std::forward<F>(f));
+        case TaskOverflowPolicy::Block:
+          // Apply back-pressure by helping the workers until there's space
+          if (!executeNextTask(currentWorkerId())) {
+            std::this_thread::yield();
+          }
+          break;
+        }
+      }
+
+      // Get next free task id
+      TaskId taskId = allocateTask();
+
+      // Capture task lambda
+      Future<R> future = m_tasks[taskId].capture<F, R>(std::forward<F>(f));
+
+      pushTask(taskId);
+      notifyWorkers();
+
+      return future;
+    }
+
+    // Task slots are handed out round-robin, but skip any slot still waiting
+    // on (or in the middle of) execution, e.g. behind a long running task,
+    // or whose result hasn't been retrieved through its Future yet.
+    TaskId allocateTask() {
+      uint32_t numTries = 0;
+      while (true) {
+        const TaskId taskId = m_taskId++ & (m_taskCount - 1);
+        if (m_tasks[taskId].tryAcquire()) {
+          return taskId;
+        }
+
+        // Every slot is taken, e.g. by threads executing tasks while they wait on a future
+        if (++numTries == m_taskCount) {
+          numTries = 0;
+          if constexpr (MultiProducer) {
+            if (!executeNextTask(currentWorkerId())) {
+              std::this_thread::yield();
+            }
+          } else {
+            std::this_thread::yield();
+          }
+        }
+      }
+    }
+
+    template<typename F, typename R>
+    Future<R> executeInline(F&& f) {
+      TaskId taskId = allocateTask();
+      Future<R> future = m_tasks[taskId].capture<F, R>(std::forward<F>(f));
+      runTask(taskId);
+      return future;
+    }
+
+    void notifyWorkers() {
+      // Threads waiting on a future help with new work in multi-producer mode
+      if constexpr (MultiProducer) {
+        notifyWaiters();
+      }
+
+      if constexpr (!LowLatency) {
+        std::unique_lock<TaskMutex> lock(m_taskMutex);
+        if constexpr (WorkStealing) {
+          // Notify only one worker when workers can steal from the others
+          m_condOnAdd.notify_one();
+        } else {
+          // Notify all workers when they cannot steal
+          m_condOnAdd.notify_all();
+        }
+      }
+    }
+
     void processWork(const uint32_t workerId) {
       while (true) {
         // Using a conditional wait in high-latency mode
@@ -397,6 +844,13 @@ namespace dxvk {
           return;
         }
 
+        if constexpr (MultiProducer) {
+          if (!executeNextTask(workerId) && LowLatency) {
+            std::this_thread::yield();
+          }
+          continue;
+        }
+
         // Try executing a task from our queue
         if (executeTask(workerId))
           continue;
@@ -438,12 +892,41 @@ namespace dxvk {
       }
 
       // Execute the task
-      m_tasks[taskId]();
+      runTask(taskId);
+
+      return true;
+    }
+
+    // Multi-producer mode: own deque first, then the injection queue, then steal.
+    // Pass kInvalidWorker when calling from a thread outside of the pool.
+    bool executeNextTask(const uint32_t workerId) {
+      TaskId taskId;
+      bool found = (workerId != kInvalidWorker && m_workerDeques[workerId]->pop(taskId)) ||
+                   m_injectionQueue->pop(taskId);
+
+      if (!found && WorkStealing) {
+        const uint32_t firstVictim = workerId != kInvalidWorker ? workerId + 1 : 0;
+        for (uint32_t i = 0; i < m_numThread && !found; i++) {
+          const uint32_t victim = (firstVictim + i) % m_numThread;
+          if (victim != workerId) {
+            found = m_workerDeques[victim]->steal(taskId);
+          }
+        }
+      }
+
+      if (!found) {
+        return false;
+      }
+
+      --m_numTasks;
+
+      // Execute the task
+      runTask(taskId);
 
       return true;
     }
 
-    std::vector<Task> m_tasks;
+    std::unique_ptr<Task[]> m_tasks;
     std::atomic<TaskId> m_taskId = 0;
     uint32_t m_taskCount;
 
@@ -453,6 +936,8 @@ namespace dxvk {
 
     uint8_t m_numThread;
 
+    const TaskOverflowPolicy m_overflowPolicy;
+
     std::atomic<bool> m_stopWork = false;
 
     // Used conditionally to wait for tasks in high-latency mode
@@ -462,6 +947,12 @@ namespace dxvk {
     // Used to synchronize intra-thread stealing
     sync::Spinlock m_threadMutex;
 
+    // Used to wake threads waiting on a future, see waitFor
+    dxvk::mutex m_waitMutex;
+    dxvk::condition_variable m_condOnProgress;
+    std::atomic<uint32_t> m_numWaiters = 0;
+    std::atomic<uint64_t> m_waitEpoch = 0;
+
     std::vector<std::thread> m_workerThreads;
 
     // We expect high volume of potentially small tasks via "Schedule" per-
@@ -470,6 +961,14 @@ namespace dxvk {
     //  1. Non-circular queue incurs allocation overhead thats unacceptable
     //  2. Use of mutex, and CVs, incur overhead thats unacceptable
     std::vector<QueuePtr> m_workerTasks;
-    std::atomic_uint32_t m_numTasks;
+    std::atomic_uint32_t m_numTasks = 0;
+
+    // Multi-producer mode queues
+    std::unique_ptr<InjectionQueue> m_injectionQueue;
+    std::vector<DequePtr> m_workerDeques;
+
+    // Identifies the pool and worker index of the current thread, if it is a worker
+    static inline thread_local const WorkerThreadPool* s_pCurrentPool = nullptr;
+    static inline thread_local uint32_t s_currentWorkerId = kInvalidWorker;
   };
 } //dxvk
\ No newline at end of file
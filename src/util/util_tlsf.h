@@ -0,0 +1,437 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#pragma once
+
+#include <stdint.h>
+#include <assert.h>
+
+#include <algorithm>
+#include <vector>
+
+#include "util_bit.h"
+
+namespace dxvk {
+
+  /**
+   * \brief Two level segregated fit range allocator
+   *
+   * Places allocations within a range of \c capacity bytes and only deals
+   * in offsets, the memory itself is owned by the caller. Free ranges are
+   * kept in lists by size class, a first level per power of two split into
+   * \c SecondLevelCount linear steps, and two levels of bitmaps locate a
+   * non-empty list that fits a request in constant time. Ranges are linked
+   * to their physical neighbours, so freeing coalesces in constant time.
+   *
+   * Allocations come from the first range of the smallest class in which
+   * every range fits, so a range of the request's own class that would have
+   * fit is only used once no larger one is left. Each allocation is identified
+   * by a handle the caller stores alongside the offset and passes back when
+   * freeing, so no lookup by offset is needed. Not thread safe.
+   */
+  class TlsfAllocator {
+    static constexpr uint32_t SecondLevelBits  = 4;
+    static constexpr uint32_t SecondLevelCount = 1u << SecondLevelBits;
+    static constexpr uint32_t FirstLevelCount  = 64 - SecondLevelBits + 1;
+    static constexpr uint32_t InvalidBlock     = ~0u;
+  public:
+    static constexpr uint64_t InvalidOffset = ~0ull;
+    static constexpr uint32_t InvalidHandle = InvalidBlock;
+
+    struct Stats {
+      uint64_t freeBytes = 0;     // bytes not covered by allocations
+      uint64_t freeRanges = 0;    // number of disjoint free ranges
+      uint64_t allocations = 0;   // live allocations
+    };
+
+    explicit TlsfAllocator(uint64_t capacity)
+    : m_capacity(capacity) {
+      if (capacity != 0) {
+        m_stats.freeBytes = capacity;
+        insertFree(createBlock(0, capacity, InvalidBlock, InvalidBlock));
+      }
+    }
+
+    TlsfAllocator(const TlsfAllocator&) = delete;
+    TlsfAllocator& operator=(const TlsfAllocator&) = delete;
+
+    /**
+     * \brief Allocates a range
+     *
+     * Both the start and the length of the range are aligned, which
+     * matches what memory chunks have always handed out.
+     * \param [in] size Number of bytes, must not be zero
+     * \param [in] align Alignment, a power of two
+     * \param [out] length Aligned length of the range
+     * \param [out] handle Handle to free the range with
+     * \returns Offset of the range, or \c InvalidOffset
+     */
+    uint64_t alloc(uint64_t size, uint64_t align, uint64_t& length, uint32_t& handle) {
+      assert(size != 0 && align != 0 && (align & (align - 1)) == 0);
+
+      length = alignUp(size, align);
+
+      if (length > m_stats.freeBytes) {
+        return InvalidOffset;
+      }
+
+      // Padding the request by the alignment guarantees that any range
+      // of the class fits. If nothing that large is left, fall back to
+      // the ranges of the class the request itself maps to, which may
+      // still fit if they happen to be aligned.
+      uint32_t block = InvalidBlock;
+
+      if (length + align - 1 >= length) {
+        block = findFree(length + align - 1);
+      }
+
+      if (block == InvalidBlock) {
+        block = findFittingInClass(length, align);
+      }
+
+      if (block == InvalidBlock) {
+        return InvalidOffset;
+      }
+
+      removeFree(block);
+
+      const uint64_t blockStart = m_blocks[block].offset;
+      const uint64_t blockEnd   = blockStart + m_blocks[block].size;
+      const uint64_t allocStart = alignUp(blockStart, align);
+      const uint64_t allocEnd   = allocStart + length;
+      assert(allocEnd <= blockEnd);
+
+      // Split off the alignment padding and the tail as free ranges. Physical
+      // neighbours of a free range are always allocated, so nothing to merge.
+      if (allocStart != blockStart) {
+        const uint32_t head = createBlock(blockStart, allocStart - blockStart, m_blocks[block].prevPhysical, block);
+        linkPrevious(head);
+        m_blocks[block].offset = allocStart;
+        m_blocks[block].size -= allocStart - blockStart;
+        insertFree(head);
+      }
+
+      if (allocEnd != blockEnd) {
+        const uint32_t tail = createBlock(allocEnd, blockEnd - allocEnd, block, m_blocks[block].nextPhysical);
+        m_blocks[block].nextPhysical = tail;
+        linkNext(tail);
+        m_blocks[block].size = length;
+        insertFree(tail);
+      }
+
+      handle = block;
+      m_stats.freeBytes -= length;
+      m_stats.allocations += 1;
+      return allocStart;
+    }
+
+    /**
+     * \brief Frees a range
+     *
+     * \param [in] handle Handle returned by \c alloc
+     * \returns Length of the freed range
+     */
+    uint64_t free(uint32_t handle) {
+      assert(handle < m_blocks.size() && !m_blocks[handle].isFree);
+
+      uint32_t block = handle;
+
+      const uint64_t length = m_blocks[block].size;
+      m_stats.freeBytes += length;
+      m_stats.allocations -= 1;
+
+      const uint32_t prev = m_blocks[block].prevPhysical;
+
+      if (prev != InvalidBlock && m_blocks[prev].isFree) {
+        removeFree(prev);
+        m_blocks[prev].size += m_blocks[block].size;
+        m_blocks[prev].nextPhysical = m_blocks[block].nextPhysical;
+        linkNext(prev);
+        destroyBlock(block);
+        block = prev;
+      }
+
+      const uint32_t next = m_blocks[block].nextPhysical;
+
+      if (next != InvalidBlock && m_blocks[next].isFree) {
+        removeFree(next);
+        m_blocks[block].size += m_blocks[next].size;
+        m_blocks[block].nextPhysical = m_blocks[next].nextPhysical;
+        linkNext(block);
+        destroyBlock(next);
+      }
+
+      insertFree(block);
+      return length;
+    }
+
+    /**
+     * \brief Size of the largest free range
+     *
+     * Only walks the list of the largest non-empty class.
+     */
+    uint64_t largestFreeRange() const {
+      if (m_firstLevelMap == 0) {
+        return 0;
+      }
+
+      const uint32_t fl = 63 - lzcnt64(m_firstLevelMap);
+      const uint32_t sl = 31 - bit::lzcnt(m_secondLevelMaps[fl]);
+
+      uint64_t largest = 0;
+
+      for (uint32_t block = m_freeHeads[fl][sl]; block != InvalidBlock; block = m_blocks[block].nextFree) {
+        largest = std::max(largest, m_blocks[block].size);
+      }
+
+      return largest;
+    }
+
+    uint64_t capacity() const {
+      return m_capacity;
+    }
+
+    bool isEmpty() const {
+      return m_stats.allocations == 0;
+    }
+
+    const Stats& getStats() const {
+      return m_stats;
+    }
+
+    /**
+     * \brief Calls a function for every free range in address order
+     *
+     * Meant for tests and diagnostics, walks all ranges.
+     * \param [in] fn Called with the offset and size of each free range
+     */
+    template<typename Fn>
+    void forEachFreeRange(const Fn& fn) const {
+      uint32_t block = m_firstPhysical;
+
+      while (block != InvalidBlock) {
+        if (m_blocks[block].isFree) {
+          fn(m_blocks[block].offset, m_blocks[block].size);
+        }
+        block = m_blocks[block].nextPhysical;
+      }
+    }
+
+  private:
+    struct Block {
+      uint64_t offset;
+      uint64_t size;
+      uint32_t prevPhysical;
+      uint32_t nextPhysical;
+      uint32_t prevFree;
+      uint32_t nextFree;
+      bool isFree;
+    };
+
+    uint64_t m_capacity;
+    Stats m_stats;
+
+    std::vector<Block> m_blocks;
+    std::vector<uint32_t> m_unusedBlocks;
+    uint32_t m_firstPhysical = InvalidBlock;
+
+    uint64_t m_firstLevelMap = 0;
+    uint32_t m_secondLevelMaps[FirstLevelCount] = { };
+    uint32_t m_freeHeads[FirstLevelCount][SecondLevelCount];
+
+    static uint64_t alignUp(uint64_t value, uint64_t align) {
+      return (value + align - 1) & ~(align - 1);
+    }
+
+    static uint32_t lzcnt64(uint64_t n) {
+      const uint32_t hi = uint32_t(n >> 32);
+      return hi != 0 ? bit::lzcnt(hi) : 32 + bit::lzcnt(uint32_t(n));
+    }
+
+    static uint32_t tzcnt64(uint64_t n) {
+      const uint32_t lo = uint32_t(n);
+      return lo != 0 ? bit::tzcnt(lo) : 32 + bit::tzcnt(uint32_t(n >> 32));
+    }
+
+    // Class of a range, sizes below SecondLevelCount map linearly into the first list
+    static void mapping(uint64_t size, uint32_t& fl, uint32_t& sl) {
+      if (size < SecondLevelCount) {
+        fl = 0;
+        sl = uint32_t(size);
+      } else {
+        const uint32_t msb = 63 - lzcnt64(size);
+        fl = msb - SecondLevelBits + 1;
+        sl = uint32_t(size >> (msb - SecondLevelBits)) ^ SecondLevelCount;
+      }
+    }
+
+    uint32_t findFree(uint64_t size) const {
+      // Round up to the next class, so that every range in it fits
+      if (size >= SecondLevelCount) {
+        const uint32_t msb = 63 - lzcnt64(size);
+        const uint64_t round = (uint64_t(1) << (msb - SecondLevelBits)) - 1;
+
+        if (size + round < size) {
+          return InvalidBlock;
+        }
+
+        size += round;
+      }
+
+      uint32_t fl, sl;
+      mapping(size, fl, sl);
+
+      return findFreeFrom(fl, sl);
+    }
+
+    uint32_t findFreeFrom(uint32_t fl, uint32_t sl) const {
+      uint32_t slMap = sl < SecondLevelCount ? m_secondLevelMaps[fl] & (~0u << sl) : 0;
+
+      if (slMap == 0) {
+        const uint64_t flMap = fl + 1 < 64 ? m_firstLevelMap & (~0ull << (fl + 1)) : 0;
+
+        if (flMap == 0) {
+          return InvalidBlock;
+        }
+
+        fl = tzcnt64(flMap);
+        slMap = m_secondLevelMaps[fl];
+      }
+
+      return m_freeHeads[fl][bit::tzcnt(slMap)];
+    }
+
+    uint32_t findFittingInClass(uint64_t length, uint64_t align) const {
+      uint32_t fl, sl;
+      mapping(length, fl, sl);
+
+      if (!(m_secondLevelMaps[fl] & (1u << sl))) {
+        return InvalidBlock;
+      }
+
+      for (uint32_t block = m_freeHeads[fl][sl]; block != InvalidBlock; block = m_blocks[block].nextFree) {
+        const Block& b = m_blocks[block];
+
+        if (alignUp(b.offset, align) + length <= b.offset + b.size) {
+          return block;
+        }
+      }
+
+      return InvalidBlock;
+    }
+
+    uint32_t createBlock(uint64_t offset, uint64_t size, uint32_t prevPhysical, uint32_t nextPhysical) {
+      uint32_t block;
+
+      if (!m_unusedBlocks.empty()) {
+        block = m_unusedBlocks.back();
+        m_unusedBlocks.pop_back();
+      } else {
+        block = uint32_t(m_blocks.size());
+        m_blocks.emplace_back();
+      }
+
+      m_blocks[block] = Block { offset, size, prevPhysical, nextPhysical, InvalidBlock, InvalidBlock, false };
+
+      if (prevPhysical == InvalidBlock) {
+        m_firstPhysical = block;
+      }
+
+      return block;
+    }
+
+    void destroyBlock(uint32_t block) {
+      // Note: Keeps stale handles from passing the assert in free.
+      m_blocks[block].isFree = true;
+      m_unusedBlocks.push_back(block);
+    }
+
+    void linkPrevious(uint32_t block) {
+      const uint32_t prev = m_blocks[block].prevPhysical;
+
+      if (prev != InvalidBlock) {
+        m_blocks[prev].nextPhysical = block;
+      } else {
+        m_firstPhysical = block;
+      }
+
+      m_blocks[m_blocks[block].nextPhysical].prevPhysical = block;
+    }
+
+    void linkNext(uint32_t block) {
+      const uint32_t next = m_blocks[block].nextPhysical;
+
+      if (next != InvalidBlock) {
+        m_blocks[next].prevPhysical = block;
+      }
+    }
+
+    void insertFree(uint32_t block) {
+      uint32_t fl, sl;
+      mapping(m_blocks[block].size, fl, sl);
+
+      const uint32_t head = (m_secondLevelMaps[fl] & (1u << sl)) ? m_freeHeads[fl][sl] : InvalidBlock;
+
+      m_blocks[block].isFree = true;
+      m_blocks[block].prevFree = InvalidBlock;
+      m_blocks[block].nextFree = head;
+
+      if (head != InvalidBlock) {
+        m_blocks[head].prevFree = block;
+      }
+
+      m_freeHeads[fl][sl] = block;
+      m_secondLevelMaps[fl] |= 1u << sl;
+      m_firstLevelMap |= 1ull << fl;
+      m_stats.freeRanges += 1;
+    }
+
+    void removeFree(uint32_t block) {
+      uint32_t fl, sl;
+      mapping(m_blocks[block].size, fl, sl);
+
+      const uint32_t prev = m_blocks[block].prevFree;
+      const uint32_t next = m_blocks[block].nextFree;
+
+      if (prev != InvalidBlock) {
+        m_blocks[prev].nextFree = next;
+      } else {
+        m_freeHeads[fl][sl] = next;
+      }
+
+      if (next != InvalidBlock) {
+        m_blocks[next].prevFree = prev;
+      }
+
+      if (m_freeHeads[fl][sl] == InvalidBlock) {
+        m_secondLevelMaps[fl] &= ~(1u << sl);
+
+        if (m_secondLevelMaps[fl] == 0) {
+          m_firstLevelMap &= ~(1ull << fl);
+        }
+      }
+
+      m_blocks[block].isFree = false;
+      m_stats.freeRanges -= 1;
+    }
+  };
+
+}
@@ -0,0 +1,272 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_timer.h"
+#include "../../../src/dxvk/rtx_render/rtx_asset_package.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_asset_package.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    static constexpr uint32_t kBlobSize = 16;
+
+    struct AssetDescV1 {
+      uint16_t nameIdx;
+      AssetPackage::AssetDesc::Type type;
+      uint8_t format;
+      uint32_t size;
+      uint16_t depth;
+      uint16_t numMips;
+      uint16_t numTailMips;
+      uint16_t arraySize;
+      uint16_t baseBlobIdx;
+      uint16_t tailBlobIdx;
+    };
+
+    static_assert(sizeof(AssetDescV1) == 20, "Asset description structure size mismatch!");
+
+    std::string m_filename;
+
+    static std::string assetName(uint32_t idx) {
+      return str::format("textures/T_", idx, "_", (idx * 2654435761u) % 977, ".dds");
+    }
+
+    static uint8_t blobByte(uint32_t blobIdx, uint32_t i) {
+      return static_cast<uint8_t>(blobIdx * 31 + i);
+    }
+
+    static void write(FILE* file, const void* data, size_t size) {
+      if (size != std::fwrite(data, 1, size, file)) {
+        throw DxvkError("Unable to write the test package");
+      }
+    }
+
+    // Writes a package with a single data blob per asset. A misaligned
+    // version 2 dictionary cannot be used in place and has to be read.
+    void writePackage(uint32_t version, uint32_t assetCount, bool alignDictionary) {
+      FILE* file = std::fopen(m_filename.c_str(), "wb");
+      if (file == nullptr) {
+        throw DxvkError(str::format("Unable to create ", m_filename));
+      }
+
+      AssetPackage::Header header = { AssetPackage::kMagic, version, 0 };
+      write(file, &header, sizeof(header));
+
+      std::vector<AssetPackage::BlobDesc> blobs(assetCount);
+      for (uint32_t i = 0; i < assetCount; ++i) {
+        uint8_t data[kBlobSize];
+        for (uint32_t n = 0; n < kBlobSize; ++n) {
+          data[n] = blobByte(i, n);
+        }
+
+        blobs[i] = { };
+        blobs[i].offset = std::ftell(file);
+        blobs[i].size = kBlobSize;
+        write(file, data, kBlobSize);
+      }
+
+      if (!alignDictionary) {
+        write(file, "", 1);
+      }
+
+      header.dictOffset = std::ftell(file);
+
+      std::string names;
+      std::vector<uint32_t> nameOffsets;
+      for (uint32_t i = 0; i < assetCount; ++i) {
+        nameOffsets.push_back(static_cast<uint32_t>(names.size()));
+        names += assetName(i);
+        names.push_back('\0');
+      }
+
+      if (version == 1) {
+        const uint16_t counts[2] = { static_cast<uint16_t>(assetCount), static_cast<uint16_t>(assetCount) };
+        write(file, counts, sizeof(counts));
+
+        for (uint32_t i = 0; i < assetCount; ++i) {
+          AssetDescV1 desc = { };
+          desc.nameIdx = static_cast<uint16_t>(i);
+          desc.type = AssetPackage::AssetDesc::Type::BUFFER;
+          desc.size = i;
+          desc.numMips = 1;
+          desc.arraySize = 1;
+          desc.baseBlobIdx = static_cast<uint16_t>(i);
+          write(file, &desc, sizeof(desc));
+        }
+      } else {
+        const AssetPackage::DictHeader dictHeader = { assetCount, assetCount, names.size() };
+        write(file, &dictHeader, sizeof(dictHeader));
+
+        std::vector<AssetPackage::NameIndexEntry> nameIndex;
+
+        for (uint32_t i = 0; i < assetCount; ++i) {
+          AssetPackage::AssetDesc desc = { };
+          desc.nameOffset = nameOffsets[i];
+          desc.type = AssetPackage::AssetDesc::Type::BUFFER;
+          desc.size = i;
+          desc.numMips = 1;
+          desc.arraySize = 1;
+          desc.baseBlobIdx = i;
+          write(file, &desc, sizeof(desc));
+
+          nameIndex.push_back({ AssetPackage::hashName(assetName(i)), i, 0 });
+        }
+
+        write(file, blobs.data(), blobs.size() * sizeof(AssetPackage::BlobDesc));
+
+        std::sort(nameIndex.begin(), nameIndex.end(), [](const auto& a, const auto& b) {
+          return a.hash < b.hash || (a.hash == b.hash && a.assetIdx < b.assetIdx);
+        });
+        write(file, nameIndex.data(), nameIndex.size() * sizeof(AssetPackage::NameIndexEntry));
+      }
+
+      if (version == 1) {
+        write(file, blobs.data(), blobs.size() * sizeof(AssetPackage::BlobDesc));
+      }
+
+      write(file, names.data(), names.size());
+
+      std::fseek(file, 0, SEEK_SET);
+      write(file, &header, sizeof(header));
+      std::fclose(file);
+    }
+
+    void checkPackage(uint32_t version, uint32_t assetCount, bool alignDictionary) {
+      writePackage(version, assetCount, alignDictionary);
+
+      Rc<AssetPackage> package = new AssetPackage(m_filename);
+
+      {
+        std::cout << "Mounting a version " << version << " package with " << assetCount << " assets" << std::endl;
+        Timer time;
+
+        if (!package->initialize()) {
+          throw DxvkError(str::format("Unable to mount a version ", version, " package"));
+        }
+      }
+
+      if (package->getAssetCount() != assetCount) {
+        throw DxvkError(str::format("Unexpected asset count ", package->getAssetCount()));
+      }
+
+      for (uint32_t i = 0; i < assetCount; ++i) {
+        const uint32_t assetIdx = package->findAsset(assetName(i));
+
+        if (assetIdx != i) {
+          throw DxvkError(str::format("Asset ", assetName(i), " was found at ", assetIdx, " instead of ", i));
+        }
+
+        if (package->getAssetName(i) != assetName(i)) {
+          throw DxvkError(str::format("Unexpected name of asset ", i));
+        }
+
+        const AssetPackage::AssetDesc* desc = package->getAssetDesc(i);
+
+        if (desc == nullptr || desc->size != i || desc->baseBlobIdx != i ||
+            desc->type != AssetPackage::AssetDesc::Type::BUFFER) {
+          throw DxvkError(str::format("Unexpected description of asset ", i));
+        }
+      }
+
+      if (package->findAsset("textures/missing.dds") != AssetPackage::kNoAssetIdx ||
+          package->findAsset("") != AssetPackage::kNoAssetIdx ||
+          package->getAssetDesc(assetCount) != nullptr ||
+          package->getDataBlobDesc(assetCount) != nullptr) {
+        throw DxvkError("Lookup of a missing asset succeeded");
+      }
+
+      // The blob descriptions must point at the right data
+      for (uint32_t i : { 0u, assetCount / 2, assetCount - 1 }) {
+        uint8_t data[kBlobSize];
+
+        if (package->readDataBlob(i, data, sizeof(data)) != kBlobSize) {
+          throw DxvkError(str::format("Unable to read blob ", i));
+        }
+
+        const uint8_t* mapped = static_cast<const uint8_t*>(package->mapDataBlob(i));
+
+        for (uint32_t n = 0; n < kBlobSize; ++n) {
+          if (data[n] != blobByte(i, n) || mapped == nullptr || mapped[n] != blobByte(i, n)) {
+            throw DxvkError(str::format("Unexpected contents of blob ", i));
+          }
+        }
+      }
+    }
+
+    void test_corrupted() {
+      writePackage(2, 100, true);
+
+      // Cut the name table short
+      std::filesystem::resize_file(m_filename, std::filesystem::file_size(m_filename) - 10);
+
+      Rc<AssetPackage> package = new AssetPackage(m_filename);
+
+      if (package->initialize()) {
+        throw DxvkError("A truncated package was mounted");
+      }
+
+      if (package->getAssetCount() != 0 || package->findAsset(assetName(0)) != AssetPackage::kNoAssetIdx) {
+        throw DxvkError("A failed mount left a dictionary behind");
+      }
+    }
+
+  public:
+    void run() {
+      m_filename = (std::filesystem::temp_directory_path() / "test_asset_package.pkg").string();
+
+      checkPackage(1, 1000, true);
+      checkPackage(2, 1000, true);
+      checkPackage(2, 1000, false);
+
+      // Version 2 packages are not limited to 16 bit counts
+      checkPackage(2, 100000, true);
+      checkPackage(1, 65535, true);
+
+      test_corrupted();
+
+      std::filesystem::remove(m_filename);
+
+      std::cout << "All passed\n";
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp testApp;
+    testApp.run();
+  }
+  catch (const dxvk::DxvkError& error) {
+    std::cerr << error.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
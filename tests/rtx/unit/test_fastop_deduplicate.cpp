@@ -0,0 +1,213 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_fastops.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+#define TEST(ISA)                                                                                                   \
+      {                                                                                                             \
+        std::vector<T> out(reference.size());                                                                       \
+        uint32_t uniqueCount;                                                                                       \
+        if (verbose) {                                                                                              \
+          std::cout << "Running: deduplicateSort_"#ISA" --> ";                                                     \
+          Timer time;                                                                                               \
+          uniqueCount = fast::deduplicateSort_##ISA<T>(out.data(), srcData.data(), count, maxValue, scratch.data()); \
+        } else {                                                                                                    \
+          uniqueCount = fast::deduplicateSort_##ISA<T>(out.data(), srcData.data(), count, maxValue, scratch.data()); \
+        }                                                                                                           \
+        if (uniqueCount != reference.size() || !std::equal(reference.begin(), reference.end(), out.begin()))       \
+          throw dxvk::DxvkError("Output not matching deduplicateSort_"#ISA);                                        \
+        if (std::any_of(scratch.begin(), scratch.end(), [](uint8_t flag) { return flag != 0; }))                   \
+          throw dxvk::DxvkError("Scratch memory not cleared by deduplicateSort_"#ISA);                              \
+      }
+
+#define TEST_CHECK(ISA)                                                    \
+      if (fast::getSimdSupportLevel() >= SIMD::ISA) {                      \
+        TEST(ISA);                                                         \
+      } else if (verbose) {                                                \
+        std::cout << #ISA" not supported by this processor" << std::endl;  \
+      }
+
+namespace fast {
+  template<typename T>
+  extern uint32_t deduplicateSort_slow(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template<typename T>
+  extern uint32_t deduplicateSort_SSE(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template<typename T>
+  extern uint32_t deduplicateSort_AVX2(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+  template<typename T>
+  extern uint32_t deduplicateSort_AVX512(T* dstData, const T* srcData, const uint32_t count, const uint32_t maxValue, uint8_t* scratchFlags);
+
+class DeduplicateTestApp {
+public:
+  static void run() {
+    std::cout << "Begin test (16-bit)" << std::endl;
+    test_correctness<uint16_t>();
+    test_benchmark<uint16_t>();
+
+    std::cout << "Begin test (32-bit)" << std::endl;
+    test_correctness<uint32_t>();
+    test_benchmark<uint32_t>();
+  }
+
+private:
+  // The binning approach hashGeometryData used before, kept as the reference
+  template<typename T>
+  static void deduplicateSortLegacy(const T* srcData, const uint32_t count, const uint32_t maxValue, std::vector<T>& out) {
+    out.resize(maxValue + 1, (T) 0);
+
+    for (uint32_t i = 0; i < count; i++) {
+      out[srcData[i]] = 1;
+    }
+
+    uint32_t uniqueCount = 0;
+    for (uint32_t i = 0; i <= maxValue; i++) {
+      if (out[i])
+        out[uniqueCount++] = i;
+    }
+
+    out.resize(uniqueCount);
+  }
+
+  template<typename T>
+  static std::vector<T> generateIndices(std::mt19937& rng, const uint32_t count, const uint32_t vertexCount, const float usedFraction) {
+    // Triangle lists over a subset of the vertices, with neighbouring triangles sharing vertices
+    std::uniform_real_distribution<float> unorm(0.f, 1.f);
+    std::vector<T> used;
+    for (uint32_t v = 0; v < vertexCount; v++) {
+      if (unorm(rng) < usedFraction)
+        used.push_back(v);
+    }
+
+    if (used.empty())
+      used.push_back(vertexCount - 1);
+
+    std::vector<T> indices(count);
+    std::uniform_int_distribution<uint32_t> jitter(0, 8);
+    for (uint32_t i = 0; i < count; i++) {
+      const uint32_t base = (uint64_t) i * used.size() / std::max(count, 1u);
+      indices[i] = used[std::min<size_t>(base + jitter(rng), used.size() - 1)];
+    }
+
+    std::shuffle(indices.begin(), indices.begin() + count / 2, rng);
+    return indices;
+  }
+
+  template<typename T>
+  static void execute(const std::vector<T>& srcData, const uint32_t maxValue, const bool verbose) {
+    const uint32_t count = (uint32_t) srcData.size();
+
+    std::vector<T> reference;
+    if (verbose) {
+      std::cout << "Running: legacy binning --> ";
+      Timer time;
+      deduplicateSortLegacy(srcData.data(), count, maxValue, reference);
+    } else {
+      deduplicateSortLegacy(srcData.data(), count, maxValue, reference);
+    }
+
+    std::vector<uint8_t> scratch(fast::deduplicateSortScratchSize(maxValue), 0);
+
+    TEST(slow);
+    TEST(SSE);
+    TEST_CHECK(AVX2);
+    TEST_CHECK(AVX512);
+
+    // The dispatching entry point
+    std::vector<T> out(reference.size());
+    if (fast::deduplicateSort<T>(out.data(), srcData.data(), count, maxValue, scratch.data()) != reference.size() || out != reference)
+      throw dxvk::DxvkError("Output not matching deduplicateSort");
+  }
+
+  template<typename T>
+  static void test_correctness() {
+    std::mt19937 rng(1234);
+    const uint32_t maxVertexCount = (uint32_t) std::min<uint64_t>(std::numeric_limits<T>::max() + 1ull, 300000);
+
+    // Edge cases, a single value, a large value range and an empty set
+    execute<T>({ 0 }, 0, false);
+    execute<T>({ 7, 7, 7 }, 7, false);
+    const T largeValue = (T) std::min<uint32_t>(std::numeric_limits<T>::max(), 1u << 24);
+    execute<T>({ largeValue, 0, largeValue }, largeValue, false);
+    execute<T>({ }, 100, false);
+
+    for (uint32_t iteration = 0; iteration < 200; iteration++) {
+      const uint32_t vertexCount = 1 + rng() % maxVertexCount;
+      const uint32_t indexCount = 1 + rng() % (vertexCount * 3);
+      const float usedFraction = (rng() % 4 == 0) ? 1.f : (rng() % 1000) / 1000.f;
+
+      const std::vector<T> indices = generateIndices<T>(rng, indexCount, vertexCount, usedFraction);
+      const uint32_t maxValue = *std::max_element(indices.begin(), indices.end());
+
+      execute<T>(indices, maxValue, false);
+    }
+
+    std::cout << "Deduplicate fast ops successfully tested for correctness" << std::endl;
+  }
+
+  template<typename T>
+  static void test_benchmark() {
+    std::mt19937 rng(5678);
+
+    struct Case {
+      const char* name;
+      uint32_t indexCount;
+      uint32_t vertexCount;
+      float usedFraction;
+    };
+
+    const Case cases[] = {
+      { "small mesh", 3 * 2000, 1200, 1.f },
+      { "dense mesh", 3 * 40000, 21000, 1.f },
+      { "sparse mesh", 3 * 5000, 60000, 0.1f },
+      { "large mesh", 3 * 500000, 260000, 1.f },
+    };
+
+    for (const Case& c : cases) {
+      const uint32_t vertexCount = (uint32_t) std::min<uint64_t>(c.vertexCount, std::numeric_limits<T>::max() + 1ull);
+      const std::vector<T> indices = generateIndices<T>(rng, c.indexCount, vertexCount, c.usedFraction);
+      const uint32_t maxValue = *std::max_element(indices.begin(), indices.end());
+
+      std::cout << std::endl << "Benchmark: " << c.name << ", " << c.indexCount << " indices, max index " << maxValue << std::endl;
+      execute<T>(indices, maxValue, true);
+    }
+  }
+};
+}
+
+int main() {
+  try {
+    fast::DeduplicateTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
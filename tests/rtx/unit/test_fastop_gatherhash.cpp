@@ -0,0 +1,216 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <cstring>
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_fastops.h"
+#include "../../../src/util/util_timer.h"
+#include "../../../src/util/xxHash/xxhash.h"
+
+using namespace dxvk;
+
+namespace fast {
+class GatherHashTestApp {
+public:
+  static void run() {
+    test_correctness<uint16_t>();
+    test_correctness<uint32_t>();
+
+    std::cout << "Gather hash fast ops successfully tested for correctness" << std::endl;
+
+    test_benchmark();
+  }
+
+private:
+  static constexpr uint32_t kSegmentElements = 64 * 1024;
+
+  // Interleaved vertex data, 12 bytes of positions followed by 8 bytes of texcoords and some padding
+  static constexpr size_t kStride = 32;
+
+  static std::vector<uint8_t> generateVertices(std::mt19937& rng, const uint32_t vertexCount) {
+    std::vector<uint8_t> vertices(vertexCount * kStride);
+    for (uint8_t& byte : vertices) {
+      byte = (uint8_t) rng();
+    }
+    return vertices;
+  }
+
+  // What hashVertexRegionIndexed does, one seeded hash per element
+  template<typename T>
+  static uint64_t hashChained(const uint8_t* pBase, const size_t elementSize, const T* indices, const uint32_t count) {
+    uint64_t result = 0;
+    for (uint32_t i = 0; i < count; i++) {
+      result = XXH3_64bits_withSeed(pBase + indices[i] * kStride, elementSize, result);
+    }
+    return result;
+  }
+
+  template<typename T>
+  static uint64_t hashReference(const uint8_t* pBase, const size_t elementSize, const T* indices, const uint32_t begin, const uint32_t end) {
+    std::vector<uint8_t> gathered;
+    for (uint32_t i = begin; i < end; i++) {
+      const size_t index = indices ? indices[i] : i;
+      gathered.insert(gathered.end(), pBase + index * kStride, pBase + index * kStride + elementSize);
+    }
+    return XXH3_64bits(gathered.data(), gathered.size());
+  }
+
+  template<typename T>
+  static uint64_t hashReference(const uint8_t* pBase, const size_t elementSize, const T* indices, const uint32_t count) {
+    if (count <= kSegmentElements) {
+      return hashReference(pBase, elementSize, indices, 0, count);
+    }
+
+    std::vector<uint64_t> segmentHashes;
+    for (uint32_t begin = 0; begin < count; begin += kSegmentElements) {
+      segmentHashes.push_back(hashReference(pBase, elementSize, indices, begin, std::min(begin + kSegmentElements, count)));
+    }
+    return XXH3_64bits(segmentHashes.data(), segmentHashes.size() * sizeof(uint64_t));
+  }
+
+  template<typename T>
+  static void test_correctness() {
+    std::mt19937 rng(1234);
+
+    const uint32_t vertexCount = (uint32_t) std::min<uint64_t>(std::numeric_limits<T>::max() + 1ull, 300000);
+    const std::vector<uint8_t> vertices = generateVertices(rng, vertexCount);
+
+    for (const uint32_t count : { 0u, 1u, 7u, 1000u, kSegmentElements, kSegmentElements + 1, vertexCount }) {
+      if (count > vertexCount)
+        continue;
+
+      std::vector<T> indices(count);
+      std::iota(indices.begin(), indices.end(), (T) 0);
+      std::shuffle(indices.begin(), indices.end(), rng);
+
+      std::vector<uint64_t> scratch(fast::hashGatheredElementsScratchSize(count));
+
+      // Element sizes with a dedicated gather loop, a generic one and one larger than the gather block
+      for (const size_t elementSize : { 8u, 12u, 16u, 4u, 20u }) {
+        const uint64_t expected = hashReference(vertices.data(), elementSize, indices.data(), count);
+
+        if (fast::hashGatheredElements(vertices.data(), kStride, elementSize, indices.data(), count, scratch.data()) != expected)
+          throw dxvk::DxvkError(str::format("Indexed gather hash mismatch, count ", count, " element size ", elementSize));
+
+        // Splitting the work across threads must not change the hash
+        if (fast::hashGatheredElements(vertices.data(), kStride, elementSize, indices.data(), count, scratch.data(), 1) != expected)
+          throw dxvk::DxvkError(str::format("Parallel gather hash mismatch, count ", count, " element size ", elementSize));
+
+        const uint64_t expectedNonIndexed = hashReference<T>(vertices.data(), elementSize, nullptr, count);
+
+        if (fast::hashGatheredElements<T>(vertices.data(), kStride, elementSize, nullptr, count, scratch.data()) != expectedNonIndexed)
+          throw dxvk::DxvkError(str::format("Non-indexed gather hash mismatch, count ", count, " element size ", elementSize));
+      }
+    }
+
+    // Elements that do not fit into a gather block are hashed in place
+    std::vector<uint8_t> large(3 * 10000);
+    for (uint8_t& byte : large) {
+      byte = (uint8_t) rng();
+    }
+
+    const T largeIndices[] = { 2, 0, 1 };
+    std::vector<uint8_t> gathered;
+    for (const T index : largeIndices) {
+      gathered.insert(gathered.end(), large.begin() + index * 10000, large.begin() + (index + 1) * 10000);
+    }
+
+    uint64_t largeScratch;
+    if (fast::hashGatheredElements(large.data(), 10000, 10000, largeIndices, 3, &largeScratch) != XXH3_64bits(gathered.data(), gathered.size()))
+      throw dxvk::DxvkError("Gather hash mismatch for large elements");
+  }
+
+  template<typename T>
+  static void benchmark(std::mt19937& rng, const uint32_t vertexCount, const size_t elementSize) {
+    const std::vector<uint8_t> vertices = generateVertices(rng, vertexCount);
+
+    // Unique indices are sorted, as produced by deduplicateSort
+    std::vector<T> indices(vertexCount);
+    std::iota(indices.begin(), indices.end(), (T) 0);
+
+    std::vector<uint64_t> scratch(fast::hashGatheredElementsScratchSize(vertexCount));
+
+    constexpr uint32_t kIterations = 10;
+    uint64_t legacy = 0;
+    uint64_t streamed = 0;
+
+    std::cout << std::endl << vertexCount << " vertices, " << sizeof(T) * 8 << "-bit indices, " << elementSize << " byte elements" << std::endl;
+
+    {
+      std::cout << "Running: chained per element hash --> ";
+      Timer time;
+      for (uint32_t i = 0; i < kIterations; i++) {
+        legacy += hashChained(vertices.data(), elementSize, indices.data(), vertexCount);
+      }
+    }
+
+    {
+      std::cout << "Running: streamed gather hash --> ";
+      Timer time;
+      for (uint32_t i = 0; i < kIterations; i++) {
+        streamed += fast::hashGatheredElements(vertices.data(), kStride, elementSize, indices.data(), vertexCount, scratch.data());
+      }
+    }
+
+    {
+      std::cout << "Running: streamed gather hash, parallel --> ";
+      Timer time;
+      for (uint32_t i = 0; i < kIterations; i++) {
+        streamed -= fast::hashGatheredElements(vertices.data(), kStride, elementSize, indices.data(), vertexCount, scratch.data(), 1);
+      }
+    }
+
+    if (streamed != 0 || legacy == 0)
+      throw dxvk::DxvkError("Unexpected benchmark hashes");
+  }
+
+  static void test_benchmark() {
+    std::mt19937 rng(5678);
+
+    for (const uint32_t vertexCount : { 100u, 1000u, 10000u, 60000u }) {
+      benchmark<uint16_t>(rng, vertexCount, 12);
+      benchmark<uint16_t>(rng, vertexCount, 8);
+    }
+
+    for (const uint32_t vertexCount : { 100000u, 1000000u }) {
+      benchmark<uint32_t>(rng, vertexCount, 12);
+      benchmark<uint32_t>(rng, vertexCount, 8);
+    }
+  }
+};
+}
+
+int main() {
+  try {
+    fast::GatherHashTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
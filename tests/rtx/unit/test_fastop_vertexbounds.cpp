@@ -0,0 +1,220 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cfloat>
+#include <cstring>
+#include <random>
+#include <vector>
+#include <xmmintrin.h>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_fastops.h"
+#include "../../../src/util/util_timer.h"
+
+using namespace dxvk;
+
+namespace fast {
+extern void extendBoundingBox_slow(const uint8_t* pPositions, const size_t stride, const uint32_t count, float minPos[3], float maxPos[3]);
+extern void extendBoundingBox_SSE(const uint8_t* pPositions, const size_t stride, const uint32_t count, float minPos[3], float maxPos[3]);
+extern void extendByteRange_slow(const uint8_t* pData, const size_t stride, const uint32_t count, const uint32_t bytesPerElement, uint8_t& minValue, uint8_t& maxValue);
+extern void extendByteRange_SSE(const uint8_t* pData, const size_t stride, const uint32_t count, const uint32_t bytesPerElement, uint8_t& minValue, uint8_t& maxValue);
+
+class VertexBoundsTestApp {
+public:
+  static void run() {
+    test_boundingBox();
+    test_byteRange();
+
+    std::cout << "Vertex bounds fast ops successfully tested for correctness" << std::endl;
+
+    test_benchmark();
+  }
+
+private:
+  // Vertex data is sized exactly, so that reading past the last element is caught by the address sanitizer
+  static std::vector<uint8_t> generateVertices(std::mt19937& rng, const uint32_t count, const size_t stride, const size_t elementSize) {
+    std::vector<uint8_t> vertices(count > 0 ? (count - 1) * stride + elementSize : 0);
+    std::uniform_real_distribution<float> position(-1000.f, 1000.f);
+
+    for (size_t i = 0; i + sizeof(float) <= vertices.size(); i += sizeof(float)) {
+      const float value = position(rng);
+      memcpy(&vertices[i], &value, sizeof(float));
+    }
+    return vertices;
+  }
+
+  static void test_boundingBox() {
+    std::mt19937 rng(1234);
+
+    for (const size_t stride : { 12u, 16u, 20u, 32u, 44u }) {
+      for (const uint32_t count : { 0u, 1u, 2u, 3u, 4u, 5u, 17u, 1000u }) {
+        const std::vector<uint8_t> vertices = generateVertices(rng, count, stride, 12);
+
+        // Start from an empty box and from one the positions only partially extend
+        for (const float initial : { FLT_MAX, 0.f }) {
+          float expectedMin[3] = { initial, initial, initial };
+          float expectedMax[3] = { -initial, -initial, -initial };
+          extendBoundingBox_slow(vertices.data(), stride, count, expectedMin, expectedMax);
+
+          float minPos[3] = { initial, initial, initial };
+          float maxPos[3] = { -initial, -initial, -initial };
+          extendBoundingBox_SSE(vertices.data(), stride, count, minPos, maxPos);
+
+          if (memcmp(minPos, expectedMin, sizeof(minPos)) != 0 || memcmp(maxPos, expectedMax, sizeof(maxPos)) != 0)
+            throw dxvk::DxvkError(str::format("Bounding box mismatch, stride ", stride, " count ", count));
+        }
+      }
+    }
+  }
+
+  static void test_byteRange() {
+    std::mt19937 rng(5678);
+
+    for (const size_t stride : { 4u, 5u, 8u, 32u }) {
+      for (const uint32_t count : { 0u, 1u, 4u, 5u, 9u, 1000u }) {
+        for (uint32_t bytesPerElement = 1; bytesPerElement <= 4; bytesPerElement++) {
+          std::vector<uint8_t> data(count > 0 ? (count - 1) * stride + bytesPerElement : 0);
+          for (uint8_t& byte : data) {
+            // Keep the values away from the limits, so that bytes leaking in from outside the elements show
+            byte = (uint8_t) (16 + rng() % 200);
+          }
+
+          for (const uint8_t initial : { (uint8_t) 255, (uint8_t) 100 }) {
+            uint8_t expectedMin = initial;
+            uint8_t expectedMax = 255 - initial;
+            extendByteRange_slow(data.data(), stride, count, bytesPerElement, expectedMin, expectedMax);
+
+            uint8_t minValue = initial;
+            uint8_t maxValue = 255 - initial;
+            extendByteRange_SSE(data.data(), stride, count, bytesPerElement, minValue, maxValue);
+
+            if (minValue != expectedMin || maxValue != expectedMax)
+              throw dxvk::DxvkError(str::format("Byte range mismatch, stride ", stride, " count ", count, " bytes ", bytesPerElement));
+          }
+        }
+      }
+    }
+
+    // Bytes past bytesPerElement must not affect the range
+    const uint8_t element[8] = { 10, 20, 0, 255, 30, 40, 0, 255 };
+    uint8_t minValue = 255;
+    uint8_t maxValue = 0;
+    extendByteRange(element, 4, 2, 2, minValue, maxValue);
+
+    if (minValue != 10 || maxValue != 40)
+      throw dxvk::DxvkError("Byte range includes bytes outside of the elements");
+  }
+
+  // What the geometry workers did before, one set of scalar loads per vertex
+  static void boundingBoxLegacy(const uint8_t* pVertex, const size_t stride, const uint32_t count, float minOut[3], float maxOut[3]) {
+    __m128 minPos = _mm_set_ps1(FLT_MAX);
+    __m128 maxPos = _mm_set_ps1(-FLT_MAX);
+
+    for (uint32_t i = 0; i < count; ++i) {
+      const float* pPosition = reinterpret_cast<const float*>(pVertex);
+      __m128 vertexPos = _mm_set_ps(0.0f, pPosition[2], pPosition[1], pPosition[0]);
+      minPos = _mm_min_ps(minPos, vertexPos);
+      maxPos = _mm_max_ps(maxPos, vertexPos);
+      pVertex += stride;
+    }
+
+    alignas(16) float minStore[4];
+    alignas(16) float maxStore[4];
+    _mm_store_ps(minStore, minPos);
+    _mm_store_ps(maxStore, maxPos);
+    memcpy(minOut, minStore, 3 * sizeof(float));
+    memcpy(maxOut, maxStore, 3 * sizeof(float));
+  }
+
+  static void benchmark(std::mt19937& rng, const uint32_t count, const size_t stride) {
+    const std::vector<uint8_t> vertices = generateVertices(rng, count, stride, 12);
+
+    constexpr uint32_t kIterations = 100;
+    float legacy = 0.f;
+    float fused = 0.f;
+
+    std::cout << std::endl << count << " vertices, " << stride << " byte stride" << std::endl;
+
+    {
+      std::cout << "Running: bounding box, per vertex loads --> ";
+      Timer time;
+      for (uint32_t i = 0; i < kIterations; i++) {
+        float minPos[3], maxPos[3];
+        boundingBoxLegacy(vertices.data(), stride, count, minPos, maxPos);
+        legacy += minPos[0] + maxPos[2];
+      }
+    }
+
+    {
+      std::cout << "Running: bounding box, full width loads --> ";
+      Timer time;
+      for (uint32_t i = 0; i < kIterations; i++) {
+        float minPos[3] = { FLT_MAX, FLT_MAX, FLT_MAX };
+        float maxPos[3] = { -FLT_MAX, -FLT_MAX, -FLT_MAX };
+        extendBoundingBox(vertices.data(), stride, count, minPos, maxPos);
+        fused += minPos[0] + maxPos[2];
+      }
+    }
+
+    {
+      std::cout << "Running: bone range, per byte --> ";
+      Timer time;
+      uint8_t minValue = 255, maxValue = 0;
+      for (uint32_t i = 0; i < kIterations; i++) {
+        extendByteRange_slow(vertices.data() + 12 - 4, stride, count, 4, minValue, maxValue);
+      }
+    }
+
+    {
+      std::cout << "Running: bone range, vectorized --> ";
+      Timer time;
+      uint8_t minValue = 255, maxValue = 0;
+      for (uint32_t i = 0; i < kIterations; i++) {
+        extendByteRange(vertices.data() + 12 - 4, stride, count, 4, minValue, maxValue);
+      }
+    }
+
+    if (legacy != fused)
+      throw dxvk::DxvkError("Unexpected benchmark bounds");
+  }
+
+  static void test_benchmark() {
+    std::mt19937 rng(91011);
+
+    for (const uint32_t count : { 1000u, 100000u, 1000000u }) {
+      benchmark(rng, count, 12);
+      benchmark(rng, count, 32);
+    }
+  }
+};
+}
+
+int main() {
+  try {
+    fast::VertexBoundsTestApp::run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
@@ -0,0 +1,162 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/dxvk/rtx_render/rtx_instance_gc.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_instance_gc.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    struct Instance {
+      uint32_t id;
+      uint32_t frameLastUpdated;
+      bool isMarkedForGC;
+      bool isInsideFrustum;
+      bool isAnimated;
+      bool isPlayerModel;
+      bool isSkinned;
+      uint32_t vectorId;
+    };
+
+    // The collection predicate of the instance manager before the mark and sweep split
+    static bool referenceShouldCollect(const Instance& instance, const uint32_t currentFrame, const uint32_t numFramesToKeepInstances,
+                                       const bool antiCullingObjectEnable, const bool forceGarbageCollection) {
+      const bool enableGarbageCollection =
+        !antiCullingObjectEnable ||
+        instance.isInsideFrustum ||
+        instance.isSkinned ||
+        instance.isAnimated ||
+        instance.isPlayerModel;
+
+      return ((forceGarbageCollection || enableGarbageCollection) &&
+              instance.frameLastUpdated + numFramesToKeepInstances <= currentFrame) ||
+             instance.isMarkedForGC;
+    }
+
+    static bool shouldCollect(const Instance& instance, const uint32_t currentFrame, const uint32_t numFramesToKeepInstances,
+                              const bool antiCullingObjectEnable, const bool forceGarbageCollection, uint32_t& numExemptQueries) {
+      const bool collectAllExpired = !antiCullingObjectEnable || forceGarbageCollection;
+      const uint8_t flags = getGarbageCollectionFlags(instance.isMarkedForGC, collectAllExpired, [&] {
+        ++numExemptQueries;
+        return instance.isInsideFrustum || instance.isAnimated || instance.isPlayerModel || instance.isSkinned;
+      });
+
+      return shouldCollectInstance(flags, instance.frameLastUpdated, currentFrame, numFramesToKeepInstances, collectAllExpired);
+    }
+
+    void test_decision() {
+      const uint32_t currentFrame = 100;
+      const uint32_t numFramesToKeepInstances = 3;
+
+      for (uint32_t bits = 0; bits < (1u << 7); ++bits) {
+        for (uint32_t frameLastUpdated : { 0u, 96u, 97u, 98u, 100u }) {
+          Instance instance = {};
+          instance.frameLastUpdated = frameLastUpdated;
+          instance.isMarkedForGC = bits & (1 << 0);
+          instance.isInsideFrustum = bits & (1 << 1);
+          instance.isAnimated = bits & (1 << 2);
+          instance.isPlayerModel = bits & (1 << 3);
+          instance.isSkinned = bits & (1 << 4);
+          const bool antiCullingObjectEnable = bits & (1 << 5);
+          const bool forceGarbageCollection = bits & (1 << 6);
+
+          uint32_t numExemptQueries = 0;
+          const bool collect = shouldCollect(instance, currentFrame, numFramesToKeepInstances, antiCullingObjectEnable, forceGarbageCollection, numExemptQueries);
+
+          if (collect != referenceShouldCollect(instance, currentFrame, numFramesToKeepInstances, antiCullingObjectEnable, forceGarbageCollection))
+            throw DxvkError(str::format("Collection decision differs from the reference, case ", bits, ", frame ", frameLastUpdated));
+
+          // The exemption needs the BLAS, it must not be queried when the decision does not depend on it
+          const bool exemptMatters = !instance.isMarkedForGC && antiCullingObjectEnable && !forceGarbageCollection;
+          if (numExemptQueries != (exemptMatters ? 1u : 0u))
+            throw DxvkError("Culling exemption was queried when not needed");
+        }
+      }
+    }
+
+    void test_compaction() {
+      std::mt19937 rng(5);
+
+      for (uint32_t round = 0; round < 100; ++round) {
+        std::vector<Instance*> instances;
+        std::vector<Instance> storage(rng() % 64);
+        std::vector<uint8_t> collect(storage.size());
+
+        for (uint32_t i = 0; i < storage.size(); ++i) {
+          storage[i].id = i;
+          storage[i].vectorId = i;
+          instances.push_back(&storage[i]);
+          collect[i] = rng() % 3 == 0;
+        }
+
+        std::vector<uint32_t> collected;
+        const uint32_t numKept = compactCollected(instances, collect,
+          [](Instance* pInstance, const uint32_t newIndex) { pInstance->vectorId = newIndex; },
+          [&](Instance* pInstance) { collected.push_back(pInstance->id); });
+
+        if (numKept != instances.size() || numKept + collected.size() != storage.size())
+          throw DxvkError("Compaction lost instances");
+
+        // Kept and collected instances both stay in their original order
+        uint32_t nextKept = 0;
+        uint32_t nextCollected = 0;
+        for (uint32_t i = 0; i < storage.size(); ++i) {
+          if (collect[i]) {
+            if (collected[nextCollected++] != i)
+              throw DxvkError("Collected instances were reported out of order");
+          } else {
+            if (instances[nextKept] != &storage[i] || storage[i].vectorId != nextKept)
+              throw DxvkError("Kept instances were reordered or their index not updated");
+            ++nextKept;
+          }
+        }
+      }
+    }
+
+  public:
+    void run() {
+      test_decision();
+      test_compaction();
+
+      std::cout << "Instance garbage collection successfully tested for correctness" << std::endl;
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp app;
+    app.run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
@@ -0,0 +1,259 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_timer.h"
+#include "../../../src/dxvk/rtx_render/rtx_sparse_unique_cache.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_sparse_unique_cache.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    // Mimics a material, equality is decided by the full contents
+    struct Material {
+      uint32_t id = 0;
+      uint32_t data[31] = {};
+
+      bool operator==(const Material& other) const {
+        return id == other.id && std::equal(std::begin(data), std::end(data), std::begin(other.data));
+      }
+    };
+
+    // Deliberately weak hash, equal hashes must be told apart by the key comparison
+    struct MaterialHashFn {
+      size_t operator() (const Material& material) const {
+        return material.id % 64;
+      }
+    };
+
+    using Cache = SparseUniqueCache<Material, MaterialHashFn>;
+
+    static Material makeMaterial(uint32_t id) {
+      Material material;
+      material.id = id;
+      for (uint32_t i = 0; i < 31; ++i) {
+        material.data[i] = id * 31 + i;
+      }
+      return material;
+    }
+
+    static void checkRange(const SlotRange& range, uint32_t begin, uint32_t end, const char* what) {
+      if (range.begin != begin || range.end != end) {
+        throw DxvkError(str::format(what, ": unexpected dirty range [", range.begin, ", ", range.end, ")"));
+      }
+    }
+
+    void test_trackAndFree() {
+      Cache cache;
+      std::unordered_map<uint32_t, uint32_t> reference;
+      std::mt19937 rng(7);
+
+      for (uint32_t i = 0; i < 100000; ++i) {
+        const uint32_t id = rng() % 2000;
+        const Material material = makeMaterial(id);
+
+        if (rng() % 4 == 0) {
+          cache.free(material);
+          reference.erase(id);
+          continue;
+        }
+
+        const uint32_t idx = cache.track(material);
+        auto it = reference.find(id);
+
+        if (it != reference.end() && it->second != idx) {
+          throw DxvkError(str::format("Material ", id, " moved from slot ", it->second, " to ", idx));
+        }
+
+        if (!(cache.getObjectTable()[idx] == material)) {
+          throw DxvkError(str::format("Slot ", idx, " does not hold material ", id));
+        }
+
+        reference[id] = idx;
+      }
+
+      if (cache.getActiveCount() != reference.size()) {
+        throw DxvkError(str::format("Unexpected active count ", cache.getActiveCount(), " vs ", reference.size()));
+      }
+
+      // Slots are recycled, the table never grows past the peak number of live materials
+      if (cache.getTotalCount() > 2000) {
+        throw DxvkError(str::format("Unexpected total count ", cache.getTotalCount()));
+      }
+
+      for (const auto& entry : reference) {
+        uint32_t idx;
+        if (!cache.find(makeMaterial(entry.first), idx) || idx != entry.second) {
+          throw DxvkError(str::format("Material ", entry.first, " was not found"));
+        }
+      }
+    }
+
+    void test_freeListOrder() {
+      Cache cache;
+
+      for (uint32_t i = 0; i < 8; ++i) {
+        cache.track(makeMaterial(i));
+      }
+
+      cache.free(makeMaterial(5));
+      cache.free(makeMaterial(2));
+
+      if (cache.getGeneration(5) != 1 || cache.getGeneration(2) != 1 || cache.getGeneration(0) != 0) {
+        throw DxvkError("Freeing did not bump the slot generations");
+      }
+
+      // Freed slots are refilled in the order they were freed
+      if (cache.track(makeMaterial(100)) != 5 || cache.track(makeMaterial(101)) != 2 || cache.track(makeMaterial(102)) != 8) {
+        throw DxvkError("Freed slots were not reused in FIFO order");
+      }
+
+      uint32_t idx;
+      if (cache.find(makeMaterial(5), idx) || cache.find(makeMaterial(2), idx)) {
+        throw DxvkError("Freed material was found");
+      }
+    }
+
+    void test_onFirstCache() {
+      Cache cache;
+      uint32_t numCalls = 0;
+
+      auto onFirstCache = [&numCalls](const Material& material) {
+        ++numCalls;
+        return material;
+      };
+
+      cache.track(makeMaterial(1), onFirstCache);
+      cache.track(makeMaterial(1), onFirstCache);
+      cache.track(makeMaterial(2), onFirstCache);
+
+      if (numCalls != 2) {
+        throw DxvkError(str::format("First cache callback was invoked ", numCalls, " times"));
+      }
+    }
+
+    void test_dirtyRange() {
+      Cache cache;
+
+      for (uint32_t i = 0; i < 100; ++i) {
+        cache.track(makeMaterial(i));
+      }
+
+      checkRange(cache.getDirtyRange(), 0, 100, "Initial fill");
+      cache.clearDirtyRange();
+
+      // Tracking known materials does not change anything
+      for (uint32_t i = 0; i < 100; ++i) {
+        cache.track(makeMaterial(i));
+      }
+
+      if (!cache.getDirtyRange().empty()) {
+        throw DxvkError("Tracking known materials made the table dirty");
+      }
+
+      cache.free(makeMaterial(40));
+      cache.free(makeMaterial(60));
+      checkRange(cache.getDirtyRange(), 40, 61, "Free");
+      cache.clearDirtyRange();
+
+      cache.track(makeMaterial(1000));
+      checkRange(cache.getDirtyRange(), 40, 41, "Slot reuse");
+
+      cache.track(makeMaterial(1001));
+      cache.track(makeMaterial(1002));
+      checkRange(cache.getDirtyRange(), 40, 101, "Append");
+      cache.clearDirtyRange();
+
+      cache.at(7);
+      checkRange(cache.getDirtyRange(), 7, 8, "Mutable access");
+
+      cache.clear();
+      if (!cache.getDirtyRange().empty() || cache.getTotalCount() != 0) {
+        throw DxvkError("Clear did not reset the cache");
+      }
+    }
+
+    void test_benchmark() {
+      // A frame worth of draws referencing a few thousand unique materials
+      constexpr uint32_t kNumMaterials = 4000;
+      constexpr uint32_t kNumDraws = 1000000;
+
+      std::vector<Material> materials;
+      for (uint32_t i = 0; i < kNumMaterials; ++i) {
+        materials.push_back(makeMaterial(i));
+      }
+
+      struct GoodHashFn {
+        size_t operator() (const Material& material) const {
+          return material.id * 0x9E3779B97F4A7C15ull;
+        }
+      };
+
+      SparseUniqueCache<Material, GoodHashFn> cache;
+      std::mt19937 rng(3);
+      uint64_t checksum = 0;
+
+      {
+        std::cout << "Tracking " << kNumDraws << " draws: ";
+        Timer time;
+
+        for (uint32_t i = 0; i < kNumDraws; ++i) {
+          checksum += cache.track(materials[rng() % kNumMaterials]);
+        }
+      }
+
+      if (cache.getTotalCount() != kNumMaterials || checksum == 0) {
+        throw DxvkError("Unexpected benchmark result");
+      }
+    }
+
+  public:
+    void run() {
+      test_trackAndFree();
+      test_freeListOrder();
+      test_onFirstCache();
+      test_dirtyRange();
+      test_benchmark();
+
+      std::cout << "All passed\n";
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp testApp;
+    testApp.run();
+  }
+  catch (const dxvk::DxvkError& error) {
+    std::cerr << error.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
@@ -19,9 +19,12 @@
 * FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
 * DEALINGS IN THE SOFTWARE.
 */
+#include <random>
 #include <set>
+#include <thread>
 #include "../../test_utils.h"
 #include "../../../src/util/util_spatial_map.h"
+#include "../../../src/util/util_timer.h"
 
 namespace dxvk {
   // Note: Logger needed by some shared code used in this Unit Test.
@@ -41,20 +44,390 @@ namespace dxvk {
     }
 
     void testPoint(const SpatialMap<int>& map, const Vector3& pos, const std::set<int>& expectedResult) {
-      auto candidates = map.getDataNearPos(pos);
       std::set<int> candidatesSet;
-      int count = 0;
-      for (auto vec : candidates) {
-        for (int value : *vec) {
-          count++;
-          candidatesSet.emplace(value);
-        }
-      }
+      map.forEachNearPos(pos, [&candidatesSet](int value) {
+        candidatesSet.emplace(value);
+        return true;
+      });
       if (candidatesSet != expectedResult) {
         throw DxvkError(str::format("incorrect result: for pos ", ToString(pos), " expected [", ToString(expectedResult), "] but got [", ToString(candidatesSet), "]."));
       }
     }
 
+    static Vector3 randomPosition(std::mt19937& rng, float extent) {
+      std::uniform_real_distribution<float> dist(-extent, extent);
+      return Vector3(dist(rng), dist(rng), dist(rng));
+    }
+
+    void testRangeQueries() {
+      std::mt19937 rng(11);
+      SpatialMap<int> map(4.0f);
+      std::vector<Vector3> positions;
+
+      for (int i = 0; i < 5000; i++) {
+        positions.push_back(randomPosition(rng, 50.f));
+        map.insert(positions.back(), i);
+      }
+
+      // Move some of the data around and remove some of it
+      for (int i = 0; i < 5000; i += 3) {
+        const Vector3 newPosition = randomPosition(rng, 50.f);
+        map.move(positions[i], newPosition, i);
+        positions[i] = newPosition;
+      }
+
+      for (int i = 0; i < 5000; i += 7) {
+        map.erase(positions[i], i);
+      }
+
+      auto isAlive = [](int i) { return i % 7 != 0; };
+
+      for (int q = 0; q < 200; q++) {
+        const Vector3 center = randomPosition(rng, 60.f);
+        // Include radii much larger than the cell size to cover the occupied cell walk
+        const float radius = q % 10 == 0 ? 100.f : float(q % 13);
+
+        std::set<int> expected;
+        for (int i = 0; i < 5000; i++) {
+          if (isAlive(i) && lengthSqr(positions[i] - center) <= radius * radius) {
+            expected.emplace(i);
+          }
+        }
+
+        std::set<int> result;
+        map.forEachInRadius(center, radius, [&result](int value) {
+          result.emplace(value);
+          return true;
+        });
+
+        if (result != expected) {
+          throw DxvkError(str::format("incorrect radius query result around ", ToString(center), ", radius ", radius));
+        }
+
+        const Vector3 minPos = center - Vector3(radius);
+        const Vector3 maxPos = center + Vector3(radius * 0.5f);
+
+        expected.clear();
+        for (int i = 0; i < 5000; i++) {
+          const Vector3& p = positions[i];
+          if (isAlive(i) && p.x >= minPos.x && p.y >= minPos.y && p.z >= minPos.z && p.x <= maxPos.x && p.y <= maxPos.y && p.z <= maxPos.z) {
+            expected.emplace(i);
+          }
+        }
+
+        result.clear();
+        map.forEachInAABB(minPos, maxPos, [&result](int value) {
+          result.emplace(value);
+          return true;
+        });
+
+        if (result != expected) {
+          throw DxvkError(str::format("incorrect AABB query result around ", ToString(center)));
+        }
+      }
+
+      // Queries stop when the callback returns false
+      int numVisited = 0;
+      map.forEachInRadius(Vector3(0.f), 1000.f, [&numVisited](int) {
+        return ++numVisited < 10;
+      });
+
+      if (numVisited != 10) {
+        throw DxvkError("query did not stop early");
+      }
+
+      // Emptied cells are released
+      for (int i = 0; i < 5000; i++) {
+        if (isAlive(i)) {
+          map.erase(positions[i], i);
+        }
+      }
+
+      if (map.size() != 0 || map.getCellCount() != 0) {
+        throw DxvkError(str::format("map is not empty after erasing all data, ", map.size(), " entries in ", map.getCellCount(), " cells left"));
+      }
+    }
+
+    void testConcurrentReads() {
+      std::mt19937 rng(5);
+      SpatialMap<int> map(10.0f);
+
+      for (int i = 0; i < 20000; i++) {
+        map.insert(randomPosition(rng, 500.f), i);
+      }
+
+      std::vector<Vector3> queries;
+      for (int i = 0; i < 1000; i++) {
+        queries.push_back(randomPosition(rng, 500.f));
+      }
+
+      auto runQueries = [&map, &queries]() {
+        uint64_t checksum = 0;
+        for (const Vector3& query : queries) {
+          map.forEachInRadius(query, 25.f, [&checksum](int value) {
+            checksum += value;
+            return true;
+          });
+        }
+        return checksum;
+      };
+
+      const uint64_t expected = runQueries();
+
+      std::vector<uint64_t> results(4);
+      std::vector<std::thread> threads;
+      for (size_t i = 0; i < results.size(); i++) {
+        threads.emplace_back([&results, &runQueries, i]() { results[i] = runQueries(); });
+      }
+      for (auto& thread : threads) {
+        thread.join();
+      }
+
+      for (uint64_t result : results) {
+        if (result != expected) {
+          throw DxvkError("concurrent queries returned different results");
+        }
+      }
+    }
+
+    // The layout SpatialMap used before: a vector per cell in an unordered_map,
+    // queries return a freshly allocated vector of the 8 nearest cells.
+    struct LegacySpatialMap {
+      float cellSize;
+      fast_spatial_cache<std::vector<int>> cache;
+
+      Vector3i getCellPos(const Vector3& position) const {
+        const Vector3 scaledPos = position / cellSize;
+        return Vector3i(int(std::floor(scaledPos.x)), int(std::floor(scaledPos.y)), int(std::floor(scaledPos.z)));
+      }
+
+      void insert(const Vector3& position, int data) {
+        cache[getCellPos(position)].push_back(data);
+      }
+
+      void move(const Vector3& oldPosition, const Vector3& newPosition, int data) {
+        const Vector3i oldPos = getCellPos(oldPosition);
+        const Vector3i newPos = getCellPos(newPosition);
+        if (oldPos != newPos) {
+          auto& cell = cache[oldPos];
+          auto iter = std::find(cell.begin(), cell.end(), data);
+          std::swap(*iter, cell.back());
+          cell.pop_back();
+          if (cell.empty()) {
+            cache.erase(oldPos);
+          }
+          cache[newPos].push_back(data);
+        }
+      }
+
+      std::vector<const std::vector<int>*> getDataNearPos(const Vector3& position) const {
+        std::vector<const std::vector<int>*> result;
+        result.reserve(8);
+        const Vector3 cellPosition = position / cellSize - Vector3(0.5f, 0.5f, 0.5f);
+        const Vector3i floorPos(int(std::floor(cellPosition.x)), int(std::floor(cellPosition.y)), int(std::floor(cellPosition.z)));
+        for (int i = 0; i < 8; i++) {
+          auto iter = cache.find(floorPos + Vector3i(i & 1, (i >> 1) & 1, (i >> 2) & 1));
+          if (iter != cache.end()) {
+            result.push_back(&iter->second);
+          }
+        }
+        return result;
+      }
+    };
+
+    // Mimics instance matching: 100k instances, every frame each instance looks
+    // for its match near its new position and then moves there.
+    void testBenchmark() {
+      constexpr int kNumInstances = 100000;
+      constexpr int kNumFrames = 10;
+      constexpr float kUniqueObjectDistance = 3.f;
+
+      std::mt19937 rng(17);
+      std::vector<Vector3> positions;
+      for (int i = 0; i < kNumInstances; i++) {
+        positions.push_back(randomPosition(rng, 2000.f));
+      }
+
+      // Instances drift a little every frame
+      std::vector<std::vector<Vector3>> frames(kNumFrames);
+      for (int f = 0; f < kNumFrames; f++) {
+        const std::vector<Vector3>& previous = f == 0 ? positions : frames[f - 1];
+        for (int i = 0; i < kNumInstances; i++) {
+          frames[f].push_back(previous[i] + randomPosition(rng, 1.f));
+        }
+      }
+
+      uint64_t legacyMatches = 0;
+      uint64_t matches = 0;
+
+      {
+        LegacySpatialMap map { kUniqueObjectDistance * 2.f };
+        for (int i = 0; i < kNumInstances; i++) {
+          map.insert(positions[i], i);
+        }
+
+        std::cout << "Matching " << kNumInstances << " instances over " << kNumFrames << " frames, legacy layout: ";
+        Timer time;
+
+        std::vector<Vector3> current = positions;
+        for (const auto& frame : frames) {
+          for (int i = 0; i < kNumInstances; i++) {
+            for (const std::vector<int>* cell : map.getDataNearPos(frame[i])) {
+              for (int candidate : *cell) {
+                legacyMatches += lengthSqr(current[candidate] - frame[i]) <= kUniqueObjectDistance * kUniqueObjectDistance;
+              }
+            }
+            map.move(current[i], frame[i], i);
+            current[i] = frame[i];
+          }
+        }
+      }
+
+      {
+        SpatialMap<int> map(kUniqueObjectDistance * 2.f);
+        for (int i = 0; i < kNumInstances; i++) {
+          map.insert(positions[i], i);
+        }
+
+        std::cout << "Matching " << kNumInstances << " instances over " << kNumFrames << " frames, flat layout: ";
+        Timer time;
+
+        std::vector<Vector3> current = positions;
+        for (const auto& frame : frames) {
+          for (int i = 0; i < kNumInstances; i++) {
+            map.forEachInRadius(frame[i], kUniqueObjectDistance, [&matches](int) {
+              ++matches;
+              return true;
+            });
+            map.move(current[i], frame[i], i);
+            current[i] = frame[i];
+          }
+        }
+      }
+
+      if (matches != legacyMatches) {
+        throw DxvkError(str::format("benchmark mismatch, ", matches, " vs ", legacyMatches, " matches"));
+      }
+    }
+
+    // Mimics LightManager light matching: every light of the previous frame looks for the most
+    // similar light of the current frame, lights are only similar to lights of the same type
+    // within a distance (or within an angle, for distant lights).
+    struct Light {
+      int type;
+      Vector3 position;   // direction for distant lights
+    };
+
+    static constexpr int kNumLightTypes = 5;
+    static constexpr int kDistantLightType = 4;
+    static constexpr float kCosAngleThreshold = 0.9961947f; // cos(5 degrees)
+
+    static float lightSimilarity(const Light& a, const Light& b, float distanceThreshold) {
+      if (a.type != b.type) {
+        return -1.f;
+      }
+      if (a.type == kDistantLightType) {
+        const float cosAngle = dot(a.position, b.position);
+        return cosAngle >= kCosAngleThreshold ? cosAngle : -1.f;
+      }
+      const float distNormalized = length(a.position - b.position) / distanceThreshold;
+      return distNormalized <= 1.f ? 1.f - distNormalized : -1.f;
+    }
+
+    static std::vector<Light> generateLights(std::mt19937& rng, int count, float extent) {
+      std::vector<Light> lights;
+      for (int i = 0; i < count; i++) {
+        const int type = i % 100 == 0 ? kDistantLightType : i % 4;
+        const Vector3 position = type == kDistantLightType ? normalize(randomPosition(rng, 1.f)) : randomPosition(rng, extent);
+        lights.push_back(Light { type, position });
+      }
+      return lights;
+    }
+
+    static std::vector<int> matchLightsLinear(const std::vector<Light>& previous, const std::vector<Light>& current, float distanceThreshold) {
+      std::vector<int> matches(previous.size(), -1);
+      for (size_t i = 0; i < previous.size(); i++) {
+        float bestSimilarity = -1.f;
+        for (size_t j = 0; j < current.size(); j++) {
+          const float similarity = lightSimilarity(previous[i], current[j], distanceThreshold);
+          if (similarity > bestSimilarity) {
+            bestSimilarity = similarity;
+            matches[i] = (int) j;
+          }
+        }
+      }
+      return matches;
+    }
+
+    static std::vector<int> matchLightsSpatial(const std::vector<Light>& previous, const std::vector<Light>& current, float distanceThreshold) {
+      const float distantRadius = std::sqrt(2.f - 2.f * kCosAngleThreshold);
+
+      std::vector<SpatialMap<int>> lightsByType;
+      for (int type = 0; type < kNumLightTypes; type++) {
+        lightsByType.emplace_back(type == kDistantLightType ? 0.1f : distanceThreshold);
+      }
+      for (size_t j = 0; j < current.size(); j++) {
+        lightsByType[current[j].type].insert(current[j].position, (int) j);
+      }
+
+      std::vector<int> matches(previous.size(), -1);
+      for (size_t i = 0; i < previous.size(); i++) {
+        const Light& light = previous[i];
+        const float radius = light.type == kDistantLightType ? distantRadius : distanceThreshold;
+        float bestSimilarity = -1.f;
+        lightsByType[light.type].forEachInRadius(light.position, radius * 1.01f, [&](int j) {
+          const float similarity = lightSimilarity(light, current[j], distanceThreshold);
+          if (similarity > bestSimilarity) {
+            bestSimilarity = similarity;
+            matches[i] = j;
+          }
+          return true;
+        });
+      }
+      return matches;
+    }
+
+    void testLightMatchingBenchmark() {
+      constexpr float kUniqueObjectDistance = 300.f;
+      constexpr int kMaxLinearLights = 10000;
+
+      std::mt19937 rng(23);
+
+      for (const int numLights : { 100, 1000, 10000, 50000 }) {
+        // Lights spread over a level, all of them moving a bit, like particle and muzzle flash lights
+        const std::vector<Light> previous = generateLights(rng, numLights, 20000.f);
+        std::vector<Light> current = previous;
+        for (Light& light : current) {
+          light.position = light.type == kDistantLightType
+                         ? normalize(light.position + randomPosition(rng, 0.01f))
+                         : light.position + randomPosition(rng, 100.f);
+        }
+        std::shuffle(current.begin(), current.end(), rng);
+
+        std::vector<int> spatialMatches;
+        {
+          std::cout << "Matching " << numLights << " lights, spatial map: ";
+          Timer time;
+          spatialMatches = matchLightsSpatial(previous, current, kUniqueObjectDistance);
+        }
+
+        if (numLights > kMaxLinearLights) {
+          continue;
+        }
+
+        std::vector<int> linearMatches;
+        {
+          std::cout << "Matching " << numLights << " lights, linear search: ";
+          Timer time;
+          linearMatches = matchLightsLinear(previous, current, kUniqueObjectDistance);
+        }
+
+        if (spatialMatches != linearMatches) {
+          throw DxvkError(str::format("light matching mismatch with ", numLights, " lights"));
+        }
+      }
+    }
+
     void run() {
       SpatialMap<int> map(2.0f);
 
@@ -74,6 +447,12 @@ namespace dxvk {
       testPoint(map, Vector3(2.5f, 2.5f, 2.5f), { 0, 1, 2, 3});
       // far section of next cell
       testPoint(map, Vector3(3.5f, 3.5f, 3.5f), { 2, 3});
+
+      testRangeQueries();
+      testConcurrentReads();
+      testBenchmark();
+      testLightMatchingBenchmark();
+
       std::cout << "All passed\n";
     }
   };
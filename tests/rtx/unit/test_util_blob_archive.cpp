@@ -0,0 +1,424 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstdio>
+#include <filesystem>
+#include <fstream>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_blob_archive.h"
+#include "../../../src/util/util_timer.h"
+#include "../../../src/spirv/spirv_compression.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_blob_archive.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    static constexpr uint32_t ContentVersion = 3;
+
+    std::string m_filename;
+
+    static Sha1Hash makeKey(uint32_t value) {
+      Sha1Digest digest = { };
+      std::memcpy(digest.data(), &value, sizeof(value));
+      digest[19] = 0x5a;
+      return Sha1Hash(digest);
+    }
+
+    static std::vector<uint8_t> makeBlob(uint32_t value, size_t size) {
+      std::vector<uint8_t> blob(size);
+
+      for (size_t i = 0; i < size; i++)
+        blob[i] = uint8_t(value * 31 + i);
+
+      return blob;
+    }
+
+    void removeFiles() {
+      std::remove(m_filename.c_str());
+      std::remove((m_filename + ".tmp").c_str());
+    }
+
+    void expectBlob(BlobArchive& archive, uint32_t value, size_t size) {
+      std::vector<uint8_t> data;
+
+      if (!archive.lookup(makeKey(value), data) || data != makeBlob(value, size))
+        throw DxvkError(str::format("Blob ", value, " missing or wrong"));
+    }
+
+    void expectMissing(BlobArchive& archive, uint32_t value) {
+      std::vector<uint8_t> data;
+
+      if (archive.lookup(makeKey(value), data))
+        throw DxvkError(str::format("Blob ", value, " should be missing"));
+    }
+
+    // Offset of the first payload byte of the n-th record, all records have the given size
+    static uint64_t payloadOffset(uint32_t record, uint64_t recordPayload) {
+      return 16 + record * (32 + recordPayload) + 32;
+    }
+
+    void patchFile(uint64_t offset, const void* data, size_t size) {
+      std::fstream file(m_filename, std::ios_base::in | std::ios_base::out | std::ios_base::binary);
+      file.seekp(offset);
+      file.write(reinterpret_cast<const char*>(data), size);
+    }
+
+    void test_roundtrip() {
+      removeFiles();
+
+      {
+        BlobArchive archive(m_filename, ContentVersion);
+        expectMissing(archive, 0);
+
+        for (uint32_t i = 0; i < 100; i++)
+          archive.store(makeKey(i), makeBlob(i, i * 13));
+
+        // Pending blobs are served before they hit the disk
+        expectBlob(archive, 42, 42 * 13);
+
+        // The first store wins
+        archive.store(makeKey(7), makeBlob(8, 5));
+        expectBlob(archive, 7, 7 * 13);
+
+        if (std::filesystem::exists(m_filename))
+          throw DxvkError("Archive was written before flushing");
+
+        if (!archive.flush())
+          throw DxvkError("Flush failed");
+
+        // Still readable from the mapped file
+        expectBlob(archive, 99, 99 * 13);
+      }
+
+      {
+        BlobArchive archive(m_filename, ContentVersion);
+
+        for (uint32_t i = 0; i < 100; i++)
+          expectBlob(archive, i, i * 13);
+
+        // New blobs are added to the existing ones
+        archive.store(makeKey(100), makeBlob(100, 1000));
+        archive.flush();
+      }
+
+      BlobArchive archive(m_filename, ContentVersion);
+      expectBlob(archive, 0, 0);
+      expectBlob(archive, 100, 1000);
+
+      const auto stats = archive.getStats();
+      if (stats.hits != 2 || stats.corrupt != 0)
+        throw DxvkError("Unexpected stats");
+    }
+
+    void test_versions() {
+      removeFiles();
+
+      {
+        BlobArchive archive(m_filename, ContentVersion);
+        archive.store(makeKey(1), makeBlob(1, 64));
+        archive.flush();
+      }
+
+      {
+        // Other content versions are discarded and replaced
+        BlobArchive archive(m_filename, ContentVersion + 1);
+        expectMissing(archive, 1);
+        archive.store(makeKey(2), makeBlob(2, 64));
+        archive.flush();
+      }
+
+      {
+        BlobArchive archive(m_filename, ContentVersion + 1);
+        expectMissing(archive, 1);
+        expectBlob(archive, 2, 64);
+      }
+
+      // Something that isn't an archive at all
+      {
+        std::ofstream file(m_filename, std::ios_base::binary | std::ios_base::trunc);
+        file << "not an archive";
+      }
+
+      BlobArchive archive(m_filename, ContentVersion + 1);
+      expectMissing(archive, 2);
+      archive.store(makeKey(3), makeBlob(3, 8));
+
+      if (!archive.flush())
+        throw DxvkError("Could not replace a foreign file");
+
+      expectBlob(archive, 3, 8);
+    }
+
+    void test_concurrent_flush() {
+      removeFiles();
+
+      {
+        BlobArchive archive(m_filename, ContentVersion);
+
+        for (uint32_t i = 0; i < 200; i++)
+          archive.store(makeKey(i), makeBlob(i, 4096));
+
+        archive.flush();
+
+        // Stores and lookups go on while later flushes write the file
+        std::thread writer([&] {
+          for (uint32_t i = 0; i < 10; i++) {
+            if (!archive.flush())
+              throw DxvkError("Concurrent flush failed");
+          }
+        });
+
+        for (uint32_t i = 200; i < 400; i++) {
+          archive.store(makeKey(i), makeBlob(i, 4096));
+          expectBlob(archive, i - 200, 4096);
+          expectBlob(archive, i, 4096);
+        }
+
+        writer.join();
+
+        // Whatever was stored after the last flush started is still pending
+        const size_t pending = archive.getPendingCount();
+
+        if (!archive.flush() || archive.getPendingCount() != 0)
+          throw DxvkError(str::format("Final flush failed, ", pending, " blobs were pending"));
+      }
+
+      BlobArchive archive(m_filename, ContentVersion);
+
+      for (uint32_t i = 0; i < 400; i++)
+        expectBlob(archive, i, 4096);
+
+      if (std::filesystem::exists(m_filename + ".tmp"))
+        throw DxvkError("Temporary file was left behind");
+    }
+
+    void test_corruption() {
+      removeFiles();
+
+      {
+        BlobArchive archive(m_filename, ContentVersion);
+
+        for (uint32_t i = 0; i < 4; i++)
+          archive.store(makeKey(i), makeBlob(i, 64));
+
+        archive.flush();
+      }
+
+      // Records are written in no particular order, find the one at index 1
+      uint32_t flipped;
+      {
+        std::ifstream file(m_filename, std::ios_base::binary);
+        Sha1Digest digest;
+        file.seekg(16 + 1 * (32 + 64));
+        file.read(reinterpret_cast<char*>(digest.data()), digest.size());
+        std::memcpy(&flipped, digest.data(), sizeof(flipped));
+      }
+
+      const uint8_t garbage = 0xff;
+      patchFile(payloadOffset(1, 64) + 10, &garbage, 1);
+
+      {
+        BlobArchive archive(m_filename, ContentVersion);
+        expectMissing(archive, flipped);
+
+        for (uint32_t i = 0; i < 4; i++) {
+          if (i != flipped)
+            expectBlob(archive, i, 64);
+        }
+
+        if (archive.getStats().corrupt != 1)
+          throw DxvkError("Corrupt record was not counted");
+
+        // The corrupt record is dropped from the file
+        archive.flush();
+      }
+
+      {
+        BlobArchive archive(m_filename, ContentVersion);
+        expectMissing(archive, flipped);
+
+        if (archive.getStats().corrupt != 0)
+          throw DxvkError("Corrupt record survived a flush");
+      }
+
+      // A crash while writing leaves a truncated record behind
+      const uint64_t size = std::filesystem::file_size(m_filename);
+      std::filesystem::resize_file(m_filename, size - 20);
+
+      BlobArchive archive(m_filename, ContentVersion);
+      uint32_t found = 0;
+
+      for (uint32_t i = 0; i < 4; i++) {
+        std::vector<uint8_t> data;
+
+        if (archive.lookup(makeKey(i), data)) {
+          if (data != makeBlob(i, 64))
+            throw DxvkError("Wrong blob next to a truncated record");
+          found += 1;
+        }
+      }
+
+      if (found != 2 || archive.getStats().corrupt != 1)
+        throw DxvkError("Truncated record not handled");
+    }
+
+    void test_reader() {
+      BlobWriter writer;
+      writer.write(uint32_t(7));
+      writer.writeArray(std::vector<uint16_t> { 1, 2, 3 });
+
+      std::vector<uint8_t> data = writer.data();
+      uint32_t value;
+      std::vector<uint16_t> values;
+
+      BlobReader reader(data.data(), data.size());
+      if (!reader.read(value) || !reader.readArray(values) || !reader.atEnd() || value != 7 || values.size() != 3)
+        throw DxvkError("Reader did not read back what was written");
+
+      // Reads past the end fail, and keep failing
+      BlobReader shortReader(data.data(), data.size() - 1);
+      if (!shortReader.read(value) || shortReader.readArray(values) || shortReader.read(value))
+        throw DxvkError("Reader read past the end");
+
+      // Array counts larger than the data are rejected before allocating
+      data[4] = 0xff;
+      data[5] = 0xff;
+      BlobReader badCount(data.data(), data.size());
+      if (!badCount.read(value) || badCount.readArray(values))
+        throw DxvkError("Reader accepted a bad array count");
+    }
+
+    void test_spirv() {
+      std::mt19937 rng(1);
+
+      for (uint32_t i = 0; i < 50; i++) {
+        // Mix of small ids and large literals, like real SPIR-V
+        std::vector<uint32_t> words(1 + rng() % 2000);
+
+        for (auto& word : words)
+          word = rng() % 4 ? rng() % 300 : rng();
+
+        SpirvCodeBuffer code(words.size(), words.data());
+        SpirvCompressedBuffer compressed(code);
+
+        BlobWriter writer;
+        compressed.write(writer);
+
+        BlobReader reader(writer.data().data(), writer.data().size());
+        SpirvCompressedBuffer readBack;
+
+        if (!readBack.read(reader) || !reader.atEnd())
+          throw DxvkError("Compressed SPIR-V could not be read back");
+
+        SpirvCodeBuffer decompressed = readBack.decompress();
+
+        if (decompressed.dwords() != words.size() || std::memcmp(decompressed.data(), words.data(), words.size() * sizeof(uint32_t)) != 0)
+          throw DxvkError("Compressed SPIR-V did not survive a round trip");
+
+        // Flipped mask bits either get rejected or decompress to garbage, never out of bounds
+        std::vector<uint8_t> data = writer.data();
+        data[8] ^= 0x3;
+        BlobReader flippedReader(data.data(), data.size());
+        SpirvCompressedBuffer flipped;
+
+        if (flipped.read(flippedReader))
+          flipped.decompress();
+      }
+
+      // 64 words of 4 bytes each don't fit into a single packed word
+      BlobWriter writer;
+      writer.write(uint32_t(64));
+      writer.writeArray(std::vector<uint64_t> { ~0ull, ~0ull });
+      writer.writeArray(std::vector<uint64_t> { 0ull });
+
+      BlobReader reader(writer.data().data(), writer.data().size());
+      SpirvCompressedBuffer bad;
+
+      if (bad.read(reader))
+        throw DxvkError("Malformed SPIR-V was accepted");
+    }
+
+    void test_benchmark() {
+      removeFiles();
+
+      constexpr uint32_t BlobCount = 4000;
+
+      {
+        BlobArchive archive(m_filename, ContentVersion);
+
+        for (uint32_t i = 0; i < BlobCount; i++)
+          archive.store(makeKey(i), makeBlob(i, 8 << 10));
+
+        std::cout << std::endl << "Running: flush " << BlobCount << " blobs --> ";
+        Timer time;
+        archive.flush();
+      }
+
+      BlobArchive archive(m_filename, ContentVersion);
+      std::vector<uint8_t> data;
+
+      std::cout << "Running: open and look up " << BlobCount << " blobs --> ";
+      Timer time;
+
+      for (uint32_t i = 0; i < BlobCount; i++) {
+        if (!archive.lookup(makeKey(i), data))
+          throw DxvkError("Blob missing");
+      }
+    }
+
+  public:
+    void run() {
+      m_filename = (std::filesystem::temp_directory_path() / "test_util_blob_archive.bin").string();
+
+      test_roundtrip();
+      test_versions();
+      test_concurrent_flush();
+      test_corruption();
+      test_reader();
+      test_spirv();
+
+      std::cout << "Blob archive successfully tested for correctness" << std::endl;
+
+      test_benchmark();
+      removeFiles();
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp app;
+    app.run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
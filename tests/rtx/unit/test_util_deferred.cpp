@@ -0,0 +1,222 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <atomic>
+#include <chrono>
+#include <memory>
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_deferred.h"
+#include "../../../src/util/util_threadpool.h"
+#include "../../../src/util/util_timer.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_deferred.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    using Pool = WorkerThreadPool<16, true, false, true>;
+    using Deferred = DeferredValue<std::vector<uint32_t>>;
+
+    // Stands in for translating a shader
+    static std::vector<uint32_t> translate(uint32_t seed, uint32_t work) {
+      std::vector<uint32_t> result(64);
+      uint32_t value = seed;
+
+      for (uint32_t i = 0; i < work; i++) {
+        value = value * 1664525u + 1013904223u;
+        result[i % result.size()] ^= value;
+      }
+
+      return result;
+    }
+
+    void test_once() {
+      for (uint32_t round = 0; round < 200; round++) {
+        std::atomic<uint32_t> produced = { 0 };
+        Deferred deferred([&produced, round] {
+          produced += 1;
+          return translate(round, 2000);
+        });
+
+        const std::vector<uint32_t> expected = translate(round, 2000);
+        std::atomic<uint32_t> mismatches = { 0 };
+        std::vector<std::thread> threads;
+
+        for (uint32_t i = 0; i < 4; i++) {
+          threads.emplace_back([&, i] {
+            if (i == 0)
+              deferred.tryProduce();
+
+            if (deferred.get() != expected)
+              mismatches += 1;
+          });
+        }
+
+        for (auto& thread : threads)
+          thread.join();
+
+        if (produced != 1 || mismatches != 0 || !deferred.ready())
+          throw DxvkError(str::format("Round ", round, ": produced ", produced.load(), " times, ", mismatches.load(), " mismatches"));
+
+        if (deferred.tryProduce())
+          throw DxvkError("Value was produced twice");
+      }
+    }
+
+    void test_errors() {
+      uint32_t produced = 0;
+      DeferredValue<uint32_t> deferred([&produced] () -> uint32_t {
+        produced += 1;
+        throw DxvkError("Bad shader");
+      });
+
+      for (uint32_t i = 0; i < 2; i++) {
+        try {
+          deferred.get();
+          throw DxvkError("Error was not rethrown");
+        } catch (const DxvkError& e) {
+          if (e.message() != "Bad shader")
+            throw;
+        }
+      }
+
+      if (produced != 1)
+        throw DxvkError("Failing producer ran more than once");
+    }
+
+    // Handles scheduled on a pool that drops work once it is full, every one
+    // of them has to come out right whether a worker or the consumer made it
+    void test_pool() {
+      constexpr uint32_t Count = 2000;
+
+      std::vector<std::shared_ptr<Deferred>> handles;
+      std::atomic<uint32_t> produced = { 0 };
+
+      {
+        Pool pool(4, "test_util_deferred", TaskOverflowPolicy::Drop);
+
+        for (uint32_t i = 0; i < Count; i++) {
+          handles.push_back(std::make_shared<Deferred>([&produced, i] {
+            produced += 1;
+            return translate(i, 500 + i % 7 * 1000);
+          }));
+
+          pool.Schedule([handle = handles.back()] { handle->tryProduce(); });
+        }
+
+        std::mt19937 rng(7);
+        std::vector<uint32_t> order(Count);
+
+        for (uint32_t i = 0; i < Count; i++)
+          order[i] = i;
+
+        std::shuffle(order.begin(), order.end(), rng);
+
+        for (uint32_t i = 0; i < Count / 2; i++) {
+          const uint32_t index = order[i];
+
+          if (handles[index]->get() != translate(index, 500 + index % 7 * 1000))
+            throw DxvkError(str::format("Handle ", index, " has the wrong value"));
+        }
+      }
+
+      // The pool is gone, queued jobs were cancelled
+      for (uint32_t i = 0; i < Count; i++) {
+        if (handles[i]->get() != translate(i, 500 + i % 7 * 1000))
+          throw DxvkError(str::format("Handle ", i, " has the wrong value"));
+      }
+
+      if (produced != Count)
+        throw DxvkError(str::format("Produced ", produced.load(), " values for ", Count, " handles"));
+    }
+
+    // Time spent creating shaders on the application thread, and until the
+    // first of them is needed, e.g. a loading screen that creates them all
+    // before drawing anything
+    void test_benchmark() {
+      constexpr uint32_t Count = 1000;
+      constexpr uint32_t Work = 100000;
+
+      std::cout << std::endl << Count << " handles" << std::endl;
+
+      {
+        std::cout << "Running: create synchronously --> ";
+        Timer time;
+
+        for (uint32_t i = 0; i < Count; i++) {
+          Deferred deferred([i] { return translate(i, Work); });
+          deferred.get();
+        }
+      }
+
+      Pool pool(4, "test_util_deferred");
+      std::vector<std::shared_ptr<Deferred>> handles;
+
+      {
+        std::cout << "Running: create on a pool --> ";
+        Timer time;
+
+        for (uint32_t i = 0; i < Count; i++) {
+          handles.push_back(std::make_shared<Deferred>([i] { return translate(i, Work); }));
+          pool.Schedule([handle = handles.back()] { handle->tryProduce(); });
+        }
+      }
+
+      {
+        std::cout << "Running: retrieve from a pool --> ";
+        Timer time;
+
+        for (const auto& handle : handles)
+          handle->get();
+      }
+    }
+
+  public:
+    void run() {
+      test_once();
+      test_errors();
+      test_pool();
+
+      std::cout << "Deferred values successfully tested for correctness" << std::endl;
+
+      test_benchmark();
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp app;
+    app.run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
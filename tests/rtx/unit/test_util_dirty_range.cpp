@@ -0,0 +1,299 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstring>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_dirty_range.h"
+#include "../../../src/util/util_timer.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_dirty_range.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    struct Register {
+      float v[4];
+    };
+
+    // Stands in for the constants of a D3D9 device and the buffer they are
+    // uploaded to, slices are recycled in a shuffled order like the ones of
+    // a DxvkBuffer once the GPU is done with them.
+    class FakeConstantUpload {
+    public:
+      FakeConstantUpload(uint32_t registerCount, uint32_t sliceCount, uint32_t seed)
+      : m_shadow(registerCount), m_rng(seed) {
+        for (uint32_t i = 0; i < sliceCount; i++)
+          m_slices.emplace_back(registerCount);
+      }
+
+      // SetVertexShaderConstantF
+      void setConstants(uint32_t start, const Register* data, uint32_t count) {
+        std::memcpy(&m_shadow[start], data, count * sizeof(Register));
+        m_ranges.markDirty(start, start + count);
+      }
+
+      // Uploads the first count registers, optionally with def'd registers on top
+      const std::vector<Register>& upload(uint32_t count, bool tracked, const std::vector<std::pair<uint32_t, Register>>& defs) {
+        std::vector<Register>& slice = nextSlice();
+
+        if (tracked) {
+          const UploadDirtyTracker::Range range = m_ranges.beginUpload(slice.data(), count);
+
+          if (!range.empty())
+            std::memcpy(&slice[range.begin], &m_shadow[range.begin], range.size() * sizeof(Register));
+
+          m_copied += range.size();
+        } else {
+          std::memcpy(slice.data(), m_shadow.data(), count * sizeof(Register));
+          m_copied += count;
+        }
+
+        uint32_t defBegin = ~0u;
+        uint32_t defEnd = 0;
+
+        for (const auto& def : defs) {
+          slice[def.first] = def.second;
+          defBegin = std::min(defBegin, def.first);
+          defEnd = std::max(defEnd, def.first + 1);
+        }
+
+        m_ranges.markDirty(defBegin, defEnd);
+        return slice;
+      }
+
+      // A new buffer whose slices are all garbage
+      void recreate() {
+        for (auto& slice : m_slices)
+          std::fill(slice.begin(), slice.end(), Register { -1.0f, -1.0f, -1.0f, -1.0f });
+
+        m_ranges.invalidate();
+      }
+
+      const std::vector<Register>& shadow() const {
+        return m_shadow;
+      }
+
+      uint64_t copied() const {
+        return m_copied;
+      }
+
+    private:
+      std::vector<Register> m_shadow;
+      std::vector<std::vector<Register>> m_slices;
+      UploadDirtyTracker m_ranges;
+      std::mt19937 m_rng;
+      uint64_t m_copied = 0;
+
+      std::vector<Register>& nextSlice() {
+        // Mostly in order, sometimes a slice is held back a little longer
+        std::swap(m_slices[m_rng() % m_slices.size()], m_slices.back());
+        std::rotate(m_slices.begin(), m_slices.begin() + 1, m_slices.end());
+        return m_slices.back();
+      }
+    };
+
+    static Register makeRegister(uint32_t value) {
+      const float f = float(value);
+      return Register { f, f + 0.25f, f + 0.5f, f + 0.75f };
+    }
+
+    void test_ranges() {
+      UploadDirtyTracker ranges;
+      int a, b, c;
+
+      // Unknown slices get everything
+      auto range = ranges.beginUpload(&a, 16);
+      if (range.begin != 0 || range.end != 16)
+        throw DxvkError("Unknown slice did not get a full copy");
+
+      ranges.markDirty(4, 6);
+      range = ranges.beginUpload(&b, 16);
+      if (range.begin != 0 || range.end != 16)
+        throw DxvkError("Unknown slice did not get a full copy");
+
+      // a missed [4, 6) and [10, 12)
+      ranges.markDirty(10, 12);
+      range = ranges.beginUpload(&a, 16);
+      if (range.begin != 4 || range.end != 12)
+        throw DxvkError(str::format("Expected [4, 12), got [", range.begin, ", ", range.end, ")"));
+
+      // b only missed [10, 12)
+      range = ranges.beginUpload(&b, 16);
+      if (range.begin != 10 || range.end != 12)
+        throw DxvkError(str::format("Expected [10, 12), got [", range.begin, ", ", range.end, ")"));
+
+      // Nothing changed
+      range = ranges.beginUpload(&a, 16);
+      if (!range.empty())
+        throw DxvkError("Clean slice got a copy");
+
+      // Ranges are clipped to what the slice needs
+      ranges.markDirty(8, 32);
+      range = ranges.beginUpload(&b, 12);
+      if (range.begin != 8 || range.end != 12)
+        throw DxvkError("Range was not clipped");
+
+      // b was written with fewer registers than it needs now
+      range = ranges.beginUpload(&b, 16);
+      if (range.begin != 0 || range.end != 16)
+        throw DxvkError("Grown slice did not get a full copy");
+
+      ranges.beginUpload(&c, 16);
+      ranges.invalidate();
+      range = ranges.beginUpload(&c, 16);
+      if (range.begin != 0 || range.end != 16 || ranges.trackedSlices() != 1)
+        throw DxvkError("Invalidated slice did not get a full copy");
+    }
+
+    // Random constant streams against slices that are checked after every upload
+    void test_fuzz() {
+      constexpr uint32_t RegisterCount = 256;
+
+      for (uint32_t seed = 0; seed < 16; seed++) {
+        std::mt19937 rng(seed);
+        FakeConstantUpload upload(RegisterCount, 1 + seed % 8, seed);
+        uint32_t value = 0;
+
+        for (uint32_t i = 0; i < 20000; i++) {
+          const uint32_t op = rng() % 16;
+
+          if (op < 10) {
+            const uint32_t count = 1 + rng() % (op < 8 ? 4 : 64);
+            const uint32_t start = rng() % (RegisterCount - count + 1);
+            std::vector<Register> data;
+
+            for (uint32_t r = 0; r < count; r++)
+              data.push_back(makeRegister(value++));
+
+            upload.setConstants(start, data.data(), count);
+          } else if (op == 15 && rng() % 64 == 0) {
+            upload.recreate();
+          } else {
+            const uint32_t count = rng() % 2 ? RegisterCount : 1 + rng() % RegisterCount;
+
+            // Some shaders have def'd constants on top of the application's
+            std::vector<std::pair<uint32_t, Register>> defs;
+            if (op >= 14) {
+              for (uint32_t d = 0; d < 3; d++)
+                defs.emplace_back(rng() % count, makeRegister(1000000 + d));
+            }
+
+            const auto& slice = upload.upload(count, true, defs);
+
+            for (uint32_t r = 0; r < count; r++) {
+              Register expected = upload.shadow()[r];
+
+              for (const auto& def : defs) {
+                if (def.first == r)
+                  expected = def.second;
+              }
+
+              if (std::memcmp(&slice[r], &expected, sizeof(Register)) != 0)
+                throw DxvkError(str::format("Seed ", seed, ", upload ", i, ": register ", r, " is stale"));
+            }
+          }
+        }
+      }
+    }
+
+    // Replays a typical SetVertexShaderConstantF stream: per-frame constants once,
+    // then a world matrix and a few material registers for every draw
+    static uint64_t replay(uint32_t registerCount, bool tracked) {
+      FakeConstantUpload upload(registerCount, 16, 0);
+      std::vector<Register> frame(32);
+      const std::vector<std::pair<uint32_t, Register>> noDefs;
+
+      for (uint32_t i = 0; i < frame.size(); i++)
+        frame[i] = makeRegister(i);
+
+      for (uint32_t f = 0; f < 20; f++) {
+        frame[0] = makeRegister(f);
+        upload.setConstants(0, frame.data(), uint32_t(frame.size()));
+
+        for (uint32_t d = 0; d < 2000; d++) {
+          const Register world[4] = { makeRegister(d), makeRegister(d + 1), makeRegister(d + 2), makeRegister(d + 3) };
+          const Register material[2] = { makeRegister(f), makeRegister(d % 7) };
+
+          upload.setConstants(32, world, 4);
+          upload.setConstants(40 + d % 4, material, 2);
+          upload.upload(registerCount, tracked, noDefs);
+        }
+      }
+
+      return upload.copied();
+    }
+
+    void test_benchmark() {
+      // Hardware VS limit and a large SWVP set
+      for (const uint32_t registerCount : { 256u, 8192u }) {
+        std::cout << std::endl << registerCount << " registers, 40000 draws" << std::endl;
+
+        uint64_t fullCopies;
+        uint64_t dirtyCopies;
+
+        {
+          std::cout << "Running: full copy --> ";
+          Timer time;
+          fullCopies = replay(registerCount, false);
+        }
+
+        {
+          std::cout << "Running: dirty ranges --> ";
+          Timer time;
+          dirtyCopies = replay(registerCount, true);
+        }
+
+        std::cout << "Registers copied: " << fullCopies << " vs " << dirtyCopies << std::endl;
+
+        if (dirtyCopies >= fullCopies)
+          throw DxvkError("Dirty ranges did not reduce the copies");
+      }
+    }
+
+  public:
+    void run() {
+      test_ranges();
+      test_fuzz();
+
+      std::cout << "Dirty range tracking successfully tested for correctness" << std::endl;
+
+      test_benchmark();
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp app;
+    app.run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
@@ -0,0 +1,191 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <atomic>
+#include <condition_variable>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_frame_snapshot.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_frame_snapshot.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    // Every field is derived from the frame, so a torn read shows as a mismatch
+    struct Options {
+      uint32_t frame;
+      uint32_t fields[15];
+
+      static Options make(uint32_t frame) {
+        Options options;
+        options.frame = frame;
+        for (uint32_t i = 0; i < 15; ++i) {
+          options.fields[i] = frame * 31 + i;
+        }
+        return options;
+      }
+
+      bool isConsistent() const {
+        for (uint32_t i = 0; i < 15; ++i) {
+          if (fields[i] != frame * 31 + i) {
+            return false;
+          }
+        }
+        return true;
+      }
+    };
+
+    void test_publish() {
+      FrameSnapshot<Options> snapshot(Options::make(0));
+
+      uint32_t numNotified = 0;
+      uint32_t lastPrevious = ~0u;
+      uint32_t lastCurrent = ~0u;
+      const uint32_t id = snapshot.addListener([&](const Options& previous, const Options& current) {
+        ++numNotified;
+        lastPrevious = previous.frame;
+        lastCurrent = current.frame;
+      });
+
+      // Publishing an unchanged value is not a change
+      if (snapshot.publish(Options::make(0)) || snapshot.getVersion() != 0 || numNotified != 0) {
+        throw DxvkError("Unchanged value was published as a change");
+      }
+
+      if (!snapshot.publish(Options::make(1)) || snapshot.get().frame != 1 || snapshot.getVersion() != 1) {
+        throw DxvkError("Changed value was not published");
+      }
+
+      if (numNotified != 1 || lastPrevious != 0 || lastCurrent != 1) {
+        throw DxvkError("Listener was not notified of the change");
+      }
+
+      // The previously published value stays readable until the next change
+      const Options& held = snapshot.get();
+      snapshot.publish(Options::make(2));
+      if (held.frame != 1 || snapshot.get().frame != 2) {
+        throw DxvkError("Published value was overwritten by the next publish");
+      }
+
+      snapshot.removeListener(id);
+      snapshot.publish(Options::make(3));
+      if (numNotified != 2) {
+        throw DxvkError("Removed listener was notified");
+      }
+
+      // Resetting sets the value without counting as a change
+      FrameSnapshot<Options> initialized;
+      initialized.reset(Options::make(5));
+      if (initialized.getVersion() != 0 || initialized.copy().frame != 5 || initialized.publish(Options::make(5))) {
+        throw DxvkError("Reset value was not picked up");
+      }
+    }
+
+    // Readers copy while the producer publishes a new value every frame, the producer
+    // waits for all readers to have seen a frame before starting the next one.
+    void test_concurrentReads() {
+      constexpr uint32_t kNumReaders = 4;
+      constexpr uint32_t kNumFrames = 2000;
+
+      FrameSnapshot<Options> snapshot(Options::make(0));
+      std::atomic<bool> torn = false;
+
+      std::mutex mutex;
+      std::condition_variable cond;
+      uint32_t framesSeen[kNumReaders] = {};
+      uint32_t framePublished = 0;
+
+      std::vector<std::thread> readers;
+      for (uint32_t r = 0; r < kNumReaders; ++r) {
+        readers.emplace_back([&, r] {
+          uint32_t frame = 0;
+
+          while (frame < kNumFrames) {
+            // Copy a few times, racing the next publish
+            for (uint32_t i = 0; i < 16; ++i) {
+              const Options options = snapshot.copy();
+              if (!options.isConsistent()) {
+                torn = true;
+              }
+              frame = std::max(frame, options.frame);
+            }
+
+            std::unique_lock<std::mutex> lock(mutex);
+            framesSeen[r] = frame;
+            cond.notify_all();
+            cond.wait(lock, [&] { return framePublished > framesSeen[r] || frame == kNumFrames; });
+          }
+        });
+      }
+
+      for (uint32_t frame = 1; frame <= kNumFrames; ++frame) {
+        snapshot.publish(Options::make(frame));
+
+        std::unique_lock<std::mutex> lock(mutex);
+        framePublished = frame;
+        cond.notify_all();
+        cond.wait(lock, [&] {
+          return std::all_of(std::begin(framesSeen), std::end(framesSeen), [frame](uint32_t seen) { return seen == frame; });
+        });
+      }
+
+      for (auto& reader : readers) {
+        reader.join();
+      }
+
+      if (torn) {
+        throw DxvkError("Reader observed a partially published value");
+      }
+
+      if (snapshot.getVersion() != kNumFrames) {
+        throw DxvkError("Unexpected snapshot version");
+      }
+    }
+
+  public:
+    void run() {
+      test_publish();
+      test_concurrentReads();
+
+      std::cout << "All passed\n";
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp testApp;
+    testApp.run();
+  }
+  catch (const dxvk::DxvkError& error) {
+    std::cerr << error.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
@@ -0,0 +1,535 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <random>
+#include <thread>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_magazine_cache.h"
+#include "../../../src/util/util_tlsf.h"
+#include "../../../src/util/util_timer.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_magazine_cache.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    // Stands in for a memory type with its chunks, sub-allocates one
+    // range behind a mutex the way DxvkMemoryAllocator does.
+    class FakeMemoryBackend {
+    public:
+      static constexpr uint32_t ClassCount = 9;
+
+      static uint64_t classSize(uint32_t sizeClass) {
+        return uint64_t(256) << sizeClass;
+      }
+
+      explicit FakeMemoryBackend(uint64_t capacity)
+      : m_range(capacity), m_owners(capacity / 256), m_handles(capacity / 256) { }
+
+      // Uncached path, one lock per slice
+      uint64_t alloc(uint32_t sizeClass) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        return allocLocked(sizeClass);
+      }
+
+      void free(uint64_t offset) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        m_range.free(m_handles[offset / 256]);
+      }
+
+      uint32_t refill(const uint32_t& sizeClass, uint64_t* items, uint32_t count) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+        uint32_t n = 0;
+
+        for ( ; n < count; n++) {
+          items[n] = allocLocked(sizeClass);
+
+          if (items[n] == TlsfAllocator::InvalidOffset)
+            break;
+        }
+
+        m_refills += 1;
+        return n;
+      }
+
+      void flush(const uint32_t&, const uint64_t* items, uint32_t count) {
+        std::lock_guard<std::mutex> lock(m_mutex);
+
+        for (uint32_t i = 0; i < count; i++)
+          m_range.free(m_handles[items[i] / 256]);
+
+        m_flushes += 1;
+      }
+
+      // Marks a slice as handed out to a user, catches slices handed out twice
+      void acquire(uint64_t offset) {
+        if (m_owners[offset / 256].exchange(true))
+          throw DxvkError(str::format("Slice at ", offset, " handed out twice"));
+      }
+
+      void release(uint64_t offset) {
+        if (!m_owners[offset / 256].exchange(false))
+          throw DxvkError(str::format("Slice at ", offset, " released twice"));
+      }
+
+      bool isEmpty() const {
+        return m_range.isEmpty();
+      }
+
+      uint64_t refills() const {
+        return m_refills;
+      }
+
+      uint64_t flushes() const {
+        return m_flushes;
+      }
+
+    private:
+      std::mutex m_mutex;
+      TlsfAllocator m_range;
+      std::vector<std::atomic<bool>> m_owners;
+      // Allocation handle of the slice at each offset, like chunks store it in their slices
+      std::vector<uint32_t> m_handles;
+      uint64_t m_refills = 0;
+      uint64_t m_flushes = 0;
+
+      uint64_t allocLocked(uint32_t sizeClass) {
+        uint64_t length;
+        uint32_t handle;
+        const uint64_t offset = m_range.alloc(classSize(sizeClass), classSize(sizeClass), length, handle);
+
+        if (offset != TlsfAllocator::InvalidOffset)
+          m_handles[offset / 256] = handle;
+
+        return offset;
+      }
+    };
+
+    using SliceCache = MagazineCache<uint32_t, uint64_t>;
+
+    void test_batches() {
+      FakeMemoryBackend backend(16 << 20);
+      SliceCache cache(8);
+      std::vector<uint64_t> slices;
+
+      // The first allocation refills half a magazine, the next three are hits
+      for (uint32_t i = 0; i < 4; i++) {
+        uint64_t slice;
+        if (!cache.alloc(0, backend, slice))
+          throw DxvkError("Allocation failed");
+        slices.push_back(slice);
+      }
+
+      if (backend.refills() != 1 || cache.getStats().hits != 3 || cache.size() != 0)
+        throw DxvkError("Unexpected refills");
+
+      // Frees fill the magazine, a full magazine flushes half
+      for (uint32_t i = 0; i < 4; i++) {
+        uint64_t slice;
+        cache.alloc(0, backend, slice);
+        slices.push_back(slice);
+      }
+
+      for (const uint64_t slice : slices)
+        cache.free(0, backend, slice);
+
+      if (backend.flushes() != 0 || cache.size() != 8)
+        throw DxvkError("Magazine flushed before it was full");
+
+      // Other keys have their own magazine
+      uint64_t slice;
+      cache.alloc(1, backend, slice);
+      cache.free(1, backend, slice);
+
+      if (backend.refills() != 3 || cache.size() != 12)
+        throw DxvkError("Keys share a magazine");
+
+      cache.free(0, backend, backend.alloc(0));
+
+      if (backend.flushes() != 1 || cache.size() != 9)
+        throw DxvkError("Full magazine was not flushed");
+
+      cache.flush(backend);
+
+      if (cache.size() != 0 || !backend.isEmpty())
+        throw DxvkError("Slices leaked after flushing");
+    }
+
+    void test_exhaustion() {
+      // Only room for 3 slices, refills that come up short must still be usable
+      FakeMemoryBackend backend(3 * 256);
+      SliceCache cache(16);
+      std::vector<uint64_t> slices;
+      uint64_t slice;
+
+      while (cache.alloc(0, backend, slice)) {
+        backend.acquire(slice);
+        slices.push_back(slice);
+      }
+
+      if (slices.size() != 3)
+        throw DxvkError("Unexpected number of slices from a small backend");
+
+      for (const uint64_t s : slices) {
+        backend.release(s);
+        cache.free(0, backend, s);
+      }
+
+      cache.flush(backend);
+
+      if (!backend.isEmpty())
+        throw DxvkError("Slices leaked");
+    }
+
+    // Carves slices of every size class out of a TLSF range the way
+    // DxvkMemoryAllocator carves them out of its chunks
+    class ChunkBackend {
+    public:
+      using Classes = SliceSizeClasses<256>;
+
+      struct Slice {
+        uint64_t offset;
+        uint32_t handle;
+      };
+
+      explicit ChunkBackend(uint64_t capacity)
+      : m_range(capacity) { }
+
+      uint32_t refill(const uint32_t& sizeClass, Slice* items, uint32_t count) {
+        for (uint32_t n = 0; n < count; n++) {
+          uint64_t length;
+          items[n].offset = m_range.alloc(Classes::size(sizeClass), Classes::align(sizeClass), length, items[n].handle);
+
+          if (items[n].offset == TlsfAllocator::InvalidOffset)
+            return n;
+
+          if (length != Classes::size(sizeClass) || items[n].offset % Classes::align(sizeClass) != 0)
+            throw DxvkError(str::format("Class ", sizeClass, " slice carved with length ", length, " at ", items[n].offset));
+        }
+
+        return count;
+      }
+
+      void flush(const uint32_t& sizeClass, const Slice* items, uint32_t count) {
+        for (uint32_t i = 0; i < count; i++) {
+          if (m_range.free(items[i].handle) != Classes::size(sizeClass))
+            throw DxvkError(str::format("Class ", sizeClass, " slice freed with the wrong length"));
+        }
+      }
+
+      const TlsfAllocator& range() const {
+        return m_range;
+      }
+
+    private:
+      TlsfAllocator m_range;
+    };
+
+    void test_size_classes() {
+      using Classes = ChunkBackend::Classes;
+
+      // Half powers of two, each class a multiple of its alignment
+      const uint64_t expected[][2] = {
+        { 256, 256 }, { 384, 128 }, { 512, 512 }, { 768, 256 }, { 1024, 1024 }, { 1536, 512 },
+      };
+
+      for (uint32_t c = 0; c < std::size(expected); c++) {
+        if (Classes::size(c) != expected[c][0] || Classes::align(c) != expected[c][1])
+          throw DxvkError(str::format("Unexpected size class ", c));
+      }
+
+      if (Classes::find(257, 16) != 1 || Classes::find(257, 256) != 2 || Classes::find(64 << 10, 64 << 10) != 16)
+        throw DxvkError("Requests mapped to the wrong class");
+
+      // Random requests through the cache, checking that what the chunk
+      // hands out fits them and that used memory matches the class sizes
+      ChunkBackend backend(64 << 20);
+      MagazineCache<uint32_t, ChunkBackend::Slice> cache(16);
+      std::mt19937 rng(7);
+
+      struct Live {
+        uint32_t sizeClass;
+        ChunkBackend::Slice slice;
+      };
+
+      std::vector<Live> live;
+      uint64_t usedBytes = 0;
+      uint64_t requestedBytes = 0;
+
+      for (uint32_t i = 0; i < 20000; i++) {
+        if (live.size() < 256 && (live.empty() || rng() % 2)) {
+          const uint64_t size = 1 + rng() % (16 << 10);
+          const uint64_t align = uint64_t(16) << (rng() % 5);
+          const uint32_t sizeClass = Classes::find(size, align);
+
+          ChunkBackend::Slice slice;
+
+          if (!cache.alloc(sizeClass, backend, slice))
+            throw DxvkError("Cached allocation failed");
+
+          if (slice.offset % align != 0 || Classes::size(sizeClass) < size)
+            throw DxvkError("Slice does not fit its request");
+
+          live.push_back({ sizeClass, slice });
+          usedBytes += Classes::size(sizeClass);
+          requestedBytes += size;
+
+          // Requests aligned to at most half their size waste less than a third
+          if (align * 2 <= size && Classes::size(sizeClass) * 2 > size * 3 && size > 256)
+            throw DxvkError(str::format("Request of ", size, " bytes took ", Classes::size(sizeClass)));
+        } else {
+          const size_t index = rng() % live.size();
+          cache.free(live[index].sizeClass, backend, live[index].slice);
+          live[index] = live.back();
+          live.pop_back();
+        }
+      }
+
+      for (const Live& l : live)
+        cache.free(l.sizeClass, backend, l.slice);
+
+      cache.flush(backend);
+
+      if (!backend.range().isEmpty())
+        throw DxvkError("Slices leaked");
+
+      std::cout << "Size classes used " << usedBytes << " bytes for " << requestedBytes << " requested" << std::endl;
+    }
+
+    void test_registry() {
+      FakeMemoryBackend backend(16 << 20);
+
+      {
+        ThreadCacheRegistry<SliceCache> registry([] { return SliceCache(16); });
+
+        SliceCache* cache = &*registry.get();
+
+        if (&*registry.get() != cache)
+          throw DxvkError("Thread did not get its cache back");
+
+        uint64_t slice;
+        registry.get()->alloc(0, backend, slice);
+
+        // Another thread gets its own cache, which is handed back after the thread exited
+        SliceCache* otherCache = nullptr;
+
+        std::thread thread([&] {
+          auto access = registry.get();
+          otherCache = &*access;
+
+          // Exits with the slice still in its cache
+          uint64_t otherSlice;
+          otherCache->alloc(1, backend, otherSlice);
+          otherCache->free(1, backend, otherSlice);
+        });
+        thread.join();
+
+        if (otherCache == cache)
+          throw DxvkError("Threads share a cache");
+
+        // This thread used its cache since the last tick, only the exited thread's cache is trimmed
+        std::vector<SliceCache*> trimmed;
+        registry.trimIdle([&] (SliceCache& idle) {
+          trimmed.push_back(&idle);
+          idle.flush(backend);
+        });
+
+        if (trimmed.size() != 1 || trimmed[0] != otherCache)
+          throw DxvkError("Idle trim did not hand back exactly the cache of the exited thread");
+
+        // Not used for a whole tick, so it is idle now
+        trimmed.clear();
+        registry.trimIdle([&] (SliceCache& idle) { trimmed.push_back(&idle); });
+
+        if (trimmed.size() != 1 || trimmed[0] != cache)
+          throw DxvkError("Cache of an idle thread was not trimmed");
+
+        // Used again, so it is left alone
+        registry.get();
+        trimmed.clear();
+        registry.trimIdle([&] (SliceCache& idle) { trimmed.push_back(&idle); });
+
+        if (!trimmed.empty())
+          throw DxvkError("Cache of a busy thread was trimmed");
+
+        // Caches in use are skipped, even once they count as idle
+        {
+          auto access = registry.get();
+
+          std::thread trimmer([&] {
+            registry.trimIdle([&] (SliceCache& idle) { trimmed.push_back(&idle); });
+            registry.trimIdle([&] (SliceCache& idle) { trimmed.push_back(&idle); });
+          });
+          trimmer.join();
+        }
+
+        if (!trimmed.empty())
+          throw DxvkError("Cache in use was trimmed");
+
+        registry.get()->free(0, backend, slice);
+
+        // A full trim reaches every cache
+        trimmed.clear();
+        registry.trim([&] (SliceCache& c) {
+          trimmed.push_back(&c);
+          c.flush(backend);
+        });
+
+        if (trimmed.size() != 1 || trimmed[0] != cache || cache->size() != 0)
+          throw DxvkError("Full trim did not flush the cache of a live thread");
+      }
+
+      // A new registry must not hand out the cache of the destroyed one
+      ThreadCacheRegistry<SliceCache> registry([] { return SliceCache(16); });
+
+      if (registry.get()->size() != 0)
+        throw DxvkError("New registry returned a used cache");
+
+      if (!backend.isEmpty())
+        throw DxvkError("Slices leaked");
+    }
+
+    // Threads allocating and freeing small slices, some of them freeing what others allocated
+    static void stress(FakeMemoryBackend& backend, ThreadCacheRegistry<SliceCache>* registry, uint32_t numThreads, uint32_t iterations, bool validate) {
+      std::vector<std::thread> threads;
+      std::vector<std::vector<std::pair<uint32_t, uint64_t>>> handOver(numThreads);
+
+      for (uint32_t t = 0; t < numThreads; t++) {
+        threads.emplace_back([&, t] {
+          std::mt19937 rng(t);
+          std::vector<std::pair<uint32_t, uint64_t>> live;
+
+          for (uint32_t i = 0; i < iterations; i++) {
+            if (live.size() < 64 && (live.empty() || rng() % 2)) {
+              const uint32_t sizeClass = rng() % 4;
+              uint64_t slice;
+
+              if (registry) {
+                if (!registry->get()->alloc(sizeClass, backend, slice))
+                  throw DxvkError("Cached allocation failed");
+              } else {
+                slice = backend.alloc(sizeClass);
+              }
+
+              if (validate)
+                backend.acquire(slice);
+              live.emplace_back(sizeClass, slice);
+            } else {
+              const size_t index = rng() % live.size();
+              auto [sizeClass, slice] = live[index];
+              live[index] = live.back();
+              live.pop_back();
+
+              if (validate)
+                backend.release(slice);
+
+              if (registry)
+                registry->get()->free(sizeClass, backend, slice);
+              else
+                backend.free(slice);
+            }
+          }
+
+          handOver[t] = std::move(live);
+        });
+      }
+
+      for (auto& thread : threads)
+        thread.join();
+
+      // Free whatever the threads left on the main thread
+      for (const auto& live : handOver) {
+        for (const auto& [sizeClass, slice] : live) {
+          if (validate)
+            backend.release(slice);
+
+          if (registry)
+            registry->get()->free(sizeClass, backend, slice);
+          else
+            backend.free(slice);
+        }
+      }
+
+      if (registry)
+        registry->trim([&] (SliceCache& cache) { cache.flush(backend); });
+
+      if (!backend.isEmpty())
+        throw DxvkError("Slices leaked");
+    }
+
+    void test_stress() {
+      FakeMemoryBackend backend(256 << 20);
+      ThreadCacheRegistry<SliceCache> registry([] { return SliceCache(32); });
+      stress(backend, &registry, 8, 20000, true);
+    }
+
+    void test_benchmark() {
+      const uint32_t numThreads = std::max(4u, std::thread::hardware_concurrency());
+
+      std::cout << std::endl << numThreads << " threads, 200000 operations each" << std::endl;
+
+      {
+        std::cout << "Running: locked per slice --> ";
+        FakeMemoryBackend backend(1ull << 30);
+        Timer time;
+        stress(backend, nullptr, numThreads, 200000, false);
+      }
+
+      {
+        std::cout << "Running: per-thread magazines --> ";
+        FakeMemoryBackend backend(1ull << 30);
+        ThreadCacheRegistry<SliceCache> registry([] { return SliceCache(32); });
+        Timer time;
+        stress(backend, &registry, numThreads, 200000, false);
+      }
+    }
+
+  public:
+    void run() {
+      test_batches();
+      test_exhaustion();
+      test_size_classes();
+      test_registry();
+      test_stress();
+
+      std::cout << "Magazine caches successfully tested for correctness" << std::endl;
+
+      test_benchmark();
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp app;
+    app.run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
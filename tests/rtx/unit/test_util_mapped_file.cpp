@@ -0,0 +1,167 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <cstdio>
+#include <cstring>
+#include <filesystem>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_mapped_file.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_mapped_file.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    static constexpr size_t kFileSize = 1024 * 1024 + 123;
+
+    std::string m_filename;
+    std::vector<uint8_t> m_contents;
+
+    void writeTestFile() {
+      m_filename = (std::filesystem::temp_directory_path() / "test_util_mapped_file.bin").string();
+
+      m_contents.resize(kFileSize);
+      for (size_t i = 0; i < kFileSize; ++i) {
+        m_contents[i] = static_cast<uint8_t>((i * 2654435761u) >> 24);
+      }
+
+      FILE* file = std::fopen(m_filename.c_str(), "wb");
+      if (file == nullptr) {
+        throw DxvkError(str::format("Unable to create ", m_filename));
+      }
+      std::fwrite(m_contents.data(), 1, m_contents.size(), file);
+      std::fclose(file);
+    }
+
+    void checkRange(const MappedFile& file, uint64_t offset, size_t size) {
+      const void* data = file.view(offset, size);
+      if (data == nullptr) {
+        throw DxvkError(str::format("view(", offset, ", ", size, ") returned nullptr"));
+      }
+      if (std::memcmp(data, m_contents.data() + offset, size) != 0) {
+        throw DxvkError(str::format("view(", offset, ", ", size, ") content mismatch"));
+      }
+    }
+
+    void test_map() {
+      MappedFile file;
+
+      if (file.map(m_filename + ".missing")) {
+        throw DxvkError("Mapping a missing file must fail");
+      }
+
+      if (!file.map(m_filename)) {
+        throw DxvkError("Unable to map the test file");
+      }
+
+      if (file.size() != kFileSize) {
+        throw DxvkError(str::format("Unexpected mapped size ", file.size()));
+      }
+
+      checkRange(file, 0, kFileSize);
+      checkRange(file, 4095, 2);
+      checkRange(file, kFileSize - 1, 1);
+
+      // Out of bounds ranges must be rejected
+      if (file.view(0, kFileSize + 1) != nullptr ||
+          file.view(kFileSize, 1) != nullptr ||
+          file.view(~0ull, 2) != nullptr) {
+        throw DxvkError("Out of bounds view was not rejected");
+      }
+    }
+
+    void test_discard() {
+      MappedFile file;
+      file.map(m_filename);
+
+      // Discarded pages must be read back from the file on next access
+      file.discard(0, kFileSize);
+      checkRange(file, 0, kFileSize);
+
+      file.discard(100, 3 * 4096);
+      file.discard(kFileSize - 10, 100);
+      checkRange(file, 0, kFileSize);
+    }
+
+    void test_prefetch() {
+      MappedFile file;
+      file.map(m_filename);
+
+      // Prefetching must not change the contents, out of bounds ranges are ignored
+      file.discard(0, kFileSize);
+      file.prefetch(0, kFileSize);
+      file.prefetch(4095, 2);
+      file.prefetch(kFileSize - 1, 100);
+      file.prefetch(~0ull, 2);
+      checkRange(file, 0, kFileSize);
+    }
+
+    void test_move() {
+      MappedFile file;
+      file.map(m_filename);
+
+      MappedFile other(std::move(file));
+      if (file.isMapped() || !other.isMapped()) {
+        throw DxvkError("Mapping ownership was not transferred");
+      }
+      checkRange(other, 0, kFileSize);
+
+      file = std::move(other);
+      checkRange(file, 0, kFileSize);
+
+      file.unmap();
+      if (file.isMapped() || file.view(0, 1) != nullptr) {
+        throw DxvkError("Unmapped file still has a view");
+      }
+    }
+
+  public:
+    void run() {
+      writeTestFile();
+
+      test_map();
+      test_discard();
+      test_prefetch();
+      test_move();
+
+      std::filesystem::remove(m_filename);
+
+      std::cout << "All passed\n";
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp testApp;
+    testApp.run();
+  }
+  catch (const dxvk::DxvkError& error) {
+    std::cerr << error.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
@@ -0,0 +1,209 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <numeric>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_memoization.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_memoization.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    // Result of a range of the simulated buffer, the sum of its contents
+    struct Sum {
+      uint64_t value = 0;
+    };
+
+    std::vector<uint32_t> m_memory;
+    uint64_t m_numComputed = 0;
+
+    Sum compute(size_t start, size_t size) {
+      ++m_numComputed;
+      return Sum { std::accumulate(m_memory.begin() + start, m_memory.begin() + start + size, uint64_t(0)) };
+    }
+
+    void write(MemoryRegionMemoizer<Sum>& memoizer, std::mt19937& rng, size_t start, size_t size) {
+      for (size_t i = start; i < start + size; ++i) {
+        m_memory[i] = rng();
+      }
+      memoizer.invalidate(start, size);
+    }
+
+    void test_randomized() {
+      std::mt19937 rng(2);
+      m_memory.resize(4096);
+      for (auto& v : m_memory) {
+        v = rng();
+      }
+
+      MemoryRegionMemoizer<Sum> memoizer(64);
+      auto computeFn = [this](size_t start, size_t size) { return compute(start, size); };
+
+      // Sums of a sub-range can be derived from a containing range of the same contents
+      uint64_t numDerived = 0;
+      auto deriveFn = [this, &numDerived](const Sum& container, size_t containerStart, size_t containerSize, size_t start, size_t size) {
+        ++numDerived;
+        const uint64_t before = std::accumulate(m_memory.begin() + containerStart, m_memory.begin() + start, uint64_t(0));
+        const uint64_t after = std::accumulate(m_memory.begin() + start + size, m_memory.begin() + containerStart + containerSize, uint64_t(0));
+        return std::optional<Sum>(Sum { container.value - before - after });
+      };
+
+      for (uint32_t i = 0; i < 200000; ++i) {
+        // A handful of hot ranges, like draws out of a few vertex buffer sub-allocations
+        const size_t start = (rng() % 32) * 64 + (rng() % 4 == 0 ? rng() % 32 : 0);
+        const size_t size = std::min<size_t>(rng() % 4 == 0 ? rng() % 64 : 128, m_memory.size() - start);
+
+        switch (rng() % 16) {
+        case 0:
+          write(memoizer, rng, rng() % 4000, rng() % 96);
+          break;
+        case 1:
+          if (rng() % 16 == 0) {
+            for (auto& v : m_memory) {
+              v = rng();
+            }
+            memoizer.invalidateAll();
+          }
+          break;
+        default: {
+          const Sum expected = Sum { std::accumulate(m_memory.begin() + start, m_memory.begin() + start + size, uint64_t(0)) };
+          const Sum result = rng() % 2 ? memoizer.memoize(start, size, computeFn)
+                                       : memoizer.memoize(start, size, computeFn, deriveFn);
+
+          if (result.value != expected.value) {
+            throw DxvkError(str::format("Stale result for range ", start, "+", size, " at step ", i));
+          }
+          break;
+        }
+        }
+
+        if (memoizer.size() > 64) {
+          throw DxvkError(str::format("Memoizer exceeded its capacity, ", memoizer.size(), " results"));
+        }
+      }
+
+      const auto& stats = memoizer.getStats();
+      std::cout << "hits " << stats.hits << ", contained hits " << stats.containedHits << ", misses " << stats.misses
+                << ", evictions " << stats.evictions << ", invalidations " << stats.invalidations << std::endl;
+
+      if (stats.misses != m_numComputed || stats.hits == 0 || stats.containedHits == 0 || stats.evictions == 0 || stats.invalidations == 0) {
+        throw DxvkError("Unexpected memoizer statistics");
+      }
+
+      if (numDerived < stats.containedHits) {
+        throw DxvkError("Contained hits were not derived");
+      }
+    }
+
+    void test_subRange() {
+      m_memory.assign(1024, 1);
+      m_numComputed = 0;
+
+      MemoryRegionMemoizer<Sum> memoizer;
+      auto computeFn = [this](size_t start, size_t size) { return compute(start, size); };
+      auto deriveFn = [](const Sum& container, size_t containerStart, size_t containerSize, size_t start, size_t size) {
+        // All elements are 1, the sum of the sub-range is its size
+        return std::optional<Sum>(Sum { container.value - (containerSize - size) });
+      };
+
+      memoizer.memoize(0, 512, computeFn);
+      memoizer.memoize(100, 50, computeFn, deriveFn);
+      memoizer.memoize(100, 50, computeFn);
+
+      // Exact only queries do not use containing ranges
+      memoizer.memoize(200, 50, computeFn);
+
+      // Ranges crossing the end of the cached range can not be derived
+      memoizer.memoize(500, 50, computeFn, deriveFn);
+
+      const auto& stats = memoizer.getStats();
+      if (m_numComputed != 3 || stats.containedHits != 1 || stats.hits != 1) {
+        throw DxvkError(str::format("Unexpected sub-range handling, computed ", m_numComputed, " contained hits ", stats.containedHits));
+      }
+
+      // A write in the middle drops every range overlapping it
+      memoizer.invalidate(120, 1);
+      if (memoizer.size() != 2) {
+        throw DxvkError(str::format("Unexpected number of results after a write, ", memoizer.size()));
+      }
+
+      memoizer.invalidateAll();
+      if (memoizer.size() != 0 || memoizer.getGeneration() != 1) {
+        throw DxvkError("Discard did not drop the results");
+      }
+    }
+
+    void test_lru() {
+      m_memory.assign(1024, 1);
+
+      MemoryRegionMemoizer<Sum> memoizer(4);
+      auto computeFn = [this](size_t start, size_t size) { return compute(start, size); };
+
+      for (size_t i = 0; i < 4; ++i) {
+        memoizer.memoize(i * 10, 10, computeFn);
+      }
+
+      // Keep the first range hot, the second one is the least recently used now
+      memoizer.memoize(0, 10, computeFn);
+      memoizer.memoize(100, 10, computeFn);
+
+      m_numComputed = 0;
+      memoizer.memoize(0, 10, computeFn);
+      memoizer.memoize(20, 10, computeFn);
+      if (m_numComputed != 0) {
+        throw DxvkError("Recently used results were evicted");
+      }
+
+      memoizer.memoize(10, 10, computeFn);
+      if (m_numComputed != 1) {
+        throw DxvkError("Least recently used result was not evicted");
+      }
+    }
+
+  public:
+    void run() {
+      test_randomized();
+      test_subRange();
+      test_lru();
+
+      std::cout << "All passed\n";
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp testApp;
+    testApp.run();
+  }
+  catch (const dxvk::DxvkError& error) {
+    std::cerr << error.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
@@ -0,0 +1,242 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <random>
+#include <unordered_set>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_object_pool.h"
+#include "../../../src/util/util_timer.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_object_pool.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    struct Object {
+      static int s_numAlive;
+
+      uint32_t value;
+      std::vector<uint32_t> data;
+
+      explicit Object(uint32_t v) : value(v), data(4, v) { ++s_numAlive; }
+      ~Object() { --s_numAlive; }
+    };
+
+    // Mimics an RtInstance sized object
+    struct Payload {
+      uint64_t id;
+      uint32_t frameCreated;
+      uint8_t data[700];
+
+      Payload(uint64_t id_, uint32_t frame) : id(id_), frameCreated(frame) { }
+    };
+
+    void test_persistent() {
+      ObjectPool<Object, 16> pool;
+      std::vector<Object*> objects;
+
+      for (uint32_t i = 0; i < 1000; ++i) {
+        objects.push_back(pool.allocate(i));
+      }
+
+      // Objects must never move, cells of a new slab are handed out in address order
+      for (uint32_t i = 0; i < 1000; ++i) {
+        if (objects[i]->value != i || objects[i]->data[3] != i || ObjectPool<Object, 16>::isTransient(objects[i])) {
+          throw DxvkError(str::format("Object ", i, " was corrupted"));
+        }
+        if (i % 16 != 0 && reinterpret_cast<uintptr_t>(objects[i]) <= reinterpret_cast<uintptr_t>(objects[i - 1])) {
+          throw DxvkError(str::format("Object ", i, " is out of order within its slab"));
+        }
+      }
+
+      std::unordered_set<Object*> released;
+      for (uint32_t i = 0; i < 1000; i += 3) {
+        pool.release(objects[i]);
+        released.insert(objects[i]);
+      }
+
+      if (pool.size() != 666 || Object::s_numAlive != 666) {
+        throw DxvkError(str::format("Unexpected number of objects ", pool.size()));
+      }
+
+      // Released cells are reused before any new slab is added
+      for (uint32_t i = 0; i < 334; ++i) {
+        Object* object = pool.allocate(5000 + i);
+        if (released.count(object) == 0) {
+          throw DxvkError("Released cell was not reused");
+        }
+      }
+
+      const auto& stats = pool.getStats();
+      if (stats.capacity != 1008 || stats.allocations != 1334 || stats.releases != 334 || stats.liveObjects != 1000) {
+        throw DxvkError(str::format("Unexpected stats, capacity ", stats.capacity, " allocations ", stats.allocations));
+      }
+    }
+
+    void test_transient() {
+      {
+        ObjectPool<Object, 16> pool;
+        std::vector<Object*> persistent;
+
+        for (uint32_t frame = 0; frame < 10; ++frame) {
+          persistent.push_back(pool.allocate(frame));
+
+          Object* first = nullptr;
+          for (uint32_t i = 0; i < 100; ++i) {
+            Object* object = pool.allocateTransient(frame * 1000 + i);
+            if (!ObjectPool<Object, 16>::isTransient(object)) {
+              throw DxvkError("Transient object not recognized");
+            }
+            first = first ? first : object;
+          }
+
+          if (pool.getStats().transientObjects != 100 || pool.size() != persistent.size() + 100) {
+            throw DxvkError(str::format("Unexpected transient count in frame ", frame));
+          }
+
+          pool.releaseTransient();
+
+          // Transient memory is recycled, the first transient object of every frame lands in the same cell
+          if (pool.allocateTransient(0u) != first) {
+            throw DxvkError("Transient memory was not recycled");
+          }
+          pool.releaseTransient();
+        }
+
+        if (Object::s_numAlive != 10 || pool.getStats().capacity != 16 + 112) {
+          throw DxvkError(str::format("Unexpected state after transient frames, ", Object::s_numAlive, " alive"));
+        }
+
+        for (uint32_t i = 0; i < persistent.size(); ++i) {
+          if (persistent[i]->value != i) {
+            throw DxvkError("Persistent object overwritten by transient allocations");
+          }
+        }
+
+        // Leave live objects of both kinds for the destructor
+        pool.allocateTransient(1u);
+      }
+
+      if (Object::s_numAlive != 0) {
+        throw DxvkError(str::format("Pool leaked ", Object::s_numAlive, " objects"));
+      }
+    }
+
+    void test_benchmark() {
+      constexpr uint32_t kFrames = 200;
+      constexpr uint32_t kPersistent = 20000;
+      constexpr uint32_t kTransientPerFrame = 2000;
+      std::mt19937 rng(1234);
+
+      // Churn like particle instances: some persistent objects replaced every frame, plus per frame copies
+      auto replay = [&](auto&& allocate, auto&& release, auto&& allocateTransient, auto&& releaseTransient) {
+        std::vector<Payload*> live;
+        uint64_t checksum = 0;
+
+        for (uint32_t i = 0; i < kPersistent; ++i) {
+          live.push_back(allocate(i, 0u));
+        }
+
+        for (uint32_t frame = 1; frame < kFrames; ++frame) {
+          for (uint32_t i = 0; i < kPersistent / 10; ++i) {
+            const uint32_t victim = rng() % kPersistent;
+            release(live[victim]);
+            live[victim] = allocate(frame * kPersistent + i, frame);
+          }
+
+          for (uint32_t i = 0; i < kTransientPerFrame; ++i) {
+            checksum += allocateTransient(i, frame)->id;
+          }
+          releaseTransient();
+
+          // Walk the table, like the garbage collection does
+          for (const Payload* payload : live) {
+            checksum += payload->frameCreated;
+          }
+        }
+
+        for (Payload* payload : live) {
+          release(payload);
+        }
+        return checksum;
+      };
+
+      uint64_t heapChecksum;
+      uint64_t poolChecksum;
+
+      {
+        std::cout << "Object churn, new/delete: ";
+        Timer time;
+        std::vector<Payload*> transient;
+        rng.seed(1234);
+        heapChecksum = replay(
+          [](uint64_t id, uint32_t frame) { return new Payload(id, frame); },
+          [](Payload* payload) { delete payload; },
+          [&](uint64_t id, uint32_t frame) { return transient.emplace_back(new Payload(id, frame)); },
+          [&] { for (Payload* payload : transient) { delete payload; } transient.clear(); });
+      }
+
+      {
+        std::cout << "Object churn, object pool: ";
+        Timer time;
+        ObjectPool<Payload> pool;
+        rng.seed(1234);
+        poolChecksum = replay(
+          [&](uint64_t id, uint32_t frame) { return pool.allocate(id, frame); },
+          [&](Payload* payload) { pool.release(payload); },
+          [&](uint64_t id, uint32_t frame) { return pool.allocateTransient(id, frame); },
+          [&] { pool.releaseTransient(); });
+      }
+
+      if (heapChecksum != poolChecksum) {
+        throw DxvkError("Replay mismatch");
+      }
+    }
+
+  public:
+    void run() {
+      test_persistent();
+      test_transient();
+      test_benchmark();
+
+      std::cout << "All passed\n";
+    }
+  };
+
+  int TestApp::Object::s_numAlive = 0;
+}
+
+int main() {
+  try {
+    dxvk::TestApp testApp;
+    testApp.run();
+  }
+  catch (const dxvk::DxvkError& error) {
+    std::cerr << error.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
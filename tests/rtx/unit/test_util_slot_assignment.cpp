@@ -0,0 +1,245 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_dirty_range.h"
+#include "../../../src/util/util_slot_assignment.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_slot_assignment.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    static constexpr uint32_t kNumTypes = 3;
+    static constexpr uint32_t kNoSlot = 0xFFFF;
+
+    struct Range {
+      uint32_t offset;
+      uint32_t count;
+    };
+
+    // Stands in for the lights of a frame, which remember their slot for the next one
+    struct Item {
+      uint32_t type;
+      uint32_t slot;
+    };
+
+    std::array<Range, kNumTypes> m_ranges;
+    std::vector<uint32_t> m_slots;
+    std::vector<uint32_t> m_unplaced;
+
+    void assign(std::vector<Item>& items) {
+      assignStableSlots(static_cast<uint32_t>(items.size()),
+        [&](uint32_t item) { return items[item].type; },
+        [&](uint32_t item) { return items[item].slot; },
+        m_ranges, m_slots, m_unplaced);
+
+      validate(items);
+
+      for (uint32_t slot = 0; slot < m_slots.size(); ++slot) {
+        items[m_slots[slot]].slot = slot;
+      }
+    }
+
+    // Every item owns exactly one slot, within the range of its type
+    void validate(const std::vector<Item>& items) const {
+      if (m_slots.size() != items.size())
+        throw DxvkError("Slot count does not match item count");
+
+      uint32_t offset = 0;
+      for (uint32_t type = 0; type < kNumTypes; ++type) {
+        if (m_ranges[type].offset != offset)
+          throw DxvkError("Type ranges are not laid out back to back");
+        offset += m_ranges[type].count;
+      }
+
+      std::vector<bool> seen(items.size(), false);
+      for (uint32_t slot = 0; slot < m_slots.size(); ++slot) {
+        const uint32_t item = m_slots[slot];
+
+        if (item >= items.size() || seen[item])
+          throw DxvkError("Item placed into none or several slots");
+        seen[item] = true;
+
+        const Range& range = m_ranges[items[item].type];
+        if (slot < range.offset || slot >= range.offset + range.count)
+          throw DxvkError("Item placed outside of the range of its type");
+      }
+    }
+
+    void test_stability() {
+      std::vector<Item> items = {
+        { 0, kNoSlot }, { 1, kNoSlot }, { 2, kNoSlot }, { 0, kNoSlot }, { 1, kNoSlot }, { 0, kNoSlot }
+      };
+
+      assign(items);
+
+      // Reordering the items does not move them between slots
+      std::vector<Item> reordered(items.rbegin(), items.rend());
+      const std::vector<Item> before = reordered;
+      assign(reordered);
+
+      for (size_t i = 0; i < reordered.size(); ++i) {
+        if (reordered[i].slot != before[i].slot)
+          throw DxvkError("Unchanged item moved to another slot");
+      }
+    }
+
+    void test_reuse() {
+      std::vector<Item> items = {
+        { 0, kNoSlot }, { 0, kNoSlot }, { 0, kNoSlot }, { 1, kNoSlot }, { 1, kNoSlot }
+      };
+
+      assign(items);
+
+      // A removed item's slot goes to a new item of the same type, nothing else moves
+      const uint32_t freedSlot = items[1].slot;
+      items.erase(items.begin() + 1);
+      items.push_back({ 0, kNoSlot });
+      const std::vector<Item> before = items;
+      assign(items);
+
+      if (items.back().slot != freedSlot)
+        throw DxvkError("New item did not reuse the freed slot");
+
+      for (size_t i = 0; i + 1 < items.size(); ++i) {
+        if (items[i].slot != before[i].slot)
+          throw DxvkError("Item moved when a slot was reused");
+      }
+
+      // Removing an item of the first type shifts the range of the second, only items outside their new range move
+      items.erase(items.begin());
+      const std::vector<Item> shifted = items;
+      assign(items);
+
+      for (size_t i = 0; i < items.size(); ++i) {
+        const Range& range = m_ranges[items[i].type];
+        const bool inRange = shifted[i].slot >= range.offset && shifted[i].slot < range.offset + range.count;
+
+        if (inRange != (items[i].slot == shifted[i].slot))
+          throw DxvkError("Range shift moved an item it did not have to, or kept one outside its range");
+      }
+    }
+
+    void test_fuzz() {
+      std::mt19937 rng(1234);
+      std::vector<Item> items;
+
+      for (uint32_t frame = 0; frame < 1000; ++frame) {
+        const uint32_t removals = rng() % 8;
+        for (uint32_t i = 0; i < removals && !items.empty(); ++i) {
+          items.erase(items.begin() + rng() % items.size());
+        }
+
+        const uint32_t additions = rng() % 8;
+        for (uint32_t i = 0; i < additions; ++i) {
+          items.push_back({ static_cast<uint32_t>(rng() % kNumTypes), kNoSlot });
+        }
+
+        // Stale slots past the end of the previous frame must be ignored
+        if (!items.empty() && rng() % 4 == 0) {
+          items[rng() % items.size()].slot = static_cast<uint32_t>(items.size() + rng() % 16);
+        }
+
+        std::shuffle(items.begin(), items.end(), rng);
+
+        const std::vector<Item> before = items;
+        assign(items);
+
+        // An item whose previous slot is still within its range never moves, unless another item claimed it first
+        std::vector<uint32_t> claims(items.size(), 0);
+        for (const Item& item : before) {
+          const Range& range = m_ranges[item.type];
+          if (item.slot >= range.offset && item.slot < range.offset + range.count)
+            ++claims[item.slot];
+        }
+
+        for (size_t i = 0; i < items.size(); ++i) {
+          const Range& range = m_ranges[before[i].type];
+          const bool keepable = before[i].slot >= range.offset && before[i].slot < range.offset + range.count;
+
+          if (keepable && claims[before[i].slot] == 1 && items[i].slot != before[i].slot)
+            throw DxvkError("Item lost a slot it could have kept");
+        }
+      }
+    }
+
+    void test_dirty_ranges() {
+      DirtyRangeList ranges(2, 3);
+
+      // Elements at most the merge distance past a range extend it
+      for (uint32_t element : { 0u, 2u, 4u, 8u, 9u }) {
+        ranges.markDirty(element);
+      }
+
+      if (ranges.ranges().size() != 2 ||
+          ranges.ranges()[0].begin != 0 || ranges.ranges()[0].end != 5 ||
+          ranges.ranges()[1].begin != 8 || ranges.ranges()[1].end != 10)
+        throw DxvkError("Close dirty elements were not merged");
+
+      // Past the maximum number of ranges everything is collapsed into one
+      ranges.markDirty(20);
+      ranges.markDirty(30);
+
+      if (ranges.ranges().size() != 1 || ranges.ranges()[0].begin != 0 || ranges.ranges()[0].end != 31)
+        throw DxvkError("Dirty ranges were not collapsed");
+
+      ranges.markDirty(100);
+
+      if (ranges.ranges().size() != 1 || ranges.ranges()[0].end != 101)
+        throw DxvkError("Collapsed dirty range was not extended");
+
+      ranges.clear();
+      ranges.markDirty(50);
+
+      if (ranges.ranges().size() != 1 || ranges.ranges()[0].begin != 50 || ranges.ranges()[0].end != 51)
+        throw DxvkError("Dirty ranges were not cleared");
+    }
+
+  public:
+    void run() {
+      test_stability();
+      test_reuse();
+      test_fuzz();
+      test_dirty_ranges();
+
+      std::cout << "Slot assignment successfully tested for correctness" << std::endl;
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp app;
+    app.run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
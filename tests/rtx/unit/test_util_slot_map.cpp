@@ -0,0 +1,344 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <algorithm>
+#include <random>
+#include <unordered_map>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_slot_map.h"
+#include "../../../src/util/util_timer.h"
+#include "../../../src/util/xxHash/xxhash.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_slot_map.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    struct Object {
+      static int s_numAlive;
+
+      uint32_t value;
+
+      explicit Object(uint32_t v) : value(v) { ++s_numAlive; }
+      ~Object() { --s_numAlive; }
+    };
+
+    // Mimics a BlasEntry sized cache entry
+    struct Payload {
+      uint64_t hash;
+      uint32_t frameLastTouched;
+      uint8_t data[500];
+    };
+
+    void test_slotMap() {
+      SlotMap<Object, 16> map;
+      std::vector<SlotMap<Object, 16>::Handle> handles;
+      std::vector<Object*> pointers;
+
+      for (uint32_t i = 0; i < 1000; ++i) {
+        handles.push_back(map.emplace(i));
+        pointers.push_back(map.get(handles.back()));
+      }
+
+      // Objects must never move
+      for (uint32_t i = 0; i < 1000; ++i) {
+        if (map.get(handles[i]) != pointers[i] || pointers[i]->value != i) {
+          throw DxvkError(str::format("Object ", i, " has moved"));
+        }
+      }
+
+      // Erase every third object from within a visit
+      map.forEach([&](uint32_t index, Object& object) {
+        if (object.value % 3 == 0) {
+          map.erase(index);
+        }
+      });
+
+      if (map.size() != 666 || Object::s_numAlive != 666) {
+        throw DxvkError(str::format("Unexpected number of objects ", map.size()));
+      }
+
+      for (uint32_t i = 0; i < 1000; ++i) {
+        const bool erased = i % 3 == 0;
+        if ((map.get(handles[i]) == nullptr) != erased) {
+          throw DxvkError(str::format("Handle ", i, " did not resolve as expected"));
+        }
+      }
+
+      // Freed slots are reused, stale handles must not resolve to the new objects
+      for (uint32_t i = 0; i < 334; ++i) {
+        const auto handle = map.emplace(5000 + i);
+        if (handle.index >= 1000) {
+          throw DxvkError("Freed slot was not reused");
+        }
+      }
+
+      for (uint32_t i = 0; i < 1000; i += 3) {
+        if (map.get(handles[i]) != nullptr) {
+          throw DxvkError(str::format("Stale handle ", i, " resolved"));
+        }
+      }
+
+      if (map.capacity() != 1008) {
+        throw DxvkError(str::format("Unexpected capacity ", map.capacity()));
+      }
+
+      map.clear();
+
+      if (!map.empty() || Object::s_numAlive != 0) {
+        throw DxvkError("Objects were not destroyed on clear");
+      }
+    }
+
+    void test_hashIndex() {
+      std::mt19937 rng(1234);
+      SlotHashIndex index(16);
+      std::unordered_multimap<uint64_t, uint32_t> reference;
+
+      // Few distinct keys force long collision runs, all values of a key must stay reachable
+      auto randomKey = [&rng] {
+        const uint64_t key = rng() % 512;
+        return XXH3_64bits(&key, sizeof(key));
+      };
+
+      for (uint32_t i = 0; i < 200000; ++i) {
+        const uint64_t key = randomKey();
+
+        if (rng() % 3 != 0 || reference.empty()) {
+          index.insert(key, i);
+          reference.emplace(key, i);
+        } else {
+          auto it = reference.find(key);
+
+          if (it != reference.end()) {
+            if (!index.erase(key, it->second)) {
+              throw DxvkError("Existing value was not found on erase");
+            }
+            reference.erase(it);
+          } else if (index.erase(key, 0)) {
+            throw DxvkError("Missing value was erased");
+          }
+        }
+
+        if (i % 1000 == 0) {
+          for (uint64_t k = 0; k < 512; ++k) {
+            const uint64_t key = XXH3_64bits(&k, sizeof(k));
+
+            std::vector<uint32_t> expected;
+            auto range = reference.equal_range(key);
+            for (auto it = range.first; it != range.second; ++it) {
+              expected.push_back(it->second);
+            }
+
+            std::vector<uint32_t> values;
+            index.find(key, [&values](uint32_t value) {
+              values.push_back(value);
+              return true;
+            });
+
+            std::sort(expected.begin(), expected.end());
+            std::sort(values.begin(), values.end());
+
+            if (expected != values) {
+              throw DxvkError(str::format("Value mismatch for key ", k, " at step ", i));
+            }
+          }
+        }
+      }
+
+      if (index.size() != reference.size()) {
+        throw DxvkError("Index size mismatch");
+      }
+    }
+
+    // Replays a draw call hash stream the way DrawCallCache sees it: every frame
+    // looks up each draw by its hash, adds missing entries and collects the ones
+    // that have not been drawn for a few frames.
+    struct DrawStream {
+      std::vector<std::vector<uint64_t>> frames;
+    };
+
+    static DrawStream makeDrawStream() {
+      constexpr uint32_t kNumFrames = 200;
+      constexpr uint32_t kNumStaticDraws = 4000;
+      constexpr uint32_t kNumInstancedDraws = 200;
+      constexpr uint32_t kNumTransientDraws = 300;
+
+      std::mt19937 rng(42);
+      DrawStream stream;
+      uint64_t nextTransient = 1ull << 32;
+
+      for (uint32_t frame = 0; frame < kNumFrames; ++frame) {
+        std::vector<uint64_t> draws;
+
+        // Static geometry, the visible set slides slowly with the camera
+        for (uint32_t i = 0; i < kNumStaticDraws; ++i) {
+          const uint64_t id = i + frame * 10;
+          draws.push_back(XXH3_64bits(&id, sizeof(id)));
+        }
+
+        // Instanced geometry shares a hash between many draws
+        for (uint32_t i = 0; i < kNumInstancedDraws; ++i) {
+          const uint64_t id = (1ull << 40) + i % 20;
+          draws.push_back(XXH3_64bits(&id, sizeof(id)));
+        }
+
+        // Particles and other geometry that changes every frame
+        for (uint32_t i = 0; i < kNumTransientDraws; ++i) {
+          const uint64_t id = nextTransient++;
+          draws.push_back(XXH3_64bits(&id, sizeof(id)));
+        }
+
+        std::shuffle(draws.begin(), draws.end(), rng);
+        stream.frames.push_back(std::move(draws));
+      }
+
+      return stream;
+    }
+
+    static constexpr uint32_t kFramesToKeep = 3;
+
+    static uint64_t replayMultimap(const DrawStream& stream) {
+      std::unordered_multimap<uint64_t, Payload> entries;
+      entries.reserve(1024);
+      uint64_t numCreated = 0;
+
+      for (uint32_t frame = 0; frame < stream.frames.size(); ++frame) {
+        for (uint64_t hash : stream.frames[frame]) {
+          Payload* match = nullptr;
+          auto range = entries.equal_range(hash);
+          for (auto it = range.first; it != range.second; ++it) {
+            if (it->second.frameLastTouched != frame) {
+              match = &it->second;
+              break;
+            }
+          }
+
+          if (match == nullptr) {
+            match = &entries.emplace(hash, Payload { hash })->second;
+            ++numCreated;
+          }
+
+          match->frameLastTouched = frame;
+        }
+
+        for (auto it = entries.begin(); it != entries.end(); ) {
+          if (it->second.frameLastTouched + kFramesToKeep < frame) {
+            it = entries.erase(it);
+          } else {
+            ++it;
+          }
+        }
+      }
+
+      return numCreated;
+    }
+
+    static uint64_t replaySlotMap(const DrawStream& stream) {
+      SlotMap<Payload> entries;
+      SlotHashIndex index(1024);
+      uint64_t numCreated = 0;
+
+      for (uint32_t frame = 0; frame < stream.frames.size(); ++frame) {
+        for (uint64_t hash : stream.frames[frame]) {
+          Payload* match = nullptr;
+          index.find(hash, [&](uint32_t slot) {
+            if (entries[slot].frameLastTouched != frame) {
+              match = &entries[slot];
+              return false;
+            }
+            return true;
+          });
+
+          if (match == nullptr) {
+            const uint32_t slot = entries.emplace(Payload { hash }).index;
+            index.insert(hash, slot);
+            match = &entries[slot];
+            ++numCreated;
+          }
+
+          match->frameLastTouched = frame;
+        }
+
+        entries.forEach([&](uint32_t slot, Payload& entry) {
+          if (entry.frameLastTouched + kFramesToKeep < frame) {
+            index.erase(entry.hash, slot);
+            entries.erase(slot);
+          }
+        });
+      }
+
+      return numCreated;
+    }
+
+    void test_benchmark() {
+      const DrawStream stream = makeDrawStream();
+
+      uint64_t multimapCreated;
+      uint64_t slotMapCreated;
+
+      {
+        std::cout << "Draw stream replay, unordered_multimap: ";
+        Timer time;
+        multimapCreated = replayMultimap(stream);
+      }
+
+      {
+        std::cout << "Draw stream replay, slot map: ";
+        Timer time;
+        slotMapCreated = replaySlotMap(stream);
+      }
+
+      // Both containers must make the same caching decisions
+      if (multimapCreated != slotMapCreated) {
+        throw DxvkError(str::format("Replay mismatch, created ", multimapCreated, " vs ", slotMapCreated, " entries"));
+      }
+    }
+
+  public:
+    void run() {
+      test_slotMap();
+      test_hashIndex();
+      test_benchmark();
+
+      std::cout << "All passed\n";
+    }
+  };
+
+  int TestApp::Object::s_numAlive = 0;
+}
+
+int main() {
+  try {
+    dxvk::TestApp testApp;
+    testApp.run();
+  }
+  catch (const dxvk::DxvkError& error) {
+    std::cerr << error.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}
@@ -23,6 +23,8 @@
 #include <random>
 #include <chrono>
 #include <iostream>
+#include <atomic>
+#include <thread>
 
 #include "../../test_utils.h"
 #include "../../../src/util/util_threadpool.h"
@@ -47,6 +49,22 @@ public:
     test_smoke<4>();
     cout << "Begin misc tests" << endl;
     test_misc();
+    cout << "Begin multi-producer contention test" << endl;
+    test_contention();
+    cout << "Begin held futures test" << endl;
+    test_held_futures();
+    cout << "Begin overflow tests" << endl;
+    test_overflow<false>(TaskOverflowPolicy::Drop);
+    test_overflow<false>(TaskOverflowPolicy::Inline);
+    test_overflow<false>(TaskOverflowPolicy::Block);
+    test_overflow<true>(TaskOverflowPolicy::Drop);
+    test_overflow<true>(TaskOverflowPolicy::Inline);
+    test_overflow<true>(TaskOverflowPolicy::Block);
+    cout << "Begin nested wait test" << endl;
+    test_nested_wait();
+    cout << "Begin continuation tests" << endl;
+    test_continuations<true>();
+    test_continuations<false>();
     cout << "WorkerThreadPool successfully smoke tested" << endl;
   }
   
@@ -96,10 +114,10 @@ private:
           throw DxvkError("Failed to schedule task");
         }
 
-        results[i] = future;
+        results[i] = std::move(future);
 
         if (cancelPeriod > 0 && (i % cancelPeriod) == 0) {
-          future.cancel();
+          results[i].cancel();
         }
       }
 
@@ -180,12 +198,393 @@ private:
 
     // The lambda destructor is executed _after_ the future result is set.
     // We need to either wait for the result to update, or finalize the thread pool.
+    // Note: futures reference their task slots, so they must not outlive the pool.
+    future = Future<void>();
     delete threadPool;
 
     if (result != 2) {
       throw DxvkError("Result didnt match");
     }
   }
+
+  static void waitForCount(const std::atomic<uint32_t>& counter, const uint32_t expected) {
+    auto start = high_resolution_clock::now();
+    while (counter.load() != expected) {
+      if (duration_cast<seconds>(high_resolution_clock::now() - start).count() > 30) {
+        throw DxvkError("Timed out waiting for tasks to complete");
+      }
+      std::this_thread::yield();
+    }
+  }
+
+  static void test_contention() {
+    ZoneScoped;
+    const uint32_t numThreads = 4;
+    const uint32_t numProducers = 4;
+    const uint32_t numTasksPerProducer = 4000;
+    const uint32_t numTasks = numProducers * numTasksPerProducer;
+    const uint32_t numTasksPerThread = 256;
+
+    WorkerThreadPool<numTasksPerThread, true, true, true> threadPool(numThreads, "contention-test", TaskOverflowPolicy::Block);
+    cout << "Created multi-producer thread pool with " << numThreads << " threads" << endl;
+
+    // Note: every held future pins a task slot, so rather than holding on to
+    //  thousands of them, every task tallies its own execution.
+    vector<std::atomic<uint32_t>> executions(numTasks);
+    std::atomic<uint32_t> executed = 0;
+    std::atomic<uint32_t> nestedExecuted = 0;
+    std::atomic<bool> failed = false;
+
+    auto producer = [&](const uint32_t producerId) {
+      for (uint32_t i = 0; i < numTasksPerProducer; i++) {
+        const uint32_t value = producerId * numTasksPerProducer + i;
+
+        auto future = threadPool.Schedule([&, value]() {
+          ++executions[value];
+          ++executed;
+          // Every few tasks schedule from the worker itself, exercising the work stealing deques
+          if ((value % 8) == 0) {
+            auto nested = threadPool.Schedule([&nestedExecuted]() {
+              ++nestedExecuted;
+            });
+            if (!nested.valid()) {
+              failed = true;
+            }
+          }
+        });
+
+        if (!future.valid()) {
+          failed = true;
+        }
+      }
+    };
+
+    const uint64_t s = __rdtsc();
+
+    vector<std::thread> producers;
+    for (uint32_t i = 0; i < numProducers; i++) {
+      producers.emplace_back(producer, i);
+    }
+    for (auto& p : producers) {
+      p.join();
+    }
+
+    waitForCount(executed, numTasks);
+    waitForCount(nestedExecuted, numTasks / 8);
+
+    const uint64_t e = __rdtsc();
+
+    for (auto& execution : executions) {
+      if (execution != 1) {
+        failed = true;
+      }
+    }
+
+    if (failed) {
+      throw DxvkError("Multi-producer results didnt match");
+    }
+
+    cout << "Executed " << numTasks << " tasks (+" << nestedExecuted << " nested) from " << numProducers << " producers in " << e - s << " clocks" << endl;
+
+    FrameMark;
+  }
+
+  static void test_held_futures() {
+    ZoneScoped;
+    const uint32_t numThreads = 4;
+    const uint32_t numProducers = 4;
+    const uint32_t numTasksPerProducer = 4000;
+    const uint32_t windowSize = 12;
+
+    WorkerThreadPool<64, true, true, true> threadPool(numThreads, "held-futures-test", TaskOverflowPolicy::Block);
+
+    // Every producer holds on to its first future while it schedules thousands more, far more than
+    // there are task slots, and keeps a window of futures in flight.  A slot must never be captured
+    // again while its future is held, or the future would return another task's result.
+    vector<Future<uint64_t>> pinned(numProducers);
+    std::atomic<bool> failed = false;
+
+    auto producer = [&](const uint32_t producerId) {
+      auto expected = [producerId](const uint32_t i) -> uint64_t {
+        return ((uint64_t) producerId << 32) | i;
+      };
+
+      pinned[producerId] = threadPool.Schedule([value = expected(0)]() { return value; });
+
+      vector<Future<uint64_t>> window(windowSize);
+      for (uint32_t i = 1; i < numTasksPerProducer; i++) {
+        Future<uint64_t>& future = window[i % windowSize];
+        if (future.valid() && future.get() != expected(i - windowSize)) {
+          failed = true;
+        }
+
+        future = threadPool.Schedule([value = expected(i)]() { return value; });
+        if (!future.valid()) {
+          failed = true;
+        }
+      }
+
+      for (uint32_t i = numTasksPerProducer; i < numTasksPerProducer + windowSize; i++) {
+        Future<uint64_t>& future = window[i % windowSize];
+        if (future.valid() && future.get() != expected(i - windowSize)) {
+          failed = true;
+        }
+      }
+    };
+
+    vector<std::thread> producers;
+    for (uint32_t i = 0; i < numProducers; i++) {
+      producers.emplace_back(producer, i);
+    }
+    for (auto& p : producers) {
+      p.join();
+    }
+
+    // Retrieve the pinned results on a different thread than the one that scheduled them
+    for (uint32_t i = 0; i < numProducers; i++) {
+      if (!pinned[i].valid() || pinned[i].get() != ((uint64_t) i << 32)) {
+        failed = true;
+      }
+    }
+
+    if (failed) {
+      throw DxvkError("Held future returned the wrong result");
+    }
+
+    cout << "Held futures across " << numProducers * numTasksPerProducer << " tasks from " << numProducers << " producers" << endl;
+  }
+
+  template<bool MultiProducer>
+  static void test_overflow(const TaskOverflowPolicy policy) {
+    ZoneScoped;
+    const uint32_t numTasksPerThread = 16;
+    const uint32_t numTasks = 1000;
+
+    std::atomic<bool> gate = false;
+    std::atomic<uint32_t> executed = 0;
+    std::atomic<uint32_t> executedInline = 0;
+    const std::thread::id producerThread = std::this_thread::get_id();
+
+    {
+      WorkerThreadPool<numTasksPerThread, true, true, MultiProducer> threadPool(1, "overflow-test", policy);
+
+      // Park the only worker so the queue fills up deterministically
+      std::atomic<bool> parked = false;
+      auto blocker = threadPool.Schedule([&gate, &parked]() {
+        parked = true;
+        while (!gate.load()) {
+          std::this_thread::yield();
+        }
+      });
+
+      if (!blocker.valid()) {
+        throw DxvkError("Failed to schedule task");
+      }
+
+      // Note: the producer may help execute queued tasks when blocking, make sure it can't pick up the blocker itself
+      while (!parked.load()) {
+        std::this_thread::yield();
+      }
+
+      uint32_t dropped = 0;
+      for (uint32_t i = 0; i < numTasks; i++) {
+        auto future = threadPool.Schedule([&]() {
+          if (std::this_thread::get_id() == producerThread) {
+            ++executedInline;
+          }
+          ++executed;
+        });
+
+        if (!future.valid()) {
+          ++dropped;
+        }
+      }
+
+      gate = true;
+
+      switch (policy) {
+      case TaskOverflowPolicy::Drop:
+        if (dropped == 0 || executedInline != 0) {
+          throw DxvkError("Expected tasks to be dropped on overflow");
+        }
+        break;
+      case TaskOverflowPolicy::Inline:
+        if (dropped != 0 || executedInline == 0) {
+          throw DxvkError("Expected tasks to be executed inline on overflow");
+        }
+        break;
+      case TaskOverflowPolicy::Block:
+        if (dropped != 0) {
+          throw DxvkError("Expected no tasks to be dropped on overflow");
+        }
+        break;
+      }
+
+      waitForCount(executed, numTasks - dropped);
+
+      cout << "Overflow policy " << (uint32_t) policy << (MultiProducer ? " (multi-producer)" : "") << ": " << dropped << " dropped, " << executedInline << " executed on the producer thread" << endl;
+    }
+
+    if (executed != numTasks && policy != TaskOverflowPolicy::Drop) {
+      throw DxvkError("Not all tasks were executed on overflow");
+    }
+  }
+
+  static void test_nested_wait() {
+    ZoneScoped;
+    const uint32_t numThreads = 2;
+    const uint32_t numTasks = 2000;
+
+    WorkerThreadPool<64, true, true, true> threadPool(numThreads, "nested-wait-test", TaskOverflowPolicy::Block);
+
+    // Every worker waits on a task it scheduled itself, which only works
+    // if waiting executes other queued tasks rather than blocking the pool
+    vector<Future<uint32_t>> results(numTasks);
+    for (uint32_t i = 0; i < numTasks; i++) {
+      results[i] = threadPool.Schedule([&threadPool, i]() -> uint32_t {
+        auto inner = threadPool.Schedule([i]() -> uint32_t { return i; });
+        return inner.get() * 2 + 1;
+      });
+
+      // Note: every held future pins a task slot, retrieve results before they run out
+      if (i >= 16) {
+        const uint32_t j = i - 16;
+        if (results[j].get() != j * 2 + 1) {
+          throw DxvkError("Nested task result didnt match");
+        }
+      }
+    }
+
+    for (uint32_t j = numTasks - 16; j < numTasks; j++) {
+      if (results[j].get() != j * 2 + 1) {
+        throw DxvkError("Nested task result didnt match");
+      }
+    }
+
+    cout << "Executed " << numTasks << " nested waits" << endl;
+  }
+
+  template<bool LowLatency>
+  static void test_continuations() {
+    ZoneScoped;
+    const uint32_t numThreads = 4;
+    const uint32_t numTasksPerThread = 256;
+    const uint32_t numChains = 2000;
+    // Note: every chain holds on to a few task slots until its result is retrieved
+    const uint32_t numChainsInFlight = 32;
+
+    WorkerThreadPool<numTasksPerThread, true, LowLatency, true> threadPool(numThreads, "continuation-test", TaskOverflowPolicy::Block);
+
+    // Simple join of two results
+    {
+      auto a = threadPool.Schedule([]() -> uint32_t { return 1; });
+      auto b = threadPool.Schedule([]() -> uint32_t { return 2; });
+      auto sum = threadPool.ScheduleAfter([](Future<uint32_t> a, Future<uint32_t> b) -> uint32_t {
+        return a.get() + b.get();
+      }, std::move(a), std::move(b));
+
+      if (a.valid() || b.valid()) {
+        throw DxvkError("Dependency futures should be consumed by a continuation");
+      }
+
+      if (sum.get() != 3) {
+        throw DxvkError("Continuation result didnt match");
+      }
+    }
+
+    // Void dependencies, an already finished dependency and an invalid one
+    {
+      std::atomic<uint32_t> counter = 0;
+      auto a = threadPool.Schedule([&counter]() { ++counter; });
+      auto b = threadPool.Schedule([&counter]() { ++counter; });
+      threadPool.WhenAll(std::move(a), std::move(b)).get();
+
+      if (counter != 2) {
+        throw DxvkError("WhenAll finished before its dependencies");
+      }
+
+      auto c = threadPool.Schedule([&counter]() -> uint32_t {
+        ++counter;
+        return 7;
+      });
+      waitForCount(counter, 3);
+      std::this_thread::sleep_for(milliseconds(1));
+      auto d = threadPool.ScheduleAfter([](Future<uint32_t> c, Future<uint32_t> dropped) -> uint32_t {
+        return dropped.valid() ? 0 : c.get() * 2;
+      }, std::move(c), Future<uint32_t>());
+      if (d.get() != 14) {
+        throw DxvkError("Continuation of a finished task didnt match");
+      }
+    }
+
+    // Many chains of hash -> bounds -> enqueue style pipelines, waited on in order while other
+    // tasks keep recycling the task slots
+    {
+      vector<Future<uint64_t>> results(numChains);
+      for (uint32_t i = 0; i < numChains; i++) {
+        auto hash = threadPool.Schedule([i]() -> uint64_t { return (uint64_t) i * 31; });
+        auto bounds = threadPool.Schedule([i]() -> uint64_t { return i; });
+        auto combined = threadPool.ScheduleAfter([](Future<uint64_t> hash, Future<uint64_t> bounds) -> uint64_t {
+          return hash.get() + bounds.get();
+        }, std::move(hash), std::move(bounds));
+        results[i] = threadPool.ScheduleAfter([](Future<uint64_t> combined) -> uint64_t {
+          return combined.get() + 1;
+        }, std::move(combined));
+
+        threadPool.Schedule([]() { });
+
+        if (i >= numChainsInFlight) {
+          const uint32_t j = i - numChainsInFlight;
+          if (results[j].get() != (uint64_t) j * 32 + 1) {
+            throw DxvkError("Chained continuation result didnt match");
+          }
+        }
+      }
+
+      for (uint32_t j = numChains - numChainsInFlight; j < numChains; j++) {
+        if (results[j].get() != (uint64_t) j * 32 + 1) {
+          throw DxvkError("Chained continuation result didnt match");
+        }
+      }
+    }
+
+    // Continuations scheduled from within a task
+    {
+      auto outer = threadPool.Schedule([&threadPool]() -> uint32_t {
+        auto inner = threadPool.Schedule([]() -> uint32_t { return 20; });
+        auto next = threadPool.ScheduleAfter([](Future<uint32_t> inner) -> uint32_t { return inner.get() + 1; }, std::move(inner));
+        // Waiting from a worker executes other tasks rather than blocking the pool
+        return next.get() * 2;
+      });
+
+      if (outer.get() != 42) {
+        throw DxvkError("Nested continuation result didnt match");
+      }
+    }
+
+    // Continuations pending while the pool shuts down are cancelled along with their dependencies
+    {
+      std::atomic<bool> gate = false;
+      std::atomic<uint32_t> executed = 0;
+      {
+        WorkerThreadPool<16, true, LowLatency, true> shutdownPool(1, "continuation-shutdown-test", TaskOverflowPolicy::Block);
+        auto blocker = shutdownPool.Schedule([&gate]() {
+          while (!gate.load()) {
+            std::this_thread::yield();
+          }
+        });
+        auto a = shutdownPool.Schedule([&executed]() { ++executed; });
+        shutdownPool.ScheduleAfter([&executed](Future<void> a) { ++executed; }, std::move(a));
+        gate = true;
+      }
+
+      if (executed > 2) {
+        throw DxvkError("Continuation executed more than once");
+      }
+    }
+
+    cout << "Executed " << numChains << " continuation chains" << (LowLatency ? "" : " (sleeping workers)") << endl;
+  }
 };
 
 int main() {
@@ -0,0 +1,365 @@
+/*
+* Copyright (c) 2024, NVIDIA CORPORATION. All rights reserved.
+*
+* Permission is hereby granted, free of charge, to any person obtaining a
+* copy of this software and associated documentation files (the "Software"),
+* to deal in the Software without restriction, including without limitation
+* the rights to use, copy, modify, merge, publish, distribute, sublicense,
+* and/or sell copies of the Software, and to permit persons to whom the
+* Software is furnished to do so, subject to the following conditions:
+*
+* The above copyright notice and this permission notice shall be included in
+* all copies or substantial portions of the Software.
+*
+* THE SOFTWARE IS PROVIDED "AS IS", WITHOUT WARRANTY OF ANY KIND, EXPRESS OR
+* IMPLIED, INCLUDING BUT NOT LIMITED TO THE WARRANTIES OF MERCHANTABILITY,
+* FITNESS FOR A PARTICULAR PURPOSE AND NONINFRINGEMENT.  IN NO EVENT SHALL
+* THE AUTHORS OR COPYRIGHT HOLDERS BE LIABLE FOR ANY CLAIM, DAMAGES OR OTHER
+* LIABILITY, WHETHER IN AN ACTION OF CONTRACT, TORT OR OTHERWISE, ARISING
+* FROM, OUT OF OR IN CONNECTION WITH THE SOFTWARE OR THE USE OR OTHER
+* DEALINGS IN THE SOFTWARE.
+*/
+#include <map>
+#include <random>
+#include <vector>
+
+#include "../../test_utils.h"
+#include "../../../src/util/util_tlsf.h"
+#include "../../../src/util/util_timer.h"
+
+namespace dxvk {
+  // Note: Logger needed by some shared code used in this Unit Test.
+  Logger Logger::s_instance("test_util_tlsf.log");
+}
+
+namespace dxvk {
+  class TestApp {
+    // Worst-fit free list memory chunks used before, kept to compare against
+    class LegacyFreeList {
+    public:
+      explicit LegacyFreeList(uint64_t capacity) {
+        m_freeList.push_back({ 0, capacity });
+      }
+
+      uint64_t alloc(uint64_t size, uint64_t align, uint64_t& length, uint32_t& handle) {
+        handle = 0;
+
+        if (m_freeList.empty())
+          return TlsfAllocator::InvalidOffset;
+
+        auto bestSlice = m_freeList.begin();
+
+        for (auto slice = m_freeList.begin(); slice != m_freeList.end(); slice++) {
+          if (slice->length == size) {
+            bestSlice = slice;
+            break;
+          } else if (slice->length > bestSlice->length) {
+            bestSlice = slice;
+          }
+        }
+
+        const uint64_t sliceStart = bestSlice->offset;
+        const uint64_t sliceEnd = bestSlice->offset + bestSlice->length;
+        const uint64_t allocStart = (sliceStart + align - 1) & ~(align - 1);
+        const uint64_t allocEnd = (allocStart + size + align - 1) & ~(align - 1);
+
+        if (allocEnd > sliceEnd)
+          return TlsfAllocator::InvalidOffset;
+
+        m_freeList.erase(bestSlice);
+
+        if (allocStart != sliceStart)
+          m_freeList.push_back({ sliceStart, allocStart - sliceStart });
+        if (allocEnd != sliceEnd)
+          m_freeList.push_back({ allocEnd, sliceEnd - allocEnd });
+
+        length = allocEnd - allocStart;
+        return allocStart;
+      }
+
+      void free(uint64_t offset, uint64_t length) {
+        auto curr = m_freeList.begin();
+
+        while (curr != m_freeList.end()) {
+          if (curr->offset == offset + length) {
+            length += curr->length;
+            curr = m_freeList.erase(curr);
+          } else if (curr->offset + curr->length == offset) {
+            offset -= curr->length;
+            length += curr->length;
+            curr = m_freeList.erase(curr);
+          } else {
+            curr++;
+          }
+        }
+
+        m_freeList.push_back({ offset, length });
+      }
+
+    private:
+      struct FreeSlice {
+        uint64_t offset;
+        uint64_t length;
+      };
+
+      std::vector<FreeSlice> m_freeList;
+    };
+
+    // Checks the free ranges against the live allocations, offset -> length
+    static void validate(const TlsfAllocator& tlsf, const std::map<uint64_t, uint64_t>& live) {
+      uint64_t expectedFree = tlsf.capacity();
+      uint64_t end = 0;
+
+      for (const auto& [offset, length] : live) {
+        if (offset < end)
+          throw DxvkError(str::format("Allocations overlap at ", offset));
+        end = offset + length;
+        expectedFree -= length;
+      }
+
+      if (end > tlsf.capacity())
+        throw DxvkError("Allocation past the end of the range");
+
+      uint64_t freeBytes = 0;
+      uint64_t freeRanges = 0;
+      uint64_t largest = 0;
+      uint64_t previousEnd = ~0ull;
+
+      tlsf.forEachFreeRange([&] (uint64_t offset, uint64_t size) {
+        if (offset == previousEnd)
+          throw DxvkError(str::format("Adjacent free ranges were not coalesced at ", offset));
+
+        // A free range must not overlap any allocation
+        auto next = live.lower_bound(offset);
+        if (next != live.end() && next->first < offset + size)
+          throw DxvkError(str::format("Free range overlaps allocation at ", next->first));
+        if (next != live.begin() && std::prev(next)->first + std::prev(next)->second > offset)
+          throw DxvkError(str::format("Free range overlaps allocation before ", offset));
+
+        previousEnd = offset + size;
+        freeBytes += size;
+        freeRanges += 1;
+        largest = std::max(largest, size);
+      });
+
+      if (freeBytes != expectedFree || tlsf.getStats().freeBytes != expectedFree)
+        throw DxvkError(str::format("Free bytes mismatch, expected ", expectedFree, " got ", freeBytes, " and ", tlsf.getStats().freeBytes));
+      if (freeRanges != tlsf.getStats().freeRanges)
+        throw DxvkError("Free range count mismatch");
+      if (live.size() != tlsf.getStats().allocations)
+        throw DxvkError("Allocation count mismatch");
+      if (largest != tlsf.largestFreeRange())
+        throw DxvkError(str::format("Largest free range mismatch, expected ", largest, " got ", tlsf.largestFreeRange()));
+    }
+
+    void test_basic() {
+      TlsfAllocator tlsf(1024);
+      std::map<uint64_t, uint64_t> live;
+      uint64_t length;
+      uint32_t handleA, handleB, handle;
+
+      // Aligned allocations also have their length rounded up
+      const uint64_t a = tlsf.alloc(100, 64, length, handleA);
+      if (a != 0 || length != 128)
+        throw DxvkError("Unexpected first allocation");
+      live[a] = length;
+
+      const uint64_t b = tlsf.alloc(1, 256, length, handleB);
+      if (b == TlsfAllocator::InvalidOffset || (b & 255) != 0 || length != 256)
+        throw DxvkError("Unexpected aligned allocation");
+      live[b] = length;
+      validate(tlsf, live);
+
+      // Too large for what is left
+      if (tlsf.alloc(1024, 1, length, handle) != TlsfAllocator::InvalidOffset)
+        throw DxvkError("Allocation larger than the free space succeeded");
+
+      tlsf.free(handleA);
+      live.erase(a);
+      validate(tlsf, live);
+
+      tlsf.free(handleB);
+      live.erase(b);
+      validate(tlsf, live);
+
+      if (!tlsf.isEmpty() || tlsf.getStats().freeRanges != 1 || tlsf.largestFreeRange() != 1024)
+        throw DxvkError("Range not fully coalesced after freeing everything");
+
+      // The whole range can be handed out at once, and in single bytes
+      const uint64_t all = tlsf.alloc(1024, 1024, length, handle);
+      if (all != 0 || length != 1024 || tlsf.getStats().freeRanges != 0)
+        throw DxvkError("Failed to allocate the whole range");
+      tlsf.free(handle);
+
+      std::vector<uint32_t> bytes;
+      for (uint32_t i = 0; i < 1024; i++) {
+        if (tlsf.alloc(1, 1, length, handle) != i)
+          throw DxvkError("Single byte allocations are not packed");
+        bytes.push_back(handle);
+      }
+
+      if (tlsf.alloc(1, 1, length, handle) != TlsfAllocator::InvalidOffset)
+        throw DxvkError("Allocation from a full range succeeded");
+
+      for (uint32_t i = 0; i < 1024; i += 2)
+        tlsf.free(bytes[i]);
+      if (tlsf.getStats().freeRanges != 512 || tlsf.largestFreeRange() != 1)
+        throw DxvkError("Unexpected fragmentation");
+
+      for (uint32_t i = 1; i < 1024; i += 2)
+        tlsf.free(bytes[i]);
+      if (tlsf.getStats().freeRanges != 1 || tlsf.largestFreeRange() != 1024)
+        throw DxvkError("Range not fully coalesced after freeing single bytes");
+    }
+
+    void test_alignedFallback() {
+      // Only an exactly sized aligned range is left, which the padded
+      // search cannot find and the fallback to the class has to.
+      TlsfAllocator tlsf(4 << 20);
+      uint64_t length;
+      uint32_t handle;
+
+      std::vector<uint64_t> offsets;
+      std::vector<uint32_t> handles;
+      for (uint32_t i = 0; i < 64; i++) {
+        offsets.push_back(tlsf.alloc(64 << 10, 64 << 10, length, handle));
+        handles.push_back(handle);
+      }
+
+      tlsf.free(handles[17]);
+
+      if (tlsf.alloc(64 << 10, 64 << 10, length, handle) != offsets[17])
+        throw DxvkError("Exactly fitting aligned range was not found");
+    }
+
+    void test_fuzz() {
+      std::mt19937 rng(4321);
+
+      for (const uint64_t capacity : { 1ull << 12, 1ull << 20, 256ull << 20, 6ull << 30 }) {
+        TlsfAllocator tlsf(capacity);
+        std::map<uint64_t, uint64_t> live;
+        std::vector<std::pair<uint64_t, uint32_t>> offsets;
+
+        for (uint32_t i = 0; i < 20000; i++) {
+          if (offsets.empty() || rng() % 100 < 55) {
+            // Mostly small sizes, with the occasional large one
+            const uint32_t shift = rng() % 100 < 90 ? rng() % 12 : rng() % 28;
+            const uint64_t size = 1 + rng() % (uint64_t(1) << shift);
+            const uint64_t align = uint64_t(1) << (rng() % 17);
+            uint64_t length;
+            uint32_t handle;
+
+            const uint64_t offset = tlsf.alloc(size, align, length, handle);
+
+            if (offset == TlsfAllocator::InvalidOffset)
+              continue;
+
+            if ((offset & (align - 1)) != 0 || length < size || (length & (align - 1)) != 0)
+              throw DxvkError(str::format("Bad allocation of ", size, " aligned to ", align, " at ", offset, ", length ", length));
+
+            live[offset] = length;
+            offsets.emplace_back(offset, handle);
+          } else {
+            const size_t index = rng() % offsets.size();
+            const auto [offset, handle] = offsets[index];
+            offsets[index] = offsets.back();
+            offsets.pop_back();
+
+            if (tlsf.free(handle) != live[offset])
+              throw DxvkError("Freed length does not match the allocation");
+            live.erase(offset);
+          }
+
+          if (i % 97 == 0)
+            validate(tlsf, live);
+        }
+
+        validate(tlsf, live);
+
+        for (const auto& [offset, handle] : offsets)
+          tlsf.free(handle);
+
+        if (tlsf.getStats().freeRanges != 1 || tlsf.getStats().freeBytes != capacity)
+          throw DxvkError("Range not fully coalesced after fuzzing");
+      }
+    }
+
+    // Many live small slices, the situation of chunks backing RTX buffers
+    template<typename Allocator, typename FreeFn>
+    static void churn(Allocator& allocator, const FreeFn& freeFn, const uint32_t liveCount, const uint32_t iterations) {
+      struct Slice {
+        uint64_t offset;
+        uint64_t length;
+        uint32_t handle;
+      };
+
+      std::mt19937 rng(777);
+      std::vector<Slice> live;
+      uint64_t length;
+      uint32_t handle;
+
+      for (uint32_t i = 0; i < liveCount; i++) {
+        const uint64_t offset = allocator.alloc(256 + (rng() % 16) * 256, 256, length, handle);
+        if (offset != TlsfAllocator::InvalidOffset)
+          live.push_back({ offset, length, handle });
+      }
+
+      Timer time;
+
+      for (uint32_t i = 0; i < iterations; i++) {
+        const size_t index = rng() % live.size();
+        freeFn(allocator, live[index]);
+
+        const uint64_t offset = allocator.alloc(256 + (rng() % 16) * 256, 256, length, handle);
+        if (offset == TlsfAllocator::InvalidOffset)
+          throw DxvkError("Benchmark allocation failed");
+        live[index] = { offset, length, handle };
+      }
+
+    }
+
+    void test_benchmark() {
+      constexpr uint64_t kCapacity = 256 << 20;
+
+      for (const uint32_t liveCount : { 100u, 1000u, 10000u }) {
+        std::cout << std::endl << liveCount << " live slices" << std::endl;
+
+        {
+          std::cout << "Running: worst-fit free list --> ";
+          LegacyFreeList legacy(kCapacity);
+          churn(legacy, [] (LegacyFreeList& a, const auto& slice) { a.free(slice.offset, slice.length); }, liveCount, 20000);
+        }
+
+        {
+          std::cout << "Running: TLSF --> ";
+          TlsfAllocator tlsf(kCapacity);
+          churn(tlsf, [] (TlsfAllocator& a, const auto& slice) { a.free(slice.handle); }, liveCount, 20000);
+        }
+      }
+    }
+
+  public:
+    void run() {
+      test_basic();
+      test_alignedFallback();
+      test_fuzz();
+
+      std::cout << "TLSF allocator successfully tested for correctness" << std::endl;
+
+      test_benchmark();
+    }
+  };
+}
+
+int main() {
+  try {
+    dxvk::TestApp app;
+    app.run();
+  }
+  catch (const dxvk::DxvkError& e) {
+    std::cerr << e.message() << std::endl;
+    throw;
+  }
+
+  return 0;
+}